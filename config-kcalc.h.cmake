@@ -16,6 +16,9 @@
 /* Define if you have libgmp */
 #define HAVE_GMP 1
 
+/* Define if exceptions thrown by the GMP allocation functions get through GMP */
+#cmakedefine KNUMBER_THROWING_ALLOCATOR 1
+
 /* Define if you have support for long double in printf */
 #define HAVE_LONG_DOUBLE 1
 
@@ -27,7 +27,6 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include <clocale>
 
 #include <QApplication>
-#include <QCursor>
 #include <QKeyEvent>
 #include <QShortcut>
 #include <QStyle>
@@ -43,6 +42,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include <kcolormimedata.h>
 #include <kconfig.h>
 #include <kconfigdialog.h>
+#include <kdebug.h>
 #include <kdialog.h>
 #include <kglobal.h>
 #include <kglobalsettings.h>
@@ -66,6 +66,9 @@ namespace {
 const char description[] = I18N_NOOP("KDE Calculator");
 const char version[]	 = KCALCVERSION;
 const int maxprecision   = 1000;
+
+// how long an operation may take before the display shows that it is busy
+const int busy_delay     = 100;
 }
 
 
@@ -80,7 +83,9 @@ KCalculator::KCalculator(QWidget *parent) :
 		memory_num_(0.0),
 		constants_menu_(0),
 		constants_(0),
-		core() {
+		core(),
+		core_busy_(false),
+		settings_pending_(false) {
 
 	// central widget to contain all the elements
 	QWidget *const central = new QWidget(this);
@@ -165,6 +170,9 @@ KCalculator::KCalculator(QWidget *parent) :
 	connect(KGlobalSettings::self(), SIGNAL(kdisplayPaletteChanged()), SLOT(setColors()));
 	connect(KGlobalSettings::self(), SIGNAL(kdisplayFontChanged()), SLOT(setFonts()));
 
+	connect(&core_watcher_, SIGNAL(finished()), SLOT(slotCoreFinished()));
+	connect(calc_display, SIGNAL(cancelClicked()), SLOT(slotCancelclicked()));
+
 	calc_display->setFocus();
 }
 
@@ -174,7 +182,29 @@ KCalculator::KCalculator(QWidget *parent) :
 //------------------------------------------------------------------------------
 KCalculator::~KCalculator() {
 
+	if (core_busy_) {
+		core.cancel();
+		core_watcher_.waitForFinished();
+	}
+
 	KCalcSettings::self()->writeConfig();
+
+#ifdef KNUMBER_STATISTICS
+	const KNumber::Statistics s = KNumber::statistics();
+	kDebug() << "knumber objects allocated:" << s.objectsAllocated
+	         << "inline spills:" << s.inlineSpills
+	         << "inlined:" << s.inlined;
+	kDebug() << "knumber conversions: integer to float:" << s.integerToFloat
+	         << "integer to fraction:" << s.integerToFraction
+	         << "fraction to float:" << s.fractionToFloat
+	         << "fraction to integer:" << s.fractionToInteger
+	         << "float to integer:" << s.floatToInteger;
+	kDebug() << "knumber mpq_canonicalize calls:" << s.canonicalizations
+	         << "limb bytes:" << s.limbBytes
+	         << "fractions over the limb budget:" << s.fractionOverflows;
+	kDebug() << "knumber result cache hits:" << s.cacheHits
+	         << "misses:" << s.cacheMisses;
+#endif
 }
 
 //------------------------------------------------------------------------------
@@ -823,6 +853,11 @@ void KCalculator::slotBaseSelected(int base) {
 //------------------------------------------------------------------------------
 void KCalculator::keyPressEvent(QKeyEvent *e) {
 
+	if (core_busy_ && e->key() == Qt::Key_Escape) {
+		slotCancelclicked();
+		return;
+	}
+
 	// Fix for bug #314586
 	// Basically, on some keyboards such as French, even though the decimal separator
 	// is "," the numeric keypad has a "." key. So we fake it so people can more seamlessly
@@ -972,12 +1007,8 @@ void KCalculator::slotMemRecallclicked() {
 //------------------------------------------------------------------------------
 void KCalculator::slotMemStoreclicked() {
 
-	EnterEqual();
-
-	memory_num_ = calc_display->getAmount();
-	calc_display->setStatusText(MemField, QLatin1String("M"));
-	statusBar()->changeItem(QLatin1String("M"), MemField);
-	pbMemRecall->setEnabled(true);
+	// finish calculation so far, the result is stored once it is done
+	startCore(core.startOperation(calc_display->getAmount(), CalcEngine::FUNC_EQUAL), UPDATE_FROM_CORE | UPDATE_STORE_RESULT | UPDATE_MEMORY_STORE);
 }
 
 //------------------------------------------------------------------------------
@@ -1054,19 +1085,9 @@ void KCalculator::slotPlusMinusclicked() {
 //------------------------------------------------------------------------------
 void KCalculator::slotMemPlusMinusclicked() {
 
-	bool tmp_shift_mode = shift_mode_; // store this, because next command deletes shift_mode_
-	EnterEqual(); // finish calculation so far, to store result into MEM
-
-	if (!tmp_shift_mode) {
-		memory_num_ += calc_display->getAmount();
-	} else {
-		memory_num_ -= calc_display->getAmount();
-	}
-
-	pbShift->setChecked(false);
-	statusBar()->changeItem(i18n("M"), MemField);
-	calc_display->setStatusText(MemField, i18n("M"));
-	pbMemRecall->setEnabled(true);
+	// the shift mode is reset once the calculation so far is done
+	const UpdateFlags memory_flag = shift_mode_ ? UPDATE_MEMORY_SUBTRACT : UPDATE_MEMORY_ADD;
+	startCore(core.startOperation(calc_display->getAmount(), CalcEngine::FUNC_EQUAL), UPDATE_FROM_CORE | UPDATE_STORE_RESULT | memory_flag);
 }
 
 //------------------------------------------------------------------------------
@@ -1121,7 +1142,7 @@ void KCalculator::slotCosclicked() {
 void KCalculator::slotReciclicked() {
 
 	if (shift_mode_) {
-		core.enterOperation(calc_display->getAmount(), CalcEngine::FUNC_BINOM);
+		startCore(core.startOperation(calc_display->getAmount(), CalcEngine::FUNC_BINOM), 0);
 	} else {
 		core.Reciprocal(calc_display->getAmount());
 		updateDisplay(UPDATE_FROM_CORE);
@@ -1186,17 +1207,13 @@ void KCalculator::slotTanclicked() {
 //------------------------------------------------------------------------------
 void KCalculator::slotFactorialclicked() {
 
-    // Set WaitCursor, as this operation may take looooong
-    // time and UI frezes with large numbers. User needs some
-    // visual feedback.
-    QApplication::setOverrideCursor(QCursor(Qt::WaitCursor));
+	// this may take a long time with large numbers, so it runs on
+	// another thread and can be canceled
 	if (!shift_mode_) {
-	    core.Factorial(calc_display->getAmount());
+		startCore(core.startFunction(&CalcEngine::Factorial, calc_display->getAmount()), UPDATE_FROM_CORE);
 	} else {
-		core.Gamma(calc_display->getAmount());
+		startCore(core.startFunction(&CalcEngine::Gamma, calc_display->getAmount()), UPDATE_FROM_CORE);
 	}
-    QApplication::restoreOverrideCursor();
-    updateDisplay(UPDATE_FROM_CORE);
 }
 
 //------------------------------------------------------------------------------
@@ -1266,10 +1283,10 @@ void KCalculator::slotLnclicked() {
 void KCalculator::slotPowerclicked() {
 
 	if (shift_mode_) {
-		core.enterOperation(calc_display->getAmount(), CalcEngine::FUNC_PWR_ROOT);
+		startCore(core.startOperation(calc_display->getAmount(), CalcEngine::FUNC_PWR_ROOT), 0);
 		pbShift->setChecked(false);
 	} else {
-		core.enterOperation(calc_display->getAmount(), CalcEngine::FUNC_POWER);
+		startCore(core.startOperation(calc_display->getAmount(), CalcEngine::FUNC_POWER), 0);
 	}
 
 	// temp. work-around
@@ -1335,8 +1352,7 @@ void KCalculator::slotParenOpenclicked() {
 //------------------------------------------------------------------------------
 void KCalculator::slotParenCloseclicked() {
 
-    core.ParenClose(calc_display->getAmount());
-    updateDisplay(UPDATE_FROM_CORE);
+    startCore(core.startFunction(&CalcEngine::ParenClose, calc_display->getAmount()), UPDATE_FROM_CORE);
 }
 
 //------------------------------------------------------------------------------
@@ -1345,8 +1361,7 @@ void KCalculator::slotParenCloseclicked() {
 //------------------------------------------------------------------------------
 void KCalculator::slotANDclicked() {
 
-	core.enterOperation(calc_display->getAmount(), CalcEngine::FUNC_AND);
-	updateDisplay(UPDATE_FROM_CORE);
+	startCore(core.startOperation(calc_display->getAmount(), CalcEngine::FUNC_AND), UPDATE_FROM_CORE);
 }
 
 //------------------------------------------------------------------------------
@@ -1355,8 +1370,7 @@ void KCalculator::slotANDclicked() {
 //------------------------------------------------------------------------------
 void KCalculator::slotMultiplicationclicked() {
 
-	core.enterOperation(calc_display->getAmount(), CalcEngine::FUNC_MULTIPLY);
-	updateDisplay(UPDATE_FROM_CORE);
+	startCore(core.startOperation(calc_display->getAmount(), CalcEngine::FUNC_MULTIPLY), UPDATE_FROM_CORE);
 }
 
 //------------------------------------------------------------------------------
@@ -1365,8 +1379,7 @@ void KCalculator::slotMultiplicationclicked() {
 //------------------------------------------------------------------------------
 void KCalculator::slotDivisionclicked() {
 
-    core.enterOperation(calc_display->getAmount(), CalcEngine::FUNC_DIVIDE);
-    updateDisplay(UPDATE_FROM_CORE);
+    startCore(core.startOperation(calc_display->getAmount(), CalcEngine::FUNC_DIVIDE), UPDATE_FROM_CORE);
 }
 
 //------------------------------------------------------------------------------
@@ -1375,8 +1388,7 @@ void KCalculator::slotDivisionclicked() {
 //------------------------------------------------------------------------------
 void KCalculator::slotORclicked() {
 
-	core.enterOperation(calc_display->getAmount(), CalcEngine::FUNC_OR);
-	updateDisplay(UPDATE_FROM_CORE);
+	startCore(core.startOperation(calc_display->getAmount(), CalcEngine::FUNC_OR), UPDATE_FROM_CORE);
 }
 
 //------------------------------------------------------------------------------
@@ -1385,8 +1397,7 @@ void KCalculator::slotORclicked() {
 //------------------------------------------------------------------------------
 void KCalculator::slotXORclicked() {
 
-	core.enterOperation(calc_display->getAmount(), CalcEngine::FUNC_XOR);
-	updateDisplay(UPDATE_FROM_CORE);
+	startCore(core.startOperation(calc_display->getAmount(), CalcEngine::FUNC_XOR), UPDATE_FROM_CORE);
 }
 
 //------------------------------------------------------------------------------
@@ -1395,8 +1406,7 @@ void KCalculator::slotXORclicked() {
 //------------------------------------------------------------------------------
 void KCalculator::slotPlusclicked() {
 
-	core.enterOperation(calc_display->getAmount(), CalcEngine::FUNC_ADD);
-	updateDisplay(UPDATE_FROM_CORE);
+	startCore(core.startOperation(calc_display->getAmount(), CalcEngine::FUNC_ADD), UPDATE_FROM_CORE);
 }
 
 //------------------------------------------------------------------------------
@@ -1405,8 +1415,7 @@ void KCalculator::slotPlusclicked() {
 //------------------------------------------------------------------------------
 void KCalculator::slotMinusclicked() {
 
-    core.enterOperation(calc_display->getAmount(), CalcEngine::FUNC_SUBTRACT);
-    updateDisplay(UPDATE_FROM_CORE);
+    startCore(core.startOperation(calc_display->getAmount(), CalcEngine::FUNC_SUBTRACT), UPDATE_FROM_CORE);
 }
 
 //------------------------------------------------------------------------------
@@ -1415,8 +1424,7 @@ void KCalculator::slotMinusclicked() {
 //------------------------------------------------------------------------------
 void KCalculator::slotLeftShiftclicked() {
 
-	core.enterOperation(calc_display->getAmount(), CalcEngine::FUNC_LSH);
-	updateDisplay(UPDATE_FROM_CORE);
+	startCore(core.startOperation(calc_display->getAmount(), CalcEngine::FUNC_LSH), UPDATE_FROM_CORE);
 }
 
 //------------------------------------------------------------------------------
@@ -1425,8 +1433,7 @@ void KCalculator::slotLeftShiftclicked() {
 //------------------------------------------------------------------------------
 void KCalculator::slotRightShiftclicked() {
 
-    core.enterOperation(calc_display->getAmount(), CalcEngine::FUNC_RSH);
-    updateDisplay(UPDATE_FROM_CORE);
+    startCore(core.startOperation(calc_display->getAmount(), CalcEngine::FUNC_RSH), UPDATE_FROM_CORE);
 }
 
 //------------------------------------------------------------------------------
@@ -1440,23 +1447,13 @@ void KCalculator::slotPeriodclicked() {
     calc_display->newCharacter(KGlobal::locale()->decimalSymbol()[0]);
 }
 
-//------------------------------------------------------------------------------
-// Name: EnterEqual
-// Desc: calculates and displays the result of the pending operations
-//------------------------------------------------------------------------------
-void KCalculator::EnterEqual() {
-
-    core.enterOperation(calc_display->getAmount(), CalcEngine::FUNC_EQUAL);
-    updateDisplay(UPDATE_FROM_CORE | UPDATE_STORE_RESULT);
-}
-
 //------------------------------------------------------------------------------
 // Name: slotEqualclicked
 // Desc: calculates and displays the result of the pending operations
 //------------------------------------------------------------------------------
 void KCalculator::slotEqualclicked() {
 
-    EnterEqual();
+    startCore(core.startOperation(calc_display->getAmount(), CalcEngine::FUNC_EQUAL), UPDATE_FROM_CORE | UPDATE_STORE_RESULT);
 }
 
 //------------------------------------------------------------------------------
@@ -1465,8 +1462,7 @@ void KCalculator::slotEqualclicked() {
 //------------------------------------------------------------------------------
 void KCalculator::slotPercentclicked() {
 
-    core.enterOperation(calc_display->getAmount(), CalcEngine::FUNC_PERCENT);
-    updateDisplay(UPDATE_FROM_CORE);
+    startCore(core.startOperation(calc_display->getAmount(), CalcEngine::FUNC_PERCENT), UPDATE_FROM_CORE);
 }
 
 //------------------------------------------------------------------------------
@@ -1487,12 +1483,10 @@ void KCalculator::slotNegateclicked() {
 void KCalculator::slotModclicked(){
 
 	if (shift_mode_) {
-		core.enterOperation(calc_display->getAmount(), CalcEngine::FUNC_INTDIV);
+		startCore(core.startOperation(calc_display->getAmount(), CalcEngine::FUNC_INTDIV), UPDATE_FROM_CORE);
 	} else {
-		core.enterOperation(calc_display->getAmount(), CalcEngine::FUNC_MOD);
+		startCore(core.startOperation(calc_display->getAmount(), CalcEngine::FUNC_MOD), UPDATE_FROM_CORE);
 	}
-
-	updateDisplay(UPDATE_FROM_CORE);
 }
 
 //------------------------------------------------------------------------------
@@ -1634,6 +1628,11 @@ void KCalculator::slotConstclicked(int button) {
 //------------------------------------------------------------------------------
 void KCalculator::showSettings() {
 
+	// the settings change KNumber, which the engine may be using
+	if (core_busy_) {
+		return;
+	}
+
 	// Check if there is already a dialog and if so bring
 	// it to the foreground.
 	if (KConfigDialog::showDialog(QLatin1String("settings"))) {
@@ -2090,6 +2089,16 @@ void KCalculator::slotUpdateBitset(const KNumber &nr) {
 //------------------------------------------------------------------------------
 void KCalculator::updateSettings() {
 
+	// the settings change KNumber, which the engine may be using. a settings
+	// dialog opened before the computation started can still apply them, so
+	// they wait until it has finished
+	if (core_busy_) {
+		settings_pending_ = true;
+		return;
+	}
+
+	settings_pending_ = false;
+
 	changeButtonNames();
 	setColors();
 	setFonts();
@@ -2124,6 +2133,101 @@ void KCalculator::updateDisplay(UpdateFlags flags) {
 
 }
 
+//------------------------------------------------------------------------------
+// Name: updateMemory
+// Desc: puts the displayed result into memory for the memory keys
+//------------------------------------------------------------------------------
+void KCalculator::updateMemory(UpdateFlags flags) {
+
+	if (flags & UPDATE_MEMORY_STORE) {
+		memory_num_ = calc_display->getAmount();
+	} else if (flags & UPDATE_MEMORY_ADD) {
+		memory_num_ += calc_display->getAmount();
+	} else if (flags & UPDATE_MEMORY_SUBTRACT) {
+		memory_num_ -= calc_display->getAmount();
+	} else {
+		return;
+	}
+
+	statusBar()->changeItem(i18n("M"), MemField);
+	calc_display->setStatusText(MemField, i18n("M"));
+	pbMemRecall->setEnabled(true);
+}
+
+//------------------------------------------------------------------------------
+// Name: startCore
+// Desc: waits for a computation on the engine a moment, and if it takes
+//       longer lets it go on while the display shows that it is busy
+//------------------------------------------------------------------------------
+void KCalculator::startCore(const QFuture<KNumber> &future, UpdateFlags flags) {
+
+	Q_ASSERT(!core_busy_);
+
+	core_update_flags_ = flags;
+	core_busy_         = true;
+	core_watcher_.setFuture(future);
+
+	// most operations are done long before anyone could notice, for these
+	// nothing changes, they finish before the next key is handled. the
+	// engine is done with them once it says so, the future right after
+	if (core.waitForFinished(busy_delay)) {
+		core_watcher_.waitForFinished();
+		slotCoreFinished();
+	} else {
+		setCoreBusy(true);
+	}
+}
+
+//------------------------------------------------------------------------------
+// Name: setCoreBusy
+// Desc: keeps the buttons from being used while the engine is busy
+//------------------------------------------------------------------------------
+void KCalculator::setCoreBusy(bool busy) {
+
+	leftPad->setEnabled(!busy);
+	numericPad->setEnabled(!busy);
+	rightPad->setEnabled(!busy);
+	mBitset->setEnabled(!busy);
+	menuBar()->setEnabled(!busy);
+	calc_display->setBusy(busy);
+}
+
+//------------------------------------------------------------------------------
+// Name: slotCoreFinished
+// Desc: shows the result of the computation started by startCore()
+//------------------------------------------------------------------------------
+void KCalculator::slotCoreFinished() {
+
+	// the watcher reports a computation which startCore() already handled
+	if (!core_busy_ || !core_watcher_.isFinished()) {
+		return;
+	}
+
+	core_busy_ = false;
+	setCoreBusy(false);
+
+	// if canceled, the engine is as it was before and so is the display
+	if (!core.canceled()) {
+		updateDisplay(core_update_flags_);
+		updateMemory(core_update_flags_);
+	}
+
+	if (settings_pending_) {
+		updateSettings();
+	}
+}
+
+//------------------------------------------------------------------------------
+// Name: slotCancelclicked
+// Desc: stops the computation running on the engine
+//------------------------------------------------------------------------------
+void KCalculator::slotCancelclicked() {
+
+	if (core_busy_) {
+		core.cancel();
+	}
+}
+
 //------------------------------------------------------------------------------
 // Name: setColors
 // Desc: set the various colours
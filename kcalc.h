@@ -56,6 +56,7 @@ class KCalcConstMenu;
 #include "ui_colors.h"
 
 #include <QFlags>
+#include <QFutureWatcher>
 
 #include <kxmlguiwindow.h>
 
@@ -106,8 +107,11 @@ signals:
 
 public:
     enum UpdateFlag {
-        UPDATE_FROM_CORE    = 1,
-        UPDATE_STORE_RESULT = 2
+        UPDATE_FROM_CORE       = 1,
+        UPDATE_STORE_RESULT    = 2,
+        UPDATE_MEMORY_STORE    = 4,
+        UPDATE_MEMORY_ADD      = 8,
+        UPDATE_MEMORY_SUBTRACT = 16
     };
     
     Q_DECLARE_FLAGS(UpdateFlags, UpdateFlag)
@@ -133,6 +137,11 @@ private:
     void setBase();
 
     void updateDisplay(UpdateFlags flags);
+    void updateMemory(UpdateFlags flags);
+
+    // the display is updated with flags once the future has finished
+    void startCore(const QFuture<KNumber> &future, UpdateFlags flags);
+    void setCoreBusy(bool busy);
 	
     // button sets
     void showMemButtons(bool toggled);
@@ -147,7 +156,6 @@ protected slots:
     void updateSettings();
     void setColors();
     void setFonts();
-    void EnterEqual();
     void showSettings();
 
     // Mode
@@ -217,6 +225,9 @@ protected slots:
     void slotBitsetChanged(quint64);
     void slotUpdateBitset(const KNumber &);
 
+    void slotCoreFinished();
+    void slotCancelclicked();
+
 private:
     enum StatusField {
         ShiftField = 0,
@@ -273,6 +284,14 @@ private:
     QList<QAbstractButton*> operation_button_list_;
 
     CalcEngine core;
+
+    // the computation running on the engine, see startCore()
+    QFutureWatcher<KNumber> core_watcher_;
+    UpdateFlags             core_update_flags_;
+    bool                    core_busy_;
+
+    // settings applied while the engine was busy, see updateSettings()
+    bool                    settings_pending_;
 };
 
 Q_DECLARE_OPERATORS_FOR_FLAGS(KCalculator::UpdateFlags)
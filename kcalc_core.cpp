@@ -25,6 +25,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
 #include "kcalc_core.h"
+#include <QtConcurrentRun>
 #include <kdebug.h>
 #include <klocale.h>
 #include <kmessagebox.h>
@@ -32,19 +33,19 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 namespace {
 
 KNumber Deg2Rad(const KNumber &x) {
-	return x * (KNumber::Pi() / KNumber(180));
+	return x * KNumber::PiOver180();
 }
 
 KNumber Gra2Rad(const KNumber &x) {
-	return x * (KNumber::Pi() / KNumber(200));
+	return x * KNumber::PiOver200();
 }
 
 KNumber Rad2Deg(const KNumber &x) {
-	 return x * (KNumber(180) / KNumber::Pi());
+	 return x / KNumber::PiOver180();
 }
 
 KNumber Rad2Gra(const KNumber &x) {
-	return x * (KNumber(200) / KNumber::Pi());
+	return x / KNumber::PiOver200();
 }
 
 bool error_;
@@ -170,7 +171,7 @@ const struct operator_data Operator[] = {
 }
 
 
-CalcEngine::CalcEngine() : percent_mode_(false) {
+CalcEngine::CalcEngine() : percent_mode_(false), canceled_(false) {
 
     last_number_ = KNumber::Zero;
     error_ = false;
@@ -571,16 +572,18 @@ void CalcEngine::Log10(const KNumber &input)
     }
 }
 
-void CalcEngine::ParenClose(KNumber input)
+void CalcEngine::ParenClose(const KNumber &input)
 {
+    KNumber result = input;
+
     // evaluate stack until corresponding opening bracket
     while (!stack_.isEmpty()) {
         Node tmp_node = stack_.pop();
         if (tmp_node.operation == FUNC_BRACKET)
             break;
-        input = evalOperation(tmp_node.number, tmp_node.operation, input);
+        result = evalOperation(tmp_node.number, tmp_node.operation, result);
     }
-    last_number_ = input;
+    last_number_ = result;
     return;
 }
 
@@ -884,4 +887,94 @@ void CalcEngine::Reset()
     stack_.clear();
 }
 
+QFuture<KNumber> CalcEngine::startFunction(Function function, const KNumber &input)
+{
+    cancel_ = 0;
+    finished_.tryAcquire(finished_.available());
+    return QtConcurrent::run(this, &CalcEngine::runFunction, function, input);
+}
+
+QFuture<KNumber> CalcEngine::startOperation(const KNumber &num, Operation func)
+{
+    cancel_ = 0;
+    finished_.tryAcquire(finished_.available());
+    return QtConcurrent::run(this, &CalcEngine::runOperation, num, func);
+}
+
+bool CalcEngine::waitForFinished(int msecs)
+{
+    if (!finished_.tryAcquire(1, msecs)) {
+        return false;
+    }
+
+    finished_.release();
+    return true;
+}
+
+void CalcEngine::cancel()
+{
+    cancel_.fetchAndStoreOrdered(1);
+}
+
+bool CalcEngine::canceled() const
+{
+    return canceled_;
+}
+
+CalcEngine::State CalcEngine::state() const
+{
+    State s;
+    s.stack        = stack_;
+    s.last_number  = last_number_;
+    s.stats        = stats;
+    s.percent_mode = percent_mode_;
+    s.error        = error_;
+    return s;
+}
+
+void CalcEngine::setState(const State &state)
+{
+    stack_        = state.stack;
+    last_number_  = state.last_number;
+    stats         = state.stats;
+    percent_mode_ = state.percent_mode;
+    error_        = state.error;
+}
+
+KNumber CalcEngine::runFunction(Function function, const KNumber &input)
+{
+    const State before = state();
+
+    KNumber::setCancelFlag(&cancel_);
+    (this->*function)(input);
+    KNumber::setCancelFlag(0);
+
+    canceled_ = (cancel_ != 0);
+    if (canceled_) {
+        setState(before);
+    }
+
+    const KNumber result = canceled_ ? KNumber::NaN : last_number_;
+    finished_.release();
+    return result;
+}
+
+KNumber CalcEngine::runOperation(const KNumber &num, Operation func)
+{
+    const State before = state();
+
+    KNumber::setCancelFlag(&cancel_);
+    enterOperation(num, func);
+    KNumber::setCancelFlag(0);
+
+    canceled_ = (cancel_ != 0);
+    if (canceled_) {
+        setState(before);
+    }
+
+    const KNumber result = canceled_ ? KNumber::NaN : last_number_;
+    finished_.release();
+    return result;
+}
+
 
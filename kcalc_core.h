@@ -22,6 +22,9 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #ifndef KCALC_CORE_H_
 #define KCALC_CORE_H_
 
+#include <QAtomicInt>
+#include <QFuture>
+#include <QSemaphore>
 #include <QStack>
 #include "stats.h"
 #include "knumber.h"
@@ -81,7 +84,7 @@ public:
     void InvertSign(const KNumber &input);
     void Ln(const KNumber &input);
     void Log10(const KNumber &input);
-    void ParenClose(KNumber input);
+    void ParenClose(const KNumber &input);
     void ParenOpen(const KNumber &input);
     void Reciprocal(const KNumber &input);
     void SinDeg(const KNumber &input);
@@ -107,6 +110,27 @@ public:
 
     void Reset();
 
+public:
+    // any of the functions above taking a number, for startFunction()
+    typedef void (CalcEngine::*Function)(const KNumber &);
+
+    // run a function or enterOperation() on a worker thread, the future
+    // gives what lastOutput() does afterwards. nothing else may be called
+    // on the engine until it has finished. a canceled computation leaves
+    // the engine as it was before and gives NaN
+    QFuture<KNumber> startFunction(Function function, const KNumber &input);
+    QFuture<KNumber> startOperation(const KNumber &num, Operation func);
+
+    // waits up to msecs for the computation started last to finish,
+    // returns whether it has
+    bool waitForFinished(int msecs);
+
+    // may be called from any thread
+    void cancel();
+
+    // whether the last computation started gave up, once it has finished
+    bool canceled() const;
+
 private:
     KStats stats;
 
@@ -140,6 +164,28 @@ private:
 
     bool percent_mode_;
 
+    // set by cancel(), checked by the expensive KNumber functions while
+    // startFunction() and startOperation() run
+    QAtomicInt cancel_;
+    bool canceled_;
+
+    // released once by each computation when it is done
+    QSemaphore finished_;
+
+    struct State {
+        QStack<Node> stack;
+        KNumber last_number;
+        KStats stats;
+        bool percent_mode;
+        bool error;
+    };
+
+    State state() const;
+    void setState(const State &state);
+
+    KNumber runFunction(Function function, const KNumber &input);
+    KNumber runOperation(const KNumber &num, Operation func);
+
     bool evalStack();
 
     KNumber evalOperation(const KNumber &arg1, Operation operation, const KNumber &arg2);
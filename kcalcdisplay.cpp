@@ -27,8 +27,10 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include <QStyle>
 #include <QStyleOption>
 #include <QTimer>
+#include <QToolButton>
 
 #include <kglobal.h>
+#include <kicon.h>
 #include <klocale.h>
 #include <knotification.h>
 
@@ -44,7 +46,8 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 KCalcDisplay::KCalcDisplay(QWidget *parent) : QFrame(parent), beep_(false), 
 		groupdigits_(true), twoscomplement_(true), button_(0), lit_(false),
 		num_base_(NB_DECIMAL), precision_(9), fixed_precision_(-1), display_amount_(0), 
-		history_index_(0), selection_timer_(new QTimer(this)) {
+		history_index_(0), selection_timer_(new QTimer(this)), busy_(false),
+		busy_timer_(new QTimer(this)), cancel_button_(new QToolButton(this)) {
 		
 	setFocusPolicy(Qt::StrongFocus);
 
@@ -56,10 +59,25 @@ KCalcDisplay::KCalcDisplay(QWidget *parent) : QFrame(parent), beep_(false),
 
 	KNumber::setDefaultFloatOutput(true);
 	KNumber::setDefaultFractionalInput(true);
+	KNumber::setLazyFractionReduction(true);
+	KNumber::setFractionLimbBudget(1024);
+	KNumber::setMemoryBudget(Q_UINT64_C(256) << 20, Q_UINT64_C(1) << 30);
+	KNumber::setResultCacheSize(Q_UINT64_C(32) << 20);
 
 	connect(this, SIGNAL(clicked()), this, SLOT(slotDisplaySelected()));
 	connect(selection_timer_, SIGNAL(timeout()), this, SLOT(slotSelectionTimedOut()));
 
+	cancel_button_->setIcon(KIcon(QLatin1String("process-stop")));
+	cancel_button_->setToolTip(i18n("Cancel the calculation"));
+	cancel_button_->setAutoRaise(true);
+	cancel_button_->setFocusPolicy(Qt::NoFocus);
+	cancel_button_->hide();
+
+	busy_timer_->setInterval(100);
+
+	connect(cancel_button_, SIGNAL(clicked()), this, SIGNAL(cancelClicked()));
+	connect(busy_timer_, SIGNAL(timeout()), this, SLOT(slotBusyTimedOut()));
+
 	sendEvent(EventReset);
 }
 
@@ -129,6 +147,52 @@ void KCalcDisplay::updateFromCore(const CalcEngine &core, bool store_result_in_h
 	}
 }
 
+//------------------------------------------------------------------------------
+// Name: setBusy
+// Desc: shows or hides the elapsed time and the cancel button
+//------------------------------------------------------------------------------
+void KCalcDisplay::setBusy(bool busy) {
+
+	if (busy == busy_) {
+		return;
+	}
+
+	busy_ = busy;
+	if (busy_) {
+		busy_time_.start();
+		busy_timer_->start();
+		placeCancelButton();
+		cancel_button_->show();
+	} else {
+		busy_timer_->stop();
+		cancel_button_->hide();
+	}
+
+	update();
+}
+
+//------------------------------------------------------------------------------
+// Name: slotBusyTimedOut
+// Desc: 
+//------------------------------------------------------------------------------
+void KCalcDisplay::slotBusyTimedOut() {
+
+	update();
+}
+
+//------------------------------------------------------------------------------
+// Name: placeCancelButton
+// Desc: puts the cancel button on the side opposite to the text
+//------------------------------------------------------------------------------
+void KCalcDisplay::placeCancelButton() {
+
+	const QRect cr = contentsRect();
+	const QSize sz = cancel_button_->sizeHint();
+	const QRect r(cr.left(), cr.top() + (cr.height() - sz.height()) / 2, sz.width(), sz.height());
+
+	cancel_button_->setGeometry(QStyle::visualRect(layoutDirection(), cr, r));
+}
+
 //------------------------------------------------------------------------------
 // Name: enterDigit
 // Desc: 
@@ -929,7 +993,12 @@ void KCalcDisplay::paintEvent(QPaintEvent *) {
 	cr.adjust(margin*2, 0, -margin*2, 0);   // provide a margin
 	
 	const int align = QStyle::visualAlignment(layoutDirection(), Qt::AlignRight | Qt::AlignVCenter);
-	painter.drawText(cr, align | Qt::TextSingleLine, text_);
+	if (busy_) {
+		const QString seconds = KGlobal::locale()->formatNumber(busy_time_.elapsed() / 1000.0, 1);
+		painter.drawText(cr, align | Qt::TextSingleLine, i18n("Calculating... %1 s", seconds));
+	} else {
+		painter.drawText(cr, align | Qt::TextSingleLine, text_);
+	}
 
 	// draw the status texts using half of the normal
 	// font size but not smaller than 7pt
@@ -946,6 +1015,16 @@ void KCalcDisplay::paintEvent(QPaintEvent *) {
 	}
 }
 
+//------------------------------------------------------------------------------
+// Name: resizeEvent
+// Desc: 
+//------------------------------------------------------------------------------
+void KCalcDisplay::resizeEvent(QResizeEvent *e) {
+
+	QFrame::resizeEvent(e);
+	placeCancelButton();
+}
+
 //------------------------------------------------------------------------------
 // Name: sizeHint
 // Desc: 
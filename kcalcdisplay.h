@@ -22,6 +22,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #ifndef KCALCDISPLAY_H_
 #define KCALCDISPLAY_H_
 
+#include <QElapsedTimer>
 #include <QFrame>
 #include <QVector>
 #include "knumber.h"
@@ -29,6 +30,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 class CalcEngine;
 class KAction;
 class QTimer;
+class QToolButton;
 class QStyleOptionFrame;
 
 #define NUM_STATUS_TEXT 4
@@ -97,6 +99,10 @@ public:
     void updateFromCore(const CalcEngine &core,
                         bool store_result_in_history = false);
 
+    // while busy, the time spent so far is shown instead of the number,
+    // together with a button which emits cancelClicked()
+    void setBusy(bool busy);
+
 public slots:
     void slotCut();
     void slotCopy();
@@ -106,18 +112,22 @@ signals:
     void clicked();
     void changedText(const QString &);
     void changedAmount(const KNumber &);
+    void cancelClicked();
 
 protected:
     void  mousePressEvent(QMouseEvent *) override;
     void paintEvent(QPaintEvent *p) override;
+    void resizeEvent(QResizeEvent *e) override;
 
 private:
     bool changeSign();
     void invertColors();
     void initStyleOption(QStyleOptionFrame *option) const;
+    void placeCancelButton();
 
 private slots:
     void slotSelectionTimedOut();
+    void slotBusyTimedOut();
     void slotDisplaySelected();
     void slotHistoryBack();
     void slotHistoryForward();
@@ -151,6 +161,11 @@ private:
     QString str_status_[NUM_STATUS_TEXT];
 
     QTimer* selection_timer_;
+
+    bool          busy_;
+    QElapsedTimer busy_time_;
+    QTimer*       busy_timer_;
+    QToolButton*  cancel_button_;
 };
 
 #endif
@@ -18,18 +18,31 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include <config-kcalc.h>
 #include "knumber.h"
+#include "knumber_allocator.h"
+#include "knumber_context.h"
 #include "knumber_base.h"
 #include "knumber_error.h"
 #include "knumber_float.h"
+#include "knumber_formatter.h"
 #include "knumber_fraction.h"
 #include "knumber_integer.h"
+#include "knumber_overflow.h"
+#include "knumber_statistics.h"
+#include <QByteArray>
 #include <QDebug>
-#include <QRegExp>
-#include <QStringList>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QVarLengthArray>
+#include <QtEndian>
+#include <atomic>
 #include <cmath>
+#include <functional>
+#include <limits>
+#include <list>
+#include <new>
+#include <unordered_map>
+#include <utility>
 
-QString KNumber::GroupSeparator   = QLatin1String(",");
-QString KNumber::DecimalSeparator = QLatin1String(".");
 
 const KNumber KNumber::Zero(QLatin1String("0"));
 const KNumber KNumber::One(QLatin1String("1"));
@@ -39,333 +52,1228 @@ const KNumber KNumber::NegInfinity(QLatin1String("-inf"));
 const KNumber KNumber::NaN(QLatin1String("nan"));
 
 namespace {
-namespace impl {
-
-//------------------------------------------------------------------------------
-// Name: increment
-//------------------------------------------------------------------------------
-void increment(QString &str, int position) {
-
-    for (int i = position; i >= 0; i--) {
-        const char last_char = str[i].toLatin1();
-        switch (last_char) {
-        case '0':
-            str[i] = QLatin1Char('1');
-            break;
-        case '1':
-            str[i] = QLatin1Char('2');
-            break;
-        case '2':
-            str[i] = QLatin1Char('3');
-            break;
-        case '3':
-            str[i] = QLatin1Char('4');
-            break;
-        case '4':
-            str[i] = QLatin1Char('5');
-            break;
-        case '5':
-            str[i] = QLatin1Char('6');
-            break;
-        case '6':
-            str[i] = QLatin1Char('7');
-            break;
-        case '7':
-            str[i] = QLatin1Char('8');
-            break;
-        case '8':
-            str[i] = QLatin1Char('9');
-            break;
-        case '9':
-            str[i] = QLatin1Char('0');
-            if (i == 0) {
-				str.prepend(QLatin1Char('1'));
-			}
-            continue;
-        case '.':
-            continue;
-        }
-        break;
-    }
+
+//------------------------------------------------------------------------------
+// Name: release
+// Desc: drops a reference to a value, the last one deletes it
+//------------------------------------------------------------------------------
+void release(detail::knumber_base *p) {
+	if(p && !p->deref()) {
+		delete p;
+	}
+}
+}
+
+//------------------------------------------------------------------------------
+// Name: operand
+// Desc: presents either representation of a KNumber as a knumber_base so it
+//       can be handed to the detail classes. an inline integer is
+//       materialized on the stack, so no heap object is created for it
+//------------------------------------------------------------------------------
+class KNumber::operand {
+public:
+	explicit operand(const KNumber &n) : p_(n.value_) {
+		if(!p_) {
+			p_ = ::new (&storage_) detail::knumber_base(std::in_place_type<detail::knumber_integer>, n.small_);
+		}
+	}
+
+	~operand() {
+		if(p_ == reinterpret_cast<detail::knumber_base *>(&storage_)) {
+			p_->~knumber_base();
+		}
+	}
+
+private:
+	operand(const operand &);
+	operand &operator=(const operand &);
+
+public:
+	detail::knumber_base *get() const { return p_; }
+
+private:
+	detail::knumber_base *p_;
+	typename std::aligned_storage<sizeof(detail::knumber_base), alignof(detail::knumber_base)>::type storage_;
+};
+
+//------------------------------------------------------------------------------
+// Name: parser
+// Desc: a single pass scanner for the syntax KNumber(const QString &) accepts.
+//       it only notes where the digits are, they are then read straight into
+//       a qint64 or into the GMP types
+//------------------------------------------------------------------------------
+class KNumber::parser {
+public:
+	explicit parser(const QString &s) : s_(s.constData()), size_(s.size()), pos_(0), negative_(false), exponent_negative_(false) {
+	}
+
+private:
+	parser(const parser &);
+	parser &operator=(const parser &);
+
+public:
+	void parse(KNumber *n);
+
+private:
+	typedef QVarLengthArray<char, 128> buffer;
+
+	// [first, last) of a run of digits
+	struct span {
+		int first;
+		int last;
+		int size() const { return last - first; }
+	};
+
+private:
+	bool accept(char ch);
+	bool accept(const QString &s);
+	span digits();
+	bool accumulate(const span &d, bool negative, qint64 *value) const;
+	void append(buffer &buf, const span &d) const;
+	void to_mpz(mpz_t z, const span &d) const;
+
+private:
+	void parse_integer(KNumber *n);
+	void parse_fraction(KNumber *n);
+	void parse_float(KNumber *n);
+	bool parse_decimal_fraction(KNumber *n);
+
+private:
+	const QChar *const s_;
+	const int          size_;
+	int                pos_;
+	bool               negative_;
+	bool               exponent_negative_;
+	span               integer_;
+	span               fraction_;
+	span               exponent_;
+};
+
+//------------------------------------------------------------------------------
+// Name: accept
+//------------------------------------------------------------------------------
+bool KNumber::parser::accept(char ch) {
+	if(pos_ < size_ && s_[pos_].unicode() == static_cast<ushort>(ch)) {
+		++pos_;
+		return true;
+	}
+	return false;
+}
+
+//------------------------------------------------------------------------------
+// Name: accept
+//------------------------------------------------------------------------------
+bool KNumber::parser::accept(const QString &s) {
+	const int n = s.size();
+	if(n > size_ - pos_) {
+		return false;
+	}
+
+	const QChar *const p = s.constData();
+	for(int i = 0; i < n; ++i) {
+		if(s_[pos_ + i] != p[i]) {
+			return false;
+		}
+	}
+
+	pos_ += n;
+	return true;
 }
 
 //------------------------------------------------------------------------------
-// Name: round
+// Name: digits
+//------------------------------------------------------------------------------
+KNumber::parser::span KNumber::parser::digits() {
+	span d;
+	d.first = pos_;
+	while(pos_ < size_ && s_[pos_].unicode() >= '0' && s_[pos_].unicode() <= '9') {
+		++pos_;
+	}
+	d.last = pos_;
+	return d;
+}
+
 //------------------------------------------------------------------------------
-void round(QString &str, int precision) {
+// Name: accumulate
+// Desc: appends the digits to *value, fails if the result doesn't fit
+//------------------------------------------------------------------------------
+bool KNumber::parser::accumulate(const span &d, bool negative, qint64 *value) const {
+
+	qint64 v = *value;
+	for(int i = d.first; i < d.last; ++i) {
+		const qint64 digit = s_[i].unicode() - '0';
+		if(detail::mul_overflow(v, 10, &v) || (negative ? detail::sub_overflow(v, digit, &v) : detail::add_overflow(v, digit, &v))) {
+			return false;
+		}
+	}
+
+	*value = v;
+	return true;
+}
+
+//------------------------------------------------------------------------------
+// Name: append
+//------------------------------------------------------------------------------
+void KNumber::parser::append(buffer &buf, const span &d) const {
+	for(int i = d.first; i < d.last; ++i) {
+		buf.append(static_cast<char>(s_[i].unicode()));
+	}
+}
+
+//------------------------------------------------------------------------------
+// Name: to_mpz
+//------------------------------------------------------------------------------
+void KNumber::parser::to_mpz(mpz_t z, const span &d) const {
+	buffer buf;
+	append(buf, d);
+	buf.append('\0');
+	mpz_set_str(z, buf.constData(), 10);
+}
+
+//------------------------------------------------------------------------------
+// Name: parse
+// Desc: the accepted forms are inf, -inf and nan, [+-]digits,
+//       [+-]digits/digits and [+-][digits][separator digits][e[+-]digits].
+//       anything else is NaN
+//------------------------------------------------------------------------------
+void KNumber::parser::parse(KNumber *n) {
+
+	if(!accept('-')) {
+		accept('+');
+	} else {
+		negative_ = true;
+	}
 
-	// Cut off if more digits in fractional part than 'precision'
+	integer_ = digits();
 
-    int decimalSymbolPos = str.indexOf(QLatin1Char('.'));
+	if(integer_.size() != 0) {
+		if(pos_ == size_) {
+			parse_integer(n);
+			return;
+		}
 
-    if (decimalSymbolPos == -1) {
-        if (precision == 0) {
-            return;
-        } else if (precision > 0) {   // add dot if missing (and needed)
-            str.append(QLatin1Char('.'));
-            decimalSymbolPos = str.length() - 1;
-        }
-    }
+		if(accept('/')) {
+			fraction_ = digits();
+			if(fraction_.size() != 0 && pos_ == size_) {
+				parse_fraction(n);
+			} else {
+				n->value_ = detail::knumber_base::create<detail::knumber_error>(detail::knumber_error::ERROR_UNDEFINED);
+			}
+			return;
+		}
+	}
 
-    // fill up with more than enough zeroes (in case fractional part too short)
-    str.append(QString().fill(QLatin1Char('0'), precision));
+	if(accept(KNumberContext::active().decimalSeparator())) {
+		fraction_ = digits();
+	} else {
+		fraction_.first = fraction_.last = pos_;
+	}
 
-    // Now decide whether to round up or down
-    const char last_char = str[decimalSymbolPos + precision + 1].toLatin1();
-    switch (last_char) {
-    case '0':
-    case '1':
-    case '2':
-    case '3':
-    case '4':
-        // nothing to do, rounding down
-        break;
-    case '5':
-    case '6':
-    case '7':
-    case '8':
-    case '9':
-        // rounding up
-        increment(str, decimalSymbolPos + precision);
-        break;
-    default:
-        break;
-    }
+	exponent_.first = exponent_.last = pos_;
+	if(accept('e')) {
+		if(!accept('-')) {
+			accept('+');
+		} else {
+			exponent_negative_ = true;
+		}
 
-    decimalSymbolPos = str.indexOf(QLatin1Char('.'));
-    str.truncate(decimalSymbolPos + precision + 1);
+		exponent_ = digits();
+		if(exponent_.size() == 0) {
+			n->value_ = detail::knumber_base::create<detail::knumber_error>(detail::knumber_error::ERROR_UNDEFINED);
+			return;
+		}
+	}
+
+	if(pos_ != size_) {
+		n->value_ = detail::knumber_base::create<detail::knumber_error>(detail::knumber_error::ERROR_UNDEFINED);
+		return;
+	}
 
-    // if precision == 0 delete also '.'
-    if (precision == 0) {
-        str = str.section(QLatin1Char('.'), 0, 0);
-    }
+	// nothing which GMP could read, this has always come out as 0
+	if(integer_.size() == 0 && fraction_.size() == 0) {
+		return;
+	}
+
+	if(KNumberContext::active().fractionalInput() && parse_decimal_fraction(n)) {
+		return;
+	}
+
+	parse_float(n);
 }
+
+//------------------------------------------------------------------------------
+// Name: parse_integer
+//------------------------------------------------------------------------------
+void KNumber::parser::parse_integer(KNumber *n) {
+
+	qint64 v = 0;
+	if(accumulate(integer_, negative_, &v)) {
+		n->small_ = v;
+		return;
+	}
+
+	n->value_ = detail::knumber_base::create<detail::knumber_integer>(0);
+	detail::knumber_integer *const i = n->value_->get<detail::knumber_integer>();
+	to_mpz(i->mpz_, integer_);
+	if(negative_) {
+		mpz_neg(i->mpz_, i->mpz_);
+	}
 }
 
 //------------------------------------------------------------------------------
-// Name: round
+// Name: parse_fraction
 //------------------------------------------------------------------------------
-QString round(const QString &s, int precision) {
+void KNumber::parser::parse_fraction(KNumber *n) {
+
+	qint64 num = 0;
+	qint64 den = 0;
+	if(accumulate(integer_, negative_, &num) && accumulate(fraction_, false, &den)) {
+		if(den == 0) {
+			n->value_ = detail::knumber_base::create<detail::knumber_error>(detail::knumber_error::ERROR_UNDEFINED);
+			return;
+		}
+
+		n->value_ = detail::knumber_base::create<detail::knumber_fraction>(num, static_cast<quint64>(den));
+	} else {
+		n->value_ = detail::knumber_base::create<detail::knumber_fraction>(Q_INT64_C(0), Q_UINT64_C(1));
+		detail::knumber_fraction *const q = n->value_->get<detail::knumber_fraction>();
+		to_mpz(mpq_numref(q->mpq_), integer_);
+		to_mpz(mpq_denref(q->mpq_), fraction_);
+		if(negative_) {
+			mpz_neg(mpq_numref(q->mpq_), mpq_numref(q->mpq_));
+		}
+
+		if(mpz_sgn(mpq_denref(q->mpq_)) == 0) {
+			n->value_->emplace<detail::knumber_error>(detail::knumber_error::ERROR_UNDEFINED);
+			return;
+		}
 
-	QString tmp = s;
-    if (precision < 0 || !QRegExp(QLatin1String("^[+-]?\\d+(\\.\\d+)*(e[+-]?\\d+)?$")).exactMatch(tmp)) {
-        return s;
-    }
+		q->reduce_lazily();
+	}
 
-    // Skip the sign (for now)
-    const bool neg = (tmp[0] == QLatin1Char('-'));
-    if (neg || tmp[0] == QLatin1Char('+')) {
-        tmp.remove(0, 1);
-    }
+	n->simplify();
+}
 
-    // Split off exponential part (including 'e'-symbol)
-    QString mantString = tmp.section(QLatin1Char('e'), 0, 0, QString::SectionCaseInsensitiveSeps);
-    QString expString  = tmp.section(QLatin1Char('e'), 1, 1, QString::SectionCaseInsensitiveSeps | QString::SectionIncludeLeadingSep);
+//------------------------------------------------------------------------------
+// Name: parse_float
+//------------------------------------------------------------------------------
+void KNumber::parser::parse_float(KNumber *n) {
 
-    if (expString.length() == 1) {
-        expString.clear();
-    }
+	// GMP only knows about the US style decimal point
+	buffer buf;
+	if(negative_) {
+		buf.append('-');
+	}
 
-    impl::round(mantString, precision);
+	append(buf, integer_);
 
-    if (neg) {
-        mantString.prepend(QLatin1Char('-'));
-    }
+	if(fraction_.size() != 0) {
+		buf.append('.');
+		append(buf, fraction_);
+	}
 
-    return mantString + expString;
+	if(exponent_.size() != 0) {
+		buf.append('e');
+		if(exponent_negative_) {
+			buf.append('-');
+		}
+		append(buf, exponent_);
+	}
+
+	buf.append('\0');
+
+	n->value_ = detail::knumber_base::create<detail::knumber_float>(0.0);
+	mpf_set_str(n->value_->get<detail::knumber_float>()->mpf_, buf.constData(), 10);
+	n->simplify();
 }
+
+//------------------------------------------------------------------------------
+// Name: parse_decimal_fraction
+// Desc: reads a decimal number as an exact fraction, 1.25e1 is taken as
+//       125/10. returns false if the exponent is too large to do this, the
+//       number is read as a float then
+//------------------------------------------------------------------------------
+bool KNumber::parser::parse_decimal_fraction(KNumber *n) {
+
+	qint64 exponent = 0;
+	if(!accumulate(exponent_, exponent_negative_, &exponent) || exponent > std::numeric_limits<int>::max() / 2 || exponent < std::numeric_limits<int>::min() / 2) {
+		return false;
+	}
+
+	const qint64 scale = fraction_.size() - exponent;
+
+	qint64 num = 0;
+	if(scale >= 0 && scale <= 18 && accumulate(integer_, negative_, &num) && accumulate(fraction_, negative_, &num)) {
+		quint64 den = 1;
+		for(qint64 i = 0; i < scale; ++i) {
+			den *= 10;
+		}
+		n->value_ = detail::knumber_base::create<detail::knumber_fraction>(num, den);
+	} else {
+		n->value_ = detail::knumber_base::create<detail::knumber_fraction>(Q_INT64_C(0), Q_UINT64_C(1));
+		detail::knumber_fraction *const q = n->value_->get<detail::knumber_fraction>();
+
+		buffer buf;
+		append(buf, integer_);
+		append(buf, fraction_);
+		buf.append('\0');
+		mpz_set_str(mpq_numref(q->mpq_), buf.constData(), 10);
+		if(negative_) {
+			mpz_neg(mpq_numref(q->mpq_), mpq_numref(q->mpq_));
+		}
+
+		if(scale >= 0) {
+			mpz_ui_pow_ui(mpq_denref(q->mpq_), 10, static_cast<unsigned long>(scale));
+		} else {
+			mpz_t factor;
+			mpz_init(factor);
+			mpz_ui_pow_ui(factor, 10, static_cast<unsigned long>(-scale));
+			mpz_mul(mpq_numref(q->mpq_), mpq_numref(q->mpq_), factor);
+			mpz_clear(factor);
+		}
+
+		q->reduce_lazily();
+	}
+
+	n->simplify();
+	return true;
 }
 
+//------------------------------------------------------------------------------
+// Name: result_cache
+// Desc: results of the expensive functions by operation, operands and float
+//       precision. the entries are in the order they were last used in, the
+//       ones at the back are dropped when the cache grows over its size.
+//       results are only kept if they are on the heap and not an error, so a
+//       result which was canceled or over a memory budget is never returned
+//------------------------------------------------------------------------------
+class KNumber::result_cache {
+public:
+	enum Operation {
+		FACTORIAL,
+		TGAMMA,
+		BIN,
+		POW
+	};
+
+public:
+	static bool find(Operation op, const KNumber &x, const KNumber &y, KNumber *result) {
+
+		if(capacity.load(std::memory_order_relaxed) == 0) {
+			return false;
+		}
+
+		const std::size_t h = hash(op, x, y);
+
+		QMutexLocker locker(&mutex());
+		cache &c = instance();
+
+		const std::pair<index_type::iterator, index_type::iterator> range = c.index.equal_range(h);
+		for(index_type::iterator it = range.first; it != range.second; ++it) {
+			const entry_type::iterator e = it->second;
+			if(e->op == op && e->precision == KNumberContext::active().floatPrecisionBits() && same(e->x, x) && same(e->y, y)) {
+				KNUMBER_COUNT(CACHE_HITS);
+				c.entries.splice(c.entries.begin(), c.entries, e);
+				*result = e->result;
+				return true;
+			}
+		}
+
+		KNUMBER_COUNT(CACHE_MISSES);
+		return false;
+	}
+
+	static void insert(Operation op, const KNumber &x, const KNumber &y, const KNumber &result) {
+
+		const std::size_t limit = capacity.load(std::memory_order_relaxed);
+		if(limit == 0 || !result.value_ || result.value_->type() == detail::knumber_base::TYPE_ERROR) {
+			return;
+		}
+
+		const std::size_t bytes = size(x) + size(y) + size(result);
+		if(bytes > limit) {
+			return;
+		}
+
+		const std::size_t h = hash(op, x, y);
+
+		QMutexLocker locker(&mutex());
+		cache &c = instance();
+
+		entry e;
+		e.op        = op;
+		e.precision = KNumberContext::active().floatPrecisionBits();
+		e.x         = x;
+		e.y         = y;
+		e.result    = result;
+		e.hash      = h;
+		e.bytes     = bytes;
+
+		c.entries.push_front(e);
+		c.index.insert(std::make_pair(h, c.entries.begin()));
+		c.bytes += bytes;
+
+		trim(&c, limit);
+	}
+
+	static void set_size(std::size_t bytes) {
+		QMutexLocker locker(&mutex());
+		capacity.store(bytes, std::memory_order_relaxed);
+		trim(&instance(), bytes);
+	}
+
+	static void clear() {
+		QMutexLocker locker(&mutex());
+		trim(&instance(), 0);
+	}
+
+private:
+	struct entry {
+		Operation   op;
+		mp_bitcnt_t precision;
+		KNumber     x;
+		KNumber     y;
+		KNumber     result;
+		std::size_t hash;
+		std::size_t bytes;
+	};
+
+	typedef std::list<entry>                                            entry_type;
+	typedef std::unordered_multimap<std::size_t, entry_type::iterator> index_type;
+
+	struct cache {
+		cache() : bytes(0) {
+		}
+
+		entry_type  entries;
+		index_type  index;
+		std::size_t bytes;
+	};
+
+private:
+	static QMutex &mutex() {
+		static QMutex m;
+		return m;
+	}
+
+	static cache &instance() {
+		static cache c;
+		return c;
+	}
+
+	// drops the least recently used entries until the cache is down to this
+	// many bytes
+	static void trim(cache *c, std::size_t limit) {
+		while(c->bytes > limit) {
+			const entry &e = c->entries.back();
+
+			const std::pair<index_type::iterator, index_type::iterator> range = c->index.equal_range(e.hash);
+			for(index_type::iterator it = range.first; it != range.second; ++it) {
+				if(&*it->second == &e) {
+					c->index.erase(it);
+					break;
+				}
+			}
+
+			c->bytes -= e.bytes;
+			c->entries.pop_back();
+		}
+	}
+
+	// values are only the same if they are also of the same type, the result
+	// of 5! and 5.0! are not
+	static bool same(const KNumber &a, const KNumber &b) {
+		return a.type() == b.type() && a.compare(b) == 0;
+	}
+
+	static std::size_t hash(Operation op, const KNumber &x, const KNumber &y) {
+		return hash(x) * 31 + hash(y) * 7 + op;
+	}
+
+	// cheap rather than good, equal hashes are told apart by same()
+	static std::size_t hash(const KNumber &x) {
+
+		if(!x.value_) {
+			return std::hash<qint64>()(x.small_);
+		}
+
+		signed long int exp = 0;
+		double mantissa = 0;
+
+		switch(x.value_->type()) {
+		case detail::knumber_base::TYPE_INTEGER:
+			mantissa = mpz_get_d_2exp(&exp, x.value_->get<detail::knumber_integer>()->mpz_);
+			break;
+		case detail::knumber_base::TYPE_FLOAT:
+			mantissa = mpf_get_d_2exp(&exp, x.value_->get<detail::knumber_float>()->mpf_);
+			break;
+		case detail::knumber_base::TYPE_FRACTION:
+			mantissa = mpq_get_d(x.value_->get<detail::knumber_fraction>()->mpq_);
+			break;
+		case detail::knumber_base::TYPE_ERROR:
+			break;
+		}
+
+		return std::hash<double>()(mantissa) ^ (std::hash<long>()(exp) << 1) ^ x.value_->type();
+	}
+
+	// about how much memory a value takes
+	static std::size_t size(const KNumber &x) {
+
+		std::size_t bytes = sizeof(KNumber);
+
+		if(!x.value_) {
+			return bytes;
+		}
+
+		switch(x.value_->type()) {
+		case detail::knumber_base::TYPE_INTEGER:
+			bytes += sizeof(detail::knumber_base) + mpz_size(x.value_->get<detail::knumber_integer>()->mpz_) * sizeof(mp_limb_t);
+			break;
+		case detail::knumber_base::TYPE_FLOAT:
+			bytes += sizeof(detail::knumber_base) + (mpf_get_prec(x.value_->get<detail::knumber_float>()->mpf_) / GMP_NUMB_BITS + 2) * sizeof(mp_limb_t);
+			break;
+		case detail::knumber_base::TYPE_FRACTION: {
+				const detail::knumber_fraction *const p = x.value_->get<detail::knumber_fraction>();
+				bytes += sizeof(detail::knumber_base) + (mpz_size(mpq_numref(p->mpq_)) + mpz_size(mpq_denref(p->mpq_))) * sizeof(mp_limb_t);
+			}
+			break;
+		case detail::knumber_base::TYPE_ERROR:
+			bytes += sizeof(detail::knumber_base);
+			break;
+		}
+
+		return bytes;
+	}
+
+private:
+	static std::atomic<std::size_t> capacity;
+};
+
+std::atomic<std::size_t> KNumber::result_cache::capacity(0);
+
+//------------------------------------------------------------------------------
+// Name: serializer
+// Desc: the binary form of serialize() and deserialize(), version 1. it is
+//       little endian throughout:
+//
+//         0  u8   version
+//         1  u8   KNumber::Type
+//         2  i8   sign, -1, 0 or 1. nan is 0 and the infinities -1 and 1
+//         3  u8   0
+//         4  u32  the precision of a float in bits, 0 for the other types
+//         8  u32  words in the integer, the numerator or the mantissa
+//        12  u32  words in the denominator, 0 for the other types
+//        16  i64  floats only: the exponent, the value is mantissa * 2^exponent
+//
+//       followed by the words of the magnitudes, 64 bits each and the least
+//       significant first. they start 8 byte aligned, so on most machines
+//       mpz_import can copy them straight into the limbs
+//------------------------------------------------------------------------------
+class KNumber::serializer {
+public:
+	static QByteArray write(const KNumber &x) {
+
+		if(!x.value_) {
+			const quint64 magnitude = (x.small_ < 0) ? -static_cast<quint64>(x.small_) : static_cast<quint64>(x.small_);
+			const quint32 words     = (magnitude != 0) ? 1 : 0;
+
+			QByteArray data(header_size + words * word_size, '\0');
+			uchar *const p = write_header(data, TYPE_INTEGER, sign(x.small_), 0, words, 0);
+			if(words) {
+				qToLittleEndian<quint64>(magnitude, p);
+			}
+			return data;
+		}
+
+		switch(x.value_->type()) {
+		case detail::knumber_base::TYPE_INTEGER: {
+				const mpz_srcptr z = x.value_->get<detail::knumber_integer>()->mpz_;
+				const quint32 words = word_count(z);
+
+				QByteArray data(header_size + words * word_size, '\0');
+				write_words(write_header(data, TYPE_INTEGER, mpz_sgn(z), 0, words, 0), z);
+				return data;
+			}
+		case detail::knumber_base::TYPE_FRACTION: {
+				const mpq_srcptr q = x.value_->get<detail::knumber_fraction>()->mpq_;
+				const quint32 words     = word_count(mpq_numref(q));
+				const quint32 den_words = word_count(mpq_denref(q));
+
+				QByteArray data(header_size + (words + den_words) * word_size, '\0');
+				uchar *const p = write_header(data, TYPE_FRACTION, mpq_sgn(q), 0, words, den_words);
+				write_words(write_words(p, mpq_numref(q)), mpq_denref(q));
+				return data;
+			}
+		case detail::knumber_base::TYPE_FLOAT: {
+				const mpf_srcptr f = x.value_->get<detail::knumber_float>()->mpf_;
+
+				// the limbs of the mantissa without the zeros at the low end
+				mp_size_t size = (f->_mp_size < 0) ? -f->_mp_size : f->_mp_size;
+				const mp_limb_t *limbs = f->_mp_d;
+				qint64 exponent = 0;
+				if(size != 0) {
+					exponent = static_cast<qint64>(f->_mp_exp - size) * GMP_NUMB_BITS;
+					while(*limbs == 0) {
+						++limbs;
+						--size;
+						exponent += GMP_NUMB_BITS;
+					}
+				}
+
+				mpz_t mantissa;
+				mpz_roinit_n(mantissa, limbs, size);
+				const quint32 words = word_count(mantissa);
+
+				QByteArray data(header_size + exponent_size + words * word_size, '\0');
+				uchar *const p = write_header(data, TYPE_FLOAT, mpf_sgn(f), mpf_get_prec(f), words, 0);
+				qToLittleEndian<qint64>(exponent, p);
+				write_words(p + exponent_size, mantissa);
+				return data;
+			}
+		case detail::knumber_base::TYPE_ERROR:
+			break;
+		}
+
+		QByteArray data(header_size, '\0');
+		write_header(data, TYPE_ERROR, x.value_->sign(), 0, 0, 0);
+		return data;
+	}
+
+	// the number of bytes x was read from, 0 if it wasn't a number
+	static qint64 read(const char *data, qint64 size, KNumber *x) {
+
+		if(size < header_size) {
+			return 0;
+		}
+
+		const uchar *const h = reinterpret_cast<const uchar *>(data);
+		const int     type      = h[1];
+		const int     sign      = static_cast<qint8>(h[2]);
+		const quint32 precision = qFromLittleEndian<quint32>(h + 4);
+		const quint32 words     = qFromLittleEndian<quint32>(h + 8);
+		const quint32 den_words = qFromLittleEndian<quint32>(h + 12);
+
+		if(h[0] != format_version || h[3] != 0 || sign < -1 || sign > 1) {
+			return 0;
+		}
+
+		const qint64 length = header_size + ((type == TYPE_FLOAT) ? exponent_size : 0) + (static_cast<qint64>(words) + den_words) * word_size;
+		if(length > size || (precision != 0) != (type == TYPE_FLOAT)) {
+			return 0;
+		}
+
+		const uchar *const p = h + header_size;
+
+		switch(type) {
+		case TYPE_INTEGER:
+			if(den_words != 0) {
+				return 0;
+			}
+
+			if(words <= 1) {
+				// most fit inline, as they did before
+				const quint64 magnitude = (words != 0) ? qFromLittleEndian<quint64>(p) : 0;
+				if(sign >= 0 && magnitude <= static_cast<quint64>(std::numeric_limits<qint64>::max())) {
+					*x = KNumber(static_cast<qint64>(magnitude));
+					break;
+				} else if(sign < 0 && magnitude - 1 <= static_cast<quint64>(std::numeric_limits<qint64>::max())) {
+					*x = KNumber(-static_cast<qint64>(magnitude - 1) - 1);
+					break;
+				}
+			}
+
+			{
+				detail::knumber_base *const v = detail::knumber_base::create<detail::knumber_integer>(static_cast<qint64>(0));
+				detail::knumber_integer *const i = v->get<detail::knumber_integer>();
+				read_words(i->mpz_, p, words);
+				if(sign < 0) {
+					mpz_neg(i->mpz_, i->mpz_);
+				}
+
+				*x = KNumber(v);
+				x->simplify();
+			}
+			break;
+
+		case TYPE_FRACTION: {
+				if(den_words == 0) {
+					return 0;
+				}
+
+				mpq_t q;
+				mpq_init(q);
+				read_words(mpq_denref(q), read_words(mpq_numref(q), p, words), den_words);
+
+				if(mpz_sgn(mpq_denref(q)) == 0) {
+					mpq_clear(q);
+					return 0;
+				}
+
+				if(sign < 0) {
+					mpq_neg(q, q);
+				}
+
+				mpq_canonicalize(q);
+				*x = KNumber(detail::knumber_base::create<detail::knumber_fraction>(q));
+				x->simplify();
+				mpq_clear(q);
+			}
+			break;
+
+		case TYPE_FLOAT: {
+				// the precision is what gets allocated, so it is capped before
+				// anything is. the mantissa can't hold more than the precision,
+				// and the exponent has to fit the one of an mpf
+				const qint64 exponent = qFromLittleEndian<qint64>(p);
+				const qint64 max_exponent = std::numeric_limits<mp_exp_t>::max() / 2;
+				if(den_words != 0 || precision > max_precision || words > precision / 64 + 2 || exponent / GMP_NUMB_BITS > max_exponent || exponent / GMP_NUMB_BITS < -max_exponent) {
+					return 0;
+				}
+
+				mpz_t mantissa;
+				mpz_init(mantissa);
+				read_words(mantissa, p + exponent_size, words);
+
+				mpf_t f;
+				mpf_init2(f, precision);
+				mpf_set_z(f, mantissa);
+				if(exponent >= 0) {
+					mpf_mul_2exp(f, f, exponent);
+				} else {
+					mpf_div_2exp(f, f, -static_cast<mp_bitcnt_t>(exponent));
+				}
+
+				if(sign < 0) {
+					mpf_neg(f, f);
+				}
+
+				*x = KNumber(detail::knumber_base::create<detail::knumber_float>(f, precision));
+				mpf_clear(f);
+				mpz_clear(mantissa);
+			}
+			break;
+
+		case TYPE_ERROR:
+			if(words != 0 || den_words != 0) {
+				return 0;
+			}
+
+			*x = (sign == 0) ? NaN : (sign > 0) ? PosInfinity : NegInfinity;
+			break;
+
+		default:
+			return 0;
+		}
+
+		// the sign is stored on its own, it has to agree with the magnitude
+		return (signum(*x) == sign) ? length : 0;
+	}
+
+private:
+	static const quint8 format_version = 1;
+	static const int    header_size    = 16;
+	static const int    exponent_size  = 8;
+	static const int    word_size      = 8;
+
+	// floats are read back with at most this many bits, 300 times what the
+	// 1000 digits KCalc goes up to need. a bigger precision in a header is
+	// taken to be corrupt rather than allocated
+	static const quint32 max_precision = 1u << 20;
+
+private:
+	static int sign(qint64 x) {
+		return (x > 0) - (x < 0);
+	}
+
+	static int signum(const KNumber &x) {
+		return x.value_ ? x.value_->sign() : sign(x.small_);
+	}
+
+	static quint32 word_count(mpz_srcptr z) {
+		return (mpz_sgn(z) == 0) ? 0 : static_cast<quint32>((mpz_sizeinbase(z, 2) + 63) / 64);
+	}
+
+	// returns where the rest of the number goes
+	static uchar *write_header(QByteArray &data, Type type, int sign, quint32 precision, quint32 words, quint32 den_words) {
+		uchar *const h = reinterpret_cast<uchar *>(data.data());
+		h[0] = format_version;
+		h[1] = static_cast<uchar>(type);
+		h[2] = static_cast<uchar>(static_cast<qint8>(sign));
+		h[3] = 0;
+		qToLittleEndian<quint32>(precision, h + 4);
+		qToLittleEndian<quint32>(words, h + 8);
+		qToLittleEndian<quint32>(den_words, h + 12);
+		return h + header_size;
+	}
+
+	static uchar *write_words(uchar *p, mpz_srcptr z) {
+		std::size_t count = 0;
+		mpz_export(p, &count, -1, word_size, -1, 0, z);
+		return p + count * word_size;
+	}
+
+	static const uchar *read_words(mpz_ptr z, const uchar *p, quint32 words) {
+		mpz_import(z, words, -1, word_size, -1, 0, p);
+		return p + static_cast<std::size_t>(words) * word_size;
+	}
+};
+
 //------------------------------------------------------------------------------
 // Name: setGroupSeparator
 //------------------------------------------------------------------------------
 void KNumber::setGroupSeparator(const QString &ch) {
-	GroupSeparator = ch;
+	KNumberContext context = KNumberContext::defaultContext();
+	context.setGroupSeparator(ch);
+	KNumberContext::setDefaultContext(context);
 }
 
 //------------------------------------------------------------------------------
 // Name: setDecimalSeparator
 //------------------------------------------------------------------------------
 void KNumber::setDecimalSeparator(const QString &ch) {
-	DecimalSeparator = ch;
+	KNumberContext context = KNumberContext::defaultContext();
+	context.setDecimalSeparator(ch);
+	KNumberContext::setDefaultContext(context);
 }
 
 //------------------------------------------------------------------------------
 // Name: groupSeparator
 //------------------------------------------------------------------------------
 QString KNumber::groupSeparator() {
-	return GroupSeparator;
+	return KNumberContext::active().groupSeparator();
 }
 
 //------------------------------------------------------------------------------
 // Name: decimalSeparator
 //------------------------------------------------------------------------------
 QString KNumber::decimalSeparator() {
-	return DecimalSeparator;
+	return KNumberContext::active().decimalSeparator();
+}
+
+//------------------------------------------------------------------------------
+// Name: statisticsEnabled
+//------------------------------------------------------------------------------
+bool KNumber::statisticsEnabled() {
+#ifdef KNUMBER_STATISTICS
+	return true;
+#else
+	return false;
+#endif
+}
+
+//------------------------------------------------------------------------------
+// Name: statistics
+//------------------------------------------------------------------------------
+KNumber::Statistics KNumber::statistics() {
+
+	typedef detail::knumber_statistics stats;
+
+	Statistics s;
+	s.objectsAllocated  = stats::value(stats::OBJECTS_ALLOCATED);
+	s.inlineSpills      = stats::value(stats::INLINE_SPILLS);
+	s.integerToFloat    = stats::value(stats::INTEGER_TO_FLOAT);
+	s.integerToFraction = stats::value(stats::INTEGER_TO_FRACTION);
+	s.fractionToFloat   = stats::value(stats::FRACTION_TO_FLOAT);
+	s.fractionToInteger = stats::value(stats::FRACTION_TO_INTEGER);
+	s.floatToInteger    = stats::value(stats::FLOAT_TO_INTEGER);
+	s.inlined           = stats::value(stats::INLINED);
+	s.canonicalizations = stats::value(stats::CANONICALIZATIONS);
+	s.limbBytes         = stats::value(stats::LIMB_BYTES);
+	s.fractionOverflows = stats::value(stats::FRACTION_OVER_BUDGET);
+	s.cacheHits         = stats::value(stats::CACHE_HITS);
+	s.cacheMisses       = stats::value(stats::CACHE_MISSES);
+	s.fastPathHits      = stats::value(stats::FAST_PATH_HITS);
+	s.fastPathMisses    = stats::value(stats::FAST_PATH_MISSES);
+	s.poolHits          = stats::value(stats::POOL_HITS);
+	s.poolMisses        = stats::value(stats::POOL_MISSES);
+	return s;
+}
+
+//------------------------------------------------------------------------------
+// Name: resetStatistics
+//------------------------------------------------------------------------------
+void KNumber::resetStatistics() {
+	detail::knumber_statistics::reset();
 }
 
 //------------------------------------------------------------------------------
 // Name: setDefaultFloatPrecision
 //------------------------------------------------------------------------------
 void KNumber::setDefaultFloatPrecision(int precision) {
-    // Need to transform decimal digits into binary digits
-    const unsigned long int bin_prec = static_cast<unsigned long int>(double(precision) * M_LN10 / M_LN2 + 1);
-    mpf_set_default_prec(bin_prec);
+	KNumberContext context = KNumberContext::defaultContext();
+	context.setFloatPrecision(precision);
+	KNumberContext::setDefaultContext(context);
+	result_cache::clear();
 }
 
 //------------------------------------------------------------------------------
 // Name: setSplitoffIntegerForFractionOutput
 //------------------------------------------------------------------------------
 void KNumber::setSplitoffIntegerForFractionOutput(bool x) {
-	detail::knumber_fraction::set_split_off_integer_for_fraction_output(x);
+	KNumberContext context = KNumberContext::defaultContext();
+	context.setSplitoffIntegerForFractionOutput(x);
+	KNumberContext::setDefaultContext(context);
 }
 
 //------------------------------------------------------------------------------
 // Name: setDefaultFractionalInput
 //------------------------------------------------------------------------------
 void KNumber::setDefaultFractionalInput(bool x) {
-	detail::knumber_fraction::set_default_fractional_input(x);
+	KNumberContext context = KNumberContext::defaultContext();
+	context.setFractionalInput(x);
+	KNumberContext::setDefaultContext(context);
 }
 
 //------------------------------------------------------------------------------
-// Name: setDefaultFloatOutput
+// Name: setLazyFractionReduction
 //------------------------------------------------------------------------------
-void KNumber::setDefaultFloatOutput(bool x) {
-	detail::knumber_fraction::set_default_fractional_output(!x);
+void KNumber::setLazyFractionReduction(bool x) {
+	detail::knumber_fraction::set_lazy_reduction(x);
 }
 
 //------------------------------------------------------------------------------
-// Name: Pi
+// Name: setFractionLimbBudget
 //------------------------------------------------------------------------------
-KNumber KNumber::Pi() {
+void KNumber::setFractionLimbBudget(int limbs, FractionOverflow overflow) {
+	detail::knumber_fraction::set_limb_budget(static_cast<std::size_t>(qMax(limbs, 0)), overflow == FRACTION_OVERFLOW_TO_ERROR);
+	result_cache::clear();
+}
 
-	// TODO: after 4.10 release:
-	//       create a new constructor which works just like the normal QString
-	//       accepting constructor, but allows us to specify separator
-	//       characters, this will allow things to be done slightly more
-	// efficiently
-	QString s(QLatin1String("3.141592653589793238462643383279502884197169399375105820974944592307816406286208998628034825342117068"));
-	s.replace('.', DecimalSeparator);
-	return KNumber(s);
+//------------------------------------------------------------------------------
+// Name: setCancelFlag
+//------------------------------------------------------------------------------
+void KNumber::setCancelFlag(const QAtomicInt *flag) {
+	detail::knumber_integer::set_cancel_flag(flag);
 }
 
 //------------------------------------------------------------------------------
-// Name: Euler
+// Name: setThreadCount
 //------------------------------------------------------------------------------
-KNumber KNumber::Euler() {
+void KNumber::setThreadCount(int count) {
+	detail::knumber_integer::set_thread_count(count);
+}
 
-	// TODO: after 4.10 release:
-	//       create a new constructor which works just like the normal QString
-	//       accepting constructor, but allows us to specify separator
-	//       characters, this will allow things to be done slightly more
-	// efficiently
-	QString s(QLatin1String("2.7182818284590452353602874713526624977572470936999595749669676277240766303535475945713821785251664274"));
-	s.replace('.', DecimalSeparator);
-	return KNumber(s);
+//------------------------------------------------------------------------------
+// Name: setMemoryBudget
+//------------------------------------------------------------------------------
+void KNumber::setMemoryBudget(quint64 operationBytes, quint64 processBytes) {
+	detail::knumber_allocator::set_budget(static_cast<std::size_t>(operationBytes), static_cast<std::size_t>(processBytes));
+	result_cache::clear();
 }
 
 //------------------------------------------------------------------------------
-// Name: KNumber
+// Name: setResultCacheSize
 //------------------------------------------------------------------------------
-KNumber::KNumber() : value_(new detail::knumber_integer(0)) {
+void KNumber::setResultCacheSize(quint64 bytes) {
+	result_cache::set_size(static_cast<std::size_t>(bytes));
 }
 
 //------------------------------------------------------------------------------
-// Name: KNumber
+// Name: clearResultCache
 //------------------------------------------------------------------------------
-KNumber::KNumber(const QString &s) : value_(0) {
+void KNumber::clearResultCache() {
+	result_cache::clear();
+}
 
-	const QRegExp special_regex(QLatin1String("^(inf|-inf|nan)$"));
-	const QRegExp integer_regex(QLatin1String("^[+-]?\\d+$"));
-	const QRegExp fraction_regex(QLatin1String("^[+-]?\\d+/\\d+$"));
-	const QRegExp float_regex(QString(QLatin1String("^([+-]?\\d*)(%1\\d*)?(e([+-]?\\d+))?$")).arg(QRegExp::escape(DecimalSeparator)));
+//------------------------------------------------------------------------------
+// Name: setDefaultFloatOutput
+//------------------------------------------------------------------------------
+void KNumber::setDefaultFloatOutput(bool x) {
+	KNumberContext context = KNumberContext::defaultContext();
+	context.setFloatOutput(x);
+	KNumberContext::setDefaultContext(context);
+}
+
+//------------------------------------------------------------------------------
+// Name: constants
+// Desc: the constants are computed to the float precision in use and kept
+//       for the last few precisions asked for. copies share the cached
+//       value, so handing them out is cheap
+//------------------------------------------------------------------------------
+class KNumber::constants {
+public:
+	enum Constant {
+		PI,
+		EULER,
+		PI_OVER_180,
+		PI_OVER_200,
+		CONSTANT_COUNT
+	};
+
+public:
+	// threads and scopes with different precisions each find their own
+	// values, only a precision which hasn't been asked for lately has them
+	// worked out. that happens outside the lock
+	static KNumber get(Constant c) {
+
+		const mp_bitcnt_t precision = KNumberContext::active().floatPrecisionBits();
+
+		{
+			QMutexLocker locker(&mutex());
+			if(const entry *const e = find(precision)) {
+				return e->values[c];
+			}
+		}
+
+		entry e;
+		const KNumber pi(detail::knumber_float::pi());
+		e.precision           = precision;
+		e.values[PI]          = pi;
+		e.values[EULER]       = KNumber(detail::knumber_float::euler());
+		e.values[PI_OVER_180] = pi / KNumber(180);
+		e.values[PI_OVER_200] = pi / KNumber(200);
+
+		// another thread may have worked them out in the meantime
+		QMutexLocker locker(&mutex());
+		if(!find(precision)) {
+			entry_type &entries = instance();
+			entries.push_front(e);
+			if(entries.size() > max_entries) {
+				entries.pop_back();
+			}
+		}
 
-	if (special_regex.exactMatch(s)) {
-		value_ = new detail::knumber_error(s);
-	} else if (integer_regex.exactMatch(s)) {
-		value_ = new detail::knumber_integer(s);
-	} else if (fraction_regex.exactMatch(s)) {
-		value_ = new detail::knumber_fraction(s);
-		simplify();
-	} else if (float_regex.exactMatch(s)) {
+		return e.values[c];
+	}
 
-		if(detail::knumber_fraction::default_fractional_input) {
+private:
+	struct entry {
+		mp_bitcnt_t precision;
+		KNumber     values[CONSTANT_COUNT];
+	};
 
-			const QStringList list = float_regex.capturedTexts();
-			if(list.size() == 5) {
+	// the most recently used first
+	typedef std::list<entry> entry_type;
 
-				const QString ipart = list[1];
-				const QString fpart = list[2];
-				const int e_val     = list[4].toInt();
+	// enough for the precisions a few threads work at side by side
+	static const std::size_t max_entries = 8;
 
-				QString num = ipart + fpart.mid(1);
-				QString den = QLatin1String("1") + QString(fpart.size() - 1, QLatin1Char('0'));
+private:
+	static QMutex &mutex() {
+		static QMutex m;
+		return m;
+	}
 
-				if(e_val < 0) {
-					den = den + QString(::abs(e_val), QLatin1Char('0'));
-				} else if(e_val > 0) {
-					num = num + QString(::abs(e_val), QLatin1Char('0'));
-				}
+	static entry_type &instance() {
+		static entry_type entries;
+		return entries;
+	}
 
-				value_ = new detail::knumber_fraction(QString(QLatin1String("%1/%2")).arg(num, den));
-				simplify();
-				return;
+	// moves the entry found to the front, the lock has to be held
+	static const entry *find(mp_bitcnt_t precision) {
+		entry_type &entries = instance();
+		for(entry_type::iterator it = entries.begin(); it != entries.end(); ++it) {
+			if(it->precision == precision) {
+				entries.splice(entries.begin(), entries, it);
+				return &entries.front();
 			}
 		}
 
-		// we need to normalize the decimal separator to US style because that's
-		// the only type that the GMP function accept
-		QString new_s = s;
-		new_s.replace(DecimalSeparator, QLatin1String("."));
+		return 0;
+	}
+};
+
+//------------------------------------------------------------------------------
+// Name: Pi
+//------------------------------------------------------------------------------
+KNumber KNumber::Pi() {
+	return constants::get(constants::PI);
+}
+
+//------------------------------------------------------------------------------
+// Name: Euler
+//------------------------------------------------------------------------------
+KNumber KNumber::Euler() {
+	return constants::get(constants::EULER);
+}
+
+//------------------------------------------------------------------------------
+// Name: PiOver180
+//------------------------------------------------------------------------------
+KNumber KNumber::PiOver180() {
+	return constants::get(constants::PI_OVER_180);
+}
+
+//------------------------------------------------------------------------------
+// Name: PiOver200
+//------------------------------------------------------------------------------
+KNumber KNumber::PiOver200() {
+	return constants::get(constants::PI_OVER_200);
+}
+
+//------------------------------------------------------------------------------
+// Name: KNumber
+//------------------------------------------------------------------------------
+KNumber::KNumber() : value_(0), small_(0) {
+}
+
+//------------------------------------------------------------------------------
+// Name: KNumber
+// Desc: takes ownership of value
+//------------------------------------------------------------------------------
+KNumber::KNumber(detail::knumber_base *value) : value_(value), small_(0) {
+	simplify();
+}
+
+//------------------------------------------------------------------------------
+// Name: KNumber
+//------------------------------------------------------------------------------
+KNumber::KNumber(const QString &s) : value_(0), small_(0) {
 
-		value_ = new detail::knumber_float(new_s);
-		simplify();
+	if(s == QLatin1String("inf") || s == QLatin1String("-inf") || s == QLatin1String("nan")) {
+		value_ = detail::knumber_base::create<detail::knumber_error>(s);
 	} else {
-		value_ = new detail::knumber_error(detail::knumber_error::ERROR_UNDEFINED);
+		parser(s).parse(this);
 	}
 }
 
 //------------------------------------------------------------------------------
 // Name: KNumber
 //------------------------------------------------------------------------------
-KNumber::KNumber(qint32 value) : value_(new detail::knumber_integer(value)) {
+KNumber::KNumber(qint32 value) : value_(0), small_(value) {
 }
 
 //------------------------------------------------------------------------------
 // Name: KNumber
 //------------------------------------------------------------------------------
-KNumber::KNumber(qint64 value) : value_(new detail::knumber_integer(value)) {
+KNumber::KNumber(qint64 value) : value_(0), small_(value) {
 }
 
 //------------------------------------------------------------------------------
 // Name: KNumber
 //------------------------------------------------------------------------------
-KNumber::KNumber(quint32 value) : value_(new detail::knumber_integer(value)) {
+KNumber::KNumber(quint32 value) : value_(0), small_(value) {
 }
 
 //------------------------------------------------------------------------------
 // Name: KNumber
 //------------------------------------------------------------------------------
-KNumber::KNumber(quint64 value) : value_(new detail::knumber_integer(value)) {
+KNumber::KNumber(quint64 value) : value_(0), small_(0) {
+	if(value > static_cast<quint64>(std::numeric_limits<qint64>::max())) {
+		value_ = detail::knumber_base::create<detail::knumber_integer>(value);
+	} else {
+		small_ = static_cast<qint64>(value);
+	}
 }
 
 //------------------------------------------------------------------------------
 // Name: KNumber
 //------------------------------------------------------------------------------
-KNumber::KNumber(qint64 num, quint64 den) : value_(new detail::knumber_fraction(num, den)) {
+KNumber::KNumber(qint64 num, quint64 den) : value_(detail::knumber_base::create<detail::knumber_fraction>(num, den)), small_(0) {
 }
 
 //------------------------------------------------------------------------------
 // Name: KNumber
 //------------------------------------------------------------------------------
-KNumber::KNumber(quint64 num, quint64 den) : value_(new detail::knumber_fraction(num, den)) {
+KNumber::KNumber(quint64 num, quint64 den) : value_(detail::knumber_base::create<detail::knumber_fraction>(num, den)), small_(0) {
 }
 
 #ifdef HAVE_LONG_DOUBLE
 //------------------------------------------------------------------------------
 // Name: KNumber
 //------------------------------------------------------------------------------
-KNumber::KNumber(long double value) : value_(new detail::knumber_float(value)) {
+KNumber::KNumber(long double value) : value_(detail::knumber_base::create<detail::knumber_float>(value)), small_(0) {
 	simplify();
 }
 #endif
@@ -373,24 +1281,33 @@ KNumber::KNumber(long double value) : value_(new detail::knumber_float(value)) {
 //------------------------------------------------------------------------------
 // Name: KNumber
 //------------------------------------------------------------------------------
-KNumber::KNumber(double value) : value_(new detail::knumber_float(value)) {
+KNumber::KNumber(double value) : value_(detail::knumber_base::create<detail::knumber_float>(value)), small_(0) {
 	simplify();
 }
 
 //------------------------------------------------------------------------------
 // Name: KNumber
 //------------------------------------------------------------------------------
-KNumber::KNumber(const KNumber &other) : value_(0) {
-	if(&other != this) {
-		value_ = other.value_->clone();
+KNumber::KNumber(const KNumber &other) : value_(other.value_), small_(other.small_) {
+	if(value_) {
+		value_->ref();
 	}
 }
 
+//------------------------------------------------------------------------------
+// Name: KNumber
+// Desc: takes over the storage of other, which is left as zero
+//------------------------------------------------------------------------------
+KNumber::KNumber(KNumber &&other) noexcept : value_(other.value_), small_(other.small_) {
+	other.value_ = 0;
+	other.small_ = 0;
+}
+
 //------------------------------------------------------------------------------
 // Name: ~KNumber
 //------------------------------------------------------------------------------
 KNumber::~KNumber() {
-	delete value_;
+	release(value_);
 }
 
 //------------------------------------------------------------------------------
@@ -398,18 +1315,23 @@ KNumber::~KNumber() {
 //------------------------------------------------------------------------------
 KNumber::Type KNumber::type() const {
 
-	if(dynamic_cast<detail::knumber_integer *>(value_)) {
+	if(!value_) {
 		return TYPE_INTEGER;
-	} else if(dynamic_cast<detail::knumber_float *>(value_)) {
+	}
+
+	switch(value_->type()) {
+	case detail::knumber_base::TYPE_INTEGER:
+		return TYPE_INTEGER;
+	case detail::knumber_base::TYPE_FLOAT:
 		return TYPE_FLOAT;
-	} else if(dynamic_cast<detail::knumber_fraction *>(value_)) {
+	case detail::knumber_base::TYPE_FRACTION:
 		return TYPE_FRACTION;
-	} else if(dynamic_cast<detail::knumber_error *>(value_)) {
-		return TYPE_ERROR;
-	} else {
-		Q_ASSERT(0);
+	case detail::knumber_base::TYPE_ERROR:
 		return TYPE_ERROR;
 	}
+
+	Q_ASSERT(0);
+	return TYPE_ERROR;
 }
 
 //------------------------------------------------------------------------------
@@ -420,11 +1342,20 @@ KNumber &KNumber::operator=(const KNumber &rhs) {
 	return *this;
 }
 
+//------------------------------------------------------------------------------
+// Name: operator=
+//------------------------------------------------------------------------------
+KNumber &KNumber::operator=(KNumber &&rhs) noexcept {
+	KNumber(std::move(rhs)).swap(*this);
+	return *this;
+}
+
 //------------------------------------------------------------------------------
 // Name: swap
 //------------------------------------------------------------------------------
 void KNumber::swap(KNumber &other) {
 	qSwap(value_, other.value_);
+	qSwap(small_, other.small_);
 }
 
 //------------------------------------------------------------------------------
@@ -434,18 +1365,22 @@ KNumber KNumber::integerPart() const {
 
 	KNumber x(*this);
 
-	if(detail::knumber_integer *const p = dynamic_cast<detail::knumber_integer *>(value_)) {
+	if(!value_) {
+		return x;
+	}
+
+	if(detail::knumber_integer *const p = detail::knumber_cast<detail::knumber_integer>(value_)) {
 		// NO-OP
 		Q_UNUSED(p);
-	} else if(detail::knumber_float *const p = dynamic_cast<detail::knumber_float *>(value_)) {
-		detail::knumber_base *v = new detail::knumber_integer(p);
+	} else if(detail::knumber_float *const p = detail::knumber_cast<detail::knumber_float>(value_)) {
+		detail::knumber_base *v = detail::knumber_base::create<detail::knumber_integer>(p);
 		qSwap(v, x.value_);
-		delete v;
-	} else if(detail::knumber_fraction *const p = dynamic_cast<detail::knumber_fraction *>(value_)) {
-		detail::knumber_base *v = new detail::knumber_integer(p);
+		release(v);
+	} else if(detail::knumber_fraction *const p = detail::knumber_cast<detail::knumber_fraction>(value_)) {
+		detail::knumber_base *v = detail::knumber_base::create<detail::knumber_integer>(p);
 		qSwap(v, x.value_);
-		delete v;
-	} else if(detail::knumber_error *const p = dynamic_cast<detail::knumber_error *>(value_)) {
+		release(v);
+	} else if(detail::knumber_error *const p = detail::knumber_cast<detail::knumber_error>(value_)) {
 		// NO-OP
 		Q_UNUSED(p);
 	} else {
@@ -460,33 +1395,118 @@ KNumber KNumber::integerPart() const {
 //------------------------------------------------------------------------------
 void KNumber::simplify() {
 
-	if(value_->is_integer()) {
+	// this is only called on a value which was just made or detached, so
+	// nothing else refers to it and it can be converted in place
+	Q_ASSERT(!value_ || !value_->is_shared());
 
-		if(detail::knumber_integer *const p = dynamic_cast<detail::knumber_integer *>(value_)) {
-			// NO-OP
-			Q_UNUSED(p);
-		} else if(detail::knumber_float *const p = dynamic_cast<detail::knumber_float *>(value_)) {
-			detail::knumber_base *v = new detail::knumber_integer(p);
-			qSwap(v, value_);
-			delete v;
-		} else if(detail::knumber_fraction *const p = dynamic_cast<detail::knumber_fraction *>(value_)) {
-			detail::knumber_base *v = new detail::knumber_integer(p);
-			qSwap(v, value_);
-			delete v;
-		} else if(detail::knumber_error *const p = dynamic_cast<detail::knumber_error *>(value_)) {
+	if(value_ && value_->is_integer()) {
+
+		// anything that fits is moved back inline, the rest becomes
+		// a knumber_integer
+		if(detail::knumber_integer *const p = detail::knumber_cast<detail::knumber_integer>(value_)) {
+			if(mpz_fits_slong_p(p->mpz_)) {
+				KNUMBER_COUNT(INLINED);
+				small_ = mpz_get_si(p->mpz_);
+				release(value_);
+				value_ = 0;
+			}
+		} else if(detail::knumber_float *const p = detail::knumber_cast<detail::knumber_float>(value_)) {
+			if(mpf_fits_slong_p(p->mpf_)) {
+				KNUMBER_COUNT(FLOAT_TO_INTEGER);
+				KNUMBER_COUNT(INLINED);
+				small_ = mpf_get_si(p->mpf_);
+				release(value_);
+				value_ = 0;
+			} else {
+				// a float which would be too big as an integer is left as it is
+				signed long int exp;
+				mpf_get_d_2exp(&exp, p->mpf_);
+				if(detail::knumber_allocator::fits_budget(exp)) {
+					KNUMBER_COUNT(FLOAT_TO_INTEGER);
+					value_->assign(detail::knumber_integer(p));
+				}
+			}
+		} else if(detail::knumber_fraction *const p = detail::knumber_cast<detail::knumber_fraction>(value_)) {
+			// the denominator is only 1 if the fraction was reduced
+			KNUMBER_COUNT(FRACTION_TO_INTEGER);
+			if(mpz_cmp_ui(mpq_denref(p->mpq_), 1) == 0 && mpz_fits_slong_p(mpq_numref(p->mpq_))) {
+				KNUMBER_COUNT(INLINED);
+				small_ = mpz_get_si(mpq_numref(p->mpq_));
+				release(value_);
+				value_ = 0;
+			} else {
+				value_->assign(detail::knumber_integer(p));
+				simplify();
+			}
+		} else if(detail::knumber_error *const p = detail::knumber_cast<detail::knumber_error>(value_)) {
 			// NO-OP
 			Q_UNUSED(p);
 		} else {
 			Q_ASSERT(0);
 		}
+	} else if(value_ && value_->type() == detail::knumber_base::TYPE_FRACTION) {
+
+		// a fraction which has outgrown the limb budget is given up on,
+		// so that the next operation can't take longer still
+		detail::knumber_fraction *const p = value_->get<detail::knumber_fraction>();
+		if(p->exceeds_limb_budget()) {
+			KNUMBER_COUNT(FRACTION_OVER_BUDGET);
+			if(detail::knumber_fraction::limb_budget_error.load(std::memory_order_relaxed)) {
+				value_->emplace<detail::knumber_error>(detail::knumber_error::ERROR_UNDEFINED);
+			} else {
+				value_->assign(detail::knumber_float(p));
+			}
+		}
 	}
 }
 
+//------------------------------------------------------------------------------
+// Name: detach
+// Desc: makes value_ a heap object which only this number refers to, so the
+//       detail classes can modify it in place. inline integers are moved out
+//       to a knumber_integer and shared values are copied. a float is given
+//       the precision of the context the result is worked out in
+//------------------------------------------------------------------------------
+void KNumber::detach() {
+	if(!value_) {
+		KNUMBER_COUNT(INLINE_SPILLS);
+		value_ = detail::knumber_base::create<detail::knumber_integer>(small_);
+	} else if(value_->is_shared()) {
+		detail::knumber_base *const v = new detail::knumber_base(*value_);
+		release(value_);
+		value_ = v;
+	}
+
+	if(value_->type() == detail::knumber_base::TYPE_FLOAT) {
+		value_->get<detail::knumber_float>()->set_context_precision();
+	}
+}
+
+//------------------------------------------------------------------------------
+// Name: compare
+//------------------------------------------------------------------------------
+int KNumber::compare(const KNumber &rhs) const {
+
+	if(!value_ && !rhs.value_) {
+		return (small_ > rhs.small_) - (small_ < rhs.small_);
+	}
+
+	return operand(*this).get()->compare(operand(rhs).get());
+}
+
 //------------------------------------------------------------------------------
 // Name: operator+=
 //------------------------------------------------------------------------------
 KNumber &KNumber::operator+=(const KNumber &rhs) {
-	value_ = value_->add(rhs.value_);
+
+	qint64 r;
+	if(!value_ && !rhs.value_ && !detail::add_overflow(small_, rhs.small_, &r)) {
+		small_ = r;
+		return *this;
+	}
+
+	detach();
+	value_->add(operand(rhs).get());
 	simplify();
 	return *this;
 }
@@ -495,7 +1515,15 @@ KNumber &KNumber::operator+=(const KNumber &rhs) {
 // Name: operator-=
 //------------------------------------------------------------------------------
 KNumber &KNumber::operator-=(const KNumber &rhs) {
-	value_ = value_->sub(rhs.value_);
+
+	qint64 r;
+	if(!value_ && !rhs.value_ && !detail::sub_overflow(small_, rhs.small_, &r)) {
+		small_ = r;
+		return *this;
+	}
+
+	detach();
+	value_->sub(operand(rhs).get());
 	simplify();
 	return *this;
 }
@@ -504,7 +1532,15 @@ KNumber &KNumber::operator-=(const KNumber &rhs) {
 // Name: operator*=
 //------------------------------------------------------------------------------
 KNumber &KNumber::operator*=(const KNumber &rhs) {
-	value_ = value_->mul(rhs.value_);
+
+	qint64 r;
+	if(!value_ && !rhs.value_ && !detail::mul_overflow(small_, rhs.small_, &r)) {
+		small_ = r;
+		return *this;
+	}
+
+	detach();
+	value_->mul(operand(rhs).get());
 	simplify();
 	return *this;
 }
@@ -521,7 +1557,17 @@ KNumber &KNumber::operator/=(const KNumber &rhs) {
 		return *this;
 	}
 
-	value_ = value_->div(rhs.value_);
+	// exact quotients of inline integers stay inline, everything else
+	// needs to become a fraction or a float
+	if(!value_ && !rhs.value_) {
+		if(!(small_ == std::numeric_limits<qint64>::min() && rhs.small_ == -1) && small_ % rhs.small_ == 0) {
+			small_ /= rhs.small_;
+			return *this;
+		}
+	}
+
+	detach();
+	value_->div(operand(rhs).get());
 	simplify();
 	return *this;
 }
@@ -530,7 +1576,18 @@ KNumber &KNumber::operator/=(const KNumber &rhs) {
 // Name: operator%=
 //------------------------------------------------------------------------------
 KNumber &KNumber::operator%=(const KNumber &rhs) {
-	value_ = value_->mod(rhs.value_);
+
+	// like mpz_mod the result is never negative
+	if(!value_ && !rhs.value_ && rhs.small_ != 0 && rhs.small_ != -1 && rhs.small_ != std::numeric_limits<qint64>::min()) {
+		small_ %= rhs.small_;
+		if(small_ < 0) {
+			small_ += (rhs.small_ < 0) ? -rhs.small_ : rhs.small_;
+		}
+		return *this;
+	}
+
+	detach();
+	value_->mod(operand(rhs).get());
 	simplify();
 	return *this;
 }
@@ -539,7 +1596,15 @@ KNumber &KNumber::operator%=(const KNumber &rhs) {
 // Name: operator&=
 //------------------------------------------------------------------------------
 KNumber &KNumber::operator&=(const KNumber &rhs) {
-	value_ = value_->bitwise_and(rhs.value_);
+
+	if(!value_ && !rhs.value_) {
+		small_ &= rhs.small_;
+		return *this;
+	}
+
+	detach();
+	value_->bitwise_and(operand(rhs).get());
+	simplify();
 	return *this;
 }
 
@@ -547,7 +1612,15 @@ KNumber &KNumber::operator&=(const KNumber &rhs) {
 // Name: operator|=
 //------------------------------------------------------------------------------
 KNumber &KNumber::operator|=(const KNumber &rhs) {
-	value_ = value_->bitwise_or(rhs.value_);
+
+	if(!value_ && !rhs.value_) {
+		small_ |= rhs.small_;
+		return *this;
+	}
+
+	detach();
+	value_->bitwise_or(operand(rhs).get());
+	simplify();
 	return *this;
 }
 
@@ -555,7 +1628,15 @@ KNumber &KNumber::operator|=(const KNumber &rhs) {
 // Name: operator^=
 //------------------------------------------------------------------------------
 KNumber &KNumber::operator^=(const KNumber &rhs) {
-	value_ = value_->bitwise_xor(rhs.value_);
+
+	if(!value_ && !rhs.value_) {
+		small_ ^= rhs.small_;
+		return *this;
+	}
+
+	detach();
+	value_->bitwise_xor(operand(rhs).get());
+	simplify();
 	return *this;
 }
 
@@ -563,7 +1644,18 @@ KNumber &KNumber::operator^=(const KNumber &rhs) {
 // Name: operator<<
 //------------------------------------------------------------------------------
 KNumber &KNumber::operator<<=(const KNumber &rhs) {
-	value_ = value_->bitwise_shift(rhs.value_);
+
+	if(!value_ && !rhs.value_ && rhs.small_ >= 0 && rhs.small_ < 64) {
+		const qint64 r = static_cast<qint64>(static_cast<quint64>(small_) << rhs.small_);
+		if((r >> rhs.small_) == small_) {
+			small_ = r;
+			return *this;
+		}
+	}
+
+	detach();
+	value_->bitwise_shift(operand(rhs).get());
+	simplify();
 	return *this;
 }
 
@@ -571,8 +1663,16 @@ KNumber &KNumber::operator<<=(const KNumber &rhs) {
 // Name: operator>>=
 //------------------------------------------------------------------------------
 KNumber &KNumber::operator>>=(const KNumber &rhs) {
+
+	if(!value_ && !rhs.value_ && rhs.small_ >= 0) {
+		small_ >>= (rhs.small_ < 64) ? rhs.small_ : 63;
+		return *this;
+	}
+
 	const KNumber rhs_neg(-rhs);
-	value_ = value_->bitwise_shift(rhs_neg.value_);
+	detach();
+	value_->bitwise_shift(operand(rhs_neg).get());
+	simplify();
 	return *this;
 }
 
@@ -580,8 +1680,16 @@ KNumber &KNumber::operator>>=(const KNumber &rhs) {
 // Name: operator-
 //------------------------------------------------------------------------------
 KNumber KNumber::operator-() const {
+
+	if(!value_ && small_ != std::numeric_limits<qint64>::min()) {
+		return KNumber(-small_);
+	}
+
+	// -(2^63) spills, and a negated heap value may fit inline again
 	KNumber x(*this);
-	x.value_ = x.value_->neg();
+	x.detach();
+	x.value_->neg();
+	x.simplify();
 	return x;
 }
 
@@ -589,8 +1697,15 @@ KNumber KNumber::operator-() const {
 // Name: operator~
 //------------------------------------------------------------------------------
 KNumber KNumber::operator~() const {
+
+	if(!value_) {
+		return KNumber(~small_);
+	}
+
 	KNumber x(*this);
-	x.value_ = x.value_->cmp();
+	x.detach();
+	x.value_->cmp();
+	x.simplify();
 	return x;
 }
 
@@ -599,58 +1714,89 @@ KNumber KNumber::operator~() const {
 //------------------------------------------------------------------------------
 QString KNumber::toQString(int width, int precision) const {
 
-	if(value_->is_zero()) {
+	if(value_ ? value_->is_zero() : small_ == 0) {
 		return QLatin1String("0");
 	}
 
-	QString s;
-
-	if(detail::knumber_integer *const p = dynamic_cast<detail::knumber_integer *>(value_)) {
+	// precision is the number of decimals the result is rounded to, the
+	// formatter does that on its digits before building the string
+	if(!value_) {
 		if(width > 0) {
-			s = detail::knumber_float(p).toString(width);
+			const detail::knumber_integer i(small_);
+			return detail::knumber_formatter::format_float(detail::knumber_float(&i).mpf_, width, precision);
 		} else {
-			s = value_->toString(width);
+			return detail::knumber_formatter::format_integer(small_, precision);
 		}
-	} else if(detail::knumber_float *const p = dynamic_cast<detail::knumber_float *>(value_)) {
+	} else if(detail::knumber_integer *const p = detail::knumber_cast<detail::knumber_integer>(value_)) {
 		if(width > 0) {
-			s = value_->toString(width);
+			return detail::knumber_formatter::format_float(detail::knumber_float(p).mpf_, width, precision);
+		} else {
+			return detail::knumber_formatter::format_integer(p->mpz_, precision);
+		}
+	} else if(detail::knumber_float *const p = detail::knumber_cast<detail::knumber_float>(value_)) {
+		if(width > 0) {
+			return detail::knumber_formatter::format_float(p->mpf_, width, precision);
+		} else {
+			return detail::knumber_formatter::format_float(p->mpf_, 3 * mpf_get_prec(p->mpf_) / 10, precision);
+		}
+	} else if(detail::knumber_fraction *const p = detail::knumber_cast<detail::knumber_fraction>(value_)) {
+		if(!KNumberContext::active().floatOutput()) {
+			return p->toString(width);
 		} else {
-			s = value_->toString(3 * mpf_get_default_prec() / 10);
+			return detail::knumber_formatter::format_float(detail::knumber_float(p).mpf_, width, precision);
 		}
-	} else if(detail::knumber_fraction *const p = dynamic_cast<detail::knumber_fraction *>(value_)) {
-		s = value_->toString(width);
 	} else {
 		return value_->toString(width);
 	}
-
-	// now do some rounding to make sure things are displayed reasonably
-    if (precision >= 0) {
-        return round(s, precision);
-    } else {
-        return s;
-    }
 }
 
 //------------------------------------------------------------------------------
 // Name: toUint64
 //------------------------------------------------------------------------------
 quint64 KNumber::toUint64() const {
-	return value_->toUint64();
+	return value_ ? value_->toUint64() : static_cast<quint64>(small_);
 }
 
 //------------------------------------------------------------------------------
 // Name: toInt64
 //------------------------------------------------------------------------------
 qint64 KNumber::toInt64() const {
-	return value_->toInt64();
+	return value_ ? value_->toInt64() : small_;
+}
+
+//------------------------------------------------------------------------------
+// Name: serialize
+//------------------------------------------------------------------------------
+QByteArray KNumber::serialize() const {
+	return serializer::write(*this);
+}
+
+//------------------------------------------------------------------------------
+// Name: deserialize
+//------------------------------------------------------------------------------
+KNumber KNumber::deserialize(const char *data, qint64 size, qint64 *used) {
+
+	KNumber x;
+	const qint64 n = serializer::read(data, size, &x);
+	if(used) {
+		*used = n;
+	}
+
+	return (n != 0) ? x : NaN;
 }
 
 //------------------------------------------------------------------------------
 // Name: abs
 //------------------------------------------------------------------------------
 KNumber KNumber::abs() const {
+
+	if(!value_ && small_ != std::numeric_limits<qint64>::min()) {
+		return KNumber(small_ < 0 ? -small_ : small_);
+	}
+
 	KNumber z(*this);
-	z.value_ = z.value_->abs();
+	z.detach();
+	z.value_->abs();
 	z.simplify();
 	return z;
 }
@@ -660,7 +1806,8 @@ KNumber KNumber::abs() const {
 //------------------------------------------------------------------------------
 KNumber KNumber::cbrt() const {
 	KNumber z(*this);
-	z.value_ = z.value_->cbrt();
+	z.detach();
+	z.value_->cbrt();
 	z.simplify();
 	return z;
 }
@@ -670,7 +1817,8 @@ KNumber KNumber::cbrt() const {
 //------------------------------------------------------------------------------
 KNumber KNumber::sqrt() const {
 	KNumber z(*this);
-	z.value_ = z.value_->sqrt();
+	z.detach();
+	z.value_->sqrt();
 	z.simplify();
 	return z;
 }
@@ -688,19 +1836,16 @@ KNumber KNumber::pow(const KNumber &x) const {
 		return NaN;
 	}
 
-	// if the LHS is a special then we can use this function
-	// no matter what, cause the result is a special too
-	if(!dynamic_cast<detail::knumber_error *>(value_)) {
-		// number much bigger than this tend to crash GMP with
-		// an abort
-		if(x > KNumber(QLatin1String("1000000000"))) {
-			return PosInfinity;
-		}
+	KNumber z;
+	if(result_cache::find(result_cache::POW, *this, x, &z)) {
+		return z;
 	}
 
-	KNumber z(*this);
-	z.value_ = z.value_->pow(x.value_);
+	z = *this;
+	z.detach();
+	z.value_->pow(operand(x).get());
 	z.simplify();
+	result_cache::insert(result_cache::POW, *this, x, z);
 	return z;
 }
 
@@ -709,7 +1854,8 @@ KNumber KNumber::pow(const KNumber &x) const {
 //------------------------------------------------------------------------------
 KNumber KNumber::sin() const {
 	KNumber z(*this);
-	z.value_ = z.value_->sin();
+	z.detach();
+	z.value_->sin();
 	z.simplify();
 	return z;
 }
@@ -719,7 +1865,8 @@ KNumber KNumber::sin() const {
 //------------------------------------------------------------------------------
 KNumber KNumber::cos() const {
 	KNumber z(*this);
-	z.value_ = z.value_->cos();
+	z.detach();
+	z.value_->cos();
 	z.simplify();
 	return z;
 }
@@ -729,7 +1876,8 @@ KNumber KNumber::cos() const {
 //------------------------------------------------------------------------------
 KNumber KNumber::tan() const {
 	KNumber z(*this);
-	z.value_ = z.value_->tan();
+	z.detach();
+	z.value_->tan();
 	z.simplify();
 	return z;
 }
@@ -738,12 +1886,20 @@ KNumber KNumber::tan() const {
 // Name: tgamma
 //------------------------------------------------------------------------------
 KNumber KNumber::tgamma() const {
-	KNumber z(*this);
-	if(z > KNumber(QLatin1String("10000000000"))) {
+	if(*this > KNumber(QLatin1String("10000000000"))) {
 		return PosInfinity;
 	}
-	z.value_ = z.value_->tgamma();
+
+	KNumber z;
+	if(result_cache::find(result_cache::TGAMMA, *this, Zero, &z)) {
+		return z;
+	}
+
+	z = *this;
+	z.detach();
+	z.value_->tgamma();
 	z.simplify();
+	result_cache::insert(result_cache::TGAMMA, *this, Zero, z);
 	return z;
 }
 
@@ -752,7 +1908,8 @@ KNumber KNumber::tgamma() const {
 //------------------------------------------------------------------------------
 KNumber KNumber::asin() const {
 	KNumber z(*this);
-	z.value_ = z.value_->asin();
+	z.detach();
+	z.value_->asin();
 	z.simplify();
 	return z;
 }
@@ -762,7 +1919,8 @@ KNumber KNumber::asin() const {
 //------------------------------------------------------------------------------
 KNumber KNumber::acos() const {
 	KNumber z(*this);
-	z.value_ = z.value_->acos();
+	z.detach();
+	z.value_->acos();
 	z.simplify();
 	return z;
 }
@@ -772,7 +1930,8 @@ KNumber KNumber::acos() const {
 //------------------------------------------------------------------------------
 KNumber KNumber::atan() const {
 	KNumber z(*this);
-	z.value_ = z.value_->atan();
+	z.detach();
+	z.value_->atan();
 	z.simplify();
 	return z;
 }
@@ -782,7 +1941,8 @@ KNumber KNumber::atan() const {
 //------------------------------------------------------------------------------
 KNumber KNumber::sinh() const {
 	KNumber z(*this);
-	z.value_ = z.value_->sinh();
+	z.detach();
+	z.value_->sinh();
 	z.simplify();
 	return z;
 }
@@ -792,7 +1952,8 @@ KNumber KNumber::sinh() const {
 //------------------------------------------------------------------------------
 KNumber KNumber::cosh() const {
 	KNumber z(*this);
-	z.value_ = z.value_->cosh();
+	z.detach();
+	z.value_->cosh();
 	z.simplify();
 	return z;
 }
@@ -802,7 +1963,8 @@ KNumber KNumber::cosh() const {
 //------------------------------------------------------------------------------
 KNumber KNumber::tanh() const {
 	KNumber z(*this);
-	z.value_ = z.value_->tanh();
+	z.detach();
+	z.value_->tanh();
 	z.simplify();
 	return z;
 }
@@ -812,7 +1974,8 @@ KNumber KNumber::tanh() const {
 //------------------------------------------------------------------------------
 KNumber KNumber::asinh() const {
 	KNumber z(*this);
-	z.value_ = z.value_->asinh();
+	z.detach();
+	z.value_->asinh();
 	z.simplify();
 	return z;
 }
@@ -822,7 +1985,8 @@ KNumber KNumber::asinh() const {
 //------------------------------------------------------------------------------
 KNumber KNumber::acosh() const {
 	KNumber z(*this);
-	z.value_ = z.value_->acosh();
+	z.detach();
+	z.value_->acosh();
 	z.simplify();
 	return z;
 }
@@ -832,7 +1996,8 @@ KNumber KNumber::acosh() const {
 //------------------------------------------------------------------------------
 KNumber KNumber::atanh() const {
 	KNumber z(*this);
-	z.value_ = z.value_->atanh();
+	z.detach();
+	z.value_->atanh();
 	z.simplify();
 	return z;
 }
@@ -841,16 +2006,16 @@ KNumber KNumber::atanh() const {
 // Name: factorial
 //------------------------------------------------------------------------------
 KNumber KNumber::factorial() const {
-	KNumber z(*this);
-
-	// number much bigger than this tend to crash GMP with
-	// an abort
-	if(z > KNumber(QLatin1String("10000000000"))) {
-		return PosInfinity;
+	KNumber z;
+	if(result_cache::find(result_cache::FACTORIAL, *this, Zero, &z)) {
+		return z;
 	}
 
-	z.value_ = z.value_->factorial();
+	z = *this;
+	z.detach();
+	z.value_->factorial();
 	z.simplify();
+	result_cache::insert(result_cache::FACTORIAL, *this, Zero, z);
 	return z;
 }
 
@@ -859,7 +2024,8 @@ KNumber KNumber::factorial() const {
 //------------------------------------------------------------------------------
 KNumber KNumber::log2() const {
 	KNumber z(*this);
-	z.value_ = z.value_->log2();
+	z.detach();
+	z.value_->log2();
 	z.simplify();
 	return z;
 }
@@ -869,7 +2035,8 @@ KNumber KNumber::log2() const {
 //------------------------------------------------------------------------------
 KNumber KNumber::log10() const {
 	KNumber z(*this);
-	z.value_ = z.value_->log10();
+	z.detach();
+	z.value_->log10();
 	z.simplify();
 	return z;
 }
@@ -879,7 +2046,8 @@ KNumber KNumber::log10() const {
 //------------------------------------------------------------------------------
 KNumber KNumber::ln() const {
 	KNumber z(*this);
-	z.value_ = z.value_->ln();
+	z.detach();
+	z.value_->ln();
 	z.simplify();
 	return z;
 }
@@ -888,8 +2056,14 @@ KNumber KNumber::ln() const {
 // Name: floor
 //------------------------------------------------------------------------------
 KNumber KNumber::floor() const {
+
+	if(!value_) {
+		return *this;
+	}
+
 	KNumber z(*this);
-	z.value_ = z.value_->floor();
+	z.detach();
+	z.value_->floor();
 	z.simplify();
 	return z;
 }
@@ -898,8 +2072,14 @@ KNumber KNumber::floor() const {
 // Name: ceil
 //------------------------------------------------------------------------------
 KNumber KNumber::ceil() const {
+
+	if(!value_) {
+		return *this;
+	}
+
 	KNumber z(*this);
-	z.value_ = z.value_->ceil();
+	z.detach();
+	z.value_->ceil();
 	z.simplify();
 	return z;
 }
@@ -909,7 +2089,8 @@ KNumber KNumber::ceil() const {
 //------------------------------------------------------------------------------
 KNumber KNumber::exp2() const {
 	KNumber z(*this);
-	z.value_ = z.value_->exp2();
+	z.detach();
+	z.value_->exp2();
 	z.simplify();
 	return z;
 }
@@ -919,7 +2100,8 @@ KNumber KNumber::exp2() const {
 //------------------------------------------------------------------------------
 KNumber KNumber::exp10() const {
 	KNumber z(*this);
-	z.value_ = z.value_->exp10();
+	z.detach();
+	z.value_->exp10();
 	z.simplify();
 	return z;
 }
@@ -929,7 +2111,8 @@ KNumber KNumber::exp10() const {
 //------------------------------------------------------------------------------
 KNumber KNumber::exp() const {
 	KNumber z(*this);
-	z.value_ = z.value_->exp();
+	z.detach();
+	z.value_->exp();
 	z.simplify();
 	return z;
 }
@@ -938,8 +2121,15 @@ KNumber KNumber::exp() const {
 // Name: bin
 //------------------------------------------------------------------------------
 KNumber KNumber::bin(const KNumber &x) const {
-	KNumber z(*this);
-	z.value_ = z.value_->bin(x.value_);
+	KNumber z;
+	if(result_cache::find(result_cache::BIN, *this, x, &z)) {
+		return z;
+	}
+
+	z = *this;
+	z.detach();
+	z.value_->bin(operand(x).get());
 	z.simplify();
+	result_cache::insert(result_cache::BIN, *this, x, z);
 	return z;
 }
@@ -23,12 +23,16 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include <QString>
 #include <QtGlobal>
 
+class QAtomicInt;
+class QByteArray;
+
 namespace detail {
 class knumber_base;
 }
 
 class KNumber {
 private:
+	friend class KNumberArray;
 	friend bool operator==(const KNumber &lhs, const KNumber &rhs);
 	friend bool operator!=(const KNumber &lhs, const KNumber &rhs);
 	friend bool operator>=(const KNumber &lhs, const KNumber &rhs);
@@ -57,6 +61,10 @@ public:
 	static KNumber Pi();
 	static KNumber Euler();
 
+	// conversion factors from degrees and gradians to radians
+	static KNumber PiOver180();
+	static KNumber PiOver200();
+
 public:
 	// construction/destruction
 	KNumber();
@@ -76,6 +84,7 @@ public:
 	explicit KNumber(double value);
 
 	KNumber(const KNumber &other);
+	KNumber(KNumber &&other) noexcept;
 	~KNumber();
 
 public:
@@ -84,6 +93,7 @@ public:
 public:
 	// assignment
 	KNumber &operator=(const KNumber &rhs);
+	KNumber &operator=(KNumber &&rhs) noexcept;
 
 public:
 	// basic math operators
@@ -111,9 +121,22 @@ public:
 
 public:
 	QString toQString(int width = -1, int precision = -1) const;
+
+	// the integer part. toUint64() gives its lowest 64 bits in two's
+	// complement, toInt64() gives INT64_MIN or INT64_MAX when it is out of
+	// range. both are 0 for nan and infinity
 	quint64 toUint64() const;
 	qint64 toInt64() const;
 
+	// a compact binary form which keeps all of the value: integers and
+	// fractions exactly and floats bit for bit, with their precision. it is
+	// versioned and the same on every machine.
+	//
+	// deserialize() reads straight from the memory it is given, which can be
+	// a mapped file. *used is set to the number of bytes the value took, or
+	// to 0 when the data isn't a value in this format, which gives nan
+	QByteArray serialize() const;
+	static KNumber deserialize(const char *data, qint64 size, qint64 *used = 0);
 
 public:
 	KNumber abs() const;
@@ -148,6 +171,8 @@ public:
 	KNumber bin(const KNumber &x) const;
 
 public:
+	// these change the default KNumberContext, which the threads without
+	// a context of their own work with
 	static void setDefaultFloatPrecision(int precision);
 	static void setSplitoffIntegerForFractionOutput(bool x);
 	static void setDefaultFractionalInput(bool x);
@@ -155,21 +180,104 @@ public:
 	static void setGroupSeparator(const QString &ch);
 	static void setDecimalSeparator(const QString &ch);
 
+	// fractions are brought to lowest terms only when they are shown or have
+	// grown large, rather than after every operation. the results are the same
+	static void setLazyFractionReduction(bool x);
+
+	// a fraction result with more limbs than this in its numerator and
+	// denominator together becomes a float at the current precision, or nan.
+	// 0, the default, is no limit
+	enum FractionOverflow {
+		FRACTION_OVERFLOW_TO_FLOAT,
+		FRACTION_OVERFLOW_TO_ERROR
+	};
+
+	static void setFractionLimbBudget(int limbs, FractionOverflow overflow = FRACTION_OVERFLOW_TO_FLOAT);
+
+	// while a flag is set for the calling thread, the factorial, bin and pow
+	// of big integers are worked out in steps, which is somewhat slower. once
+	// the flag is non-zero they stop at the next step and give nan. 0 removes
+	// the flag
+	static void setCancelFlag(const QAtomicInt *flag);
+
+	// factorials of big integers are split over this many threads of the
+	// global thread pool, up to 32. 0, the default, is one thread for each
+	// core. with fewer than 8 they stay on the calling thread
+	static void setThreadCount(int count);
+
+	// integer and fraction results which would need more memory than the
+	// operation budget are given as floats, or as infinity where a float
+	// can't do either (factorials, binomials, shifts). when an operation
+	// runs out of the operation budget or takes the GMP memory in use past
+	// the process budget anyway, the result is nan. 0 is no limit, the
+	// default is 256 MiB for an operation and no limit for the process
+	static void setMemoryBudget(quint64 operationBytes, quint64 processBytes);
+
+	// the results of factorial(), tgamma(), bin() and pow() which don't fit
+	// in 64 bits are kept by operation, operands and float precision, in a
+	// cache of up to this many bytes. the least recently used go first.
+	// 0, the default, turns the cache off
+	static void setResultCacheSize(quint64 bytes);
+	static void clearResultCache();
+
+	// the separators of the calling thread's context
 	static QString groupSeparator();
 	static QString decimalSeparator();
 
+public:
+	// what the library has been doing since the start or the last reset,
+	// summed over all threads. the counters are only updated when knumber
+	// is built with KNUMBER_STATISTICS, they all stay zero otherwise
+	struct Statistics {
+		quint64 objectsAllocated;   // values created on the heap
+		quint64 inlineSpills;       // 64 bit integers moved to the heap
+		quint64 integerToFloat;
+		quint64 integerToFraction;
+		quint64 fractionToFloat;
+		quint64 fractionToInteger;  // integral fractions simplified
+		quint64 floatToInteger;     // integral floats simplified
+		quint64 inlined;            // simplified values which fit in 64 bits
+		quint64 canonicalizations;  // mpq_canonicalize calls
+		quint64 limbBytes;          // bytes of GMP limbs allocated
+		quint64 fractionOverflows;  // fractions over the limb budget
+		quint64 cacheHits;          // results found in the result cache
+		quint64 cacheMisses;        // results not found in it
+		quint64 fastPathHits;       // functions answered from a double
+		quint64 fastPathMisses;     // functions evaluated at the full precision
+		quint64 poolHits;           // allocations served from the pool
+		quint64 poolMisses;         // allocations of a pooled size from malloc
+	};
+
+	static bool statisticsEnabled();
+	static Statistics statistics();
+	static void resetStatistics();
+
 public:
 	void swap(KNumber &other);
 
 private:
-	void simplify();
+	class operand;
+	class constants;
+	class parser;
+	class result_cache;
+	class serializer;
 
 private:
-	detail::knumber_base *value_;
+	explicit KNumber(detail::knumber_base *value);
 
 private:
-	static QString GroupSeparator;
-	static QString DecimalSeparator;
+	void simplify();
+	void detach();
+	int compare(const KNumber &rhs) const;
+
+private:
+	// integers which fit in 64 bits are kept inline in small_ and value_ is
+	// left null, so the common case never touches the heap or GMP. the value
+	// spills over to a detail::knumber_integer when a result overflows.
+	// a value_ is shared between copies and is only cloned when one of them
+	// is about to be modified (see detach)
+	detail::knumber_base *value_;
+	qint64                small_;
 };
 
 #endif
@@ -0,0 +1,671 @@
+/*
+Copyright (C) 2001 - 2013 Evan Teran
+                          evan.teran@gmail.com
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <config-kcalc.h>
+#include "knumber_allocator.h"
+#include "knumber_statistics.h"
+#include <cstddef>
+#include <gmp.h>
+#include <atomic>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+
+namespace detail {
+
+namespace {
+
+const std::size_t granularity  = 8;
+const std::size_t size_classes = 64;
+const int         max_cached   = 128;
+
+// operations which need fewer bits than this are done without a budget
+const double scoped_bits = 1 << 20;
+
+struct free_block {
+	free_block *next;
+};
+
+// this has to stay trivially destructible, it is still used while the
+// thread (or the program) is being torn down
+struct pool_cache {
+	free_block *head[size_classes];
+	int         count[size_classes];
+	bool        active;
+	bool        finished;
+};
+
+thread_local pool_cache cache;
+
+std::atomic<std::size_t> operation_budget(256 << 20);
+std::atomic<std::size_t> process_budget(0);
+std::atomic<qint64>      bytes_in_use(0);
+
+// the knumber_budget_scope of the thread, the blocks are only looked at
+// while the depth is not 0. the growth is that of the whole operation
+thread_local int                  scope_depth    = 0;
+thread_local std::atomic<qint64> *scope_growth   = 0;
+thread_local bool                 scope_exceeded = false;
+
+#ifdef KNUMBER_THROWING_ALLOCATOR
+// a block which was allocated inside the scope, or one from before it which
+// GMP grew there. freeing it gives back the bytes which were charged for it,
+// release() leaves the blocks it doesn't own to the numbers they belong to
+struct scope_block {
+	void       *block;
+	std::size_t size;
+	std::size_t charged;
+	bool        owned;
+};
+
+// the blocks are kept in an open addressing table of a fixed size, the GMP
+// allocation functions can't allocate memory of their own to keep track of
+// them. an operation which has more blocks than fit is stopped as if it went
+// over its budget
+const std::size_t scope_table_size = 512;
+const std::size_t scope_table_max  = scope_table_size / 4 * 3;
+
+thread_local scope_block scope_blocks[scope_table_size];
+thread_local std::size_t scope_block_count = 0;
+#else
+// without the blocks there is no telling what was charged for the one which
+// is freed. a free gives back at most what the thread charged and didn't give
+// back yet, so that freeing numbers from before the scope doesn't make room
+// for the operation
+thread_local std::size_t scope_charged = 0;
+#endif
+
+//------------------------------------------------------------------------------
+// Name: pool_cleanup
+// Desc: gives the cached blocks of a thread back to the system when it exits
+//------------------------------------------------------------------------------
+struct pool_cleanup {
+	void activate() {
+	}
+
+	~pool_cleanup() {
+		for(std::size_t i = 0; i < size_classes; ++i) {
+			while(free_block *const b = cache.head[i]) {
+				cache.head[i] = b->next;
+				bytes_in_use.fetch_sub((i + 1) * granularity, std::memory_order_relaxed);
+				std::free(b);
+			}
+			cache.count[i] = 0;
+		}
+
+		cache.finished = true;
+	}
+};
+
+thread_local pool_cleanup cleanup;
+
+//------------------------------------------------------------------------------
+// Name: thread_cache
+//------------------------------------------------------------------------------
+pool_cache &thread_cache() {
+
+	pool_cache &c = cache;
+
+	// first use by this thread, make sure the cache gets cleaned up
+	if(!c.active) {
+		c.active = true;
+		cleanup.activate();
+	}
+
+	return c;
+}
+
+//------------------------------------------------------------------------------
+// Name: size_class
+//------------------------------------------------------------------------------
+int size_class(std::size_t size) {
+
+	if(size == 0 || size % granularity != 0 || size > size_classes * granularity) {
+		return -1;
+	}
+
+	return static_cast<int>(size / granularity) - 1;
+}
+
+//------------------------------------------------------------------------------
+// Name: over_budget
+// Desc: throws if GMP lets exceptions through, the allocation which was
+//       charged then doesn't happen. otherwise leaves it to
+//       knumber_budget_scope::check() and lets the allocation go ahead
+//------------------------------------------------------------------------------
+void over_budget(qint64 bytes) {
+	scope_exceeded = true;
+#ifdef KNUMBER_THROWING_ALLOCATOR
+	scope_growth->fetch_sub(bytes, std::memory_order_relaxed);
+	throw knumber_budget_exceeded();
+#else
+	Q_UNUSED(bytes);
+#endif
+}
+
+//------------------------------------------------------------------------------
+// Name: charge
+// Desc: flags growing by this many bytes if it goes over a budget, only ever
+//       called inside a knumber_budget_scope
+//------------------------------------------------------------------------------
+void charge(qint64 bytes) {
+
+	const std::size_t operation = operation_budget.load(std::memory_order_relaxed);
+	const std::size_t process   = process_budget.load(std::memory_order_relaxed);
+	const qint64 growth         = scope_growth->fetch_add(bytes, std::memory_order_relaxed) + bytes;
+	if(operation != 0 && growth > static_cast<qint64>(operation)) {
+		over_budget(bytes);
+	} else if(process != 0 && bytes_in_use.load(std::memory_order_relaxed) + bytes > static_cast<qint64>(process)) {
+		over_budget(bytes);
+	}
+}
+
+//------------------------------------------------------------------------------
+// Name: give_back
+// Desc: takes the charge for a block off the growth of the operation
+//------------------------------------------------------------------------------
+void give_back(std::size_t bytes) {
+	if(bytes != 0) {
+		scope_growth->fetch_sub(static_cast<qint64>(bytes), std::memory_order_relaxed);
+	}
+}
+
+#ifdef KNUMBER_THROWING_ALLOCATOR
+//------------------------------------------------------------------------------
+// Name: slot_of
+//------------------------------------------------------------------------------
+std::size_t slot_of(const void *block) {
+	// the low bits of the addresses hardly differ, the high bits of the product do
+	return static_cast<std::size_t>((static_cast<quint64>(reinterpret_cast<quintptr>(block)) * Q_UINT64_C(0x9e3779b97f4a7c15)) >> 55);
+}
+
+//------------------------------------------------------------------------------
+// Name: find_block
+//------------------------------------------------------------------------------
+scope_block *find_block(const void *block) {
+
+	for(std::size_t i = slot_of(block); scope_blocks[i].block; i = (i + 1) % scope_table_size) {
+		if(scope_blocks[i].block == block) {
+			return &scope_blocks[i];
+		}
+	}
+
+	return 0;
+}
+
+//------------------------------------------------------------------------------
+// Name: insert_block
+// Desc: returns false if the table is full
+//------------------------------------------------------------------------------
+bool insert_block(const scope_block &block) {
+
+	if(scope_block_count == scope_table_max) {
+		return false;
+	}
+
+	std::size_t i = slot_of(block.block);
+	while(scope_blocks[i].block) {
+		i = (i + 1) % scope_table_size;
+	}
+
+	scope_blocks[i] = block;
+	++scope_block_count;
+	return true;
+}
+
+//------------------------------------------------------------------------------
+// Name: erase_block
+// Desc: moves the blocks after it back where they can be found from their
+//       slot, the table doesn't need to mark deleted entries that way
+//------------------------------------------------------------------------------
+void erase_block(scope_block *block) {
+
+	std::size_t i = block - scope_blocks;
+	for(std::size_t j = (i + 1) % scope_table_size; scope_blocks[j].block; j = (j + 1) % scope_table_size) {
+		const std::size_t k     = slot_of(scope_blocks[j].block);
+		const bool        stays = (i < j) ? (i < k && k <= j) : (i < k || k <= j);
+		if(!stays) {
+			scope_blocks[i] = scope_blocks[j];
+			i = j;
+		}
+	}
+
+	scope_blocks[i].block = 0;
+	--scope_block_count;
+}
+
+//------------------------------------------------------------------------------
+// Name: forget_blocks
+//------------------------------------------------------------------------------
+void forget_blocks() {
+	if(scope_block_count != 0) {
+		std::memset(scope_blocks, 0, sizeof(scope_blocks));
+		scope_block_count = 0;
+	}
+}
+
+//------------------------------------------------------------------------------
+// Name: track_allocated
+// Desc: gmp_allocate made sure there is room for the block
+//------------------------------------------------------------------------------
+void track_allocated(void *p, std::size_t size) {
+	const scope_block block = { p, size, size, true };
+	insert_block(block);
+}
+
+//------------------------------------------------------------------------------
+// Name: track_reallocated
+//------------------------------------------------------------------------------
+void track_reallocated(void *p, void *q, std::size_t new_size, qint64 growth) {
+
+	scope_block block = { q, new_size, 0, false };
+
+	if(scope_block *const b = find_block(p)) {
+		block.charged = b->charged;
+		block.owned   = b->owned;
+		erase_block(b);
+	}
+
+	if(growth > 0) {
+		block.charged += growth;
+	} else {
+		const std::size_t shrink = qMin(static_cast<std::size_t>(-growth), block.charged);
+		block.charged -= shrink;
+		give_back(shrink);
+	}
+
+	// an owned block just made room for itself. if there is none for one from
+	// before the scope, its charge stays with the operation
+	if(block.owned || block.charged != 0) {
+		insert_block(block);
+	}
+}
+
+//------------------------------------------------------------------------------
+// Name: track_freed
+//------------------------------------------------------------------------------
+void track_freed(void *p, std::size_t size) {
+
+	Q_UNUSED(size);
+
+	if(scope_block *const b = find_block(p)) {
+		give_back(b->charged);
+		erase_block(b);
+	}
+}
+#else
+//------------------------------------------------------------------------------
+// Name: forget_blocks
+//------------------------------------------------------------------------------
+void forget_blocks() {
+	scope_charged = 0;
+}
+
+//------------------------------------------------------------------------------
+// Name: give_back_charged
+//------------------------------------------------------------------------------
+void give_back_charged(std::size_t bytes) {
+	const std::size_t n = qMin(bytes, scope_charged);
+	scope_charged -= n;
+	give_back(n);
+}
+
+//------------------------------------------------------------------------------
+// Name: track_allocated
+//------------------------------------------------------------------------------
+void track_allocated(void *p, std::size_t size) {
+	Q_UNUSED(p);
+	scope_charged += size;
+}
+
+//------------------------------------------------------------------------------
+// Name: track_reallocated
+//------------------------------------------------------------------------------
+void track_reallocated(void *p, void *q, std::size_t new_size, qint64 growth) {
+
+	Q_UNUSED(p);
+	Q_UNUSED(q);
+	Q_UNUSED(new_size);
+
+	if(growth > 0) {
+		scope_charged += growth;
+	} else {
+		give_back_charged(-growth);
+	}
+}
+
+//------------------------------------------------------------------------------
+// Name: track_freed
+//------------------------------------------------------------------------------
+void track_freed(void *p, std::size_t size) {
+	Q_UNUSED(p);
+	give_back_charged(size);
+}
+#endif
+
+//------------------------------------------------------------------------------
+// Name: out_of_memory
+//------------------------------------------------------------------------------
+void out_of_memory(size_t size) {
+
+#ifdef KNUMBER_THROWING_ALLOCATOR
+	if(scope_depth != 0) {
+		throw knumber_budget_exceeded();
+	}
+#endif
+
+	qFatal("knumber: out of memory allocating %lu bytes", static_cast<unsigned long>(size));
+}
+
+//------------------------------------------------------------------------------
+// Name: gmp_allocate
+//------------------------------------------------------------------------------
+void *gmp_allocate(size_t size) {
+
+	KNUMBER_COUNT_N(LIMB_BYTES, size);
+
+	if(scope_depth != 0) {
+		charge(size);
+#ifdef KNUMBER_THROWING_ALLOCATOR
+		// release() couldn't find the block to free it
+		if(scope_block_count == scope_table_max) {
+			over_budget(size);
+		}
+#endif
+	}
+
+	void *const p = knumber_allocator::allocate(size);
+	if(!p) {
+		out_of_memory(size);
+	}
+
+	if(scope_depth != 0) {
+		track_allocated(p, size);
+	}
+
+	return p;
+}
+
+//------------------------------------------------------------------------------
+// Name: gmp_reallocate
+//------------------------------------------------------------------------------
+void *gmp_reallocate(void *p, size_t old_size, size_t new_size) {
+
+	KNUMBER_COUNT_N(LIMB_BYTES, new_size);
+
+	const qint64 growth = static_cast<qint64>(new_size) - static_cast<qint64>(old_size);
+	if(scope_depth != 0 && growth > 0) {
+		charge(growth);
+	}
+
+	void *const q = knumber_allocator::reallocate(p, old_size, new_size);
+	if(!q) {
+		out_of_memory(new_size);
+	}
+
+	if(scope_depth != 0) {
+		track_reallocated(p, q, new_size, growth);
+	}
+
+	return q;
+}
+
+//------------------------------------------------------------------------------
+// Name: gmp_deallocate
+//------------------------------------------------------------------------------
+void gmp_deallocate(void *p, size_t size) {
+
+	if(scope_depth != 0) {
+		track_freed(p, size);
+	}
+
+	knumber_allocator::deallocate(p, size);
+}
+
+//------------------------------------------------------------------------------
+// Name: gmp_registration
+// Desc: blocks which GMP got from malloc before this runs are fine to pass
+//       through here, we only ever reuse a block for a request of exactly the
+//       size it was freed with
+//------------------------------------------------------------------------------
+struct gmp_registration {
+	gmp_registration() {
+		mp_set_memory_functions(gmp_allocate, gmp_reallocate, gmp_deallocate);
+	}
+};
+
+const gmp_registration registration;
+
+}
+
+//------------------------------------------------------------------------------
+// Name: allocate
+//------------------------------------------------------------------------------
+void *knumber_allocator::allocate(std::size_t size) {
+
+	const int n = size_class(size);
+	if(n >= 0) {
+		pool_cache &c = thread_cache();
+		if(free_block *const b = c.head[n]) {
+			c.head[n] = b->next;
+			--c.count[n];
+			KNUMBER_COUNT(POOL_HITS);
+			return b;
+		}
+		KNUMBER_COUNT(POOL_MISSES);
+	}
+
+	void *const p = std::malloc(size);
+	if(p) {
+		bytes_in_use.fetch_add(size, std::memory_order_relaxed);
+	}
+	return p;
+}
+
+//------------------------------------------------------------------------------
+// Name: reallocate
+//------------------------------------------------------------------------------
+void *knumber_allocator::reallocate(void *p, std::size_t old_size, std::size_t new_size) {
+
+	if(old_size == new_size) {
+		return p;
+	}
+
+	if(size_class(old_size) < 0 && size_class(new_size) < 0) {
+		void *const q = std::realloc(p, new_size);
+		if(q) {
+			bytes_in_use.fetch_add(static_cast<qint64>(new_size) - static_cast<qint64>(old_size), std::memory_order_relaxed);
+		}
+		return q;
+	}
+
+	void *const q = allocate(new_size);
+	if(q) {
+		std::memcpy(q, p, qMin(old_size, new_size));
+		deallocate(p, old_size);
+	}
+	return q;
+}
+
+//------------------------------------------------------------------------------
+// Name: deallocate
+//------------------------------------------------------------------------------
+void knumber_allocator::deallocate(void *p, std::size_t size) {
+
+	if(!p) {
+		return;
+	}
+
+	const int n = size_class(size);
+	if(n >= 0) {
+		pool_cache &c = thread_cache();
+		if(!c.finished && c.count[n] < max_cached) {
+			free_block *const b = static_cast<free_block *>(p);
+			b->next = c.head[n];
+			c.head[n] = b;
+			++c.count[n];
+			return;
+		}
+	}
+
+	bytes_in_use.fetch_sub(size, std::memory_order_relaxed);
+	std::free(p);
+}
+
+//------------------------------------------------------------------------------
+// Name: set_budget
+//------------------------------------------------------------------------------
+void knumber_allocator::set_budget(std::size_t operation_bytes, std::size_t process_bytes) {
+	operation_budget.store(operation_bytes, std::memory_order_relaxed);
+	process_budget.store(process_bytes, std::memory_order_relaxed);
+}
+
+//------------------------------------------------------------------------------
+// Name: fits_budget
+//------------------------------------------------------------------------------
+bool knumber_allocator::fits_budget(double bits, double scale) {
+
+	// GMP aborts if an mpz_t would need more than INT_MAX limbs
+	if(bits >= static_cast<double>(INT_MAX) * GMP_NUMB_BITS) {
+		return false;
+	}
+
+	const std::size_t operation = operation_budget.load(std::memory_order_relaxed);
+	return operation == 0 || bits / 8 * scale <= static_cast<double>(operation);
+}
+
+//------------------------------------------------------------------------------
+// Name: in_use
+//------------------------------------------------------------------------------
+qint64 knumber_allocator::in_use() {
+	return bytes_in_use.load(std::memory_order_relaxed);
+}
+
+//------------------------------------------------------------------------------
+// Name: knumber_budget_scope
+//------------------------------------------------------------------------------
+knumber_budget_scope::knumber_budget_scope(double bits) : active_(bits >= scoped_bits), outermost_(active_ && scope_depth == 0), growth_(0) {
+
+	if(!active_) {
+		return;
+	}
+
+	if(outermost_) {
+		scope_growth   = &growth_;
+		scope_exceeded = false;
+		forget_blocks();
+	}
+
+	++scope_depth;
+}
+
+//------------------------------------------------------------------------------
+// Name: knumber_budget_scope
+//------------------------------------------------------------------------------
+knumber_budget_scope::knumber_budget_scope(double bits, std::atomic<qint64> *growth) : active_(bits >= scoped_bits), outermost_(active_ && scope_depth == 0), growth_(0) {
+
+	if(!active_) {
+		return;
+	}
+
+	if(outermost_) {
+		scope_growth   = growth ? growth : &growth_;
+		scope_exceeded = false;
+		forget_blocks();
+	}
+
+	++scope_depth;
+}
+
+//------------------------------------------------------------------------------
+// Name: ~knumber_budget_scope
+//------------------------------------------------------------------------------
+knumber_budget_scope::~knumber_budget_scope() {
+
+	if(!active_) {
+		return;
+	}
+
+	--scope_depth;
+
+	if(outermost_) {
+		scope_growth   = 0;
+		scope_exceeded = false;
+		forget_blocks();
+	}
+}
+
+//------------------------------------------------------------------------------
+// Name: release
+//------------------------------------------------------------------------------
+void knumber_budget_scope::release() {
+
+	if(!outermost_) {
+		return;
+	}
+
+#ifdef KNUMBER_THROWING_ALLOCATOR
+	for(std::size_t i = 0; i < scope_table_size; ++i) {
+		const scope_block &b = scope_blocks[i];
+		if(b.block && b.owned) {
+			give_back(b.charged);
+			knumber_allocator::deallocate(b.block, b.size);
+		}
+	}
+#endif
+
+	// without KNUMBER_THROWING_ALLOCATOR, GMP always returns and nothing leaks
+	forget_blocks();
+	scope_exceeded = false;
+}
+
+//------------------------------------------------------------------------------
+// Name: growth
+//------------------------------------------------------------------------------
+std::atomic<qint64> *knumber_budget_scope::growth() {
+	return (scope_depth != 0) ? scope_growth : 0;
+}
+
+//------------------------------------------------------------------------------
+// Name: track
+//------------------------------------------------------------------------------
+void knumber_budget_scope::track(void *block, std::size_t size) {
+
+	if(scope_depth != 0 && size != 0) {
+#ifdef KNUMBER_THROWING_ALLOCATOR
+		// if the table is full, the block stays charged to the operation
+		const scope_block b = { block, size, size, false };
+		insert_block(b);
+#else
+		Q_UNUSED(block);
+		scope_charged += size;
+#endif
+	}
+}
+
+//------------------------------------------------------------------------------
+// Name: check
+//------------------------------------------------------------------------------
+void knumber_budget_scope::check() {
+
+	if(scope_exceeded) {
+		throw knumber_budget_exceeded();
+	}
+}
+
+}
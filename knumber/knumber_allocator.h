@@ -0,0 +1,116 @@
+/*
+Copyright (C) 2001 - 2013 Evan Teran
+                          evan.teran@gmail.com
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef KNUMBER_ALLOCATOR_H_
+#define KNUMBER_ALLOCATOR_H_
+
+#include <QtGlobal>
+#include <atomic>
+#include <cstddef>
+#include <new>
+
+namespace detail {
+
+// A size class pool for the knumber_* objects and the GMP limbs, the latter
+// are routed here through mp_set_memory_functions. Freed blocks are kept in
+// a per thread cache and handed out again for the next request of the same
+// size. Only sizes which are a multiple of 8 bytes, up to 512 bytes, are
+// pooled; everything else goes straight to malloc.
+class knumber_allocator {
+public:
+	static void *allocate(std::size_t size);
+	static void *reallocate(void *p, std::size_t old_size, std::size_t new_size);
+	static void deallocate(void *p, std::size_t size);
+
+public:
+	// limits on the GMP memory, 0 is no limit. the operation budget is on
+	// what an operation allocates beyond what it frees while a
+	// knumber_budget_scope is active, the process budget on in_use()
+	static void set_budget(std::size_t operation_bytes, std::size_t process_bytes);
+
+	// true if an exact result of this many bits is within what an mpz_t can
+	// hold, and within the operation budget when the operation needs scale
+	// times the size of the result all told
+	static bool fits_budget(double bits, double scale = 1);
+
+	// bytes taken from the system through the allocator and not given back
+	// yet, blocks which are cached for reuse count as in use
+	static qint64 in_use();
+};
+
+// thrown when an allocation would go over a budget while a
+// knumber_budget_scope is active: by the GMP allocation functions if GMP
+// lets exceptions through (KNUMBER_THROWING_ALLOCATOR), otherwise by
+// knumber_budget_scope::check() once GMP is done
+class knumber_budget_exceeded : public std::bad_alloc {
+};
+
+// While one of these is on the stack, the GMP allocations of the thread are
+// checked against the budgets. GMP can't clean up after an allocation has
+// thrown: once the numbers which were being worked on are destroyed,
+// release() frees whatever was allocated since the scope began and is still
+// there. Nested scopes leave all of this to the outermost one.
+//
+// An operation which is split over several threads has a scope on each of
+// them, and they share the count of what the operation has grown by. Freeing
+// a block only gives back what was charged for it to that count. Only a
+// throwing allocator keeps track of the blocks, without one a free gives back
+// no more than the thread charged since the scope began.
+//
+// The bits are about how much memory the operation needs. For a small
+// operation the bookkeeping isn't worth it, it can't take the memory far past
+// a budget, and the scope does nothing
+class knumber_budget_scope {
+public:
+	explicit knumber_budget_scope(double bits);
+
+	// a scope on another thread working on the same operation, growth is what
+	// growth() gave the thread which split the operation up
+	knumber_budget_scope(double bits, std::atomic<qint64> *growth);
+	~knumber_budget_scope();
+
+public:
+	void release();
+
+public:
+	// the count the operation of the calling thread charges its allocations
+	// to, 0 outside of a scope
+	static std::atomic<qint64> *growth();
+
+	// takes over a block which another thread of the operation allocated and
+	// charged, so that freeing it here gives it back to the operation
+	static void track(void *block, std::size_t size);
+
+public:
+	// throws knumber_budget_exceeded if the thread went over a budget since
+	// the outermost scope began. operations call this after each step, so
+	// that they stop even where the GMP allocation functions can't throw
+	static void check();
+
+private:
+	Q_DISABLE_COPY(knumber_budget_scope)
+
+private:
+	bool                active_;
+	bool                outermost_;
+	std::atomic<qint64> growth_;
+};
+
+}
+
+#endif
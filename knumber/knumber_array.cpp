@@ -0,0 +1,811 @@
+/*
+Copyright (C) 2001 - 2013 Evan Teran
+                          evan.teran@gmail.com
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <config-kcalc.h>
+#include "knumber_array.h"
+#include "knumber_base.h"
+#include "knumber_float.h"
+#include "knumber_overflow.h"
+#include "knumber_simd.h"
+#include <climits>
+#include <float.h>
+#include <math.h>
+
+namespace {
+
+// every integer up to this magnitude is exactly a double
+const double max_exact_integer = 9007199254740992.0;
+
+//------------------------------------------------------------------------------
+// Name: float_sum
+// Desc: a running sum at the context's float precision, this is exactly what
+//       adding up KNumber floats one by one does
+//------------------------------------------------------------------------------
+class float_sum {
+public:
+	float_sum() : used_(false) {
+		mpf_init2(sum_, detail::knumber_float::context_precision());
+		mpf_init2(x_, detail::knumber_float::context_precision());
+		mpf_init2(y_, detail::knumber_float::context_precision());
+	}
+
+	~float_sum() {
+		mpf_clear(sum_);
+		mpf_clear(x_);
+		mpf_clear(y_);
+	}
+
+private:
+	float_sum(const float_sum &);
+	float_sum &operator=(const float_sum &);
+
+public:
+	void add(double x) {
+		mpf_set_d(x_, x);
+		mpf_add(sum_, sum_, x_);
+		used_ = true;
+	}
+
+	void add_square(double x) {
+		mpf_set_d(x_, x);
+		mpf_mul(x_, x_, x_);
+		mpf_add(sum_, sum_, x_);
+		used_ = true;
+	}
+
+	void add_product(double x, double y) {
+		mpf_set_d(x_, x);
+		mpf_set_d(y_, y);
+		mpf_mul(x_, x_, y_);
+		mpf_add(sum_, sum_, x_);
+		used_ = true;
+	}
+
+	void add_product(qint64 x, double y) {
+		set_int64(x_, x);
+		mpf_set_d(y_, y);
+		mpf_mul(x_, x_, y_);
+		mpf_add(sum_, sum_, x_);
+		used_ = true;
+	}
+
+public:
+	bool used() const { return used_; }
+	mpf_ptr get()     { return sum_; }
+
+private:
+	// mpf_set_si only takes a long, which can be 32 bits
+	static void set_int64(mpf_t f, qint64 value) {
+		if(value >= LONG_MIN && value <= LONG_MAX) {
+			mpf_set_si(f, static_cast<long>(value));
+		} else {
+			mpf_set_si(f, static_cast<long>(value >> 32));
+			mpf_mul_2exp(f, f, 32);
+			mpf_add_ui(f, f, static_cast<unsigned long>(value & Q_INT64_C(0xffffffff)));
+		}
+	}
+
+private:
+	mpf_t sum_;
+	mpf_t x_;
+	mpf_t y_;
+	bool  used_;
+};
+
+//------------------------------------------------------------------------------
+// Name: nearest_double
+// Desc: mpf_get_d truncates, the rest it cuts off decides whether to round up
+//------------------------------------------------------------------------------
+double nearest_double(mpf_srcptr x) {
+
+	const double d = mpf_get_d(x);
+	if(!isfinite(d)) {
+		return d;
+	}
+
+	mpf_t rest;
+	mpf_init2(rest, 64);
+	mpf_set_d(rest, d);
+	mpf_sub(rest, x, rest);
+	const double r = mpf_get_d(rest);
+	mpf_clear(rest);
+
+	return d + r;
+}
+
+//------------------------------------------------------------------------------
+// Name: accumulate
+// Desc: adds value to a 64 bit running sum, the sum is moved over to spill
+//       before it would overflow
+//------------------------------------------------------------------------------
+inline void accumulate(qint64 value, qint64 *sum, KNumber *spill) {
+	qint64 r;
+	if(detail::add_overflow(*sum, value, &r)) {
+		*spill += KNumber(*sum);
+		*sum = value;
+	} else {
+		*sum = r;
+	}
+}
+
+//------------------------------------------------------------------------------
+// Name: int64_add
+//------------------------------------------------------------------------------
+bool int64_add(qint64 a, qint64 b, qint64 *r) {
+	return !detail::add_overflow(a, b, r);
+}
+
+//------------------------------------------------------------------------------
+// Name: int64_mul
+//------------------------------------------------------------------------------
+bool int64_mul(qint64 a, qint64 b, qint64 *r) {
+	return !detail::mul_overflow(a, b, r);
+}
+
+//------------------------------------------------------------------------------
+// Name: double_add
+// Desc: a + b if the double holds it exactly, the rounding error of an
+//       addition is always a double itself (Knuth's two-sum)
+//------------------------------------------------------------------------------
+bool double_add(double a, double b, double *r) {
+	const double s = a + b;
+	if(!isfinite(s)) {
+		return false;
+	}
+
+	const double bb = s - a;
+	*r = s;
+	return (a - (s - bb)) + (b - bb) == 0.0;
+}
+
+//------------------------------------------------------------------------------
+// Name: double_mul
+// Desc: a * b if the double holds it exactly, fma gives the rounding error.
+//       that doesn't work once the product gets near the denormals
+//------------------------------------------------------------------------------
+bool double_mul(double a, double b, double *r) {
+	const double p = a * b;
+	if(!isfinite(p)) {
+		return false;
+	}
+
+	if(p == 0.0) {
+		*r = 0.0;
+		return a == 0.0 || b == 0.0;
+	}
+
+	if(fabs(p) < DBL_MIN * max_exact_integer) {
+		return false;
+	}
+
+	*r = p;
+	return fma(a, b, -p) == 0.0;
+}
+
+//------------------------------------------------------------------------------
+// Name: knumber_add
+//------------------------------------------------------------------------------
+KNumber knumber_add(const KNumber &a, const KNumber &b) {
+	return a + b;
+}
+
+//------------------------------------------------------------------------------
+// Name: knumber_mul
+//------------------------------------------------------------------------------
+KNumber knumber_mul(const KNumber &a, const KNumber &b) {
+	return a * b;
+}
+
+}
+
+//------------------------------------------------------------------------------
+// Name: KNumberArray
+//------------------------------------------------------------------------------
+KNumberArray::KNumberArray() : inexact_count_(0), fast_float_(false) {
+}
+
+//------------------------------------------------------------------------------
+// Name: setFastFloat
+//------------------------------------------------------------------------------
+void KNumberArray::setFastFloat(bool x) {
+	fast_float_ = x;
+}
+
+//------------------------------------------------------------------------------
+// Name: fastFloat
+//------------------------------------------------------------------------------
+bool KNumberArray::fastFloat() const {
+	return fast_float_;
+}
+
+//------------------------------------------------------------------------------
+// Name: make_element
+// Desc: works out which lane x belongs in. floats are never integral (KNumber
+//       turns those into integers), so a float which converts to a double
+//       without loss stays non-integral in the double lane as well
+//------------------------------------------------------------------------------
+KNumberArray::element KNumberArray::make_element(const KNumber &x) {
+
+	element e;
+	e.lane  = LANE_BIG;
+	e.int64 = 0;
+	e.real  = 0.0;
+	e.big   = &x;
+
+	if(!x.value_) {
+		e.lane  = LANE_INT64;
+		e.int64 = x.small_;
+	} else if(detail::knumber_float *const p = detail::knumber_cast<detail::knumber_float>(x.value_)) {
+		const double d = mpf_get_d(p->mpf_);
+		if(isfinite(d) && mpf_cmp_d(p->mpf_, d) == 0) {
+			e.lane = LANE_DOUBLE;
+			e.real = d;
+		}
+	}
+
+	return e;
+}
+
+//------------------------------------------------------------------------------
+// Name: element_at
+//------------------------------------------------------------------------------
+KNumberArray::element KNumberArray::element_at(int i) const {
+
+	const int n = static_cast<int>(order_[i] & index_mask);
+
+	element e;
+	e.lane  = static_cast<Lane>(order_[i] >> lane_shift);
+	e.int64 = 0;
+	e.real  = 0.0;
+	e.big   = 0;
+
+	switch(e.lane) {
+	case LANE_INT64:
+		e.int64 = int64_lane_[n];
+		break;
+	case LANE_DOUBLE:
+		e.real = double_lane_[n];
+		break;
+	case LANE_BIG:
+		e.big = &big_values_[n];
+		break;
+	}
+
+	return e;
+}
+
+//------------------------------------------------------------------------------
+// Name: to_knumber
+//------------------------------------------------------------------------------
+KNumber KNumberArray::to_knumber(const element &e) {
+
+	switch(e.lane) {
+	case LANE_INT64:
+		return KNumber(e.int64);
+	case LANE_DOUBLE:
+		return KNumber(e.real);
+	case LANE_BIG:
+	default:
+		return *e.big;
+	}
+}
+
+//------------------------------------------------------------------------------
+// Name: to_double
+// Desc: integers have to be exact in a double, floats only have to be in its
+//       range
+//------------------------------------------------------------------------------
+bool KNumberArray::to_double(const element &e, double *value) {
+
+	switch(e.lane) {
+	case LANE_INT64:
+		*value = static_cast<double>(e.int64);
+		return e.int64 >= -static_cast<qint64>(max_exact_integer) && e.int64 <= static_cast<qint64>(max_exact_integer);
+	case LANE_DOUBLE:
+		*value = e.real;
+		return true;
+	case LANE_BIG:
+	default:
+		if(detail::knumber_float *const p = detail::knumber_cast<detail::knumber_float>(e.big->value_)) {
+			*value = nearest_double(p->mpf_);
+			return isfinite(*value) && fabs(*value) >= DBL_MIN;
+		}
+		return false;
+	}
+}
+
+//------------------------------------------------------------------------------
+// Name: use_fast_float
+//------------------------------------------------------------------------------
+bool KNumberArray::use_fast_float() const {
+	return fast_float_ && !isExact();
+}
+
+//------------------------------------------------------------------------------
+// Name: to_doubles
+// Desc: all elements as doubles, false if one of them doesn't fit
+//------------------------------------------------------------------------------
+bool KNumberArray::to_doubles(QVector<double> *values) const {
+
+	values->resize(size());
+	double *const out = values->data();
+
+	for(int i = 0; i < size(); ++i) {
+		if(!to_double(element_at(i), &out[i])) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+//------------------------------------------------------------------------------
+// Name: append_element
+//------------------------------------------------------------------------------
+void KNumberArray::append_element(const element &e) {
+
+	switch(e.lane) {
+	case LANE_INT64:
+		order_.append((LANE_INT64 << lane_shift) | int64_lane_.size());
+		int64_lane_.append(e.int64);
+		break;
+	case LANE_DOUBLE:
+		order_.append((LANE_DOUBLE << lane_shift) | double_lane_.size());
+		double_lane_.append(e.real);
+		break;
+	case LANE_BIG:
+		order_.append((LANE_BIG << lane_shift) | big_values_.size());
+		big_values_.append(*e.big);
+		if(e.big->type() == KNumber::TYPE_FLOAT || e.big->type() == KNumber::TYPE_ERROR) {
+			++inexact_count_;
+		}
+		break;
+	}
+}
+
+//------------------------------------------------------------------------------
+// Name: append_real
+// Desc: appends the result of a double operation the way KNumber would store
+//       it, integral values become integers
+//------------------------------------------------------------------------------
+void KNumberArray::append_real(double value) {
+
+	if(value != floor(value)) {
+		element e;
+		e.lane  = LANE_DOUBLE;
+		e.int64 = 0;
+		e.real  = value;
+		e.big   = 0;
+		append_element(e);
+	} else if(value >= -9223372036854775808.0 && value < 9223372036854775808.0) {
+		element e;
+		e.lane  = LANE_INT64;
+		e.int64 = static_cast<qint64>(value);
+		e.real  = 0.0;
+		e.big   = 0;
+		append_element(e);
+	} else {
+		append(KNumber(value));
+	}
+}
+
+//------------------------------------------------------------------------------
+// Name: append
+//------------------------------------------------------------------------------
+void KNumberArray::append(const KNumber &x) {
+	append_element(make_element(x));
+}
+
+//------------------------------------------------------------------------------
+// Name: removeLast
+// Desc: elements are appended in order, so the last one is also the last one
+//       of its lane
+//------------------------------------------------------------------------------
+void KNumberArray::removeLast() {
+
+	if(order_.isEmpty()) {
+		return;
+	}
+
+	switch(static_cast<Lane>(order_.last() >> lane_shift)) {
+	case LANE_INT64:
+		int64_lane_.pop_back();
+		break;
+	case LANE_DOUBLE:
+		double_lane_.pop_back();
+		break;
+	case LANE_BIG:
+		if(big_values_.last().type() == KNumber::TYPE_FLOAT || big_values_.last().type() == KNumber::TYPE_ERROR) {
+			--inexact_count_;
+		}
+		big_values_.pop_back();
+		break;
+	}
+
+	order_.pop_back();
+}
+
+//------------------------------------------------------------------------------
+// Name: clear
+//------------------------------------------------------------------------------
+void KNumberArray::clear() {
+	order_.clear();
+	int64_lane_.clear();
+	double_lane_.clear();
+	big_values_.clear();
+	inexact_count_ = 0;
+}
+
+//------------------------------------------------------------------------------
+// Name: reserve
+//------------------------------------------------------------------------------
+void KNumberArray::reserve(int size) {
+	order_.reserve(size);
+	int64_lane_.reserve(size);
+}
+
+//------------------------------------------------------------------------------
+// Name: size
+//------------------------------------------------------------------------------
+int KNumberArray::size() const {
+	return order_.size();
+}
+
+//------------------------------------------------------------------------------
+// Name: isEmpty
+//------------------------------------------------------------------------------
+bool KNumberArray::isEmpty() const {
+	return order_.isEmpty();
+}
+
+//------------------------------------------------------------------------------
+// Name: at
+//------------------------------------------------------------------------------
+KNumber KNumberArray::at(int i) const {
+	return to_knumber(element_at(i));
+}
+
+//------------------------------------------------------------------------------
+// Name: toVector
+//------------------------------------------------------------------------------
+QVector<KNumber> KNumberArray::toVector() const {
+
+	QVector<KNumber> v;
+	v.reserve(size());
+	for(int i = 0; i < size(); ++i) {
+		v.append(at(i));
+	}
+	return v;
+}
+
+//------------------------------------------------------------------------------
+// Name: isExact
+//------------------------------------------------------------------------------
+bool KNumberArray::isExact() const {
+	return double_lane_.isEmpty() && inexact_count_ == 0;
+}
+
+//------------------------------------------------------------------------------
+// Name: sum
+//------------------------------------------------------------------------------
+KNumber KNumberArray::sum() const {
+
+	QVector<double> values;
+	if(use_fast_float() && to_doubles(&values)) {
+		const double r = detail::knumber_simd::sum(values.constData(), values.size());
+		if(isfinite(r)) {
+			return KNumber(r);
+		}
+	}
+
+	KNumber result = KNumber::Zero;
+
+	const qint64 *const ints = int64_lane_.constData();
+	qint64 int_sum = 0;
+	for(int i = 0; i < int64_lane_.size(); ++i) {
+		accumulate(ints[i], &int_sum, &result);
+	}
+	result += KNumber(int_sum);
+
+	const KNumber *const big = big_values_.constData();
+	for(int i = 0; i < big_values_.size(); ++i) {
+		result += big[i];
+	}
+
+	if(!double_lane_.isEmpty()) {
+		const double *const reals = double_lane_.constData();
+		float_sum real_sum;
+		for(int i = 0; i < double_lane_.size(); ++i) {
+			real_sum.add(reals[i]);
+		}
+		result += KNumber(detail::knumber_base::create<detail::knumber_float>(real_sum.get()));
+	}
+
+	return result;
+}
+
+//------------------------------------------------------------------------------
+// Name: sumOfSquares
+//------------------------------------------------------------------------------
+KNumber KNumberArray::sumOfSquares() const {
+
+	QVector<double> values;
+	if(use_fast_float() && to_doubles(&values)) {
+		const double r = detail::knumber_simd::sum_of_squares(values.constData(), values.size());
+		if(isfinite(r)) {
+			return KNumber(r);
+		}
+	}
+
+	KNumber result = KNumber::Zero;
+
+	const qint64 *const ints = int64_lane_.constData();
+	qint64 int_sum = 0;
+	for(int i = 0; i < int64_lane_.size(); ++i) {
+		qint64 square;
+		if(detail::mul_overflow(ints[i], ints[i], &square)) {
+			const KNumber x(ints[i]);
+			result += x * x;
+		} else {
+			accumulate(square, &int_sum, &result);
+		}
+	}
+	result += KNumber(int_sum);
+
+	const KNumber *const big = big_values_.constData();
+	for(int i = 0; i < big_values_.size(); ++i) {
+		result += big[i] * big[i];
+	}
+
+	if(!double_lane_.isEmpty()) {
+		const double *const reals = double_lane_.constData();
+		float_sum real_sum;
+		for(int i = 0; i < double_lane_.size(); ++i) {
+			real_sum.add_square(reals[i]);
+		}
+		result += KNumber(detail::knumber_base::create<detail::knumber_float>(real_sum.get()));
+	}
+
+	return result;
+}
+
+//------------------------------------------------------------------------------
+// Name: dot
+//------------------------------------------------------------------------------
+KNumber KNumberArray::dot(const KNumberArray &other) const {
+
+	Q_ASSERT(size() == other.size());
+
+	KNumber result = KNumber::Zero;
+	qint64 int_sum = 0;
+	float_sum real_sum;
+
+	const int n = qMin(size(), other.size());
+	for(int i = 0; i < n; ++i) {
+
+		const element a = element_at(i);
+		const element b = other.element_at(i);
+
+		if(a.lane == LANE_INT64 && b.lane == LANE_INT64) {
+			qint64 product;
+			if(detail::mul_overflow(a.int64, b.int64, &product)) {
+				result += KNumber(a.int64) * KNumber(b.int64);
+			} else {
+				accumulate(product, &int_sum, &result);
+			}
+		} else if(a.lane == LANE_DOUBLE && b.lane == LANE_DOUBLE) {
+			real_sum.add_product(a.real, b.real);
+		} else if(a.lane == LANE_INT64 && b.lane == LANE_DOUBLE) {
+			real_sum.add_product(a.int64, b.real);
+		} else if(a.lane == LANE_DOUBLE && b.lane == LANE_INT64) {
+			real_sum.add_product(b.int64, a.real);
+		} else {
+			result += to_knumber(a) * to_knumber(b);
+		}
+	}
+
+	result += KNumber(int_sum);
+
+	if(real_sum.used()) {
+		result += KNumber(detail::knumber_base::create<detail::knumber_float>(real_sum.get()));
+	}
+
+	return result;
+}
+
+//------------------------------------------------------------------------------
+// Name: mean
+//------------------------------------------------------------------------------
+KNumber KNumberArray::mean() const {
+	return sum() / KNumber(size());
+}
+
+//------------------------------------------------------------------------------
+// Name: sumOfSquaredDeviations
+// Desc: the sum of (x - mean)^2
+//------------------------------------------------------------------------------
+KNumber KNumberArray::sumOfSquaredDeviations() const {
+
+	QVector<double> values;
+	if(use_fast_float() && to_doubles(&values)) {
+		const double *const x = values.constData();
+		const int n = values.size();
+		const double r = detail::knumber_simd::sum_of_squared_deviations(x, n, detail::knumber_simd::sum(x, n) / n);
+		if(isfinite(r)) {
+			return KNumber(r);
+		}
+	}
+
+	if(isExact()) {
+		// sum(x^2) - sum(x)^2 / n is the very same number for integers and
+		// fractions, and needs no subtraction per element
+		const KNumber sum_value = sum();
+		return sumOfSquares() - sum_value * sum_value / KNumber(size());
+	}
+
+	// with floats that would cancel out the digits of a small variance
+	const KNumber mean_value = mean();
+
+	KNumber result = KNumber::Zero;
+	for(int i = 0; i < size(); ++i) {
+		const KNumber d = at(i) - mean_value;
+		result += d * d;
+	}
+
+	return result;
+}
+
+//------------------------------------------------------------------------------
+// Name: variance
+//------------------------------------------------------------------------------
+KNumber KNumberArray::variance() const {
+	return sumOfSquaredDeviations() / KNumber(size());
+}
+
+//------------------------------------------------------------------------------
+// Name: apply
+//------------------------------------------------------------------------------
+template <bool I(qint64, qint64, qint64 *), bool D(double, double, double *), KNumber G(const KNumber &, const KNumber &)>
+void KNumberArray::apply(const KNumberArray *other, const element *broadcast) {
+
+	KNumberArray result;
+	result.fast_float_ = fast_float_;
+	result.reserve(size());
+
+	const int n = other ? qMin(size(), other->size()) : size();
+	for(int i = 0; i < n; ++i) {
+
+		const element a = element_at(i);
+		const element b = other ? other->element_at(i) : *broadcast;
+
+		if(a.lane == LANE_INT64 && b.lane == LANE_INT64) {
+			qint64 r;
+			if(I(a.int64, b.int64, &r)) {
+				element e = a;
+				e.int64 = r;
+				result.append_element(e);
+				continue;
+			}
+		} else if(a.lane != LANE_BIG && b.lane != LANE_BIG) {
+			// an integer takes part as a float, if a double holds it
+			const double x = (a.lane == LANE_INT64) ? static_cast<double>(a.int64) : a.real;
+			const double y = (b.lane == LANE_INT64) ? static_cast<double>(b.int64) : b.real;
+			const bool exact =
+				(a.lane == LANE_DOUBLE || fabs(x) <= max_exact_integer) &&
+				(b.lane == LANE_DOUBLE || fabs(y) <= max_exact_integer);
+
+			double r;
+			if(exact && D(x, y, &r)) {
+				result.append_real(r);
+				continue;
+			}
+		}
+
+		result.append(G(to_knumber(a), to_knumber(b)));
+	}
+
+	*this = result;
+}
+
+//------------------------------------------------------------------------------
+// Name: assign_reals
+//------------------------------------------------------------------------------
+template <bool I(qint64, qint64, qint64 *), KNumber G(const KNumber &, const KNumber &)>
+void KNumberArray::assign_reals(const QVector<double> &results, const KNumberArray *other, const element *broadcast) {
+
+	KNumberArray result;
+	result.fast_float_ = fast_float_;
+	result.reserve(size());
+
+	for(int i = 0; i < results.size(); ++i) {
+
+		const element a = element_at(i);
+		const element b = other ? other->element_at(i) : *broadcast;
+
+		if(a.lane == LANE_INT64 && b.lane == LANE_INT64) {
+			qint64 r;
+			if(I(a.int64, b.int64, &r)) {
+				element e = a;
+				e.int64 = r;
+				result.append_element(e);
+				continue;
+			}
+		} else if(isfinite(results[i])) {
+			result.append_real(results[i]);
+			continue;
+		}
+
+		result.append(G(to_knumber(a), to_knumber(b)));
+	}
+
+	*this = result;
+}
+
+//------------------------------------------------------------------------------
+// Name: scale
+//------------------------------------------------------------------------------
+void KNumberArray::scale(const KNumber &factor) {
+
+	const element f = make_element(factor);
+
+	QVector<double> x;
+	double y;
+	if(fast_float_ && (!isExact() || f.lane != LANE_INT64) && to_double(f, &y) && to_doubles(&x)) {
+		detail::knumber_simd::scale(x.data(), x.constData(), y, x.size());
+		assign_reals<int64_mul, knumber_mul>(x, 0, &f);
+		return;
+	}
+
+	apply<int64_mul, double_mul, knumber_mul>(0, &f);
+}
+
+//------------------------------------------------------------------------------
+// Name: add
+//------------------------------------------------------------------------------
+void KNumberArray::add(const KNumberArray &other) {
+
+	Q_ASSERT(size() == other.size());
+
+	QVector<double> x;
+	QVector<double> y;
+	if(fast_float_ && !(isExact() && other.isExact()) && size() == other.size() && to_doubles(&x) && other.to_doubles(&y)) {
+		detail::knumber_simd::add(x.data(), x.constData(), y.constData(), x.size());
+		assign_reals<int64_add, knumber_add>(x, &other, 0);
+		return;
+	}
+
+	apply<int64_add, double_add, knumber_add>(&other, 0);
+}
+
+//------------------------------------------------------------------------------
+// Name: mul
+//------------------------------------------------------------------------------
+void KNumberArray::mul(const KNumberArray &other) {
+
+	Q_ASSERT(size() == other.size());
+
+	QVector<double> x;
+	QVector<double> y;
+	if(fast_float_ && !(isExact() && other.isExact()) && size() == other.size() && to_doubles(&x) && other.to_doubles(&y)) {
+		detail::knumber_simd::mul(x.data(), x.constData(), y.constData(), x.size());
+		assign_reals<int64_mul, knumber_mul>(x, &other, 0);
+		return;
+	}
+
+	apply<int64_mul, double_mul, knumber_mul>(&other, 0);
+}
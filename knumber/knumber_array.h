@@ -0,0 +1,129 @@
+/*
+Copyright (C) 2001 - 2013 Evan Teran
+                          evan.teran@gmail.com
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef KNUMBER_ARRAY_H_
+#define KNUMBER_ARRAY_H_
+
+#include "knumber.h"
+#include <QVector>
+
+// A sequence of KNumbers stored by kind rather than one by one: integers
+// which fit in 64 bits go into one array, floats which are exactly a double
+// into another, and everything else (big integers, fractions, other floats,
+// errors) into a side table of KNumbers. The batch operations run over the
+// plain arrays without creating a KNumber per element.
+//
+// The results are those of doing the same one KNumber at a time, except
+// that a sum adds up its exact parts before the floats. A float result can
+// therefore differ in the last bits of its precision.
+//
+// With fast floats turned on, data which has floats in it is worked on in
+// double precision instead, as long as every value fits into a double. The
+// results then have the accuracy of a double rather than that of the float
+// precision. Integers and fractions on their own are always exact.
+class KNumberArray {
+public:
+	KNumberArray();
+
+public:
+	void setFastFloat(bool x);
+	bool fastFloat() const;
+
+public:
+	void append(const KNumber &x);
+	void removeLast();
+	void clear();
+	void reserve(int size);
+
+public:
+	int size() const;
+	bool isEmpty() const;
+	KNumber at(int i) const;
+	QVector<KNumber> toVector() const;
+
+	// true if there are only integers and fractions, arithmetic on these
+	// gives the same result whichever way it is grouped
+	bool isExact() const;
+
+public:
+	KNumber sum() const;
+	KNumber sumOfSquares() const;
+	KNumber dot(const KNumberArray &other) const;
+
+	// the mean and the population variance, neither exists for an empty array
+	KNumber mean() const;
+	KNumber sumOfSquaredDeviations() const;
+	KNumber variance() const;
+
+public:
+	// elementwise, the arrays have to be of the same size
+	void scale(const KNumber &factor);
+	void add(const KNumberArray &other);
+	void mul(const KNumberArray &other);
+
+private:
+	enum Lane {
+		LANE_INT64,
+		LANE_DOUBLE,
+		LANE_BIG
+	};
+
+	// the lane in the top two bits, the index within the lane below that
+	static const int     lane_shift = 30;
+	static const quint32 index_mask = (1u << lane_shift) - 1;
+
+	// one element, unpacked from whichever lane it is in
+	struct element {
+		Lane           lane;
+		qint64         int64;
+		double         real;
+		const KNumber *big;
+	};
+
+	element element_at(int i) const;
+	static element make_element(const KNumber &x);
+	static KNumber to_knumber(const element &e);
+	static bool to_double(const element &e, double *value);
+
+	bool use_fast_float() const;
+	bool to_doubles(QVector<double> *values) const;
+
+	void append_element(const element &e);
+	void append_real(double value);
+
+	// I and D compute the result of two integers and of two doubles, they
+	// return false if that can't be done exactly. G is used otherwise
+	template <bool I(qint64, qint64, qint64 *), bool D(double, double, double *), KNumber G(const KNumber &, const KNumber &)>
+	void apply(const KNumberArray *other, const element *broadcast);
+
+	// takes the results of a double operation done on all elements, except
+	// for those where both operands were integers; these are done with I
+	// and G like apply() does
+	template <bool I(qint64, qint64, qint64 *), KNumber G(const KNumber &, const KNumber &)>
+	void assign_reals(const QVector<double> &results, const KNumberArray *other, const element *broadcast);
+
+private:
+	QVector<quint32> order_;
+	QVector<qint64>  int64_lane_;
+	QVector<double>  double_lane_;
+	QVector<KNumber> big_values_;
+	int              inexact_count_;  // floats and errors in big_values_
+	bool             fast_float_;
+};
+
+#endif
@@ -0,0 +1,223 @@
+/*
+Copyright (C) 2001 - 2013 Evan Teran
+                          evan.teran@gmail.com
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <config-kcalc.h>
+#include "knumber_base.h"
+
+namespace detail {
+
+namespace {
+
+template <class L, class R, void (L::*F)(knumber_base *, R *)>
+void binary_entry(knumber_base *lhs, knumber_base *rhs) {
+	(lhs->get<L>()->*F)(lhs, rhs->get<R>());
+}
+
+template <class T, void (T::*F)(knumber_base *)>
+void unary_entry(knumber_base *value) {
+	(value->get<T>()->*F)(value);
+}
+
+template <class L, class R>
+int compare_entry(knumber_base *lhs, knumber_base *rhs) {
+	return lhs->get<L>()->compare(rhs->get<R>());
+}
+
+}
+
+// a row is the kind of the left hand side, the columns the kinds of the right
+// hand side. both are in the order of knumber_base::Type
+#define KNUMBER_BINARY_ROW(L, F)                        \
+	{                                                   \
+		&binary_entry<L, knumber_error, &L::F>,         \
+		&binary_entry<L, knumber_integer, &L::F>,       \
+		&binary_entry<L, knumber_float, &L::F>,         \
+		&binary_entry<L, knumber_fraction, &L::F>       \
+	}
+
+#define KNUMBER_BINARY_TABLE(F)                         \
+	{                                                   \
+		KNUMBER_BINARY_ROW(knumber_error, F),           \
+		KNUMBER_BINARY_ROW(knumber_integer, F),         \
+		KNUMBER_BINARY_ROW(knumber_float, F),           \
+		KNUMBER_BINARY_ROW(knumber_fraction, F)         \
+	}
+
+#define KNUMBER_UNARY_TABLE(F)                                  \
+	{                                                           \
+		&unary_entry<knumber_error, &knumber_error::F>,         \
+		&unary_entry<knumber_integer, &knumber_integer::F>,     \
+		&unary_entry<knumber_float, &knumber_float::F>,         \
+		&unary_entry<knumber_fraction, &knumber_fraction::F>    \
+	}
+
+#define KNUMBER_COMPARE_ROW(L)                          \
+	{                                                   \
+		&compare_entry<L, knumber_error>,               \
+		&compare_entry<L, knumber_integer>,             \
+		&compare_entry<L, knumber_float>,               \
+		&compare_entry<L, knumber_fraction>             \
+	}
+
+// in the order of knumber_base::BinaryOperation
+const knumber_base::binary_function knumber_base::binary_table[BINARY_COUNT][TYPE_COUNT][TYPE_COUNT] = {
+	KNUMBER_BINARY_TABLE(add),
+	KNUMBER_BINARY_TABLE(sub),
+	KNUMBER_BINARY_TABLE(mul),
+	KNUMBER_BINARY_TABLE(div),
+	KNUMBER_BINARY_TABLE(mod),
+	KNUMBER_BINARY_TABLE(bitwise_and),
+	KNUMBER_BINARY_TABLE(bitwise_xor),
+	KNUMBER_BINARY_TABLE(bitwise_or),
+	KNUMBER_BINARY_TABLE(bitwise_shift),
+	KNUMBER_BINARY_TABLE(pow),
+	KNUMBER_BINARY_TABLE(bin)
+};
+
+// in the order of knumber_base::UnaryOperation
+const knumber_base::unary_function knumber_base::unary_table[UNARY_COUNT][TYPE_COUNT] = {
+	KNUMBER_UNARY_TABLE(neg),
+	KNUMBER_UNARY_TABLE(cmp),
+	KNUMBER_UNARY_TABLE(abs),
+	KNUMBER_UNARY_TABLE(sqrt),
+	KNUMBER_UNARY_TABLE(cbrt),
+	KNUMBER_UNARY_TABLE(factorial),
+	KNUMBER_UNARY_TABLE(reciprocal),
+	KNUMBER_UNARY_TABLE(log2),
+	KNUMBER_UNARY_TABLE(log10),
+	KNUMBER_UNARY_TABLE(ln),
+	KNUMBER_UNARY_TABLE(exp2),
+	KNUMBER_UNARY_TABLE(exp10),
+	KNUMBER_UNARY_TABLE(floor),
+	KNUMBER_UNARY_TABLE(ceil),
+	KNUMBER_UNARY_TABLE(exp),
+	KNUMBER_UNARY_TABLE(sin),
+	KNUMBER_UNARY_TABLE(cos),
+	KNUMBER_UNARY_TABLE(tan),
+	KNUMBER_UNARY_TABLE(asin),
+	KNUMBER_UNARY_TABLE(acos),
+	KNUMBER_UNARY_TABLE(atan),
+	KNUMBER_UNARY_TABLE(sinh),
+	KNUMBER_UNARY_TABLE(cosh),
+	KNUMBER_UNARY_TABLE(tanh),
+	KNUMBER_UNARY_TABLE(asinh),
+	KNUMBER_UNARY_TABLE(acosh),
+	KNUMBER_UNARY_TABLE(atanh),
+	KNUMBER_UNARY_TABLE(tgamma)
+};
+
+const knumber_base::compare_function knumber_base::compare_table[TYPE_COUNT][TYPE_COUNT] = {
+	KNUMBER_COMPARE_ROW(knumber_error),
+	KNUMBER_COMPARE_ROW(knumber_integer),
+	KNUMBER_COMPARE_ROW(knumber_float),
+	KNUMBER_COMPARE_ROW(knumber_fraction)
+};
+
+//------------------------------------------------------------------------------
+// Name: knumber_base
+//------------------------------------------------------------------------------
+knumber_base::knumber_base(const knumber_base &other) : type_(other.type_), ref_(1) {
+
+	switch(type_) {
+	case TYPE_ERROR:
+		::new (&error_) knumber_error(&other.error_);
+		break;
+	case TYPE_INTEGER:
+		::new (&integer_) knumber_integer(&other.integer_);
+		break;
+	case TYPE_FLOAT:
+		::new (&float_) knumber_float(&other.float_);
+		break;
+	case TYPE_FRACTION:
+		::new (&fraction_) knumber_fraction(&other.fraction_);
+		break;
+	}
+}
+
+//------------------------------------------------------------------------------
+// Name: binary_self
+// Desc: an operation may replace the value before it is done with the right
+//       hand side, so x op x is carried out on a copy of x
+//------------------------------------------------------------------------------
+void knumber_base::binary_self(BinaryOperation op) {
+
+	knumber_base copy(*this);
+	binary_table[op][type_][copy.type_](this, &copy);
+}
+
+//------------------------------------------------------------------------------
+// Name: toString
+//------------------------------------------------------------------------------
+QString knumber_base::toString(int precision) const {
+
+	switch(type_) {
+	case TYPE_ERROR:
+		return error_.toString(precision);
+	case TYPE_INTEGER:
+		return integer_.toString(precision);
+	case TYPE_FLOAT:
+		return float_.toString(precision);
+	case TYPE_FRACTION:
+		return fraction_.toString(precision);
+	}
+
+	Q_ASSERT(0);
+	return QString();
+}
+
+//------------------------------------------------------------------------------
+// Name: toUint64
+//------------------------------------------------------------------------------
+quint64 knumber_base::toUint64() const {
+
+	switch(type_) {
+	case TYPE_ERROR:
+		return error_.toUint64();
+	case TYPE_INTEGER:
+		return integer_.toUint64();
+	case TYPE_FLOAT:
+		return float_.toUint64();
+	case TYPE_FRACTION:
+		return fraction_.toUint64();
+	}
+
+	Q_ASSERT(0);
+	return quint64();
+}
+
+//------------------------------------------------------------------------------
+// Name: toInt64
+//------------------------------------------------------------------------------
+qint64 knumber_base::toInt64() const {
+
+	switch(type_) {
+	case TYPE_ERROR:
+		return error_.toInt64();
+	case TYPE_INTEGER:
+		return integer_.toInt64();
+	case TYPE_FLOAT:
+		return float_.toInt64();
+	case TYPE_FRACTION:
+		return fraction_.toInt64();
+	}
+
+	Q_ASSERT(0);
+	return qint64();
+}
+
+}
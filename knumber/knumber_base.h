@@ -19,100 +19,422 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #ifndef KNUMBER_BASE_H_
 #define KNUMBER_BASE_H_
 
-// Workaround: include before gmp.h to fix build with gcc-4.9
-#include <cstddef>
-#include <gmp.h>
-
-#ifdef KNUMBER_USE_MPFR
-#include <mpfr.h>
-#endif
-
+#include "knumber_error.h"
+#include "knumber_integer.h"
+#include "knumber_float.h"
+#include "knumber_fraction.h"
+#include "knumber_allocator.h"
+#include "knumber_statistics.h"
+#include <QAtomicInt>
 #include <QtGlobal>
 #include <QString>
+#include <new>
+#include <utility>
 
 namespace detail {
 
-class knumber_error;
-class knumber_integer;
-class knumber_fraction;
-class knumber_float;
+template <class T>
+struct knumber_tag;
 
+// A value of any of the four kinds. The kind is a tag and the value itself is
+// stored inline, so an operation which turns an integer into a float (say)
+// replaces the value in place rather than allocating a new object. The binary
+// operations look up the function for the two kinds in a table indexed by
+// the tags.
+//
+// The operations are carried out by the payload classes, which get the cell
+// they are in as self. One which gives a result of a different kind calls
+// emplace() or assign() on it, after that the payload it was called on is
+// gone and only the one they return may be used.
 class knumber_base {
 public:
-	virtual ~knumber_base() { }
+	// the kind of value held, also the index into the dispatch tables
+	enum Type {
+		TYPE_ERROR,
+		TYPE_INTEGER,
+		TYPE_FLOAT,
+		TYPE_FRACTION
+	};
+
+	enum {
+		TYPE_COUNT = TYPE_FRACTION + 1
+	};
+
+public:
+	template <class T, class... Args>
+	explicit knumber_base(std::in_place_type_t<T>, Args &&...args);
+	knumber_base(const knumber_base &other);
+	~knumber_base() { destroy(); }
+
+private:
+	knumber_base &operator=(const knumber_base &);
+
+public:
+	// a new value holding a T made from args
+	template <class T, class... Args>
+	static knumber_base *create(Args &&...args) {
+		return new knumber_base(std::in_place_type<T>, std::forward<Args>(args)...);
+	}
 
 public:
-	virtual knumber_base *clone() = 0;
+	// these get created and destroyed on nearly every operation, so they
+	// come from the pool rather than the general purpose heap
+	static void *operator new(std::size_t size) {
+		KNUMBER_COUNT(OBJECTS_ALLOCATED);
+		if(void *const p = knumber_allocator::allocate(size)) {
+			return p;
+		}
+		throw std::bad_alloc();
+	}
+
+	static void operator delete(void *p, std::size_t size) {
+		knumber_allocator::deallocate(p, size);
+	}
+
+public:
+	Type type() const { return type_; }
+
+	// the payload, which has to be a T
+	template <class T>
+	T *get();
+
+	template <class T>
+	const T *get() const;
+
+public:
+	// replaces the value with a T made from args, which must not refer to the
+	// value being replaced
+	template <class T, class... Args>
+	T *emplace(Args &&...args);
+
+	// replaces the value with value, which may have been made from the value
+	// being replaced
+	template <class T>
+	T *assign(T &&value) {
+		return emplace<T>(std::move(value));
+	}
 
 public:
-	virtual QString toString(int precision) const = 0;
-	virtual quint64 toUint64() const = 0;
-	virtual qint64 toInt64() const = 0;
+	// KNumber shares values between copies, a value which is shared must
+	// not be modified (KNumber copies it first)
+	void ref()             { ref_.ref(); }
+	bool deref()           { return ref_.deref(); }
+	bool is_shared() const { return ref_ != 1; }
 
 public:
-	virtual bool is_integer() const = 0;
-	virtual bool is_zero() const = 0;
-	virtual int sign() const = 0;
+	QString toString(int precision) const;
+	quint64 toUint64() const;
+	qint64 toInt64() const;
+
+public:
+	bool is_integer() const;
+	bool is_zero() const;
+	int sign() const;
 
 public:
 	// basic math
-	virtual knumber_base *add(knumber_base *rhs) = 0;
-	virtual knumber_base *sub(knumber_base *rhs) = 0;
-	virtual knumber_base *mul(knumber_base *rhs) = 0;
-	virtual knumber_base *div(knumber_base *rhs) = 0;
-	virtual knumber_base *mod(knumber_base *rhs) = 0;
+	void add(knumber_base *rhs) { binary(BINARY_ADD, rhs); }
+	void sub(knumber_base *rhs) { binary(BINARY_SUB, rhs); }
+	void mul(knumber_base *rhs) { binary(BINARY_MUL, rhs); }
+	void div(knumber_base *rhs) { binary(BINARY_DIV, rhs); }
+	void mod(knumber_base *rhs) { binary(BINARY_MOD, rhs); }
 
 public:
 	// logical operators
-	virtual knumber_base *bitwise_and(knumber_base *rhs) = 0;
-	virtual knumber_base *bitwise_xor(knumber_base *rhs) = 0;
-	virtual knumber_base *bitwise_or(knumber_base *rhs) = 0;
-	virtual knumber_base *bitwise_shift(knumber_base *rhs) = 0;
+	void bitwise_and(knumber_base *rhs) { binary(BINARY_BITWISE_AND, rhs); }
+	void bitwise_xor(knumber_base *rhs) { binary(BINARY_BITWISE_XOR, rhs); }
+	void bitwise_or(knumber_base *rhs) { binary(BINARY_BITWISE_OR, rhs); }
+	void bitwise_shift(knumber_base *rhs) { binary(BINARY_BITWISE_SHIFT, rhs); }
 
 public:
 	// algebraic functions
-	virtual knumber_base *pow(knumber_base *rhs) = 0;
-	virtual knumber_base *neg() = 0;
-	virtual knumber_base *cmp() = 0;
-	virtual knumber_base *abs() = 0;
-	virtual knumber_base *sqrt() = 0;
-	virtual knumber_base *cbrt() = 0;
-	virtual knumber_base *factorial() = 0;
-	virtual knumber_base *reciprocal() = 0;
+	void pow(knumber_base *rhs) { binary(BINARY_POW, rhs); }
+	void neg() { unary(UNARY_NEG); }
+	void cmp() { unary(UNARY_CMP); }
+	void abs() { unary(UNARY_ABS); }
+	void sqrt() { unary(UNARY_SQRT); }
+	void cbrt() { unary(UNARY_CBRT); }
+	void factorial() { unary(UNARY_FACTORIAL); }
+	void reciprocal() { unary(UNARY_RECIPROCAL); }
 
 public:
 	// special functions
-	virtual knumber_base *log2() = 0;
-	virtual knumber_base *log10() = 0;
-	virtual knumber_base *ln() = 0;
-	virtual knumber_base *exp2() = 0;
-	virtual knumber_base *exp10() = 0;
-	virtual knumber_base *floor() = 0;
-	virtual knumber_base *ceil() = 0;
-	virtual knumber_base *exp() = 0;
-	virtual knumber_base *bin(knumber_base *rhs) = 0;
+	void log2() { unary(UNARY_LOG2); }
+	void log10() { unary(UNARY_LOG10); }
+	void ln() { unary(UNARY_LN); }
+	void exp2() { unary(UNARY_EXP2); }
+	void exp10() { unary(UNARY_EXP10); }
+	void floor() { unary(UNARY_FLOOR); }
+	void ceil() { unary(UNARY_CEIL); }
+	void exp() { unary(UNARY_EXP); }
+	void bin(knumber_base *rhs) { binary(BINARY_BIN, rhs); }
 
 public:
 	// trig functions
-	virtual knumber_base *sin() = 0;
-	virtual knumber_base *cos() = 0;
-	virtual knumber_base *tan() = 0;
-	virtual knumber_base *asin() = 0;
-	virtual knumber_base *acos() = 0;
-	virtual knumber_base *atan() = 0;
-	virtual knumber_base *sinh() = 0;
-	virtual knumber_base *cosh() = 0;
-	virtual knumber_base *tanh() = 0;
-	virtual knumber_base *asinh() = 0;
-	virtual knumber_base *acosh() = 0;
-	virtual knumber_base *atanh() = 0;
-	virtual knumber_base *tgamma() = 0;
+	void sin() { unary(UNARY_SIN); }
+	void cos() { unary(UNARY_COS); }
+	void tan() { unary(UNARY_TAN); }
+	void asin() { unary(UNARY_ASIN); }
+	void acos() { unary(UNARY_ACOS); }
+	void atan() { unary(UNARY_ATAN); }
+	void sinh() { unary(UNARY_SINH); }
+	void cosh() { unary(UNARY_COSH); }
+	void tanh() { unary(UNARY_TANH); }
+	void asinh() { unary(UNARY_ASINH); }
+	void acosh() { unary(UNARY_ACOSH); }
+	void atanh() { unary(UNARY_ATANH); }
+	void tgamma() { unary(UNARY_TGAMMA); }
 
 public:
 	// comparison
-	virtual int compare(knumber_base *rhs) = 0;
+	int compare(knumber_base *rhs) { return compare_table[type_][rhs->type_](this, rhs); }
+
+public:
+	typedef void (*binary_function)(knumber_base *lhs, knumber_base *rhs);
+	typedef void (*unary_function)(knumber_base *value);
+	typedef int (*compare_function)(knumber_base *lhs, knumber_base *rhs);
+
+private:
+	// the rows of the dispatch tables
+	enum BinaryOperation {
+		BINARY_ADD,
+		BINARY_SUB,
+		BINARY_MUL,
+		BINARY_DIV,
+		BINARY_MOD,
+		BINARY_BITWISE_AND,
+		BINARY_BITWISE_XOR,
+		BINARY_BITWISE_OR,
+		BINARY_BITWISE_SHIFT,
+		BINARY_POW,
+		BINARY_BIN,
+		BINARY_COUNT
+	};
+
+	enum UnaryOperation {
+		UNARY_NEG,
+		UNARY_CMP,
+		UNARY_ABS,
+		UNARY_SQRT,
+		UNARY_CBRT,
+		UNARY_FACTORIAL,
+		UNARY_RECIPROCAL,
+		UNARY_LOG2,
+		UNARY_LOG10,
+		UNARY_LN,
+		UNARY_EXP2,
+		UNARY_EXP10,
+		UNARY_FLOOR,
+		UNARY_CEIL,
+		UNARY_EXP,
+		UNARY_SIN,
+		UNARY_COS,
+		UNARY_TAN,
+		UNARY_ASIN,
+		UNARY_ACOS,
+		UNARY_ATAN,
+		UNARY_SINH,
+		UNARY_COSH,
+		UNARY_TANH,
+		UNARY_ASINH,
+		UNARY_ACOSH,
+		UNARY_ATANH,
+		UNARY_TGAMMA,
+		UNARY_COUNT
+	};
+
+	// indexed by the operation, then the kind of the left hand side and then
+	// that of the right hand side
+	static const binary_function binary_table[BINARY_COUNT][TYPE_COUNT][TYPE_COUNT];
+	static const unary_function unary_table[UNARY_COUNT][TYPE_COUNT];
+	static const compare_function compare_table[TYPE_COUNT][TYPE_COUNT];
+
+private:
+	void binary(BinaryOperation op, knumber_base *rhs);
+	void binary_self(BinaryOperation op);
+	void unary(UnaryOperation op) { unary_table[op][type_](this); }
+	void destroy();
+
+private:
+	Type       type_;
+	QAtomicInt ref_;
+
+	union {
+		knumber_error    error_;
+		knumber_integer  integer_;
+		knumber_float    float_;
+		knumber_fraction fraction_;
+	};
+};
+
+template <>
+struct knumber_tag<knumber_error> {
+	static const knumber_base::Type value = knumber_base::TYPE_ERROR;
+};
+
+template <>
+struct knumber_tag<knumber_integer> {
+	static const knumber_base::Type value = knumber_base::TYPE_INTEGER;
+};
+
+template <>
+struct knumber_tag<knumber_float> {
+	static const knumber_base::Type value = knumber_base::TYPE_FLOAT;
 };
 
+template <>
+struct knumber_tag<knumber_fraction> {
+	static const knumber_base::Type value = knumber_base::TYPE_FRACTION;
+};
+
+template <> inline knumber_error    *knumber_base::get<knumber_error>()    { return &error_; }
+template <> inline knumber_integer  *knumber_base::get<knumber_integer>()  { return &integer_; }
+template <> inline knumber_float    *knumber_base::get<knumber_float>()    { return &float_; }
+template <> inline knumber_fraction *knumber_base::get<knumber_fraction>() { return &fraction_; }
+
+template <> inline const knumber_error    *knumber_base::get<knumber_error>() const    { return &error_; }
+template <> inline const knumber_integer  *knumber_base::get<knumber_integer>() const  { return &integer_; }
+template <> inline const knumber_float    *knumber_base::get<knumber_float>() const    { return &float_; }
+template <> inline const knumber_fraction *knumber_base::get<knumber_fraction>() const { return &fraction_; }
+
+//------------------------------------------------------------------------------
+// Name: destroy
+// Desc: destroys the payload but leaves the tag, so the cell has to get a new
+//       one right away
+//------------------------------------------------------------------------------
+inline void knumber_base::destroy() {
+
+	switch(type_) {
+	case TYPE_ERROR:
+		error_.~knumber_error();
+		break;
+	case TYPE_INTEGER:
+		integer_.~knumber_integer();
+		break;
+	case TYPE_FLOAT:
+		float_.~knumber_float();
+		break;
+	case TYPE_FRACTION:
+		fraction_.~knumber_fraction();
+		break;
+	}
+}
+
+//------------------------------------------------------------------------------
+// Name: binary
+//------------------------------------------------------------------------------
+inline void knumber_base::binary(BinaryOperation op, knumber_base *rhs) {
+
+	if(rhs == this) {
+		binary_self(op);
+		return;
+	}
+
+	binary_table[op][type_][rhs->type_](this, rhs);
+}
+
+//------------------------------------------------------------------------------
+// Name: is_integer
+//------------------------------------------------------------------------------
+inline bool knumber_base::is_integer() const {
+
+	switch(type_) {
+	case TYPE_ERROR:
+		return error_.is_integer();
+	case TYPE_INTEGER:
+		return integer_.is_integer();
+	case TYPE_FLOAT:
+		return float_.is_integer();
+	case TYPE_FRACTION:
+		return fraction_.is_integer();
+	}
+
+	Q_ASSERT(0);
+	return false;
+}
+
+//------------------------------------------------------------------------------
+// Name: is_zero
+//------------------------------------------------------------------------------
+inline bool knumber_base::is_zero() const {
+
+	switch(type_) {
+	case TYPE_ERROR:
+		return error_.is_zero();
+	case TYPE_INTEGER:
+		return integer_.is_zero();
+	case TYPE_FLOAT:
+		return float_.is_zero();
+	case TYPE_FRACTION:
+		return fraction_.is_zero();
+	}
+
+	Q_ASSERT(0);
+	return false;
+}
+
+//------------------------------------------------------------------------------
+// Name: sign
+//------------------------------------------------------------------------------
+inline int knumber_base::sign() const {
+
+	switch(type_) {
+	case TYPE_ERROR:
+		return error_.sign();
+	case TYPE_INTEGER:
+		return integer_.sign();
+	case TYPE_FLOAT:
+		return float_.sign();
+	case TYPE_FRACTION:
+		return fraction_.sign();
+	}
+
+	Q_ASSERT(0);
+	return 0;
+}
+
+//------------------------------------------------------------------------------
+// Name: knumber_base
+//------------------------------------------------------------------------------
+template <class T, class... Args>
+knumber_base::knumber_base(std::in_place_type_t<T>, Args &&...args) : type_(knumber_tag<T>::value), ref_(1) {
+	::new (get<T>()) T(std::forward<Args>(args)...);
+}
+
+//------------------------------------------------------------------------------
+// Name: emplace
+//------------------------------------------------------------------------------
+template <class T, class... Args>
+T *knumber_base::emplace(Args &&...args) {
+
+	destroy();
+
+	try {
+		T *const p = ::new (get<T>()) T(std::forward<Args>(args)...);
+		type_ = knumber_tag<T>::value;
+		return p;
+	} catch(...) {
+		// the old value is gone already, so leave one behind which can be
+		// destroyed
+		::new (&error_) knumber_error(knumber_error::ERROR_UNDEFINED);
+		type_ = TYPE_ERROR;
+		throw;
+	}
+}
+
+//------------------------------------------------------------------------------
+// Name: knumber_cast
+// Desc: returns the payload of p as a T if that is what it is, null otherwise
+//------------------------------------------------------------------------------
+template <class T>
+T *knumber_cast(knumber_base *p) {
+	if(p->type() == knumber_tag<T>::value) {
+		return p->get<T>();
+	}
+
+	return 0;
+}
+
 }
 
 #endif
@@ -0,0 +1,79 @@
+/*
+Copyright (C) 2001 - 2013 Evan Teran
+                          evan.teran@gmail.com
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef KNUMBER_BITS_H_
+#define KNUMBER_BITS_H_
+
+#include <limits>
+
+// the bit counts the integer factorials and powers are split up by
+
+namespace detail {
+
+//------------------------------------------------------------------------------
+// Name: trailing_zeros
+// Desc: the number of zero bits below the lowest one, x must not be 0
+//------------------------------------------------------------------------------
+inline int trailing_zeros(unsigned long x) {
+#if defined(__GNUC__)
+	return __builtin_ctzl(x);
+#else
+	int n = 0;
+	while(!(x & 1)) {
+		x >>= 1;
+		++n;
+	}
+	return n;
+#endif
+}
+
+//------------------------------------------------------------------------------
+// Name: highest_bit
+// Desc: the position of the highest one bit, x must not be 0
+//------------------------------------------------------------------------------
+inline int highest_bit(unsigned long x) {
+#if defined(__GNUC__)
+	return std::numeric_limits<unsigned long>::digits - 1 - __builtin_clzl(x);
+#else
+	int n = 0;
+	while(x >>= 1) {
+		++n;
+	}
+	return n;
+#endif
+}
+
+//------------------------------------------------------------------------------
+// Name: bit_count
+// Desc: the number of one bits
+//------------------------------------------------------------------------------
+inline int bit_count(unsigned long x) {
+#if defined(__GNUC__)
+	return __builtin_popcountl(x);
+#else
+	int n = 0;
+	for(; x != 0; x &= x - 1) {
+		++n;
+	}
+	return n;
+#endif
+}
+
+}
+
+#endif
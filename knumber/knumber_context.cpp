@@ -0,0 +1,210 @@
+/*
+Copyright (C) 2001 - 2013 Evan Teran
+                          evan.teran@gmail.com
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <config-kcalc.h>
+#include "knumber_context.h"
+#include <QMutex>
+#include <QMutexLocker>
+#include <atomic>
+#include <cmath>
+#include <deque>
+
+namespace {
+
+// the precision GMP gives floats unless told otherwise
+const unsigned long gmp_default_bits = 64;
+
+//------------------------------------------------------------------------------
+// Name: default_contexts
+// Desc: every default context there has been. the threads read the latest
+//       without a lock, so the earlier ones are kept around in case one is
+//       still in use. the default changes only with the settings, so there
+//       are few of them
+//------------------------------------------------------------------------------
+struct default_contexts {
+	default_contexts() : latest(0) {
+		history.push_back(KNumberContext());
+		latest.store(&history.back(), std::memory_order_release);
+	}
+
+	QMutex                              mutex;
+	std::deque<KNumberContext>          history;
+	std::atomic<const KNumberContext *> latest;
+};
+
+default_contexts &defaults() {
+	static default_contexts d;
+	return d;
+}
+
+thread_local const KNumberContext *current_context = 0;
+
+}
+
+//------------------------------------------------------------------------------
+// Name: Scope
+//------------------------------------------------------------------------------
+KNumberContext::Scope::Scope(const KNumberContext &context) : context_(context), previous_(current_context) {
+	current_context = &context_;
+}
+
+//------------------------------------------------------------------------------
+// Name: ~Scope
+//------------------------------------------------------------------------------
+KNumberContext::Scope::~Scope() {
+	current_context = previous_;
+}
+
+//------------------------------------------------------------------------------
+// Name: KNumberContext
+//------------------------------------------------------------------------------
+KNumberContext::KNumberContext() : precision_(0), precision_bits_(gmp_default_bits), group_separator_(QLatin1String(",")), decimal_separator_(QLatin1String(".")), fractional_input_(false), float_output_(false), split_off_integer_(false) {
+}
+
+//------------------------------------------------------------------------------
+// Name: active
+//------------------------------------------------------------------------------
+const KNumberContext &KNumberContext::active() {
+	if(const KNumberContext *const context = current_context) {
+		return *context;
+	}
+
+	return *defaults().latest.load(std::memory_order_acquire);
+}
+
+//------------------------------------------------------------------------------
+// Name: current
+//------------------------------------------------------------------------------
+KNumberContext KNumberContext::current() {
+	return active();
+}
+
+//------------------------------------------------------------------------------
+// Name: defaultContext
+//------------------------------------------------------------------------------
+KNumberContext KNumberContext::defaultContext() {
+	return *defaults().latest.load(std::memory_order_acquire);
+}
+
+//------------------------------------------------------------------------------
+// Name: setDefaultContext
+//------------------------------------------------------------------------------
+void KNumberContext::setDefaultContext(const KNumberContext &context) {
+	default_contexts &d = defaults();
+	QMutexLocker locker(&d.mutex);
+	d.history.push_back(context);
+	d.latest.store(&d.history.back(), std::memory_order_release);
+}
+
+//------------------------------------------------------------------------------
+// Name: setFloatPrecision
+//------------------------------------------------------------------------------
+void KNumberContext::setFloatPrecision(int digits) {
+	if(digits > 0) {
+		// Need to transform decimal digits into binary digits
+		precision_      = digits;
+		precision_bits_ = static_cast<unsigned long>(double(digits) * M_LN10 / M_LN2 + 1);
+	} else {
+		precision_      = 0;
+		precision_bits_ = gmp_default_bits;
+	}
+}
+
+//------------------------------------------------------------------------------
+// Name: floatPrecision
+//------------------------------------------------------------------------------
+int KNumberContext::floatPrecision() const {
+	return precision_;
+}
+
+//------------------------------------------------------------------------------
+// Name: floatPrecisionBits
+//------------------------------------------------------------------------------
+unsigned long KNumberContext::floatPrecisionBits() const {
+	return precision_bits_;
+}
+
+//------------------------------------------------------------------------------
+// Name: setGroupSeparator
+//------------------------------------------------------------------------------
+void KNumberContext::setGroupSeparator(const QString &ch) {
+	group_separator_ = ch;
+}
+
+//------------------------------------------------------------------------------
+// Name: setDecimalSeparator
+//------------------------------------------------------------------------------
+void KNumberContext::setDecimalSeparator(const QString &ch) {
+	decimal_separator_ = ch;
+}
+
+//------------------------------------------------------------------------------
+// Name: groupSeparator
+//------------------------------------------------------------------------------
+QString KNumberContext::groupSeparator() const {
+	return group_separator_;
+}
+
+//------------------------------------------------------------------------------
+// Name: decimalSeparator
+//------------------------------------------------------------------------------
+QString KNumberContext::decimalSeparator() const {
+	return decimal_separator_;
+}
+
+//------------------------------------------------------------------------------
+// Name: setFractionalInput
+//------------------------------------------------------------------------------
+void KNumberContext::setFractionalInput(bool x) {
+	fractional_input_ = x;
+}
+
+//------------------------------------------------------------------------------
+// Name: fractionalInput
+//------------------------------------------------------------------------------
+bool KNumberContext::fractionalInput() const {
+	return fractional_input_;
+}
+
+//------------------------------------------------------------------------------
+// Name: setFloatOutput
+//------------------------------------------------------------------------------
+void KNumberContext::setFloatOutput(bool x) {
+	float_output_ = x;
+}
+
+//------------------------------------------------------------------------------
+// Name: floatOutput
+//------------------------------------------------------------------------------
+bool KNumberContext::floatOutput() const {
+	return float_output_;
+}
+
+//------------------------------------------------------------------------------
+// Name: setSplitoffIntegerForFractionOutput
+//------------------------------------------------------------------------------
+void KNumberContext::setSplitoffIntegerForFractionOutput(bool x) {
+	split_off_integer_ = x;
+}
+
+//------------------------------------------------------------------------------
+// Name: splitoffIntegerForFractionOutput
+//------------------------------------------------------------------------------
+bool KNumberContext::splitoffIntegerForFractionOutput() const {
+	return split_off_integer_;
+}
@@ -0,0 +1,120 @@
+/*
+Copyright (C) 2001 - 2013 Evan Teran
+                          evan.teran@gmail.com
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef KNUMBER_CONTEXT_H_
+#define KNUMBER_CONTEXT_H_
+
+#include <QString>
+#include <QtGlobal>
+
+class KNumber;
+
+namespace detail {
+class knumber_float;
+class knumber_fraction;
+}
+
+// The settings numbers are read, worked out and shown with: the float
+// precision, the separators and how fractions are read and shown.
+//
+// Each thread works with the context made current for it by a
+// KNumberContext::Scope, or else with the default context, which is what
+// KNumber::setDefaultFloatPrecision() and the other setters change. Two
+// threads with a scope each can therefore evaluate with different settings
+// at the same time and both get the same results as on their own.
+//
+// A float keeps the precision it was worked out at. It is brought to the
+// precision of the current context when it is next modified, so results
+// always have the precision of the context they come from.
+class KNumberContext {
+	friend class KNumber;
+	friend class detail::knumber_float;
+	friend class detail::knumber_fraction;
+
+public:
+	class Scope;
+
+public:
+	// the library defaults: 64 bit floats, '.' and ',' as separators and
+	// fractions shown as fractions but read as floats
+	KNumberContext();
+
+public:
+	// the context of the calling thread
+	static KNumberContext current();
+
+	// the context threads without a scope use. changing it only affects
+	// the values created or modified afterwards
+	static KNumberContext defaultContext();
+	static void setDefaultContext(const KNumberContext &context);
+
+public:
+	// the float precision in decimal digits, 0 is the 64 bits of GMP
+	void setFloatPrecision(int digits);
+	int floatPrecision() const;
+	unsigned long floatPrecisionBits() const;
+
+	void setGroupSeparator(const QString &ch);
+	void setDecimalSeparator(const QString &ch);
+	QString groupSeparator() const;
+	QString decimalSeparator() const;
+
+	// decimal input such as "0.25" is read as the fraction 1/4 rather than
+	// as a float
+	void setFractionalInput(bool x);
+	bool fractionalInput() const;
+
+	// fractions are shown as floats
+	void setFloatOutput(bool x);
+	bool floatOutput() const;
+
+	// fractions are shown as "1 1/2" rather than "3/2"
+	void setSplitoffIntegerForFractionOutput(bool x);
+	bool splitoffIntegerForFractionOutput() const;
+
+private:
+	// the context of the calling thread without a copy, this stays valid
+	// for as long as it is current
+	static const KNumberContext &active();
+
+private:
+	int           precision_;
+	unsigned long precision_bits_;
+	QString       group_separator_;
+	QString       decimal_separator_;
+	bool          fractional_input_;
+	bool          float_output_;
+	bool          split_off_integer_;
+};
+
+// makes a context current for the calling thread until it goes out of scope,
+// the one which was current before is restored after that
+class KNumberContext::Scope {
+public:
+	explicit Scope(const KNumberContext &context);
+	~Scope();
+
+private:
+	Q_DISABLE_COPY(Scope)
+
+private:
+	KNumberContext        context_;
+	const KNumberContext *previous_;
+};
+
+#endif
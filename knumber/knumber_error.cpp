@@ -17,10 +17,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
 #include <config-kcalc.h>
-#include "knumber_integer.h"
-#include "knumber_float.h"
-#include "knumber_fraction.h"
-#include "knumber_error.h"
+#include "knumber_base.h"
 #include <cmath> // for M_PI
 #include <QDebug>
 
@@ -51,6 +48,12 @@ knumber_error::knumber_error() : error_(ERROR_UNDEFINED) {
 
 }
 
+//------------------------------------------------------------------------------
+// Name:
+//------------------------------------------------------------------------------
+knumber_error::knumber_error(knumber_error &&other) : error_(other.error_) {
+}
+
 //------------------------------------------------------------------------------
 // Name:
 //------------------------------------------------------------------------------
@@ -103,201 +106,212 @@ QString knumber_error::toString(int precision) const {
 //------------------------------------------------------------------------------
 // Name:
 //------------------------------------------------------------------------------
-knumber_base *knumber_error::add(knumber_base *rhs) {
+void knumber_error::add(knumber_base *, knumber_integer *) {
+}
 
-	if(knumber_integer *const p = dynamic_cast<knumber_integer *>(rhs)) {
-		Q_UNUSED(p);
-		return this;
-	} else if(knumber_float *const p = dynamic_cast<knumber_float *>(rhs)) {
-		Q_UNUSED(p);
-		return this;
-	} else if(knumber_fraction *const p = dynamic_cast<knumber_fraction *>(rhs)) {
-		Q_UNUSED(p);
-		return this;
-	} else if(knumber_error *const p = dynamic_cast<knumber_error *>(rhs)) {
-		if(error_ == ERROR_POS_INFINITY && p->error_ == ERROR_NEG_INFINITY) {
-			error_ = ERROR_UNDEFINED;
-		} else if(error_ == ERROR_NEG_INFINITY && p->error_ == ERROR_POS_INFINITY) {
-			error_ = ERROR_UNDEFINED;
-		} else if(p->error_ == ERROR_UNDEFINED) {
-			error_ = ERROR_UNDEFINED;
-		}
-		return this;
-	}
+//------------------------------------------------------------------------------
+// Name:
+//------------------------------------------------------------------------------
+void knumber_error::add(knumber_base *, knumber_float *) {
+}
 
-	Q_ASSERT(0);
-	return 0;
+//------------------------------------------------------------------------------
+// Name:
+//------------------------------------------------------------------------------
+void knumber_error::add(knumber_base *, knumber_fraction *) {
 }
 
 //------------------------------------------------------------------------------
 // Name:
 //------------------------------------------------------------------------------
-knumber_base *knumber_error::sub(knumber_base *rhs) {
+void knumber_error::add(knumber_base *, knumber_error *rhs) {
 
-	if(knumber_integer *const p = dynamic_cast<knumber_integer *>(rhs)) {
-		Q_UNUSED(p);
-		return this;
-	} else if(knumber_float *const p = dynamic_cast<knumber_float *>(rhs)) {
-		Q_UNUSED(p);
-		return this;
-	} else if(knumber_fraction *const p = dynamic_cast<knumber_fraction *>(rhs)) {
-		Q_UNUSED(p);
-		return this;
-	} else if(knumber_error *const p = dynamic_cast<knumber_error *>(rhs)) {
-		if(error_ == ERROR_POS_INFINITY && p->error_ == ERROR_POS_INFINITY) {
-			error_ = ERROR_UNDEFINED;
-		} else if(error_ == ERROR_NEG_INFINITY && p->error_ == ERROR_NEG_INFINITY) {
-			error_ = ERROR_UNDEFINED;
-		} else if(p->error_ == ERROR_UNDEFINED) {
-			error_ = ERROR_UNDEFINED;
-		}
-		return this;
+	if(error_ == ERROR_POS_INFINITY && rhs->error_ == ERROR_NEG_INFINITY) {
+		error_ = ERROR_UNDEFINED;
+	} else if(error_ == ERROR_NEG_INFINITY && rhs->error_ == ERROR_POS_INFINITY) {
+		error_ = ERROR_UNDEFINED;
+	} else if(rhs->error_ == ERROR_UNDEFINED) {
+		error_ = ERROR_UNDEFINED;
 	}
+}
 
-	Q_ASSERT(0);
-	return 0;
+//------------------------------------------------------------------------------
+// Name:
+//------------------------------------------------------------------------------
+void knumber_error::sub(knumber_base *, knumber_integer *) {
 }
 
 //------------------------------------------------------------------------------
 // Name:
 //------------------------------------------------------------------------------
-knumber_base *knumber_error::mul(knumber_base *rhs) {
+void knumber_error::sub(knumber_base *, knumber_float *) {
+}
 
-	if(knumber_integer *const p = dynamic_cast<knumber_integer *>(rhs)) {
-		if(p->is_zero()) {
-			error_ = ERROR_UNDEFINED;
-		}
-		return this;
-	} else if(knumber_float *const p = dynamic_cast<knumber_float *>(rhs)) {
-		if(p->is_zero()) {
-			error_ = ERROR_UNDEFINED;
-		}
-		return this;
-	} else if(knumber_fraction *const p = dynamic_cast<knumber_fraction *>(rhs)) {
-		if(p->is_zero()) {
-			error_ = ERROR_UNDEFINED;
-		}
-		return this;
-	} else if(knumber_error *const p = dynamic_cast<knumber_error *>(rhs)) {
-		if(error_ == ERROR_POS_INFINITY && p->error_ == ERROR_NEG_INFINITY) {
-			error_ = ERROR_NEG_INFINITY;
-		} else if(error_ == ERROR_NEG_INFINITY && p->error_ == ERROR_POS_INFINITY) {
-			error_ = ERROR_NEG_INFINITY;
-		} else if(error_ == ERROR_NEG_INFINITY && p->error_ == ERROR_NEG_INFINITY) {
-			error_ = ERROR_POS_INFINITY;
-		} else if(p->error_ == ERROR_UNDEFINED) {
-			error_ = ERROR_UNDEFINED;
-		}
-		return this;
+//------------------------------------------------------------------------------
+// Name:
+//------------------------------------------------------------------------------
+void knumber_error::sub(knumber_base *, knumber_fraction *) {
+}
+
+//------------------------------------------------------------------------------
+// Name:
+//------------------------------------------------------------------------------
+void knumber_error::sub(knumber_base *, knumber_error *rhs) {
+
+	if(error_ == ERROR_POS_INFINITY && rhs->error_ == ERROR_POS_INFINITY) {
+		error_ = ERROR_UNDEFINED;
+	} else if(error_ == ERROR_NEG_INFINITY && rhs->error_ == ERROR_NEG_INFINITY) {
+		error_ = ERROR_UNDEFINED;
+	} else if(rhs->error_ == ERROR_UNDEFINED) {
+		error_ = ERROR_UNDEFINED;
 	}
+}
 
-	Q_ASSERT(0);
-	return 0;
+//------------------------------------------------------------------------------
+// Name:
+//------------------------------------------------------------------------------
+void knumber_error::mul(knumber_base *, knumber_integer *rhs) {
+
+	if(rhs->is_zero()) {
+		error_ = ERROR_UNDEFINED;
+	}
 }
 
 //------------------------------------------------------------------------------
 // Name:
 //------------------------------------------------------------------------------
-knumber_base *knumber_error::div(knumber_base *rhs) {
+void knumber_error::mul(knumber_base *, knumber_float *rhs) {
 
-	if(knumber_integer *const p = dynamic_cast<knumber_integer *>(rhs)) {
-		Q_UNUSED(p);
-		return this;
-	} else if(knumber_float *const p = dynamic_cast<knumber_float *>(rhs)) {
-		Q_UNUSED(p);
-		return this;
-	} else if(knumber_fraction *const p = dynamic_cast<knumber_fraction *>(rhs)) {
-		Q_UNUSED(p);
-		return this;
-	} else if(knumber_error *const p = dynamic_cast<knumber_error *>(rhs)) {
-		Q_UNUSED(p);
+	if(rhs->is_zero()) {
 		error_ = ERROR_UNDEFINED;
-		return this;
 	}
+}
 
-	Q_ASSERT(0);
-	return 0;
+//------------------------------------------------------------------------------
+// Name:
+//------------------------------------------------------------------------------
+void knumber_error::mul(knumber_base *, knumber_fraction *rhs) {
+
+	if(rhs->is_zero()) {
+		error_ = ERROR_UNDEFINED;
+	}
 }
 
 //------------------------------------------------------------------------------
 // Name:
 //------------------------------------------------------------------------------
-knumber_base *knumber_error::mod(knumber_base *rhs) {
+void knumber_error::mul(knumber_base *, knumber_error *rhs) {
 
-	if(knumber_integer *const p = dynamic_cast<knumber_integer *>(rhs)) {
-		Q_UNUSED(p);
-		return this;
-	} else if(knumber_float *const p = dynamic_cast<knumber_float *>(rhs)) {
-		Q_UNUSED(p);
-		return this;
-	} else if(knumber_fraction *const p = dynamic_cast<knumber_fraction *>(rhs)) {
-		Q_UNUSED(p);
-		return this;
-	} else if(knumber_error *const p = dynamic_cast<knumber_error *>(rhs)) {
-		Q_UNUSED(p);
+	if(error_ == ERROR_POS_INFINITY && rhs->error_ == ERROR_NEG_INFINITY) {
+		error_ = ERROR_NEG_INFINITY;
+	} else if(error_ == ERROR_NEG_INFINITY && rhs->error_ == ERROR_POS_INFINITY) {
+		error_ = ERROR_NEG_INFINITY;
+	} else if(error_ == ERROR_NEG_INFINITY && rhs->error_ == ERROR_NEG_INFINITY) {
+		error_ = ERROR_POS_INFINITY;
+	} else if(rhs->error_ == ERROR_UNDEFINED) {
 		error_ = ERROR_UNDEFINED;
-		return this;
 	}
+}
 
-	Q_ASSERT(0);
-	return 0;
+//------------------------------------------------------------------------------
+// Name:
+//------------------------------------------------------------------------------
+void knumber_error::div(knumber_base *, knumber_integer *) {
+}
+
+//------------------------------------------------------------------------------
+// Name:
+//------------------------------------------------------------------------------
+void knumber_error::div(knumber_base *, knumber_float *) {
+}
+
+//------------------------------------------------------------------------------
+// Name:
+//------------------------------------------------------------------------------
+void knumber_error::div(knumber_base *, knumber_fraction *) {
 }
 
 //------------------------------------------------------------------------------
 // Name:
 //------------------------------------------------------------------------------
-knumber_base *knumber_error::pow(knumber_base *rhs) {
-
-	if(knumber_integer *const p = dynamic_cast<knumber_integer *>(rhs)) {
-		Q_UNUSED(p);
-		return this;
-	} else if(knumber_float *const p = dynamic_cast<knumber_float *>(rhs)) {
-		Q_UNUSED(p);
-		return this;
-	} else if(knumber_fraction *const p = dynamic_cast<knumber_fraction *>(rhs)) {
-		Q_UNUSED(p);
-		return this;
-	} else if(knumber_error *const p = dynamic_cast<knumber_error *>(rhs)) {
-
-		switch(error_) {
-		case ERROR_POS_INFINITY:
-			if(p->sign() > 0) {
-				return this;
-			} else if(p->sign() < 0) {
-				knumber_integer *n = new knumber_integer(0);
-				delete this;
-				return n;
-			} else {
-				error_ = ERROR_UNDEFINED;
-				return this;
-			}
-			break;
-		case ERROR_NEG_INFINITY:
-			if(p->sign() > 0) {
-				error_ = ERROR_POS_INFINITY;
-				return this;
-			} else if(p->sign() < 0) {
-				knumber_integer *n = new knumber_integer(0);
-				delete this;
-				return n;
-			} else {
-				error_ = ERROR_UNDEFINED;
-				return this;
-			}
-			break;
-		case ERROR_UNDEFINED:
-			return this;
+void knumber_error::div(knumber_base *, knumber_error *) {
+	error_ = ERROR_UNDEFINED;
+}
+
+//------------------------------------------------------------------------------
+// Name:
+//------------------------------------------------------------------------------
+void knumber_error::mod(knumber_base *, knumber_integer *) {
+}
+
+//------------------------------------------------------------------------------
+// Name:
+//------------------------------------------------------------------------------
+void knumber_error::mod(knumber_base *, knumber_float *) {
+}
+
+//------------------------------------------------------------------------------
+// Name:
+//------------------------------------------------------------------------------
+void knumber_error::mod(knumber_base *, knumber_fraction *) {
+}
+
+//------------------------------------------------------------------------------
+// Name:
+//------------------------------------------------------------------------------
+void knumber_error::mod(knumber_base *, knumber_error *) {
+	error_ = ERROR_UNDEFINED;
+}
+
+//------------------------------------------------------------------------------
+// Name:
+//------------------------------------------------------------------------------
+void knumber_error::pow(knumber_base *, knumber_integer *) {
+}
+
+//------------------------------------------------------------------------------
+// Name:
+//------------------------------------------------------------------------------
+void knumber_error::pow(knumber_base *, knumber_float *) {
+}
+
+//------------------------------------------------------------------------------
+// Name:
+//------------------------------------------------------------------------------
+void knumber_error::pow(knumber_base *, knumber_fraction *) {
+}
+
+//------------------------------------------------------------------------------
+// Name:
+//------------------------------------------------------------------------------
+void knumber_error::pow(knumber_base *self, knumber_error *rhs) {
+
+	switch(error_) {
+	case ERROR_POS_INFINITY:
+		if(rhs->sign() < 0) {
+			self->emplace<knumber_integer>(0);
+		} else if(rhs->sign() == 0) {
+			error_ = ERROR_UNDEFINED;
 		}
+		break;
+	case ERROR_NEG_INFINITY:
+		if(rhs->sign() > 0) {
+			error_ = ERROR_POS_INFINITY;
+		} else if(rhs->sign() < 0) {
+			self->emplace<knumber_integer>(0);
+		} else {
+			error_ = ERROR_UNDEFINED;
+		}
+		break;
+	case ERROR_UNDEFINED:
+		break;
 	}
-
-	Q_ASSERT(0);
-	return 0;
 }
 
 //------------------------------------------------------------------------------
 // Name:
 //------------------------------------------------------------------------------
-knumber_base *knumber_error::neg() {
+void knumber_error::neg(knumber_base *) {
 
 	switch(error_) {
 	case ERROR_POS_INFINITY:
@@ -310,23 +324,20 @@ knumber_base *knumber_error::neg() {
 	default:
 		break;
 	}
-
-	return this;
 }
 
 //------------------------------------------------------------------------------
 // Name:
 //------------------------------------------------------------------------------
-knumber_base *knumber_error::cmp() {
+void knumber_error::cmp(knumber_base *) {
 
 	error_ = ERROR_UNDEFINED;
-	return this;
 }
 
 //------------------------------------------------------------------------------
 // Name:
 //------------------------------------------------------------------------------
-knumber_base *knumber_error::abs() {
+void knumber_error::abs(knumber_base *) {
 
 	switch(error_) {
 	case ERROR_NEG_INFINITY:
@@ -337,14 +348,12 @@ knumber_base *knumber_error::abs() {
 	default:
 		break;
 	}
-
-	return this;
 }
 
 //------------------------------------------------------------------------------
 // Name:
 //------------------------------------------------------------------------------
-knumber_base *knumber_error::sqrt() {
+void knumber_error::sqrt(knumber_base *) {
 
 	switch(error_) {
 	case ERROR_NEG_INFINITY:
@@ -355,232 +364,290 @@ knumber_base *knumber_error::sqrt() {
 	default:
 		break;
 	}
-
-	return this;
 }
 
 //------------------------------------------------------------------------------
 // Name:
 //------------------------------------------------------------------------------
-knumber_base *knumber_error::cbrt() {
-
-	return this;
+void knumber_error::cbrt(knumber_base *) {
 }
 
 //------------------------------------------------------------------------------
 // Name:
 //------------------------------------------------------------------------------
-knumber_base *knumber_error::factorial() {
+void knumber_error::factorial(knumber_base *) {
 	error_ = ERROR_UNDEFINED;
-	return this;
 }
 
 //------------------------------------------------------------------------------
 // Name:
 //------------------------------------------------------------------------------
-knumber_base *knumber_error::sin() {
+void knumber_error::sin(knumber_base *) {
 
 	error_ = ERROR_UNDEFINED;
-	return this;
 }
 
 //------------------------------------------------------------------------------
 // Name:
 //------------------------------------------------------------------------------
-knumber_base *knumber_error::cos() {
+void knumber_error::cos(knumber_base *) {
 
 	error_ = ERROR_UNDEFINED;
-	return this;
 }
 
 //------------------------------------------------------------------------------
 // Name:
 //------------------------------------------------------------------------------
-knumber_base* knumber_error::tgamma() {
+void knumber_error::tgamma(knumber_base *) {
 
 	error_ = ERROR_UNDEFINED;
-	return this;
 }
 
 //------------------------------------------------------------------------------
 // Name:
 //------------------------------------------------------------------------------
-knumber_base *knumber_error::tan() {
+void knumber_error::tan(knumber_base *) {
 
 	error_ = ERROR_UNDEFINED;
-	return this;
 }
 
 //------------------------------------------------------------------------------
 // Name:
 //------------------------------------------------------------------------------
-knumber_base *knumber_error::asin() {
+void knumber_error::asin(knumber_base *) {
 
 	error_ = ERROR_UNDEFINED;
-	return this;
 }
 
 //------------------------------------------------------------------------------
 // Name:
 //------------------------------------------------------------------------------
-knumber_base *knumber_error::acos() {
+void knumber_error::acos(knumber_base *) {
 
 	error_ = ERROR_UNDEFINED;
-	return this;
 }
 
 //------------------------------------------------------------------------------
 // Name:
 //------------------------------------------------------------------------------
-knumber_base *knumber_error::atan() {
+void knumber_error::atan(knumber_base *self) {
 
 	switch(error_) {
     case ERROR_POS_INFINITY:
-		delete this;
-		return new knumber_float(M_PI / 2.0);
+		self->emplace<knumber_float>(M_PI / 2.0);
+		break;
     case ERROR_NEG_INFINITY:
-		delete this;
-		return new knumber_float(-M_PI / 2.0);
+		self->emplace<knumber_float>(-M_PI / 2.0);
+		break;
 	case ERROR_UNDEFINED:
 	default:
-		return this;
+		break;
 	}
 }
 
 //------------------------------------------------------------------------------
 // Name:
 //------------------------------------------------------------------------------
-knumber_base *knumber_error::sinh() {
-
-	return this;
+void knumber_error::sinh(knumber_base *) {
 }
 
 //------------------------------------------------------------------------------
 // Name:
 //------------------------------------------------------------------------------
-knumber_base *knumber_error::cosh() {
+void knumber_error::cosh(knumber_base *) {
 
 	error_ = ERROR_UNDEFINED;
-	return this;
 }
 
 //------------------------------------------------------------------------------
 // Name:
 //------------------------------------------------------------------------------
-knumber_base *knumber_error::tanh() {
+void knumber_error::tanh(knumber_base *self) {
 
 	if(sign() > 0) {
-		delete this;
-		return new knumber_integer(1);
+		self->emplace<knumber_integer>(1);
 	} else if(sign() < 0) {
-		delete this;
-		return new knumber_integer(-1);
-	} else {
-		return this;
+		self->emplace<knumber_integer>(-1);
 	}
 }
 
 //------------------------------------------------------------------------------
 // Name:
 //------------------------------------------------------------------------------
-knumber_base *knumber_error::asinh() {
-
-	return this;
+void knumber_error::asinh(knumber_base *) {
 }
 
 //------------------------------------------------------------------------------
 // Name:
 //------------------------------------------------------------------------------
-knumber_base *knumber_error::acosh() {
+void knumber_error::acosh(knumber_base *) {
 
 	if(sign() < 0) {
 		error_ = ERROR_UNDEFINED;
 	}
-
-	return this;
 }
 
 //------------------------------------------------------------------------------
 // Name:
 //------------------------------------------------------------------------------
-knumber_base *knumber_error::atanh() {
+void knumber_error::atanh(knumber_base *) {
 
 	error_ = ERROR_UNDEFINED;
-	return this;
 }
 
 //------------------------------------------------------------------------------
 // Name:
 //------------------------------------------------------------------------------
-int knumber_error::compare(knumber_base *rhs) {
+int knumber_error::compare(knumber_integer *) {
 
-	if(knumber_integer *const p = dynamic_cast<knumber_integer *>(rhs)) {
-		if(sign() > 0) {
-			return 1;
-		} else {
-			return -1;
-		}
-	} else if(knumber_float *const p = dynamic_cast<knumber_float *>(rhs)) {
-		if(sign() > 0) {
-			return 1;
-		} else {
-			return -1;
-		}
-	} else if(knumber_fraction *const p = dynamic_cast<knumber_fraction *>(rhs)) {
-		if(sign() > 0) {
-			return 1;
-		} else {
-			return -1;
-		}
-	} else if(knumber_error *const p = dynamic_cast<knumber_error *>(rhs)) {
-		return sign() == p->sign();
+	if(sign() > 0) {
+		return 1;
+	} else {
+		return -1;
 	}
+}
 
-	Q_ASSERT(0);
-	return 0;
+//------------------------------------------------------------------------------
+// Name:
+//------------------------------------------------------------------------------
+int knumber_error::compare(knumber_float *) {
+
+	if(sign() > 0) {
+		return 1;
+	} else {
+		return -1;
+	}
+}
+
+//------------------------------------------------------------------------------
+// Name:
+//------------------------------------------------------------------------------
+int knumber_error::compare(knumber_fraction *) {
+
+	if(sign() > 0) {
+		return 1;
+	} else {
+		return -1;
+	}
+}
+
+//------------------------------------------------------------------------------
+// Name:
+//------------------------------------------------------------------------------
+int knumber_error::compare(knumber_error *rhs) {
+	return sign() == rhs->sign();
+}
+
+//------------------------------------------------------------------------------
+// Name:
+//------------------------------------------------------------------------------
+void knumber_error::bitwise_and(knumber_base *, knumber_error *) {
+	error_ = ERROR_UNDEFINED;
 }
 
 //------------------------------------------------------------------------------
 // Name:
 //------------------------------------------------------------------------------
-knumber_base *knumber_error::clone() {
-	return new knumber_error(this);
+void knumber_error::bitwise_and(knumber_base *, knumber_integer *) {
+	error_ = ERROR_UNDEFINED;
 }
 
 //------------------------------------------------------------------------------
 // Name:
 //------------------------------------------------------------------------------
-knumber_base *knumber_error::bitwise_and(knumber_base *rhs) {
-	Q_UNUSED(rhs);
+void knumber_error::bitwise_and(knumber_base *, knumber_float *) {
 	error_ = ERROR_UNDEFINED;
-	return this;
 }
 
 //------------------------------------------------------------------------------
 // Name:
 //------------------------------------------------------------------------------
-knumber_base *knumber_error::bitwise_xor(knumber_base *rhs) {
-	Q_UNUSED(rhs);
+void knumber_error::bitwise_and(knumber_base *, knumber_fraction *) {
 	error_ = ERROR_UNDEFINED;
-	return this;
 }
 
 //------------------------------------------------------------------------------
 // Name:
 //------------------------------------------------------------------------------
-knumber_base *knumber_error::bitwise_or(knumber_base *rhs) {
-	Q_UNUSED(rhs);
+void knumber_error::bitwise_xor(knumber_base *, knumber_error *) {
 	error_ = ERROR_UNDEFINED;
-	return this;
 }
 
 //------------------------------------------------------------------------------
 // Name:
 //------------------------------------------------------------------------------
-knumber_base *knumber_error::bitwise_shift(knumber_base *rhs) {
-	Q_UNUSED(rhs);
+void knumber_error::bitwise_xor(knumber_base *, knumber_integer *) {
+	error_ = ERROR_UNDEFINED;
+}
+
+//------------------------------------------------------------------------------
+// Name:
+//------------------------------------------------------------------------------
+void knumber_error::bitwise_xor(knumber_base *, knumber_float *) {
+	error_ = ERROR_UNDEFINED;
+}
+
+//------------------------------------------------------------------------------
+// Name:
+//------------------------------------------------------------------------------
+void knumber_error::bitwise_xor(knumber_base *, knumber_fraction *) {
+	error_ = ERROR_UNDEFINED;
+}
+
+//------------------------------------------------------------------------------
+// Name:
+//------------------------------------------------------------------------------
+void knumber_error::bitwise_or(knumber_base *, knumber_error *) {
+	error_ = ERROR_UNDEFINED;
+}
+
+//------------------------------------------------------------------------------
+// Name:
+//------------------------------------------------------------------------------
+void knumber_error::bitwise_or(knumber_base *, knumber_integer *) {
+	error_ = ERROR_UNDEFINED;
+}
+
+//------------------------------------------------------------------------------
+// Name:
+//------------------------------------------------------------------------------
+void knumber_error::bitwise_or(knumber_base *, knumber_float *) {
+	error_ = ERROR_UNDEFINED;
+}
+
+//------------------------------------------------------------------------------
+// Name:
+//------------------------------------------------------------------------------
+void knumber_error::bitwise_or(knumber_base *, knumber_fraction *) {
+	error_ = ERROR_UNDEFINED;
+}
+
+//------------------------------------------------------------------------------
+// Name:
+//------------------------------------------------------------------------------
+void knumber_error::bitwise_shift(knumber_base *, knumber_error *) {
+	error_ = ERROR_UNDEFINED;
+}
+
+//------------------------------------------------------------------------------
+// Name:
+//------------------------------------------------------------------------------
+void knumber_error::bitwise_shift(knumber_base *, knumber_integer *) {
+	error_ = ERROR_UNDEFINED;
+}
+
+//------------------------------------------------------------------------------
+// Name:
+//------------------------------------------------------------------------------
+void knumber_error::bitwise_shift(knumber_base *, knumber_float *) {
+	error_ = ERROR_UNDEFINED;
+}
+
+//------------------------------------------------------------------------------
+// Name:
+//------------------------------------------------------------------------------
+void knumber_error::bitwise_shift(knumber_base *, knumber_fraction *) {
 	error_ = ERROR_UNDEFINED;
-	return this;
 }
 
 //------------------------------------------------------------------------------
@@ -618,74 +685,65 @@ int knumber_error::sign() const {
 //------------------------------------------------------------------------------
 // Name:
 //------------------------------------------------------------------------------
-knumber_base *knumber_error::reciprocal() {
+void knumber_error::reciprocal(knumber_base *) {
 
 	error_ = ERROR_UNDEFINED;
-	return this;
 }
 
 //------------------------------------------------------------------------------
 // Name:
 //------------------------------------------------------------------------------
-knumber_base *knumber_error::log2() {
+void knumber_error::log2(knumber_base *) {
 	error_ = ERROR_UNDEFINED;
-	return this;
 }
 
 //------------------------------------------------------------------------------
 // Name:
 //------------------------------------------------------------------------------
-knumber_base *knumber_error::log10() {
+void knumber_error::log10(knumber_base *) {
 	error_ = ERROR_UNDEFINED;
-	return this;
 }
 
 //------------------------------------------------------------------------------
 // Name:
 //------------------------------------------------------------------------------
-knumber_base *knumber_error::ln() {
+void knumber_error::ln(knumber_base *) {
 	error_ = ERROR_UNDEFINED;
-	return this;
 }
 
 //------------------------------------------------------------------------------
 // Name:
 //------------------------------------------------------------------------------
-knumber_base *knumber_error::ceil() {
+void knumber_error::ceil(knumber_base *) {
 	error_ = ERROR_UNDEFINED;
-	return this;
 }
 
 //------------------------------------------------------------------------------
 // Name:
 //------------------------------------------------------------------------------
-knumber_base *knumber_error::floor() {
+void knumber_error::floor(knumber_base *) {
 	error_ = ERROR_UNDEFINED;
-	return this;
 }
 
 //------------------------------------------------------------------------------
 // Name:
 //------------------------------------------------------------------------------
-knumber_base *knumber_error::exp2() {
+void knumber_error::exp2(knumber_base *) {
 	error_ = ERROR_UNDEFINED;
-	return this;
 }
 
 //------------------------------------------------------------------------------
 // Name:
 //------------------------------------------------------------------------------
-knumber_base *knumber_error::exp10() {
+void knumber_error::exp10(knumber_base *) {
 	error_ = ERROR_UNDEFINED;
-	return this;
 }
 
 //------------------------------------------------------------------------------
 // Name:
 //------------------------------------------------------------------------------
-knumber_base *knumber_error::exp() {
+void knumber_error::exp(knumber_base *) {
 	error_ = ERROR_UNDEFINED;
-	return this;
 }
 
 //------------------------------------------------------------------------------
@@ -702,13 +760,33 @@ qint64 knumber_error::toInt64() const {
 	return 0;
 }
 
+
+//------------------------------------------------------------------------------
+// Name:
+//------------------------------------------------------------------------------
+void knumber_error::bin(knumber_base *, knumber_error *) {
+	error_ = ERROR_UNDEFINED;
+}
+
+//------------------------------------------------------------------------------
+// Name:
+//------------------------------------------------------------------------------
+void knumber_error::bin(knumber_base *, knumber_integer *) {
+	error_ = ERROR_UNDEFINED;
+}
+
+//------------------------------------------------------------------------------
+// Name:
+//------------------------------------------------------------------------------
+void knumber_error::bin(knumber_base *, knumber_float *) {
+	error_ = ERROR_UNDEFINED;
+}
+
 //------------------------------------------------------------------------------
 // Name:
 //------------------------------------------------------------------------------
-knumber_base *knumber_error::bin(knumber_base *rhs) {
-	Q_UNUSED(rhs);
+void knumber_error::bin(knumber_base *, knumber_fraction *) {
 	error_ = ERROR_UNDEFINED;
-	return this;
 }
 
 }
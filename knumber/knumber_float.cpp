@@ -17,12 +17,13 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
 #include <config-kcalc.h>
-#include "knumber_integer.h"
-#include "knumber_float.h"
-#include "knumber_fraction.h"
-#include "knumber_error.h"
-#include <QScopedArrayPointer>
+#include "knumber_context.h"
+#include "knumber_base.h"
+#include "knumber_formatter.h"
 #include <QDebug>
+#include <atomic>
+#include <float.h>
+#include <limits>
 #include <math.h>
 
 #ifdef _MSC_VER
@@ -42,42 +43,281 @@ double exp10(double x) { return exp(x * log(10)); }
 
 namespace detail {
 
+namespace {
+
+//------------------------------------------------------------------------------
+// Name: fits_ulong_abs
+//------------------------------------------------------------------------------
+bool fits_ulong_abs(mpz_srcptr x) {
+	return mpz_sizeinbase(x, 2) <= static_cast<size_t>(std::numeric_limits<unsigned long>::digits);
+}
+
+//------------------------------------------------------------------------------
+// Name: power_of_two
+// Desc: true if |x| is 2^n, n is then one less than the number of bits
+//------------------------------------------------------------------------------
+bool power_of_two(mpz_srcptr x) {
+	return mpz_sgn(x) != 0 && mpz_scan1(x, 0) + 1 == mpz_sizeinbase(x, 2);
+}
+
+//------------------------------------------------------------------------------
+// Name: add_integer
+// Desc: f += x, or f -= x if negate is set. |x| has to fit in an unsigned long
+//------------------------------------------------------------------------------
+void add_integer(mpf_ptr f, mpz_srcptr x, bool negate) {
+	if((mpz_sgn(x) < 0) != negate) {
+		mpf_sub_ui(f, f, mpz_get_ui(x));
+	} else {
+		mpf_add_ui(f, f, mpz_get_ui(x));
+	}
+}
+
+//------------------------------------------------------------------------------
+// Name: mul_integer
+// Desc: f *= x, or f /= x if divide is set, with a shift for a power of two.
+//       returns false, leaving f as it is, if x is too big for that
+//------------------------------------------------------------------------------
+bool mul_integer(mpf_ptr f, mpz_srcptr x, bool divide) {
+
+	if(power_of_two(x)) {
+		if(divide) {
+			mpf_div_2exp(f, f, mpz_sizeinbase(x, 2) - 1);
+		} else {
+			mpf_mul_2exp(f, f, mpz_sizeinbase(x, 2) - 1);
+		}
+	} else if(fits_ulong_abs(x)) {
+		if(divide) {
+			mpf_div_ui(f, f, mpz_get_ui(x));
+		} else {
+			mpf_mul_ui(f, f, mpz_get_ui(x));
+		}
+	} else {
+		return false;
+	}
+
+	if(mpz_sgn(x) < 0) {
+		mpf_neg(f, f);
+	}
+
+	return true;
+}
+
+//------------------------------------------------------------------------------
+// Name: fits_ulong_fraction
+// Desc: true if the numerator and the denominator of q fit in unsigned longs
+//------------------------------------------------------------------------------
+bool fits_ulong_fraction(mpq_srcptr q) {
+	return fits_ulong_abs(mpq_numref(q)) && fits_ulong_abs(mpq_denref(q));
+}
+
 #ifdef KNUMBER_USE_MPFR
-const mpfr_rnd_t  knumber_float::rounding_mode = MPFR_RNDN;
-const mpfr_prec_t knumber_float::precision     = 1024;
+// a double can't be trusted with more digits than this
+const int max_fast_digits = DBL_DIG;
+
+// the error we allow for in the libm functions, in units in the last place.
+// the common implementations stay well within this
+const double libm_ulps = 8.0;
+
+// sin, cos and tan of a double are exact to within libm_ulps, but one step to
+// the next double changes them by up to that step. only while the step is far
+// below the period does the interval between x and the next double bound them
+const double max_periodic_arg = 1 << 26;
+
+double libc_exp10(double x) { return ::pow(10.0, x); }
+
+//------------------------------------------------------------------------------
+// Name: rounds_unambiguously
+// Desc: returns true if every value in [lo, hi] is shown the same when it is
+//       rounded to the given number of significant digits
+//------------------------------------------------------------------------------
+bool rounds_unambiguously(double lo, double hi, int digits) {
+
+	// the interval has to stay clear of zero, we can't tell a tiny result
+	// (or one which underflowed) from zero
+	if(lo < DBL_MIN && hi > -DBL_MIN) {
+		return false;
+	}
+
+	const double a = qMin(::fabs(lo), ::fabs(hi));
+	const double b = qMax(::fabs(lo), ::fabs(hi));
+
+	const int e = static_cast<int>(::floor(::log10(b)));
+	if(e < -280 || e > 280) {
+		return false;
+	}
+
+	// scale so that the last digit shown is the units digit, the scaling
+	// itself may be off by a few ulps
+	const double scale = ::pow(10.0, digits - 1 - e);
+	const double a_scaled = a * scale * (1.0 - 4 * DBL_EPSILON);
+	const double b_scaled = b * scale * (1.0 + 4 * DBL_EPSILON);
+
+	return ::floor(a_scaled + 0.5) == ::floor(b_scaled + 0.5);
+}
 #endif
 
+}
+
+#ifdef KNUMBER_USE_MPFR
+const mpfr_rnd_t knumber_float::rounding_mode = MPFR_RNDN;
+
+//------------------------------------------------------------------------------
+// Name: execute_mpfr_func
+// Desc: evaluates F in MPFR at the precision of the value, so the result is
+//       as precise as the rest of the float arithmetic
+//------------------------------------------------------------------------------
+template <int F(mpfr_ptr rop, mpfr_srcptr op, mpfr_rnd_t rnd)>
+void knumber_float::execute_mpfr_func(knumber_base *self) {
+	mpfr_t mpfr;
+	mpfr_init2(mpfr, mpf_get_prec(mpf_));
+	mpfr_set_f(mpfr, mpf_, rounding_mode);
+	F(mpfr, mpfr, rounding_mode);
+	mpfr_result(self, mpfr);
+}
+
+//------------------------------------------------------------------------------
+// Name: execute_mpfr_func
+//------------------------------------------------------------------------------
+template <int F(mpfr_ptr rop, mpfr_srcptr op1, mpfr_srcptr op2, mpfr_rnd_t rnd)>
+void knumber_float::execute_mpfr_func(knumber_base *self, const mpf_t y) {
+	mpfr_t lhs;
+	mpfr_t rhs;
+	mpfr_init2(lhs, mpf_get_prec(mpf_));
+	mpfr_init2(rhs, mpf_get_prec(mpf_));
+	mpfr_set_f(lhs, mpf_, rounding_mode);
+	mpfr_set_f(rhs, y, rounding_mode);
+	F(lhs, lhs, rhs, rounding_mode);
+	mpfr_clear(rhs);
+	mpfr_result(self, lhs);
+}
+
+//------------------------------------------------------------------------------
+// Name: mpfr_result
+// Desc: stores the result of an MPFR function and clears it, NaN and the
+//       infinities become the matching error
+//------------------------------------------------------------------------------
+void knumber_float::mpfr_result(knumber_base *self, mpfr_t mpfr) {
+
+	if(mpfr_nan_p(mpfr)) {
+		self->emplace<knumber_error>(knumber_error::ERROR_UNDEFINED);
+	} else if(mpfr_inf_p(mpfr)) {
+		self->emplace<knumber_error>((mpfr_sgn(mpfr) < 0) ? knumber_error::ERROR_NEG_INFINITY : knumber_error::ERROR_POS_INFINITY);
+	} else {
+		mpfr_get_f(mpf_, mpfr, rounding_mode);
+	}
+
+	mpfr_clear(mpfr);
+}
+
+//------------------------------------------------------------------------------
+// Name: try_libc_func
+// Desc: evaluates F in double precision and bounds the error of the result.
+//       succeeds if the whole error interval shows the same digits at the
+//       output precision
+//------------------------------------------------------------------------------
 template <double F(double)>
-knumber_base *knumber_float::execute_libc_func(double x) {
+bool knumber_float::try_libc_func(double *result, double max_arg) const {
+
+	const KNumberContext &context = KNumberContext::active();
+	const int digits = (context.floatPrecision() > 0) ? context.floatPrecision() : static_cast<int>(context.floatPrecisionBits() * M_LN2 / M_LN10);
+	if(digits > max_fast_digits) {
+		return false;
+	}
+
+	const double x = mpf_get_d(mpf_);
+	if(!(::fabs(x) <= max_arg)) {
+		return false;
+	}
+
+	const double r = F(x);
+	if(isnan(r) || isinf(r)) {
+		return false;
+	}
+
+	double lo = r;
+	double hi = r;
+
+	// mpf_get_d truncates, so unless x is exact the value lies between x and
+	// the next double away from zero. the results at both ends bound F over
+	// the step unless it has an extremum there, and then they miss it by no
+	// more than about F'' * ulp^2, which the allowance for libm covers while
+	// ulp(x) is small. max_arg keeps it small for the periodic functions
+	if(mpf_cmp_d(mpf_, x) != 0) {
+		const double r2 = F(::nextafter(x, (x < 0) ? -HUGE_VAL : HUGE_VAL));
+		if(isnan(r2) || isinf(r2)) {
+			return false;
+		}
+		lo = qMin(lo, r2);
+		hi = qMax(hi, r2);
+	}
+
+	lo -= ::fabs(lo) * libm_ulps * DBL_EPSILON;
+	hi += ::fabs(hi) * libm_ulps * DBL_EPSILON;
+
+	if(!rounds_unambiguously(lo, hi, digits)) {
+		return false;
+	}
+
+	*result = r;
+	return true;
+}
+
+//------------------------------------------------------------------------------
+// Name: execute_adaptive_func
+// Desc: tries F in double precision first and only falls back to G at the
+//       full float precision when that isn't good enough for the output
+//------------------------------------------------------------------------------
+template <double F(double), int G(mpfr_ptr rop, mpfr_srcptr op, mpfr_rnd_t rnd)>
+void knumber_float::execute_adaptive_func(knumber_base *self, double max_arg) {
+
+	double r;
+	if(try_libc_func<F>(&r, max_arg)) {
+		KNUMBER_COUNT(FAST_PATH_HITS);
+		mpf_set_d(mpf_, r);
+		return;
+	}
+
+	KNUMBER_COUNT(FAST_PATH_MISSES);
+	execute_mpfr_func<G>(self);
+}
+#endif
+
+//------------------------------------------------------------------------------
+// Name: context_precision
+//------------------------------------------------------------------------------
+mp_bitcnt_t knumber_float::context_precision() {
+	return KNumberContext::active().floatPrecisionBits();
+}
+
+//------------------------------------------------------------------------------
+// Name: set_context_precision
+// Desc: GMP leaves the value alone if it already has this precision
+//------------------------------------------------------------------------------
+void knumber_float::set_context_precision() {
+	mpf_set_prec(mpf_, context_precision());
+}
+
+template <double F(double)>
+void knumber_float::execute_libc_func(knumber_base *self, double x) {
 	const double r = F(x);
 	if(isnan(r)) {
-		knumber_error *e = new knumber_error(knumber_error::ERROR_UNDEFINED);
-		delete this;
-		return e;
+		self->emplace<knumber_error>(knumber_error::ERROR_UNDEFINED);
 	} else if(isinf(r)) {
-		knumber_error *e = new knumber_error(knumber_error::ERROR_POS_INFINITY);
-		delete this;
-		return e;
+		self->emplace<knumber_error>(knumber_error::ERROR_POS_INFINITY);
 	} else {
 		mpf_set_d(mpf_, r);
-		return this;
 	}
 }
 
 template <double F(double, double)>
-knumber_base *knumber_float::execute_libc_func(double x, double y) {
+void knumber_float::execute_libc_func(knumber_base *self, double x, double y) {
 	const double r = F(x, y);
 	if(isnan(r)) {
-		knumber_error *e = new knumber_error(knumber_error::ERROR_UNDEFINED);
-		delete this;
-		return e;
+		self->emplace<knumber_error>(knumber_error::ERROR_UNDEFINED);
 	} else if(isinf(r)) {
-		knumber_error *e = new knumber_error(knumber_error::ERROR_POS_INFINITY);
-		delete this;
-		return e;
+		self->emplace<knumber_error>(knumber_error::ERROR_POS_INFINITY);
 	} else {
 		mpf_set_d(mpf_, r);
-		return this;
 	}
 }
 
@@ -86,7 +326,7 @@ knumber_base *knumber_float::execute_libc_func(double x, double y) {
 //------------------------------------------------------------------------------
 knumber_float::knumber_float(const QString &s) {
 
-	mpf_init(mpf_);
+	mpf_init2(mpf_, context_precision());
 	mpf_set_str(mpf_, s.toAscii(), 10);
 }
 
@@ -98,7 +338,8 @@ knumber_float::knumber_float(double value) {
 	Q_ASSERT(!isinf(value));
 	Q_ASSERT(!isnan(value));
 
-	mpf_init_set_d(mpf_, value);
+	mpf_init2(mpf_, context_precision());
+	mpf_set_d(mpf_, value);
 }
 
 #ifdef HAVE_LONG_DOUBLE
@@ -110,7 +351,8 @@ knumber_float::knumber_float(long double value) {
 	Q_ASSERT(!isinf(value));
 	Q_ASSERT(!isnan(value));
 
-	mpf_init_set_d(mpf_, value);
+	mpf_init2(mpf_, context_precision());
+	mpf_set_d(mpf_, value);
 }
 #endif
 
@@ -119,16 +361,27 @@ knumber_float::knumber_float(long double value) {
 //------------------------------------------------------------------------------
 knumber_float::knumber_float(mpf_t mpf) {
 
-	mpf_init(mpf_);
+	mpf_init2(mpf_, context_precision());
+	mpf_set(mpf_, mpf);
+}
+
+//------------------------------------------------------------------------------
+// Name:
+//------------------------------------------------------------------------------
+knumber_float::knumber_float(mpf_t mpf, mp_bitcnt_t precision) {
+
+	mpf_init2(mpf_, precision);
 	mpf_set(mpf_, mpf);
 }
 
 //------------------------------------------------------------------------------
 // Name:
+// Desc: a copy keeps the precision of the value
 //------------------------------------------------------------------------------
 knumber_float::knumber_float(const knumber_float *value) {
 
-	mpf_init_set(mpf_, value->mpf_);
+	mpf_init2(mpf_, mpf_get_prec(value->mpf_));
+	mpf_set(mpf_, value->mpf_);
 }
 
 //------------------------------------------------------------------------------
@@ -136,7 +389,8 @@ knumber_float::knumber_float(const knumber_float *value) {
 //------------------------------------------------------------------------------
 knumber_float::knumber_float(const knumber_integer *value) {
 
-	mpf_init(mpf_);
+	KNUMBER_COUNT(INTEGER_TO_FLOAT);
+	mpf_init2(mpf_, context_precision());
 	mpf_set_z(mpf_, value->mpz_);
 }
 
@@ -145,16 +399,128 @@ knumber_float::knumber_float(const knumber_integer *value) {
 //------------------------------------------------------------------------------
 knumber_float::knumber_float(const knumber_fraction *value) {
 
-	mpf_init(mpf_);
+	KNUMBER_COUNT(FRACTION_TO_FLOAT);
+	mpf_init2(mpf_, context_precision());
 	mpf_set_q(mpf_, value->mpq_);
 }
 
+//------------------------------------------------------------------------------
+// Name: pi
+//------------------------------------------------------------------------------
+knumber_base *knumber_float::pi() {
+
+	knumber_base *const value = knumber_base::create<knumber_float>(0.0);
+	knumber_float *const r = value->get<knumber_float>();
+
+#ifdef KNUMBER_USE_MPFR
+	mpfr_t mpfr;
+	mpfr_init2(mpfr, mpf_get_prec(r->mpf_));
+	mpfr_const_pi(mpfr, rounding_mode);
+	mpfr_get_f(r->mpf_, mpfr, rounding_mode);
+	mpfr_clear(mpfr);
+#else
+	// Gauss-Legendre, each iteration roughly doubles the number of
+	// correct bits, so this converges quickly even at high precisions
+	const mp_bitcnt_t working_precision = mpf_get_prec(r->mpf_) + 64;
+
+	mpf_t a;
+	mpf_t b;
+	mpf_t t;
+	mpf_t x;
+	mpf_init2(a, working_precision);
+	mpf_init2(b, working_precision);
+	mpf_init2(t, working_precision);
+	mpf_init2(x, working_precision);
+
+	mpf_set_ui(a, 1);
+	mpf_sqrt_ui(b, 2);
+	mpf_ui_div(b, 1, b);
+	mpf_set_ui(t, 1);
+	mpf_div_2exp(t, t, 2);
+
+	for(unsigned int k = 0; (static_cast<mp_bitcnt_t>(4) << k) < working_precision; ++k) {
+		// x = (a + b) / 2, b = sqrt(a * b), t -= 2^k * (a - x)^2
+		mpf_add(x, a, b);
+		mpf_div_2exp(x, x, 1);
+		mpf_mul(b, a, b);
+		mpf_sqrt(b, b);
+		mpf_sub(a, a, x);
+		mpf_mul(a, a, a);
+		mpf_mul_2exp(a, a, k);
+		mpf_sub(t, t, a);
+		mpf_swap(a, x);
+	}
+
+	// pi = (a + b)^2 / 4t
+	mpf_add(x, a, b);
+	mpf_mul(x, x, x);
+	mpf_mul_2exp(t, t, 2);
+	mpf_div(r->mpf_, x, t);
+
+	mpf_clear(a);
+	mpf_clear(b);
+	mpf_clear(t);
+	mpf_clear(x);
+#endif
+	return value;
+}
+
+//------------------------------------------------------------------------------
+// Name: euler
+//------------------------------------------------------------------------------
+knumber_base *knumber_float::euler() {
+
+	knumber_base *const value = knumber_base::create<knumber_float>(0.0);
+	knumber_float *const r = value->get<knumber_float>();
+
+#ifdef KNUMBER_USE_MPFR
+	mpfr_t mpfr;
+	mpfr_init2(mpfr, mpf_get_prec(r->mpf_));
+	mpfr_set_ui(mpfr, 1, rounding_mode);
+	mpfr_exp(mpfr, mpfr, rounding_mode);
+	mpfr_get_f(r->mpf_, mpfr, rounding_mode);
+	mpfr_clear(mpfr);
+#else
+	// e = sum of 1/k!, stop once the terms no longer matter
+	const mp_bitcnt_t working_precision = mpf_get_prec(r->mpf_) + 64;
+
+	mpf_t sum;
+	mpf_t term;
+	mpf_init2(sum, working_precision);
+	mpf_init2(term, working_precision);
+
+	mpf_set_ui(sum, 1);
+	mpf_set_ui(term, 1);
+
+	for(unsigned long int k = 1; ; ++k) {
+		mpf_div_ui(term, term, k);
+
+		signed long int exponent;
+		mpf_get_d_2exp(&exponent, term);
+		if(exponent < -static_cast<signed long int>(working_precision)) {
+			break;
+		}
+
+		mpf_add(sum, sum, term);
+	}
+
+	mpf_set(r->mpf_, sum);
+
+	mpf_clear(sum);
+	mpf_clear(term);
+#endif
+	return value;
+}
+
 //------------------------------------------------------------------------------
 // Name:
 //------------------------------------------------------------------------------
-knumber_base *knumber_float::clone() {
+knumber_float::knumber_float(knumber_float &&other) {
 
-	return new knumber_float(this);
+	// GMP has no way to make an mpf_t without limbs, so this takes the other
+	// one's over and leaves it with none, which only its destructor looks at
+	*mpf_ = *other.mpf_;
+	other.mpf_->_mp_d = 0;
 }
 
 //------------------------------------------------------------------------------
@@ -162,363 +528,518 @@ knumber_base *knumber_float::clone() {
 //------------------------------------------------------------------------------
 knumber_float::~knumber_float() {
 
-	mpf_clear(mpf_);
+	if(mpf_->_mp_d) {
+		mpf_clear(mpf_);
+	}
 }
 
 //------------------------------------------------------------------------------
 // Name:
 //------------------------------------------------------------------------------
-knumber_base *knumber_float::add(knumber_base *rhs) {
+void knumber_float::add(knumber_base *self, knumber_integer *rhs) {
 
-	if(knumber_integer *const p = dynamic_cast<knumber_integer *>(rhs)) {
-		knumber_float f(p);
-		return add(&f);
-	} else if(knumber_float *const p = dynamic_cast<knumber_float *>(rhs)) {
-		mpf_add(mpf_, mpf_, p->mpf_);
-		return this;
-	} else if(knumber_fraction *const p = dynamic_cast<knumber_fraction *>(rhs)) {
-		knumber_float f(p);
-		return add(&f);
-	} else if(knumber_error *const p = dynamic_cast<knumber_error *>(rhs)) {
-		knumber_error *e = new knumber_error(p);
-		delete this;
-		return e;
+	if(fits_ulong_abs(rhs->mpz_)) {
+		add_integer(mpf_, rhs->mpz_, false);
+		return;
 	}
 
-	Q_ASSERT(0);
-	return 0;
+	knumber_float f(rhs);
+	add(self, &f);
 }
 
 //------------------------------------------------------------------------------
 // Name:
 //------------------------------------------------------------------------------
-knumber_base *knumber_float::sub(knumber_base *rhs) {
+void knumber_float::add(knumber_base *, knumber_float *rhs) {
+
+	mpf_add(mpf_, mpf_, rhs->mpf_);
+}
 
-	if(knumber_integer *const p = dynamic_cast<knumber_integer *>(rhs)) {
-		knumber_float f(p);
-		return sub(&f);
-	} else if(knumber_float *const p = dynamic_cast<knumber_float *>(rhs)) {
-		mpf_sub(mpf_, mpf_, p->mpf_);
-		return this;
-	} else if(knumber_fraction *const p = dynamic_cast<knumber_fraction *>(rhs)) {
-		knumber_float f(p);
-		return sub(&f);
-	} else if(knumber_error *const p = dynamic_cast<knumber_error *>(rhs)) {
-		knumber_error *e = new knumber_error(p);
-		delete this;
-		return e->neg();
+//------------------------------------------------------------------------------
+// Name:
+//------------------------------------------------------------------------------
+void knumber_float::add(knumber_base *self, knumber_fraction *rhs) {
+
+	// x + n/d as (x * d + n) / d
+	if(fits_ulong_fraction(rhs->mpq_)) {
+		mpf_mul_ui(mpf_, mpf_, mpz_get_ui(mpq_denref(rhs->mpq_)));
+		add_integer(mpf_, mpq_numref(rhs->mpq_), false);
+		mpf_div_ui(mpf_, mpf_, mpz_get_ui(mpq_denref(rhs->mpq_)));
+		return;
 	}
 
-	Q_ASSERT(0);
-	return 0;
+	knumber_float f(rhs);
+	add(self, &f);
 }
 
 //------------------------------------------------------------------------------
 // Name:
 //------------------------------------------------------------------------------
-knumber_base *knumber_float::mul(knumber_base *rhs) {
+void knumber_float::add(knumber_base *self, knumber_error *rhs) {
 
-	if(knumber_integer *const p = dynamic_cast<knumber_integer *>(rhs)) {
-		knumber_float f(p);
-		return mul(&f);
-	} else if(knumber_float *const p = dynamic_cast<knumber_float *>(rhs)) {
-		mpf_mul(mpf_, mpf_, p->mpf_);
-		return this;
-	} else if(knumber_fraction *const p = dynamic_cast<knumber_fraction *>(rhs)) {
-		knumber_float f(p);
-		return mul(&f);
-	} else if(knumber_error *const p = dynamic_cast<knumber_error *>(rhs)) {
-		if(is_zero()) {
-			delete this;
-			return new knumber_error(knumber_error::ERROR_UNDEFINED);
-		}
+	self->assign(knumber_error(rhs));
+}
 
-		if(sign() < 0) {
-			delete this;
-			knumber_error *e = new knumber_error(p);
-			return e->neg();
-		} else {
-			delete this;
-			return new knumber_error(p);
-		}
+//------------------------------------------------------------------------------
+// Name:
+//------------------------------------------------------------------------------
+void knumber_float::sub(knumber_base *self, knumber_integer *rhs) {
+
+	if(fits_ulong_abs(rhs->mpz_)) {
+		add_integer(mpf_, rhs->mpz_, true);
+		return;
+	}
+
+	knumber_float f(rhs);
+	sub(self, &f);
+}
+
+//------------------------------------------------------------------------------
+// Name:
+//------------------------------------------------------------------------------
+void knumber_float::sub(knumber_base *, knumber_float *rhs) {
+
+	mpf_sub(mpf_, mpf_, rhs->mpf_);
+}
+
+//------------------------------------------------------------------------------
+// Name:
+//------------------------------------------------------------------------------
+void knumber_float::sub(knumber_base *self, knumber_fraction *rhs) {
+
+	if(fits_ulong_fraction(rhs->mpq_)) {
+		mpf_mul_ui(mpf_, mpf_, mpz_get_ui(mpq_denref(rhs->mpq_)));
+		add_integer(mpf_, mpq_numref(rhs->mpq_), true);
+		mpf_div_ui(mpf_, mpf_, mpz_get_ui(mpq_denref(rhs->mpq_)));
+		return;
+	}
+
+	knumber_float f(rhs);
+	sub(self, &f);
+}
+
+//------------------------------------------------------------------------------
+// Name:
+//------------------------------------------------------------------------------
+void knumber_float::sub(knumber_base *self, knumber_error *rhs) {
+
+	self->assign(knumber_error(rhs))->neg(self);
+}
+
+//------------------------------------------------------------------------------
+// Name:
+//------------------------------------------------------------------------------
+void knumber_float::mul(knumber_base *self, knumber_integer *rhs) {
+
+	if(mul_integer(mpf_, rhs->mpz_, false)) {
+		return;
 	}
 
-	Q_ASSERT(0);
-	return 0;
+	knumber_float f(rhs);
+	mul(self, &f);
+}
+
+//------------------------------------------------------------------------------
+// Name:
+//------------------------------------------------------------------------------
+void knumber_float::mul(knumber_base *, knumber_float *rhs) {
+
+	mpf_mul(mpf_, mpf_, rhs->mpf_);
 }
 
 //------------------------------------------------------------------------------
 // Name:
 //------------------------------------------------------------------------------
-knumber_base *knumber_float::div(knumber_base *rhs) {
+void knumber_float::mul(knumber_base *self, knumber_fraction *rhs) {
+
+	if(fits_ulong_fraction(rhs->mpq_)) {
+		mul_integer(mpf_, mpq_numref(rhs->mpq_), false);
+		mul_integer(mpf_, mpq_denref(rhs->mpq_), true);
+		return;
+	}
+
+	knumber_float f(rhs);
+	mul(self, &f);
+}
+
+//------------------------------------------------------------------------------
+// Name:
+//------------------------------------------------------------------------------
+void knumber_float::mul(knumber_base *self, knumber_error *rhs) {
+
+	if(is_zero()) {
+		self->emplace<knumber_error>(knumber_error::ERROR_UNDEFINED);
+	} else if(sign() < 0) {
+		self->assign(knumber_error(rhs))->neg(self);
+	} else {
+		self->assign(knumber_error(rhs));
+	}
+}
+
+//------------------------------------------------------------------------------
+// Name:
+//------------------------------------------------------------------------------
+void knumber_float::div(knumber_base *self, knumber_integer *rhs) {
 
 	if(rhs->is_zero()) {
-		if(sign() < 0) {
-			delete this;
-			return new knumber_error(knumber_error::ERROR_NEG_INFINITY);
-		} else {
-			delete this;
-			return new knumber_error(knumber_error::ERROR_POS_INFINITY);
-		}
+		self->emplace<knumber_error>((sign() < 0) ? knumber_error::ERROR_NEG_INFINITY : knumber_error::ERROR_POS_INFINITY);
+		return;
 	}
 
-	if(knumber_integer *const p = dynamic_cast<knumber_integer *>(rhs)) {
-		knumber_float f(p);
-		return div(&f);
-	} else if(knumber_float *const p = dynamic_cast<knumber_float *>(rhs)) {
-		mpf_div(mpf_, mpf_, p->mpf_);
-		return this;
-	} else if(knumber_fraction *const p = dynamic_cast<knumber_fraction *>(rhs)) {
-		knumber_float f(p);
-		return div(&f);
-	} else if(knumber_error *const p = dynamic_cast<knumber_error *>(rhs)) {
-		if(p->sign() > 0 || p->sign() < 0) {
-			delete this;
-			return new knumber_integer(0);
-		}
+	if(mul_integer(mpf_, rhs->mpz_, true)) {
+		return;
+	}
+
+	knumber_float f(rhs);
+	div(self, &f);
+}
+
+//------------------------------------------------------------------------------
+// Name:
+//------------------------------------------------------------------------------
+void knumber_float::div(knumber_base *self, knumber_float *rhs) {
+
+	if(rhs->is_zero()) {
+		self->emplace<knumber_error>((sign() < 0) ? knumber_error::ERROR_NEG_INFINITY : knumber_error::ERROR_POS_INFINITY);
+		return;
+	}
+
+	mpf_div(mpf_, mpf_, rhs->mpf_);
+}
+
+//------------------------------------------------------------------------------
+// Name:
+//------------------------------------------------------------------------------
+void knumber_float::div(knumber_base *self, knumber_fraction *rhs) {
+
+	if(rhs->is_zero()) {
+		self->emplace<knumber_error>((sign() < 0) ? knumber_error::ERROR_NEG_INFINITY : knumber_error::ERROR_POS_INFINITY);
+		return;
+	}
+
+	if(fits_ulong_fraction(rhs->mpq_)) {
+		mul_integer(mpf_, mpq_denref(rhs->mpq_), false);
+		mul_integer(mpf_, mpq_numref(rhs->mpq_), true);
+		return;
+	}
+
+	knumber_float f(rhs);
+	div(self, &f);
+}
+
+//------------------------------------------------------------------------------
+// Name:
+//------------------------------------------------------------------------------
+void knumber_float::div(knumber_base *self, knumber_error *rhs) {
+
+	if(rhs->sign() != 0) {
+		self->emplace<knumber_integer>(0);
+	} else {
+		self->assign(knumber_error(rhs));
+	}
+}
+
+//------------------------------------------------------------------------------
+// Name:
+//------------------------------------------------------------------------------
+void knumber_float::mod(knumber_base *self, knumber_integer *rhs) {
 
-		delete this;
-		return new knumber_error(p);
+	if(rhs->is_zero()) {
+		self->emplace<knumber_error>(knumber_error::ERROR_UNDEFINED);
+		return;
 	}
 
-	Q_ASSERT(0);
-	return 0;
+	self->emplace<knumber_integer>(0);
 }
 
 //------------------------------------------------------------------------------
 // Name:
 //------------------------------------------------------------------------------
-knumber_base *knumber_float::mod(knumber_base *rhs) {
+void knumber_float::mod(knumber_base *self, knumber_float *rhs) {
+
+	if(rhs->is_zero()) {
+		self->emplace<knumber_error>(knumber_error::ERROR_UNDEFINED);
+		return;
+	}
+
+	self->emplace<knumber_integer>(0);
+}
 
-	Q_UNUSED(rhs);
+//------------------------------------------------------------------------------
+// Name:
+//------------------------------------------------------------------------------
+void knumber_float::mod(knumber_base *self, knumber_fraction *rhs) {
 
 	if(rhs->is_zero()) {
-		delete this;
-		return new knumber_error(knumber_error::ERROR_UNDEFINED);
+		self->emplace<knumber_error>(knumber_error::ERROR_UNDEFINED);
+		return;
 	}
 
-	delete this;
-	return new knumber_integer(0);
+	self->emplace<knumber_integer>(0);
+}
+
+//------------------------------------------------------------------------------
+// Name:
+//------------------------------------------------------------------------------
+void knumber_float::mod(knumber_base *self, knumber_error *) {
+
+	self->emplace<knumber_integer>(0);
+}
+
+//------------------------------------------------------------------------------
+// Name:
+//------------------------------------------------------------------------------
+void knumber_float::bitwise_and(knumber_base *self, knumber_integer *) {
+
+	self->emplace<knumber_integer>(0);
+}
+
+//------------------------------------------------------------------------------
+// Name:
+//------------------------------------------------------------------------------
+void knumber_float::bitwise_and(knumber_base *self, knumber_float *) {
+
+	self->emplace<knumber_integer>(0);
+}
+
+//------------------------------------------------------------------------------
+// Name:
+//------------------------------------------------------------------------------
+void knumber_float::bitwise_and(knumber_base *self, knumber_fraction *) {
+
+	self->emplace<knumber_integer>(0);
 }
 
 //------------------------------------------------------------------------------
 // Name:
 //------------------------------------------------------------------------------
-knumber_base *knumber_float::bitwise_and(knumber_base *rhs) {
+void knumber_float::bitwise_and(knumber_base *self, knumber_error *) {
 
-	Q_UNUSED(rhs);
-	delete this;
-	return new knumber_integer(0);
+	self->emplace<knumber_integer>(0);
 }
 
 //------------------------------------------------------------------------------
 // Name:
 //------------------------------------------------------------------------------
-knumber_base *knumber_float::bitwise_xor(knumber_base *rhs) {
+void knumber_float::bitwise_xor(knumber_base *self, knumber_integer *) {
 
-	Q_UNUSED(rhs);
-	delete this;
-	return new knumber_integer(0);
+	self->emplace<knumber_integer>(0);
 }
 
 //------------------------------------------------------------------------------
 // Name:
 //------------------------------------------------------------------------------
-knumber_base *knumber_float::bitwise_or(knumber_base *rhs) {
+void knumber_float::bitwise_xor(knumber_base *self, knumber_float *) {
 
-	Q_UNUSED(rhs);
-	delete this;
-	return new knumber_integer(0);
+	self->emplace<knumber_integer>(0);
 }
 
 //------------------------------------------------------------------------------
 // Name:
 //------------------------------------------------------------------------------
-knumber_base *knumber_float::bitwise_shift(knumber_base *rhs) {
+void knumber_float::bitwise_xor(knumber_base *self, knumber_fraction *) {
+
+	self->emplace<knumber_integer>(0);
+}
+
+//------------------------------------------------------------------------------
+// Name:
+//------------------------------------------------------------------------------
+void knumber_float::bitwise_xor(knumber_base *self, knumber_error *) {
+
+	self->emplace<knumber_integer>(0);
+}
+
+//------------------------------------------------------------------------------
+// Name:
+//------------------------------------------------------------------------------
+void knumber_float::bitwise_or(knumber_base *self, knumber_integer *) {
+
+	self->emplace<knumber_integer>(0);
+}
+
+//------------------------------------------------------------------------------
+// Name:
+//------------------------------------------------------------------------------
+void knumber_float::bitwise_or(knumber_base *self, knumber_float *) {
+
+	self->emplace<knumber_integer>(0);
+}
+
+//------------------------------------------------------------------------------
+// Name:
+//------------------------------------------------------------------------------
+void knumber_float::bitwise_or(knumber_base *self, knumber_fraction *) {
+
+	self->emplace<knumber_integer>(0);
+}
+
+//------------------------------------------------------------------------------
+// Name:
+//------------------------------------------------------------------------------
+void knumber_float::bitwise_or(knumber_base *self, knumber_error *) {
+
+	self->emplace<knumber_integer>(0);
+}
+
+//------------------------------------------------------------------------------
+// Name:
+//------------------------------------------------------------------------------
+void knumber_float::bitwise_shift(knumber_base *self, knumber_integer *) {
 
-	Q_UNUSED(rhs);
-	delete this;
 	// NOTE: we don't support bitwise operations with non-integer operands
-	return new knumber_error(knumber_error::ERROR_UNDEFINED);
+	self->emplace<knumber_error>(knumber_error::ERROR_UNDEFINED);
 }
 
 //------------------------------------------------------------------------------
 // Name:
 //------------------------------------------------------------------------------
-knumber_base *knumber_float::neg() {
+void knumber_float::bitwise_shift(knumber_base *self, knumber_float *) {
+
+	// NOTE: we don't support bitwise operations with non-integer operands
+	self->emplace<knumber_error>(knumber_error::ERROR_UNDEFINED);
+}
+
+//------------------------------------------------------------------------------
+// Name:
+//------------------------------------------------------------------------------
+void knumber_float::bitwise_shift(knumber_base *self, knumber_fraction *) {
+
+	// NOTE: we don't support bitwise operations with non-integer operands
+	self->emplace<knumber_error>(knumber_error::ERROR_UNDEFINED);
+}
+
+//------------------------------------------------------------------------------
+// Name:
+//------------------------------------------------------------------------------
+void knumber_float::bitwise_shift(knumber_base *self, knumber_error *) {
+
+	// NOTE: we don't support bitwise operations with non-integer operands
+	self->emplace<knumber_error>(knumber_error::ERROR_UNDEFINED);
+}
+
+//------------------------------------------------------------------------------
+// Name:
+//------------------------------------------------------------------------------
+void knumber_float::neg(knumber_base *) {
 
 	mpf_neg(mpf_, mpf_);
-	return this;
 }
 
 //------------------------------------------------------------------------------
 // Name:
 //------------------------------------------------------------------------------
-knumber_base *knumber_float::cmp() {
+void knumber_float::cmp(knumber_base *self) {
 
-	delete this;
-	return new knumber_error(knumber_error::ERROR_UNDEFINED);
+	self->emplace<knumber_error>(knumber_error::ERROR_UNDEFINED);
 }
 
 //------------------------------------------------------------------------------
 // Name:
 //------------------------------------------------------------------------------
-knumber_base *knumber_float::abs() {
+void knumber_float::abs(knumber_base *) {
 
 	mpf_abs(mpf_, mpf_);
-	return this;
 }
 
 //------------------------------------------------------------------------------
 // Name:
 //------------------------------------------------------------------------------
-knumber_base *knumber_float::sqrt() {
+void knumber_float::sqrt(knumber_base *self) {
 
 	if(sign() < 0) {
-		delete this;
-		return new knumber_error(knumber_error::ERROR_UNDEFINED);
+		self->emplace<knumber_error>(knumber_error::ERROR_UNDEFINED);
+		return;
 	}
 
 #ifdef KNUMBER_USE_MPFR
-	mpfr_t mpfr;
-	mpfr_init_set_f(mpfr, mpf_, rounding_mode);
-	mpfr_sqrt(mpfr, mpfr, rounding_mode);
-	mpfr_get_f(mpf_, mpfr, rounding_mode);
-	mpfr_clear(mpfr);
+	execute_mpfr_func< ::mpfr_sqrt>(self);
 #else
 	mpf_sqrt(mpf_, mpf_);
 #endif
-	return this;
 }
 
 //------------------------------------------------------------------------------
 // Name:
 //------------------------------------------------------------------------------
-knumber_base *knumber_float::cbrt() {
+void knumber_float::cbrt(knumber_base *self) {
 
 #ifdef KNUMBER_USE_MPFR
-	mpfr_t mpfr;
-	mpfr_init_set_f(mpfr, mpf_, rounding_mode);
-	mpfr_cbrt(mpfr, mpfr, rounding_mode);
-	mpfr_get_f(mpf_, mpfr, rounding_mode);
-	mpfr_clear(mpfr);
+	execute_adaptive_func< ::cbrt, ::mpfr_cbrt>(self);
 #else
 	const double x = mpf_get_d(mpf_);
 	if(isinf(x)) {
-		delete this;
-		return new knumber_error(knumber_error::ERROR_POS_INFINITY);
+		self->emplace<knumber_error>(knumber_error::ERROR_POS_INFINITY);
 	} else {
 #ifdef Q_CC_MSVC
-		return execute_libc_func< ::pow>(x, 1.0 / 3.0);
+		execute_libc_func< ::pow>(self, x, 1.0 / 3.0);
 #else
-		return execute_libc_func< ::cbrt>(x);
+		execute_libc_func< ::cbrt>(self, x);
 #endif
 	}
 #endif
-	return this;
 }
 
 //------------------------------------------------------------------------------
 // Name:
 //------------------------------------------------------------------------------
-knumber_base *knumber_float::factorial() {
+void knumber_float::factorial(knumber_base *self) {
 
 	if(sign() < 0) {
-		delete this;
-		return new knumber_error(knumber_error::ERROR_UNDEFINED);
+		self->emplace<knumber_error>(knumber_error::ERROR_UNDEFINED);
+		return;
 	}
 
-	knumber_integer *i = new knumber_integer(this);
-	delete this;
-	return i->factorial();
+	self->assign(knumber_integer(this))->factorial(self);
 }
 
 //------------------------------------------------------------------------------
 // Name:
 //------------------------------------------------------------------------------
-knumber_base *knumber_float::sin() {
+void knumber_float::sin(knumber_base *self) {
 
 #ifdef KNUMBER_USE_MPFR
-	mpfr_t mpfr;
-	mpfr_init_set_f(mpfr, mpf_, rounding_mode);
-	mpfr_sin(mpfr, mpfr, rounding_mode);
-	mpfr_get_f(mpf_, mpfr, rounding_mode);
-	mpfr_clear(mpfr);
-	return this;
+	execute_adaptive_func< ::sin, ::mpfr_sin>(self, max_periodic_arg);
 #else
 	const double x = mpf_get_d(mpf_);
 	if(isinf(x)) {
-		delete this;
-		return new knumber_error(knumber_error::ERROR_POS_INFINITY);
+		self->emplace<knumber_error>(knumber_error::ERROR_POS_INFINITY);
 	} else {
-		return execute_libc_func< ::sin>(x);
+		execute_libc_func< ::sin>(self, x);
 	}
 #endif
-
 }
 
 //------------------------------------------------------------------------------
 // Name:
 //------------------------------------------------------------------------------
-knumber_base *knumber_float::floor() {
-#ifdef KNUMBER_USE_MPFR
-	mpfr_t mpfr;
-	mpfr_init_set_f(mpfr, mpf_, rounding_mode);
-	mpfr_floor(mpfr, mpfr);
-	mpfr_get_f(mpf_, mpfr, rounding_mode);
-	mpfr_clear(mpfr);
-	return this;
-#else
-	const double x = mpf_get_d(mpf_);
-	if(isinf(x)) {
-		delete this;
-		return new knumber_error(knumber_error::ERROR_POS_INFINITY);
-	} else {
-		return execute_libc_func< ::floor>(x);
-	}
-#endif
+void knumber_float::floor(knumber_base *) {
+
+	// exact at any precision, no need to go through MPFR or a double
+	mpf_floor(mpf_, mpf_);
 }
 
 //------------------------------------------------------------------------------
 // Name:
 //------------------------------------------------------------------------------
-knumber_base *knumber_float::ceil() {
-#ifdef KNUMBER_USE_MPFR
-	mpfr_t mpfr;
-	mpfr_init_set_f(mpfr, mpf_, rounding_mode);
-	mpfr_ceil(mpfr, mpfr);
-	mpfr_get_f(mpf_, mpfr, rounding_mode);
-	mpfr_clear(mpfr);
-	return this;
-#else
-	const double x = mpf_get_d(mpf_);
-	if(isinf(x)) {
-		delete this;
-		return new knumber_error(knumber_error::ERROR_POS_INFINITY);
-	} else {
-		return execute_libc_func< ::ceil>(x);
-	}
-#endif
+void knumber_float::ceil(knumber_base *) {
+
+	// exact at any precision, no need to go through MPFR or a double
+	mpf_ceil(mpf_, mpf_);
 }
 //------------------------------------------------------------------------------
 // Name:
 //------------------------------------------------------------------------------
-knumber_base *knumber_float::cos() {
+void knumber_float::cos(knumber_base *self) {
 
 #ifdef KNUMBER_USE_MPFR
-	mpfr_t mpfr;
-	mpfr_init_set_f(mpfr, mpf_, rounding_mode);
-	mpfr_cos(mpfr, mpfr, rounding_mode);
-	mpfr_get_f(mpf_, mpfr, rounding_mode);
-	mpfr_clear(mpfr);
-	return this;
+	execute_adaptive_func< ::cos, ::mpfr_cos>(self, max_periodic_arg);
 #else
 	const double x = mpf_get_d(mpf_);
 	if(isinf(x)) {
-		delete this;
-		return new knumber_error(knumber_error::ERROR_POS_INFINITY);
+		self->emplace<knumber_error>(knumber_error::ERROR_POS_INFINITY);
 	} else {
-		return execute_libc_func< ::cos>(x);
+		execute_libc_func< ::cos>(self, x);
 	}
 #endif
 }
@@ -526,22 +1047,16 @@ knumber_base *knumber_float::cos() {
 //------------------------------------------------------------------------------
 // Name:
 //------------------------------------------------------------------------------
-knumber_base *knumber_float::tan() {
+void knumber_float::tan(knumber_base *self) {
 
 #ifdef KNUMBER_USE_MPFR
-	mpfr_t mpfr;
-	mpfr_init_set_f(mpfr, mpf_, rounding_mode);
-	mpfr_tan(mpfr, mpfr, rounding_mode);
-	mpfr_get_f(mpf_, mpfr, rounding_mode);
-	mpfr_clear(mpfr);
-	return this;
+	execute_adaptive_func< ::tan, ::mpfr_tan>(self, max_periodic_arg);
 #else
 	const double x = mpf_get_d(mpf_);
 	if(isinf(x)) {
-		delete this;
-		return new knumber_error(knumber_error::ERROR_POS_INFINITY);
+		self->emplace<knumber_error>(knumber_error::ERROR_POS_INFINITY);
 	} else {
-		return execute_libc_func< ::tan>(x);
+		execute_libc_func< ::tan>(self, x);
 	}
 #endif
 }
@@ -549,53 +1064,43 @@ knumber_base *knumber_float::tan() {
 //------------------------------------------------------------------------------
 // Name:
 //------------------------------------------------------------------------------
-knumber_base *knumber_float::asin() {
+void knumber_float::asin(knumber_base *self) {
+
 	if(mpf_cmp_d(mpf_, 1.0) > 0 || mpf_cmp_d(mpf_, -1.0) < 0) {
-		delete this;
-		return new knumber_error(knumber_error::ERROR_UNDEFINED);
+		self->emplace<knumber_error>(knumber_error::ERROR_UNDEFINED);
+		return;
 	}
 
 #ifdef KNUMBER_USE_MPFR
-	mpfr_t mpfr;
-	mpfr_init_set_f(mpfr, mpf_, rounding_mode);
-	mpfr_asin(mpfr, mpfr, rounding_mode);
-	mpfr_get_f(mpf_, mpfr, rounding_mode);
-	mpfr_clear(mpfr);
-	return this;
+	execute_adaptive_func< ::asin, ::mpfr_asin>(self);
 #else
 	const double x = mpf_get_d(mpf_);
 	if(isinf(x)) {
-		delete this;
-		return new knumber_error(knumber_error::ERROR_POS_INFINITY);
+		self->emplace<knumber_error>(knumber_error::ERROR_POS_INFINITY);
 	} else {
-		return execute_libc_func< ::asin>(x);
+		execute_libc_func< ::asin>(self, x);
 	}
 #endif
 }
 
 //------------------------------------------------------------------------------
 // Name:
-//------------------------------------------------------------------------------s
-knumber_base *knumber_float::acos() {
+//------------------------------------------------------------------------------
+void knumber_float::acos(knumber_base *self) {
+
 	if(mpf_cmp_d(mpf_, 1.0) > 0 || mpf_cmp_d(mpf_, -1.0) < 0) {
-		delete this;
-		return new knumber_error(knumber_error::ERROR_UNDEFINED);
+		self->emplace<knumber_error>(knumber_error::ERROR_UNDEFINED);
+		return;
 	}
 
 #ifdef KNUMBER_USE_MPFR
-	mpfr_t mpfr;
-	mpfr_init_set_f(mpfr, mpf_, rounding_mode);
-	mpfr_acos(mpfr, mpfr, rounding_mode);
-	mpfr_get_f(mpf_, mpfr, rounding_mode);
-	mpfr_clear(mpfr);
-	return this;
+	execute_adaptive_func< ::acos, ::mpfr_acos>(self);
 #else
 	const double x = mpf_get_d(mpf_);
 	if(isinf(x)) {
-		delete this;
-		return new knumber_error(knumber_error::ERROR_POS_INFINITY);
+		self->emplace<knumber_error>(knumber_error::ERROR_POS_INFINITY);
 	} else {
-		return execute_libc_func< ::acos>(x);
+		execute_libc_func< ::acos>(self, x);
 	}
 #endif
 }
@@ -603,22 +1108,16 @@ knumber_base *knumber_float::acos() {
 //------------------------------------------------------------------------------
 // Name:
 //------------------------------------------------------------------------------
-knumber_base *knumber_float::atan() {
+void knumber_float::atan(knumber_base *self) {
 
 #ifdef KNUMBER_USE_MPFR
-	mpfr_t mpfr;
-	mpfr_init_set_f(mpfr, mpf_, rounding_mode);
-	mpfr_atan(mpfr, mpfr, rounding_mode);
-	mpfr_get_f(mpf_, mpfr, rounding_mode);
-	mpfr_clear(mpfr);
-	return this;
+	execute_adaptive_func< ::atan, ::mpfr_atan>(self);
 #else
 	const double x = mpf_get_d(mpf_);
 	if(isinf(x)) {
-		delete this;
-		return new knumber_error(knumber_error::ERROR_POS_INFINITY);
+		self->emplace<knumber_error>(knumber_error::ERROR_POS_INFINITY);
 	} else {
-		return execute_libc_func< ::atan>(x);
+		execute_libc_func< ::atan>(self, x);
 	}
 #endif
 }
@@ -626,213 +1125,219 @@ knumber_base *knumber_float::atan() {
 //------------------------------------------------------------------------------
 // Name:
 //------------------------------------------------------------------------------
-knumber_base *knumber_float::sinh() {
+void knumber_float::sinh(knumber_base *self) {
+
 #ifdef KNUMBER_USE_MPFR
-	mpfr_t mpfr;
-	mpfr_init_set_f(mpfr, mpf_, rounding_mode);
-	mpfr_sinh(mpfr, mpfr, rounding_mode);
-	mpfr_get_f(mpf_, mpfr, rounding_mode);
-	mpfr_clear(mpfr);
-	return this;
+	execute_adaptive_func< ::sinh, ::mpfr_sinh>(self);
 #else
 	const double x = mpf_get_d(mpf_);
-	return execute_libc_func< ::sinh>(x);
+	execute_libc_func< ::sinh>(self, x);
 #endif
-
 }
 
 //------------------------------------------------------------------------------
 // Name:
 //------------------------------------------------------------------------------
-knumber_base *knumber_float::cosh() {
+void knumber_float::cosh(knumber_base *self) {
+
 #ifdef KNUMBER_USE_MPFR
-	mpfr_t mpfr;
-	mpfr_init_set_f(mpfr, mpf_, rounding_mode);
-	mpfr_cosh(mpfr, mpfr, rounding_mode);
-	mpfr_get_f(mpf_, mpfr, rounding_mode);
-	mpfr_clear(mpfr);
-	return this;
+	execute_adaptive_func< ::cosh, ::mpfr_cosh>(self);
 #else
 	const double x = mpf_get_d(mpf_);
-	return execute_libc_func< ::cosh>(x);
+	execute_libc_func< ::cosh>(self, x);
 #endif
 }
 
 //------------------------------------------------------------------------------
 // Name:
 //------------------------------------------------------------------------------
-knumber_base *knumber_float::tanh() {
+void knumber_float::tanh(knumber_base *self) {
+
 #ifdef KNUMBER_USE_MPFR
-	mpfr_t mpfr;
-	mpfr_init_set_f(mpfr, mpf_, rounding_mode);
-	mpfr_tanh(mpfr, mpfr, rounding_mode);
-	mpfr_get_f(mpf_, mpfr, rounding_mode);
-	mpfr_clear(mpfr);
-	return this;
+	execute_adaptive_func< ::tanh, ::mpfr_tanh>(self);
 #else
 	const double x = mpf_get_d(mpf_);
-	return execute_libc_func< ::tanh>(x);
+	execute_libc_func< ::tanh>(self, x);
 #endif
 }
 
 //------------------------------------------------------------------------------
 // Name:
 //------------------------------------------------------------------------------
-knumber_base *knumber_float::tgamma() {
+void knumber_float::tgamma(knumber_base *self) {
 
 #ifdef KNUMBER_USE_MPFR
-	mpfr_t mpfr;
-	mpfr_init_set_f(mpfr, mpf_, rounding_mode);
-	mpfr_gamma(mpfr, mpfr, rounding_mode);
-	mpfr_get_f(mpf_, mpfr, rounding_mode);
-	mpfr_clear(mpfr);
-	return this;
+	execute_mpfr_func< ::mpfr_gamma>(self);
 #else
 	const double x = mpf_get_d(mpf_);
 	if(isinf(x)) {
-		delete this;
-		return new knumber_error(knumber_error::ERROR_POS_INFINITY);
-
+		self->emplace<knumber_error>(knumber_error::ERROR_POS_INFINITY);
 	} else {
-		return execute_libc_func< ::tgamma>(x);
+		execute_libc_func< ::tgamma>(self, x);
 	}
 #endif
-
 }
 
 //------------------------------------------------------------------------------
 // Name:
 //------------------------------------------------------------------------------
-knumber_base *knumber_float::asinh() {
+void knumber_float::asinh(knumber_base *self) {
+
 #ifdef KNUMBER_USE_MPFR
-	mpfr_t mpfr;
-	mpfr_init_set_f(mpfr, mpf_, rounding_mode);
-	mpfr_asinh(mpfr, mpfr, rounding_mode);
-	mpfr_get_f(mpf_, mpfr, rounding_mode);
-	mpfr_clear(mpfr);
-	return this;
+	execute_adaptive_func< ::asinh, ::mpfr_asinh>(self);
 #else
 	const double x = mpf_get_d(mpf_);
-	return execute_libc_func< ::asinh>(x);
+	execute_libc_func< ::asinh>(self, x);
 #endif
 }
 
 //------------------------------------------------------------------------------
 // Name:
 //------------------------------------------------------------------------------
-knumber_base *knumber_float::acosh() {
+void knumber_float::acosh(knumber_base *self) {
+
 #ifdef KNUMBER_USE_MPFR
-	mpfr_t mpfr;
-	mpfr_init_set_f(mpfr, mpf_, rounding_mode);
-	mpfr_acosh(mpfr, mpfr, rounding_mode);
-	mpfr_get_f(mpf_, mpfr, rounding_mode);
-	mpfr_clear(mpfr);
-	return this;
+	execute_adaptive_func< ::acosh, ::mpfr_acosh>(self);
 #else
 	const double x = mpf_get_d(mpf_);
-	return execute_libc_func< ::acosh>(x);
+	execute_libc_func< ::acosh>(self, x);
 #endif
 }
 
 //------------------------------------------------------------------------------
 // Name:
 //------------------------------------------------------------------------------
-knumber_base *knumber_float::atanh() {
+void knumber_float::atanh(knumber_base *self) {
+
 #ifdef KNUMBER_USE_MPFR
-	mpfr_t mpfr;
-	mpfr_init_set_f(mpfr, mpf_, rounding_mode);
-	mpfr_atanh(mpfr, mpfr, rounding_mode);
-	mpfr_get_f(mpf_, mpfr, rounding_mode);
-	mpfr_clear(mpfr);
-	return this;
+	execute_adaptive_func< ::atanh, ::mpfr_atanh>(self);
 #else
 	const double x = mpf_get_d(mpf_);
-	return execute_libc_func< ::atanh>(x);
+	execute_libc_func< ::atanh>(self, x);
 #endif
 }
 
 //------------------------------------------------------------------------------
 // Name:
 //------------------------------------------------------------------------------
-knumber_base *knumber_float::pow(knumber_base *rhs) {
+void knumber_float::pow(knumber_base *self, knumber_integer *rhs) {
 
-	if(knumber_integer *const p = dynamic_cast<knumber_integer *>(rhs)) {
-		mpf_pow_ui(mpf_, mpf_, mpz_get_ui(p->mpz_));
+	// an exponent which doesn't fit is done like a float one, and so is
+	// one whose result the exponent of an mpf_t (a count of limbs in a
+	// long) can't hold
+	if(mpz_sizeinbase(rhs->mpz_, 2) > static_cast<size_t>(std::numeric_limits<unsigned long>::digits)) {
+		knumber_float f(rhs);
+		pow(self, &f);
+		return;
+	}
 
-		if(p->sign() < 0) {
-			return reciprocal();
-		} else {
-			return this;
-		}
-	} else if(knumber_float *const p = dynamic_cast<knumber_float *>(rhs)) {
-		return execute_libc_func< ::pow>(mpf_get_d(mpf_), mpf_get_d(p->mpf_));
-	} else if(knumber_fraction *const p = dynamic_cast<knumber_fraction *>(rhs)) {
-		knumber_float f(p);
-		return execute_libc_func< ::pow>(mpf_get_d(mpf_), mpf_get_d(f.mpf_));
-	} else if(knumber_error *const p = dynamic_cast<knumber_error *>(rhs)) {
-		if(p->sign() > 0) {
-			knumber_error *e = new knumber_error(knumber_error::ERROR_POS_INFINITY);
-			delete this;
-			return e;
-		} else if(p->sign() < 0) {
-			knumber_integer *n = new knumber_integer(0);
-			delete this;
-			return n;
-		} else {
-			knumber_error *e = new knumber_error(knumber_error::ERROR_UNDEFINED);
-			delete this;
-			return e;
+	if(mpf_sgn(mpf_) != 0) {
+		signed long int exp;
+		const double d = mpf_get_d_2exp(&exp, mpf_);
+		const double bits = static_cast<double>(mpz_get_ui(rhs->mpz_)) * (exp + ::log2(::fabs(d)));
+		if(::fabs(bits) > ::ldexp(1.0, 62)) {
+			knumber_float f(rhs);
+			pow(self, &f);
+			return;
 		}
 	}
 
-	Q_ASSERT(0);
-	return 0;
+	mpf_pow_ui(mpf_, mpf_, mpz_get_ui(rhs->mpz_));
+
+	if(rhs->sign() < 0) {
+		reciprocal(self);
+	}
 }
 
 //------------------------------------------------------------------------------
 // Name:
 //------------------------------------------------------------------------------
-int knumber_float::compare(knumber_base *rhs) {
+void knumber_float::pow(knumber_base *self, knumber_float *rhs) {
 
-	if(knumber_integer *const p = dynamic_cast<knumber_integer *>(rhs)) {
-		knumber_float f(p);
-		return compare(&f);
-	} else if(knumber_float *const p = dynamic_cast<knumber_float *>(rhs)) {
-		return mpf_cmp(mpf_, p->mpf_);
-	} else if(knumber_fraction *const p = dynamic_cast<knumber_fraction *>(rhs)) {
-		knumber_float f(p);
-		return compare(&f);
-	} else if(knumber_error *const p = dynamic_cast<knumber_error *>(rhs)) {
-		// NOTE: any number compared to NaN/Inf/-Inf always compares less
-		//       at the moment
-		return -1;
-	}
+#ifdef KNUMBER_USE_MPFR
+	execute_mpfr_func< ::mpfr_pow>(self, rhs->mpf_);
+#else
+	execute_libc_func< ::pow>(self, mpf_get_d(mpf_), mpf_get_d(rhs->mpf_));
+#endif
+}
+
+//------------------------------------------------------------------------------
+// Name:
+//------------------------------------------------------------------------------
+void knumber_float::pow(knumber_base *self, knumber_fraction *rhs) {
 
-	Q_ASSERT(0);
-	return 0;
+	knumber_float f(rhs);
+#ifdef KNUMBER_USE_MPFR
+	execute_mpfr_func< ::mpfr_pow>(self, f.mpf_);
+#else
+	execute_libc_func< ::pow>(self, mpf_get_d(mpf_), mpf_get_d(f.mpf_));
+#endif
 }
 
 //------------------------------------------------------------------------------
 // Name:
 //------------------------------------------------------------------------------
-QString knumber_float::toString(int precision) const {
+void knumber_float::pow(knumber_base *self, knumber_error *rhs) {
 
-	size_t size;
-	if (precision > 0) {
-		size = gmp_snprintf(NULL, 0, "%.*Fg", precision, mpf_) + 1;
+	if(rhs->sign() > 0) {
+		self->emplace<knumber_error>(knumber_error::ERROR_POS_INFINITY);
+	} else if(rhs->sign() < 0) {
+		self->emplace<knumber_integer>(0);
 	} else {
-		size = gmp_snprintf(NULL, 0, "%.Fg", mpf_) + 1;
+		self->emplace<knumber_error>(knumber_error::ERROR_UNDEFINED);
 	}
+}
 
-	QScopedArrayPointer<char> buf(new char[size]);
+//------------------------------------------------------------------------------
+// Name:
+//------------------------------------------------------------------------------
+int knumber_float::compare(knumber_integer *rhs) {
 
-	if (precision > 0) {
-		gmp_snprintf(&buf[0], size, "%.*Fg", precision, mpf_);
-	} else {
-		gmp_snprintf(&buf[0], size, "%.Fg", mpf_);
+	return mpf_cmp_z(mpf_, rhs->mpz_);
+}
+
+//------------------------------------------------------------------------------
+// Name:
+//------------------------------------------------------------------------------
+int knumber_float::compare(knumber_float *rhs) {
+
+	return mpf_cmp(mpf_, rhs->mpf_);
+}
+
+//------------------------------------------------------------------------------
+// Name:
+//------------------------------------------------------------------------------
+int knumber_float::compare(knumber_fraction *rhs) {
+
+	// x against n/d as x * d against n, x * d is exact with two more limbs
+	if(fits_ulong_abs(mpq_denref(rhs->mpq_))) {
+		mpf_t scaled;
+		mpf_init2(scaled, mpf_get_prec(mpf_) + 2 * GMP_NUMB_BITS);
+		mpf_mul_ui(scaled, mpf_, mpz_get_ui(mpq_denref(rhs->mpq_)));
+		const int r = mpf_cmp_z(scaled, mpq_numref(rhs->mpq_));
+		mpf_clear(scaled);
+		return r;
 	}
 
-	return QLatin1String(&buf[0]);
+	knumber_float f(rhs);
+	return compare(&f);
+}
+
+//------------------------------------------------------------------------------
+// Name:
+//------------------------------------------------------------------------------
+int knumber_float::compare(knumber_error *) {
+
+	// NOTE: any number compared to NaN/Inf/-Inf always compares less
+	//       at the moment
+	return -1;
+}
+
+//------------------------------------------------------------------------------
+// Name:
+//------------------------------------------------------------------------------
+QString knumber_float::toString(int precision) const {
+	return knumber_formatter::format_float(mpf_, precision, -1);
 }
 
 //------------------------------------------------------------------------------
@@ -862,32 +1367,28 @@ int knumber_float::sign() const {
 //------------------------------------------------------------------------------
 // Name:
 //------------------------------------------------------------------------------
-knumber_base *knumber_float::reciprocal() {
+void knumber_float::reciprocal(knumber_base *) {
 
 	mpf_t mpf;
-	mpf_init_set_d(mpf, 1.0);
+	mpf_init2(mpf, context_precision());
+	mpf_set_ui(mpf, 1);
 	mpf_div(mpf_, mpf, mpf_);
-	return this;
+	mpf_clear(mpf);
 }
 
 //------------------------------------------------------------------------------
 // Name:
 //------------------------------------------------------------------------------
-knumber_base *knumber_float::log2() {
+void knumber_float::log2(knumber_base *self) {
+
 #ifdef KNUMBER_USE_MPFR
-	mpfr_t mpfr;
-	mpfr_init_set_f(mpfr, mpf_, rounding_mode);
-	mpfr_log2(mpfr, mpfr, rounding_mode);
-	mpfr_get_f(mpf_, mpfr, rounding_mode);
-	mpfr_clear(mpfr);
-	return this;
+	execute_adaptive_func< ::log2, ::mpfr_log2>(self);
 #else
 	const double x = mpf_get_d(mpf_);
 	if(isinf(x)) {
-		delete this;
-		return new knumber_error(knumber_error::ERROR_POS_INFINITY);
+		self->emplace<knumber_error>(knumber_error::ERROR_POS_INFINITY);
 	} else {
-		return execute_libc_func< ::log2>(x);
+		execute_libc_func< ::log2>(self, x);
 	}
 #endif
 }
@@ -895,21 +1396,16 @@ knumber_base *knumber_float::log2() {
 //------------------------------------------------------------------------------
 // Name:
 //------------------------------------------------------------------------------
-knumber_base *knumber_float::log10() {
+void knumber_float::log10(knumber_base *self) {
+
 #ifdef KNUMBER_USE_MPFR
-	mpfr_t mpfr;
-	mpfr_init_set_f(mpfr, mpf_, rounding_mode);
-	mpfr_log10(mpfr, mpfr, rounding_mode);
-	mpfr_get_f(mpf_, mpfr, rounding_mode);
-	mpfr_clear(mpfr);
-	return this;
+	execute_adaptive_func< ::log10, ::mpfr_log10>(self);
 #else
 	const double x = mpf_get_d(mpf_);
 	if(isinf(x)) {
-		delete this;
-		return new knumber_error(knumber_error::ERROR_POS_INFINITY);
+		self->emplace<knumber_error>(knumber_error::ERROR_POS_INFINITY);
 	} else {
-		return execute_libc_func< ::log10>(x);
+		execute_libc_func< ::log10>(self, x);
 	}
 #endif
 }
@@ -917,21 +1413,16 @@ knumber_base *knumber_float::log10() {
 //------------------------------------------------------------------------------
 // Name:
 //------------------------------------------------------------------------------
-knumber_base *knumber_float::ln() {
+void knumber_float::ln(knumber_base *self) {
+
 #ifdef KNUMBER_USE_MPFR
-	mpfr_t mpfr;
-	mpfr_init_set_f(mpfr, mpf_, rounding_mode);
-	mpfr_log(mpfr, mpfr, rounding_mode);
-	mpfr_get_f(mpf_, mpfr, rounding_mode);
-	mpfr_clear(mpfr);
-	return this;
+	execute_adaptive_func< ::log, ::mpfr_log>(self);
 #else
 	const double x = mpf_get_d(mpf_);
 	if(isinf(x)) {
-		delete this;
-		return new knumber_error(knumber_error::ERROR_POS_INFINITY);
+		self->emplace<knumber_error>(knumber_error::ERROR_POS_INFINITY);
 	} else {
-		return execute_libc_func< ::log>(x);
+		execute_libc_func< ::log>(self, x);
 	}
 #endif
 }
@@ -939,21 +1430,16 @@ knumber_base *knumber_float::ln() {
 //------------------------------------------------------------------------------
 // Name:
 //------------------------------------------------------------------------------
-knumber_base *knumber_float::exp2() {
+void knumber_float::exp2(knumber_base *self) {
+
 #ifdef KNUMBER_USE_MPFR
-	mpfr_t mpfr;
-	mpfr_init_set_f(mpfr, mpf_, rounding_mode);
-	mpfr_exp2(mpfr, mpfr, rounding_mode);
-	mpfr_get_f(mpf_, mpfr, rounding_mode);
-	mpfr_clear(mpfr);
-	return this;
+	execute_adaptive_func< ::exp2, ::mpfr_exp2>(self);
 #else
 	const double x = mpf_get_d(mpf_);
 	if(isinf(x)) {
-		delete this;
-		return new knumber_error(knumber_error::ERROR_POS_INFINITY);
+		self->emplace<knumber_error>(knumber_error::ERROR_POS_INFINITY);
 	} else {
-		return execute_libc_func< ::exp2>(x);
+		execute_libc_func< ::exp2>(self, x);
 	}
 #endif
 }
@@ -961,21 +1447,16 @@ knumber_base *knumber_float::exp2() {
 //------------------------------------------------------------------------------
 // Name:
 //------------------------------------------------------------------------------
-knumber_base *knumber_float::exp10() {
+void knumber_float::exp10(knumber_base *self) {
+
 #ifdef KNUMBER_USE_MPFR
-	mpfr_t mpfr;
-	mpfr_init_set_f(mpfr, mpf_, rounding_mode);
-	mpfr_exp10(mpfr, mpfr, rounding_mode);
-	mpfr_get_f(mpf_, mpfr, rounding_mode);
-	mpfr_clear(mpfr);
-	return this;
+	execute_adaptive_func<libc_exp10, ::mpfr_exp10>(self);
 #else
 	const double x = mpf_get_d(mpf_);
 	if(isinf(x)) {
-		delete this;
-		return new knumber_error(knumber_error::ERROR_POS_INFINITY);
+		self->emplace<knumber_error>(knumber_error::ERROR_POS_INFINITY);
 	} else {
-		return execute_libc_func< ::pow>(10, x);
+		execute_libc_func< ::pow>(self, 10, x);
 	}
 #endif
 }
@@ -983,21 +1464,16 @@ knumber_base *knumber_float::exp10() {
 //------------------------------------------------------------------------------
 // Name:
 //------------------------------------------------------------------------------
-knumber_base *knumber_float::exp() {
+void knumber_float::exp(knumber_base *self) {
+
 #ifdef KNUMBER_USE_MPFR
-	mpfr_t mpfr;
-	mpfr_init_set_f(mpfr, mpf_, rounding_mode);
-	mpfr_exp(mpfr, mpfr, rounding_mode);
-	mpfr_get_f(mpf_, mpfr, rounding_mode);
-	mpfr_clear(mpfr);
-	return this;
+	execute_adaptive_func< ::exp, ::mpfr_exp>(self);
 #else
 	const double x = mpf_get_d(mpf_);
 	if(isinf(x)) {
-		delete this;
-		return new knumber_error(knumber_error::ERROR_POS_INFINITY);
+		self->emplace<knumber_error>(knumber_error::ERROR_POS_INFINITY);
 	} else {
-		return execute_libc_func< ::exp>(x);
+		execute_libc_func< ::exp>(self, x);
 	}
 #endif
 }
@@ -1019,10 +1495,33 @@ qint64 knumber_float::toInt64() const {
 //------------------------------------------------------------------------------
 // Name:
 //------------------------------------------------------------------------------
-knumber_base *knumber_float::bin(knumber_base *rhs) {
-	Q_UNUSED(rhs);
-	delete this;
-	return new knumber_error(knumber_error::ERROR_UNDEFINED);
+void knumber_float::bin(knumber_base *self, knumber_integer *) {
+
+	self->emplace<knumber_error>(knumber_error::ERROR_UNDEFINED);
+}
+
+//------------------------------------------------------------------------------
+// Name:
+//------------------------------------------------------------------------------
+void knumber_float::bin(knumber_base *self, knumber_float *) {
+
+	self->emplace<knumber_error>(knumber_error::ERROR_UNDEFINED);
+}
+
+//------------------------------------------------------------------------------
+// Name:
+//------------------------------------------------------------------------------
+void knumber_float::bin(knumber_base *self, knumber_fraction *) {
+
+	self->emplace<knumber_error>(knumber_error::ERROR_UNDEFINED);
+}
+
+//------------------------------------------------------------------------------
+// Name:
+//------------------------------------------------------------------------------
+void knumber_float::bin(knumber_base *self, knumber_error *) {
+
+	self->emplace<knumber_error>(knumber_error::ERROR_UNDEFINED);
 }
 
 }
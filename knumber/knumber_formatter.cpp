@@ -0,0 +1,478 @@
+/*
+Copyright (C) 2001 - 2013 Evan Teran
+                          evan.teran@gmail.com
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <config-kcalc.h>
+#include "knumber_formatter.h"
+#include <climits>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+namespace detail {
+
+namespace {
+
+//------------------------------------------------------------------------------
+// Name: format_buffer
+// Desc: only ever grows, so after the first few numbers no more allocations
+//       are needed
+//------------------------------------------------------------------------------
+struct format_buffer {
+	format_buffer() : data(0), capacity(0) {
+	}
+
+	~format_buffer() {
+		std::free(data);
+	}
+
+	char *reserve(std::size_t size) {
+		if(size > capacity) {
+			char *const p = static_cast<char *>(std::realloc(data, size));
+			if(!p) {
+				qFatal("knumber: out of memory allocating %lu bytes", static_cast<unsigned long>(size));
+			}
+			data     = p;
+			capacity = size;
+		}
+		return data;
+	}
+
+	char        *data;
+	std::size_t capacity;
+};
+
+thread_local format_buffer buffer;
+
+//------------------------------------------------------------------------------
+// Name: format_integers
+// Desc: the integers the digits of a float are worked out in, kept like the
+//       buffer so they only allocate while growing
+//------------------------------------------------------------------------------
+struct format_integers {
+	format_integers() {
+		mpz_init(n);
+		mpz_init(divisor);
+		mpz_init(remainder);
+	}
+
+	~format_integers() {
+		mpz_clear(n);
+		mpz_clear(divisor);
+		mpz_clear(remainder);
+	}
+
+	mpz_t n;
+	mpz_t divisor;
+	mpz_t remainder;
+};
+
+thread_local format_integers integers;
+
+// the powers of ten which fit in an unsigned long
+const unsigned long small_powers_of_ten[] = {
+	1ul, 10ul, 100ul, 1000ul, 10000ul, 100000ul, 1000000ul, 10000000ul, 100000000ul, 1000000000ul
+#if ULONG_MAX > 0xfffffffful
+	, 10000000000ul, 100000000000ul, 1000000000000ul, 10000000000000ul, 100000000000000ul,
+	1000000000000000ul, 10000000000000000ul, 100000000000000000ul, 1000000000000000000ul, 10000000000000000000ul
+#endif
+};
+
+const long max_small_power = sizeof(small_powers_of_ten) / sizeof(small_powers_of_ten[0]) - 1;
+
+// room for an 'e', a sign and the digits of any mp_exp_t
+const std::size_t max_exponent_size = 24;
+
+// the exact digits of a float need integers with about 3.3 bits for each
+// step of the decimal exponent, past this the digits come from mpf_get_str
+const long max_exact_exponent = 20000;
+
+//------------------------------------------------------------------------------
+// Name: write_unsigned
+// Desc: writes the decimal digits of value to p, at least min_digits of them,
+//       returns the end of what was written
+//------------------------------------------------------------------------------
+char *write_unsigned(char *p, quint64 value, int min_digits) {
+
+	char digits[24];
+	int n = 0;
+	do {
+		digits[n++] = static_cast<char>('0' + value % 10);
+		value /= 10;
+	} while(value != 0 || n < min_digits);
+
+	while(n != 0) {
+		*p++ = digits[--n];
+	}
+
+	return p;
+}
+
+//------------------------------------------------------------------------------
+// Name: finish
+// Desc: pads a number without decimals with zeros to that many of them, s
+//       needs room for decimals + 1 more characters
+//------------------------------------------------------------------------------
+QString finish(char *s, int length, int decimals) {
+
+	if(decimals > 0) {
+		s[length++] = '.';
+		std::memset(s + length, '0', decimals);
+		length += decimals;
+	}
+
+	return QString::fromLatin1(s, length);
+}
+
+//------------------------------------------------------------------------------
+// Name: round_scaled
+// Desc: n = |mpf| * 10^decimals rounded to an integer, halfway cases away from
+//       zero. an mpf is an integer times a power of two, so this is exact
+//------------------------------------------------------------------------------
+void round_scaled(mpz_t n, const mpf_t mpf, long decimals) {
+
+	const mp_size_t size = (mpf->_mp_size < 0) ? -mpf->_mp_size : mpf->_mp_size;
+
+	// the value is m * 2^shift
+	mpz_t m;
+	mpz_roinit_n(m, mpf->_mp_d, size);
+	const long shift = static_cast<long>(mpf->_mp_exp - size) * GMP_NUMB_BITS;
+
+	if(decimals >= 0) {
+		if(decimals <= max_small_power) {
+			mpz_mul_ui(n, m, small_powers_of_ten[decimals]);
+		} else {
+			mpz_ui_pow_ui(n, 10, decimals);
+			mpz_mul(n, n, m);
+		}
+
+		if(shift >= 0) {
+			mpz_mul_2exp(n, n, shift);
+		} else {
+			// only a power of two to divide by, the bit below the point decides
+			const int round_up = mpz_tstbit(n, -shift - 1);
+			mpz_fdiv_q_2exp(n, n, -shift);
+			mpz_add_ui(n, n, round_up);
+		}
+		return;
+	}
+
+	const mpz_ptr divisor   = integers.divisor;
+	const mpz_ptr remainder = integers.remainder;
+
+	if(-decimals <= max_small_power) {
+		mpz_set_ui(divisor, small_powers_of_ten[-decimals]);
+	} else {
+		mpz_ui_pow_ui(divisor, 10, -decimals);
+	}
+
+	if(shift >= 0) {
+		mpz_mul_2exp(n, m, shift);
+	} else {
+		mpz_set(n, m);
+		mpz_mul_2exp(divisor, divisor, -shift);
+	}
+
+	mpz_fdiv_qr(n, remainder, n, divisor);
+	mpz_mul_2exp(remainder, remainder, 1);
+	if(mpz_cmp(remainder, divisor) >= 0) {
+		mpz_add_ui(n, n, 1);
+	}
+}
+
+//------------------------------------------------------------------------------
+// Name: decimal_exponent
+// Desc: the exponent of the first decimal digit of mpf, which can be one off
+//------------------------------------------------------------------------------
+long decimal_exponent(const mpf_t mpf) {
+	signed long int binary_exponent;
+	const double d = mpf_get_d_2exp(&binary_exponent, mpf);
+	return static_cast<long>(std::floor(std::log10(std::fabs(d)) + binary_exponent * 0.30102999566398119521));
+}
+
+//------------------------------------------------------------------------------
+// Name: digit_count
+// Desc: how many significant digits format_float shows of a number with this
+//       decimal exponent, at most n_digits
+//------------------------------------------------------------------------------
+int digit_count(long x, int n_digits, int significant, int decimals) {
+
+	if(decimals < 0) {
+		return n_digits;
+	}
+
+	const long wanted = (x < -4 || x >= significant) ? decimals + 1 : x + 1 + decimals;
+	return (wanted > 0 && wanted < n_digits) ? static_cast<int>(wanted) : n_digits;
+}
+
+//------------------------------------------------------------------------------
+// Name: is_power_of_ten
+//------------------------------------------------------------------------------
+bool is_power_of_ten(const char *digits, int count) {
+	return digits[0] == '1' && std::strspn(digits + 1, "0") == static_cast<std::size_t>(count - 1);
+}
+
+//------------------------------------------------------------------------------
+// Name: generate_digits
+// Desc: writes the first count significant digits of |mpf| to s, rounded
+//       halfway away from zero, and returns the decimal exponent of the first
+//       one. x is where to start looking for that exponent. a number which
+//       rounds up to a power of ten gets its exponent. s needs room for
+//       count + 2 characters
+//------------------------------------------------------------------------------
+long generate_digits(char *s, const mpf_t mpf, int count, long x) {
+
+	if(x > max_exact_exponent || x < -max_exact_exponent) {
+		mp_exp_t exponent;
+		mpf_get_str(s, &exponent, 10, count, mpf);
+		const int offset = (*s == '-') ? 1 : 0;
+		const int length = static_cast<int>(std::strlen(s + offset));
+		std::memmove(s, s + offset, length);
+		std::memset(s + length, '0', count - length);
+		return static_cast<long>(exponent) - 1;
+	}
+
+	const mpz_ptr n = integers.n;
+
+	// more or fewer than count digits means the exponent was off, unless the
+	// digits rounded up to 10^count
+	for(;;) {
+		round_scaled(n, mpf, count - 1 - x);
+
+		// mpz_sizeinbase can be one too big
+		const std::size_t size = mpz_sizeinbase(n, 10);
+		if(size > static_cast<std::size_t>(count) + 1) {
+			++x;
+			continue;
+		}
+
+		mpz_get_str(s, 10, n);
+		const std::size_t length = std::strlen(s);
+		if(length < static_cast<std::size_t>(count)) {
+			--x;
+		} else if(length == static_cast<std::size_t>(count)) {
+			break;
+		} else if(s[0] == '1' && std::strspn(s + 1, "0") == length - 1) {
+			s[count] = '\0';
+			++x;
+			break;
+		} else {
+			++x;
+		}
+	}
+
+	return x;
+}
+
+}
+
+//------------------------------------------------------------------------------
+// Name: format_integer
+//------------------------------------------------------------------------------
+QString knumber_formatter::format_integer(qint64 value, int decimals) {
+
+	char *const s = buffer.reserve(max_exponent_size + qMax(decimals, 0) + 2);
+	char *p = s;
+
+	if(value < 0) {
+		*p++ = '-';
+	}
+
+	// negated as unsigned, so the most negative value works too
+	p = write_unsigned(p, (value < 0) ? -static_cast<quint64>(value) : static_cast<quint64>(value), 1);
+	return finish(s, static_cast<int>(p - s), decimals);
+}
+
+//------------------------------------------------------------------------------
+// Name: format_integer
+//------------------------------------------------------------------------------
+QString knumber_formatter::format_integer(const mpz_t mpz, int decimals) {
+
+	char *const s = buffer.reserve(mpz_sizeinbase(mpz, 10) + qMax(decimals, 0) + 4);
+	mpz_get_str(s, 10, mpz);
+	return finish(s, static_cast<int>(std::strlen(s)), decimals);
+}
+
+//------------------------------------------------------------------------------
+// Name: format_float
+// Desc: the digits are worked out from the exact value of the float and
+//       rounded once, to whichever of the precision and the decimals asked
+//       for ends first. they are laid out the way "%g" does it
+//------------------------------------------------------------------------------
+QString knumber_formatter::format_float(const mpf_t mpf, int precision, int decimals) {
+
+	// like mpf_get_str, no more digits than the precision of the number holds
+	const int max_digits  = static_cast<int>(mpf_get_prec(mpf) * 30103 / 100000) + 2;
+	const int n_digits    = (precision > 0 && precision < max_digits) ? precision : max_digits;
+	const int significant = (precision > 0) ? precision : static_cast<int>(mpf_get_prec(mpf) * 30103 / 100000) + 1;
+
+	// the digits go at the start of the buffer, the result right after them.
+	// the most the result needs is a sign, the digits, "0.0000" or enough
+	// zeros to reach the decimal point, an exponent and the decimals
+	const int digits_size = n_digits + 2;
+	const std::size_t result_size = digits_size + 8 + significant + max_exponent_size + qMax(decimals, 0) + 2;
+	char *const digits = buffer.reserve(digits_size + result_size);
+	char *const result = digits + digits_size;
+	char *p = result;
+
+	if(mpf_sgn(mpf) == 0) {
+		*p++ = '0';
+		return finish(result, 1, decimals);
+	}
+
+	// with decimals asked for the digits are rounded once, to whichever of
+	// the precision and the decimals ends first. which one that is depends
+	// on the exponent, so this goes by an estimate of it and checks after
+	long x = decimal_exponent(mpf);
+	int count = digit_count(x, n_digits, significant, decimals);
+	x = generate_digits(digits, mpf, count, x);
+
+	// the exponent of all n_digits decides the notation. fewer digits only
+	// have another one if they rounded up to a power of ten
+	long exponent = x;
+	if(count != digit_count(x, n_digits, significant, decimals) || (count < n_digits && is_power_of_ten(digits, count))) {
+		exponent = generate_digits(digits, mpf, n_digits, x);
+		count    = digit_count(exponent, n_digits, significant, decimals);
+		x        = (count < n_digits) ? generate_digits(digits, mpf, count, exponent) : exponent;
+	}
+
+	const bool scientific = (exponent < -4 || exponent >= significant);
+
+	if(decimals >= 0) {
+		if(!scientific && x + 1 + decimals <= 0) {
+			// the first digit is past the last decimal, it is 1 there or 0
+			round_scaled(integers.n, mpf, decimals);
+			if(mpz_sgn(integers.n) == 0) {
+				*p++ = '0';
+				return finish(result, 1, decimals);
+			}
+
+			count     = 1;
+			digits[0] = '1';
+			x         = -decimals;
+		}
+	} else {
+		while(count > 1 && digits[count - 1] == '0') {
+			--count;
+		}
+	}
+
+	if(mpf_sgn(mpf) < 0) {
+		*p++ = '-';
+	}
+
+	// the number of decimals the digits give
+	long shown;
+
+	if(scientific) {
+		*p++ = digits[0];
+		if(count > 1) {
+			*p++ = '.';
+			std::memcpy(p, digits + 1, count - 1);
+			p += count - 1;
+		}
+		shown = count - 1;
+	} else if(x < 0) {
+		*p++ = '0';
+		*p++ = '.';
+		for(long i = x + 1; i < 0; ++i) {
+			*p++ = '0';
+		}
+		std::memcpy(p, digits, count);
+		p += count;
+		shown = count - x - 1;
+	} else if(x + 1 < count) {
+		std::memcpy(p, digits, x + 1);
+		p += x + 1;
+		*p++ = '.';
+		std::memcpy(p, digits + x + 1, count - x - 1);
+		p += count - x - 1;
+		shown = count - x - 1;
+	} else {
+		std::memcpy(p, digits, count);
+		p += count;
+		for(long i = count; i <= x; ++i) {
+			*p++ = '0';
+		}
+		shown = 0;
+	}
+
+	if(decimals > shown) {
+		if(shown == 0) {
+			*p++ = '.';
+		}
+		std::memset(p, '0', decimals - shown);
+		p += decimals - shown;
+	}
+
+	if(scientific) {
+		*p++ = 'e';
+		*p++ = (x < 0) ? '-' : '+';
+		p = write_unsigned(p, (x < 0) ? -static_cast<quint64>(x) : static_cast<quint64>(x), 2);
+	}
+
+	return QString::fromLatin1(result, static_cast<int>(p - result));
+}
+
+//------------------------------------------------------------------------------
+// Name: format_fraction
+//------------------------------------------------------------------------------
+QString knumber_formatter::format_fraction(const mpq_t mpq, bool split_off_integer) {
+
+	const mpz_srcptr num = mpq_numref(mpq);
+	const mpz_srcptr den = mpq_denref(mpq);
+
+	char *s;
+	char *p;
+
+	if(split_off_integer && mpz_cmpabs(num, den) >= 0) {
+
+		mpz_t integer_part;
+		mpz_t remainder;
+		mpz_init(integer_part);
+		mpz_init(remainder);
+
+		mpz_tdiv_qr(integer_part, remainder, num, den);
+		mpz_abs(remainder, remainder);
+
+		s = buffer.reserve(mpz_sizeinbase(integer_part, 10) + mpz_sizeinbase(remainder, 10) + mpz_sizeinbase(den, 10) + 8);
+		p = s;
+
+		mpz_get_str(p, 10, integer_part);
+		p += std::strlen(p);
+		*p++ = ' ';
+		mpz_get_str(p, 10, remainder);
+		p += std::strlen(p);
+
+		mpz_clear(integer_part);
+		mpz_clear(remainder);
+	} else {
+		s = buffer.reserve(mpz_sizeinbase(num, 10) + mpz_sizeinbase(den, 10) + 8);
+		p = s;
+
+		mpz_get_str(p, 10, num);
+		p += std::strlen(p);
+	}
+
+	*p++ = '/';
+	mpz_get_str(p, 10, den);
+	p += std::strlen(p);
+
+	return QString::fromLatin1(s, static_cast<int>(p - s));
+}
+
+}
@@ -0,0 +1,51 @@
+/*
+Copyright (C) 2001 - 2013 Evan Teran
+                          evan.teran@gmail.com
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef KNUMBER_FORMATTER_H_
+#define KNUMBER_FORMATTER_H_
+
+// Workaround: include before gmp.h to fix build with gcc-4.9
+#include <cstddef>
+#include <gmp.h>
+#include <QString>
+
+namespace detail {
+
+// Turns the GMP types into text. The digits are written once into a buffer
+// which every thread keeps around for the next call, and the QString is made
+// from that in a single allocation.
+//
+// Float digits are worked out exactly from the mantissa and rounded once,
+// halfway away from zero, so the last digit shown is always correct.
+// decimals >= 0 rounds to that many digits after the decimal point (of the
+// mantissa when there is an exponent), padding with zeros where needed.
+class knumber_formatter {
+public:
+	static QString format_integer(qint64 value, int decimals);
+	static QString format_integer(const mpz_t mpz, int decimals);
+
+	// like "%.*Fg", a precision <= 0 gives all significant digits
+	static QString format_float(const mpf_t mpf, int precision, int decimals);
+
+	// "n/d", or "i n/d" with the integer part split off
+	static QString format_fraction(const mpq_t mpq, bool split_off_integer);
+};
+
+}
+
+#endif
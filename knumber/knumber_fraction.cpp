@@ -17,71 +17,145 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
 #include <config-kcalc.h>
-#include "knumber_integer.h"
-#include "knumber_float.h"
-#include "knumber_fraction.h"
-#include "knumber_error.h"
-#include <QScopedArrayPointer>
+#include "knumber_context.h"
+#include "knumber_base.h"
+#include "knumber_formatter.h"
+#include "knumber_allocator.h"
 #include <QDebug>
+#include <limits>
 
 namespace detail {
 
-bool knumber_fraction::default_fractional_input              = false;
-bool knumber_fraction::default_fractional_output             = true;
-bool knumber_fraction::split_off_integer_for_fraction_output = false;
+std::atomic<bool>        knumber_fraction::lazy_reduction(false);
+std::atomic<std::size_t> knumber_fraction::limb_budget(0);
+std::atomic<bool>        knumber_fraction::limb_budget_error(false);
+
+namespace {
 
 //------------------------------------------------------------------------------
-// Name:
+// Name: add_unreduced
+// Desc: r += q, or r -= q if negate is set, leaving out the GCD of mpq_add
+//------------------------------------------------------------------------------
+void add_unreduced(mpq_ptr r, mpq_srcptr q, bool negate) {
+
+	if(mpz_cmp(mpq_denref(r), mpq_denref(q)) == 0) {
+		if(negate) {
+			mpz_sub(mpq_numref(r), mpq_numref(r), mpq_numref(q));
+		} else {
+			mpz_add(mpq_numref(r), mpq_numref(r), mpq_numref(q));
+		}
+		return;
+	}
+
+	mpz_mul(mpq_numref(r), mpq_numref(r), mpq_denref(q));
+	if(negate) {
+		mpz_submul(mpq_numref(r), mpq_numref(q), mpq_denref(r));
+	} else {
+		mpz_addmul(mpq_numref(r), mpq_numref(q), mpq_denref(r));
+	}
+	mpz_mul(mpq_denref(r), mpq_denref(r), mpq_denref(q));
+}
+
+//------------------------------------------------------------------------------
+// Name: mul_unreduced
+//------------------------------------------------------------------------------
+void mul_unreduced(mpq_ptr r, mpq_srcptr q) {
+	mpz_mul(mpq_numref(r), mpq_numref(r), mpq_numref(q));
+	mpz_mul(mpq_denref(r), mpq_denref(r), mpq_denref(q));
+}
+
+//------------------------------------------------------------------------------
+// Name: div_unreduced
+// Desc: q must not be zero
 //------------------------------------------------------------------------------
-void knumber_fraction::set_default_fractional_input(bool value) {
-	default_fractional_input = value;
+void div_unreduced(mpq_ptr r, mpq_srcptr q) {
+
+	if(r == q) {
+		mpq_set_ui(r, 1, 1);
+		return;
+	}
+
+	mpz_mul(mpq_numref(r), mpq_numref(r), mpq_denref(q));
+	mpz_mul(mpq_denref(r), mpq_denref(r), mpq_numref(q));
+
+	if(mpz_sgn(mpq_denref(r)) < 0) {
+		mpz_neg(mpq_numref(r), mpq_numref(r));
+		mpz_neg(mpq_denref(r), mpq_denref(r));
+	}
+}
+
+//------------------------------------------------------------------------------
+// Name: compare_unreduced
+// Desc: mpq_cmp, for fractions which need not be in lowest terms
+//------------------------------------------------------------------------------
+int compare_unreduced(mpq_srcptr a, mpq_srcptr b) {
+
+	const int sa = mpq_sgn(a);
+	const int sb = mpq_sgn(b);
+	if(sa != sb) {
+		return (sa < sb) ? -1 : 1;
+	}
+
+	mpz_t lhs;
+	mpz_t rhs;
+	mpz_init(lhs);
+	mpz_init(rhs);
+	mpz_mul(lhs, mpq_numref(a), mpq_denref(b));
+	mpz_mul(rhs, mpq_numref(b), mpq_denref(a));
+	const int r = mpz_cmp(lhs, rhs);
+	mpz_clear(lhs);
+	mpz_clear(rhs);
+	return r;
+}
+
 }
 
 //------------------------------------------------------------------------------
 // Name:
 //------------------------------------------------------------------------------
-void knumber_fraction::set_default_fractional_output(bool value) {
-	default_fractional_output = value;
+void knumber_fraction::set_lazy_reduction(bool value) {
+	lazy_reduction.store(value, std::memory_order_relaxed);
 }
 
 //------------------------------------------------------------------------------
 // Name:
 //------------------------------------------------------------------------------
-void knumber_fraction::set_split_off_integer_for_fraction_output(bool value) {
-	split_off_integer_for_fraction_output = value;
+void knumber_fraction::set_limb_budget(std::size_t limbs, bool error) {
+	limb_budget.store(limbs, std::memory_order_relaxed);
+	limb_budget_error.store(error, std::memory_order_relaxed);
 }
 
 //------------------------------------------------------------------------------
 // Name:
 //------------------------------------------------------------------------------
-knumber_fraction::knumber_fraction(const QString &s) {
+knumber_fraction::knumber_fraction(const QString &s) : reduced_(false), reduced_limbs_(0) {
 	mpq_init(mpq_);
 	mpq_set_str(mpq_, s.toAscii(), 10);
-	mpq_canonicalize(mpq_);
+	reduce();
 }
 
 //------------------------------------------------------------------------------
 // Name:
 //------------------------------------------------------------------------------
-knumber_fraction::knumber_fraction(qint64 num, quint64 den) {
+knumber_fraction::knumber_fraction(qint64 num, quint64 den) : reduced_(false), reduced_limbs_(0) {
 	mpq_init(mpq_);
 	mpq_set_si(mpq_, num, den);
-	mpq_canonicalize(mpq_);
+	reduce_lazily();
 }
 
 //------------------------------------------------------------------------------
 // Name:
 //------------------------------------------------------------------------------
-knumber_fraction::knumber_fraction(quint64 num, quint64 den) {
+knumber_fraction::knumber_fraction(quint64 num, quint64 den) : reduced_(false), reduced_limbs_(0) {
 	mpq_init(mpq_);
 	mpq_set_ui(mpq_, num, den);
-	mpq_canonicalize(mpq_);
+	reduce_lazily();
 }
 
 //------------------------------------------------------------------------------
 // Name:
 //------------------------------------------------------------------------------
-knumber_fraction::knumber_fraction(mpq_t mpq) {
+knumber_fraction::knumber_fraction(mpq_t mpq) : reduced_(true), reduced_limbs_(mpz_size(mpq_denref(mpq))) {
 	mpq_init(mpq_);
 	mpq_set(mpq_, mpq);
 }
@@ -89,7 +163,7 @@ knumber_fraction::knumber_fraction(mpq_t mpq) {
 //------------------------------------------------------------------------------
 // Name:
 //------------------------------------------------------------------------------
-knumber_fraction::knumber_fraction(const knumber_fraction *value) {
+knumber_fraction::knumber_fraction(const knumber_fraction *value) : reduced_(value->reduced_), reduced_limbs_(value->reduced_limbs_) {
 	mpq_init(mpq_);
 	mpq_set(mpq_, value->mpq_);
 }
@@ -97,11 +171,91 @@ knumber_fraction::knumber_fraction(const knumber_fraction *value) {
 //------------------------------------------------------------------------------
 // Name:
 //------------------------------------------------------------------------------
-knumber_fraction::knumber_fraction(const knumber_integer *value) {
+knumber_fraction::knumber_fraction(const knumber_integer *value) : reduced_(true), reduced_limbs_(1) {
+	KNUMBER_COUNT(INTEGER_TO_FRACTION);
 	mpq_init(mpq_);
 	mpq_set_z(mpq_, value->mpz_);
 }
 
+//------------------------------------------------------------------------------
+// Name: reduce
+// Desc: brings the fraction to lowest terms
+//------------------------------------------------------------------------------
+void knumber_fraction::reduce() {
+	KNUMBER_COUNT(CANONICALIZATIONS);
+	mpq_canonicalize(mpq_);
+	reduced_       = true;
+	reduced_limbs_ = mpz_size(mpq_denref(mpq_));
+}
+
+//------------------------------------------------------------------------------
+// Name: reduce_lazily
+// Desc: called after mpq_ was changed without reducing it
+//------------------------------------------------------------------------------
+void knumber_fraction::reduce_lazily() {
+
+	if(mpz_cmp_ui(mpq_denref(mpq_), 1) == 0) {
+		reduced_ = true;
+	} else if(!lazy_reduction.load(std::memory_order_relaxed) || mpz_size(mpq_denref(mpq_)) > reduced_limbs_ + lazy_reduction_limbs) {
+		reduce();
+	} else {
+		reduced_ = false;
+	}
+}
+
+//------------------------------------------------------------------------------
+// Name: scale_reduced
+// Desc: multiplies a fraction in lowest terms by x, or divides it by x if
+//       divide is set, and keeps it in lowest terms. the only common factor
+//       which can come up is one of x and the denominator (the numerator if
+//       dividing), so this takes the GCD of that rather than of the result.
+//       x must not be 0 when dividing
+//------------------------------------------------------------------------------
+void knumber_fraction::scale_reduced(mpz_srcptr x, bool divide) {
+
+	ensure_reduced();
+
+	mpz_ptr const keep   = divide ? mpq_denref(mpq_) : mpq_numref(mpq_);
+	mpz_ptr const cancel = divide ? mpq_numref(mpq_) : mpq_denref(mpq_);
+
+	if(mpz_sgn(x) == 0) {
+		mpq_set_ui(mpq_, 0, 1);
+		reduced_limbs_ = 1;
+		return;
+	}
+
+	if(mpz_sizeinbase(x, 2) <= static_cast<size_t>(std::numeric_limits<unsigned long>::digits)) {
+		const unsigned long a = mpz_get_ui(x);
+		const unsigned long g = mpz_gcd_ui(0, cancel, a);
+		mpz_divexact_ui(cancel, cancel, g);
+		mpz_mul_ui(keep, keep, a / g);
+	} else {
+		mpz_t g;
+		mpz_init(g);
+		mpz_gcd(g, cancel, x);
+		mpz_divexact(cancel, cancel, g);
+		mpz_divexact(g, x, g);
+		mpz_abs(g, g);
+		mpz_mul(keep, keep, g);
+		mpz_clear(g);
+	}
+
+	if(mpz_sgn(x) < 0) {
+		mpz_neg(mpq_numref(mpq_), mpq_numref(mpq_));
+	}
+
+	reduced_limbs_ = mpz_size(mpq_denref(mpq_));
+}
+
+//------------------------------------------------------------------------------
+// Name: ensure_reduced
+//------------------------------------------------------------------------------
+void knumber_fraction::ensure_reduced() {
+	if(!reduced_) {
+		reduce();
+	}
+}
+
 #if 0
 //------------------------------------------------------------------------------
 // Name:
@@ -115,8 +269,14 @@ knumber_fraction::knumber_fraction(const knumber_float *value) {
 //------------------------------------------------------------------------------
 // Name:
 //------------------------------------------------------------------------------
-knumber_base *knumber_fraction::clone() {
-	return new knumber_fraction(this);
+knumber_fraction::knumber_fraction(knumber_fraction &&other) : reduced_(other.reduced_), reduced_limbs_(other.reduced_limbs_) {
+
+	// takes the limbs over, mpq_init would allocate a denominator of 1 which
+	// is thrown away right after. mpz_init doesn't allocate, so the other one
+	// is left with two empty integers for its destructor
+	*mpq_ = *other.mpq_;
+	mpz_init(mpq_numref(other.mpq_));
+	mpz_init(mpq_denref(other.mpq_));
 }
 
 //------------------------------------------------------------------------------
@@ -130,237 +290,407 @@ knumber_fraction::~knumber_fraction() {
 // Name:
 //------------------------------------------------------------------------------
 bool knumber_fraction::is_integer() const {
-	return (mpz_cmp_ui(mpq_denref(mpq_), 1) == 0);
+	if(mpz_cmp_ui(mpq_denref(mpq_), 1) == 0) {
+		return true;
+	}
+
+	// a division is a lot cheaper than the GCD reduce() would need
+	return !reduced_ && mpz_divisible_p(mpq_numref(mpq_), mpq_denref(mpq_));
+}
+
+//------------------------------------------------------------------------------
+// Name:
+//------------------------------------------------------------------------------
+void knumber_fraction::add(knumber_base *, knumber_integer *rhs) {
+	// n/d + i = (n + i*d)/d, which keeps a fraction in lowest terms
+	mpz_addmul(mpq_numref(mpq_), mpq_denref(mpq_), rhs->mpz_);
+}
+
+//------------------------------------------------------------------------------
+// Name:
+//------------------------------------------------------------------------------
+void knumber_fraction::add(knumber_base *self, knumber_float *rhs) {
+	self->assign(knumber_float(this))->add(self, rhs);
+}
+
+//------------------------------------------------------------------------------
+// Name:
+//------------------------------------------------------------------------------
+void knumber_fraction::add(knumber_base *, knumber_fraction *rhs) {
+	if(lazy_reduction.load(std::memory_order_relaxed)) {
+		add_unreduced(mpq_, rhs->mpq_, false);
+		reduce_lazily();
+	} else {
+		mpq_add(mpq_, mpq_, rhs->mpq_);
+	}
+}
+
+//------------------------------------------------------------------------------
+// Name:
+//------------------------------------------------------------------------------
+void knumber_fraction::add(knumber_base *self, knumber_error *rhs) {
+	self->assign(knumber_error(rhs));
 }
 
 //------------------------------------------------------------------------------
 // Name:
 //------------------------------------------------------------------------------
-knumber_base *knumber_fraction::add(knumber_base *rhs) {
+void knumber_fraction::sub(knumber_base *, knumber_integer *rhs) {
+	mpz_submul(mpq_numref(mpq_), mpq_denref(mpq_), rhs->mpz_);
+}
 
-	if(knumber_integer *const p = dynamic_cast<knumber_integer *>(rhs)) {
-		knumber_fraction q(p);
-		mpq_add(mpq_, mpq_, q.mpq_);
-		return this;
-	} else if(knumber_float *const p = dynamic_cast<knumber_float *>(rhs)) {
-		knumber_float *f = new knumber_float(this);
-		delete this;
-		return f->add(p);
-	} else if(knumber_fraction *const p = dynamic_cast<knumber_fraction *>(rhs)) {
-		mpq_add(mpq_, mpq_, p->mpq_);
-		return this;
-	} else if(knumber_error *const p = dynamic_cast<knumber_error *>(rhs)) {
-		knumber_error *e = new knumber_error(p);
-		delete this;
-		return e;
+//------------------------------------------------------------------------------
+// Name:
+//------------------------------------------------------------------------------
+void knumber_fraction::sub(knumber_base *self, knumber_float *rhs) {
+	self->assign(knumber_float(this))->sub(self, rhs);
+}
+
+//------------------------------------------------------------------------------
+// Name:
+//------------------------------------------------------------------------------
+void knumber_fraction::sub(knumber_base *, knumber_fraction *rhs) {
+	if(lazy_reduction.load(std::memory_order_relaxed)) {
+		add_unreduced(mpq_, rhs->mpq_, true);
+		reduce_lazily();
+	} else {
+		mpq_sub(mpq_, mpq_, rhs->mpq_);
 	}
+}
 
-	Q_ASSERT(0);
-	return 0;
+//------------------------------------------------------------------------------
+// Name:
+//------------------------------------------------------------------------------
+void knumber_fraction::sub(knumber_base *self, knumber_error *rhs) {
+	self->assign(knumber_error(rhs))->neg(self);
 }
 
 //------------------------------------------------------------------------------
 // Name:
 //------------------------------------------------------------------------------
-knumber_base *knumber_fraction::sub(knumber_base *rhs) {
+void knumber_fraction::mul(knumber_base *, knumber_integer *rhs) {
+	if(lazy_reduction.load(std::memory_order_relaxed)) {
+		mpz_mul(mpq_numref(mpq_), mpq_numref(mpq_), rhs->mpz_);
+		reduce_lazily();
+	} else {
+		scale_reduced(rhs->mpz_, false);
+	}
+}
 
-	if(knumber_integer *const p = dynamic_cast<knumber_integer *>(rhs)) {
-		knumber_fraction q(p);
-		mpq_sub(mpq_, mpq_, q.mpq_);
-		return this;
-	} else if(knumber_float *const p = dynamic_cast<knumber_float *>(rhs)) {
-		knumber_float *f = new knumber_float(this);
-		delete this;
-		return f->sub(p);
-	} else if(knumber_fraction *const p = dynamic_cast<knumber_fraction *>(rhs)) {
-		mpq_sub(mpq_, mpq_, p->mpq_);
-		return this;
-	} else if(knumber_error *const p = dynamic_cast<knumber_error *>(rhs)) {
-		knumber_error *e = new knumber_error(p);
-		delete this;
-		return e->neg();
+//------------------------------------------------------------------------------
+// Name:
+//------------------------------------------------------------------------------
+void knumber_fraction::mul(knumber_base *self, knumber_float *rhs) {
+	self->assign(knumber_float(this))->mul(self, rhs);
+}
+
+//------------------------------------------------------------------------------
+// Name:
+//------------------------------------------------------------------------------
+void knumber_fraction::mul(knumber_base *, knumber_fraction *rhs) {
+	if(lazy_reduction.load(std::memory_order_relaxed)) {
+		mul_unreduced(mpq_, rhs->mpq_);
+		reduce_lazily();
+	} else {
+		mpq_mul(mpq_, mpq_, rhs->mpq_);
 	}
+}
 
-	Q_ASSERT(0);
-	return 0;
+//------------------------------------------------------------------------------
+// Name:
+//------------------------------------------------------------------------------
+void knumber_fraction::mul(knumber_base *self, knumber_error *rhs) {
+	if(is_zero()) {
+		self->emplace<knumber_error>(knumber_error::ERROR_UNDEFINED);
+	} else if(sign() < 0) {
+		self->assign(knumber_error(rhs))->neg(self);
+	} else {
+		self->assign(knumber_error(rhs));
+	}
 }
 
 //------------------------------------------------------------------------------
 // Name:
 //------------------------------------------------------------------------------
-knumber_base *knumber_fraction::mul(knumber_base *rhs) {
+void knumber_fraction::div(knumber_base *self, knumber_integer *rhs) {
 
-	if(knumber_integer *const p = dynamic_cast<knumber_integer *>(rhs)) {
-		knumber_fraction q(p);
-		mpq_mul(mpq_, mpq_, q.mpq_);
-		return this;
-	} else if(knumber_float *const p = dynamic_cast<knumber_float *>(rhs)) {
-		knumber_float *q = new knumber_float(this);
-		delete this;
-		return q->mul(p);
-	} else if(knumber_fraction *const p = dynamic_cast<knumber_fraction *>(rhs)) {
-		mpq_mul(mpq_, mpq_, p->mpq_);
-		return this;
-	} else if(knumber_error *const p = dynamic_cast<knumber_error *>(rhs)) {
-		if(is_zero()) {
-			delete this;
-			knumber_error *e = new knumber_error(knumber_error::ERROR_UNDEFINED);
-			return e;
-		}
+	if(rhs->is_zero()) {
+		self->emplace<knumber_error>((sign() < 0) ? knumber_error::ERROR_NEG_INFINITY : knumber_error::ERROR_POS_INFINITY);
+		return;
+	}
 
-		if(sign() < 0) {
-			delete this;
-			knumber_error *e = new knumber_error(p);
-			return e->neg();
-		} else {
-			delete this;
-			knumber_error *e = new knumber_error(p);
-			return e;
+	if(lazy_reduction.load(std::memory_order_relaxed)) {
+		mpz_mul(mpq_denref(mpq_), mpq_denref(mpq_), rhs->mpz_);
+		if(mpz_sgn(rhs->mpz_) < 0) {
+			mpz_neg(mpq_numref(mpq_), mpq_numref(mpq_));
+			mpz_neg(mpq_denref(mpq_), mpq_denref(mpq_));
 		}
+		reduce_lazily();
+	} else {
+		scale_reduced(rhs->mpz_, true);
+	}
+}
+
+//------------------------------------------------------------------------------
+// Name:
+//------------------------------------------------------------------------------
+void knumber_fraction::div(knumber_base *self, knumber_float *rhs) {
+
+	if(rhs->is_zero()) {
+		self->emplace<knumber_error>((sign() < 0) ? knumber_error::ERROR_NEG_INFINITY : knumber_error::ERROR_POS_INFINITY);
+		return;
 	}
 
-	Q_ASSERT(0);
-	return 0;
+	self->assign(knumber_float(this))->div(self, rhs);
 }
 
 //------------------------------------------------------------------------------
 // Name:
 //------------------------------------------------------------------------------
-knumber_base *knumber_fraction::div(knumber_base *rhs) {
+void knumber_fraction::div(knumber_base *self, knumber_fraction *rhs) {
 
 	if(rhs->is_zero()) {
-		if(sign() < 0) {
-			delete this;
-			return new knumber_error(knumber_error::ERROR_NEG_INFINITY);
-		} else {
-			delete this;
-			return new knumber_error(knumber_error::ERROR_POS_INFINITY);
-		}
+		self->emplace<knumber_error>((sign() < 0) ? knumber_error::ERROR_NEG_INFINITY : knumber_error::ERROR_POS_INFINITY);
+		return;
 	}
 
-	if(knumber_integer *const p = dynamic_cast<knumber_integer *>(rhs)) {
-		knumber_fraction f(p);
-		return div(&f);
-	} else if(knumber_float *const p = dynamic_cast<knumber_float *>(rhs)) {
-		knumber_float *f = new knumber_float(this);
-		delete this;
-		return f->div(p);
-	} else if(knumber_fraction *const p = dynamic_cast<knumber_fraction *>(rhs)) {
-		mpq_div(mpq_, mpq_, p->mpq_);
-		return this;
-	} else if(knumber_error *const p = dynamic_cast<knumber_error *>(rhs)) {
-
-		if(p->sign() > 0) {
-			delete this;
-			return new knumber_integer(0);
-		} else if(p->sign() < 0) {
-			delete this;
-			return new knumber_integer(0);
-		}
+	if(lazy_reduction.load(std::memory_order_relaxed)) {
+		div_unreduced(mpq_, rhs->mpq_);
+		reduce_lazily();
+	} else {
+		mpq_div(mpq_, mpq_, rhs->mpq_);
+	}
+}
+
+//------------------------------------------------------------------------------
+// Name:
+//------------------------------------------------------------------------------
+void knumber_fraction::div(knumber_base *self, knumber_error *rhs) {
 
-		knumber_error *e = new knumber_error(p);
-		delete this;
-		return e;
+	if(rhs->sign() != 0) {
+		self->emplace<knumber_integer>(0);
+	} else {
+		self->assign(knumber_error(rhs));
 	}
+}
+
+//------------------------------------------------------------------------------
+// Name:
+//------------------------------------------------------------------------------
+void knumber_fraction::mod(knumber_base *self, knumber_integer *rhs) {
 
-	Q_ASSERT(0);
-	return 0;
+	if(rhs->is_zero()) {
+		self->emplace<knumber_error>(knumber_error::ERROR_UNDEFINED);
+		return;
+	}
+
+	// NOTE: we don't support modulus operations with non-integer operands
+	mpq_set_d(mpq_, 0);
+	reduced_ = true;
 }
 
 //------------------------------------------------------------------------------
 // Name:
 //------------------------------------------------------------------------------
-knumber_base *knumber_fraction::mod(knumber_base *rhs) {
+void knumber_fraction::mod(knumber_base *self, knumber_float *rhs) {
 
 	if(rhs->is_zero()) {
-		delete this;
-		return new knumber_error(knumber_error::ERROR_UNDEFINED);
+		self->emplace<knumber_error>(knumber_error::ERROR_UNDEFINED);
+		return;
 	}
 
 	// NOTE: we don't support modulus operations with non-integer operands
 	mpq_set_d(mpq_, 0);
-	return this;
+	reduced_ = true;
+}
+
+//------------------------------------------------------------------------------
+// Name:
+//------------------------------------------------------------------------------
+void knumber_fraction::mod(knumber_base *self, knumber_fraction *rhs) {
+
+	if(rhs->is_zero()) {
+		self->emplace<knumber_error>(knumber_error::ERROR_UNDEFINED);
+		return;
+	}
+
+	// NOTE: we don't support modulus operations with non-integer operands
+	mpq_set_d(mpq_, 0);
+	reduced_ = true;
+}
+
+//------------------------------------------------------------------------------
+// Name:
+//------------------------------------------------------------------------------
+void knumber_fraction::mod(knumber_base *, knumber_error *) {
+
+	// NOTE: we don't support modulus operations with non-integer operands
+	mpq_set_d(mpq_, 0);
+	reduced_ = true;
+}
+
+//------------------------------------------------------------------------------
+// Name:
+//------------------------------------------------------------------------------
+void knumber_fraction::bitwise_and(knumber_base *self, knumber_error *) {
+	// NOTE: we don't support bitwise operations with non-integer operands
+	self->emplace<knumber_integer>(0);
+}
+
+//------------------------------------------------------------------------------
+// Name:
+//------------------------------------------------------------------------------
+void knumber_fraction::bitwise_and(knumber_base *self, knumber_integer *) {
+	// NOTE: we don't support bitwise operations with non-integer operands
+	self->emplace<knumber_integer>(0);
+}
+
+//------------------------------------------------------------------------------
+// Name:
+//------------------------------------------------------------------------------
+void knumber_fraction::bitwise_and(knumber_base *self, knumber_float *) {
+	// NOTE: we don't support bitwise operations with non-integer operands
+	self->emplace<knumber_integer>(0);
+}
+
+//------------------------------------------------------------------------------
+// Name:
+//------------------------------------------------------------------------------
+void knumber_fraction::bitwise_and(knumber_base *self, knumber_fraction *) {
+	// NOTE: we don't support bitwise operations with non-integer operands
+	self->emplace<knumber_integer>(0);
+}
+
+//------------------------------------------------------------------------------
+// Name:
+//------------------------------------------------------------------------------
+void knumber_fraction::bitwise_xor(knumber_base *self, knumber_error *) {
+	// NOTE: we don't support bitwise operations with non-integer operands
+	self->emplace<knumber_integer>(0);
+}
+
+//------------------------------------------------------------------------------
+// Name:
+//------------------------------------------------------------------------------
+void knumber_fraction::bitwise_xor(knumber_base *self, knumber_integer *) {
+	// NOTE: we don't support bitwise operations with non-integer operands
+	self->emplace<knumber_integer>(0);
+}
+
+//------------------------------------------------------------------------------
+// Name:
+//------------------------------------------------------------------------------
+void knumber_fraction::bitwise_xor(knumber_base *self, knumber_float *) {
+	// NOTE: we don't support bitwise operations with non-integer operands
+	self->emplace<knumber_integer>(0);
 }
 
 //------------------------------------------------------------------------------
 // Name:
 //------------------------------------------------------------------------------
-knumber_base *knumber_fraction::bitwise_and(knumber_base *rhs) {
+void knumber_fraction::bitwise_xor(knumber_base *self, knumber_fraction *) {
+	// NOTE: we don't support bitwise operations with non-integer operands
+	self->emplace<knumber_integer>(0);
+}
 
-	Q_UNUSED(rhs);
-	delete this;
+//------------------------------------------------------------------------------
+// Name:
+//------------------------------------------------------------------------------
+void knumber_fraction::bitwise_or(knumber_base *self, knumber_error *) {
 	// NOTE: we don't support bitwise operations with non-integer operands
-	return new knumber_integer(0);
+	self->emplace<knumber_integer>(0);
 }
 
 //------------------------------------------------------------------------------
 // Name:
 //------------------------------------------------------------------------------
-knumber_base *knumber_fraction::bitwise_xor(knumber_base *rhs) {
+void knumber_fraction::bitwise_or(knumber_base *self, knumber_integer *) {
+	// NOTE: we don't support bitwise operations with non-integer operands
+	self->emplace<knumber_integer>(0);
+}
 
-	Q_UNUSED(rhs);
-	delete this;
+//------------------------------------------------------------------------------
+// Name:
+//------------------------------------------------------------------------------
+void knumber_fraction::bitwise_or(knumber_base *self, knumber_float *) {
 	// NOTE: we don't support bitwise operations with non-integer operands
-	return new knumber_integer(0);
+	self->emplace<knumber_integer>(0);
 }
 
 //------------------------------------------------------------------------------
 // Name:
 //------------------------------------------------------------------------------
-knumber_base *knumber_fraction::bitwise_or(knumber_base *rhs) {
+void knumber_fraction::bitwise_or(knumber_base *self, knumber_fraction *) {
+	// NOTE: we don't support bitwise operations with non-integer operands
+	self->emplace<knumber_integer>(0);
+}
 
-	Q_UNUSED(rhs);
-	delete this;
+//------------------------------------------------------------------------------
+// Name:
+//------------------------------------------------------------------------------
+void knumber_fraction::bitwise_shift(knumber_base *self, knumber_error *) {
 	// NOTE: we don't support bitwise operations with non-integer operands
-	return new knumber_integer(0);
+	self->emplace<knumber_error>(knumber_error::ERROR_UNDEFINED);
 }
 
 //------------------------------------------------------------------------------
 // Name:
 //------------------------------------------------------------------------------
-knumber_base *knumber_fraction::bitwise_shift(knumber_base *rhs) {
+void knumber_fraction::bitwise_shift(knumber_base *self, knumber_integer *) {
+	// NOTE: we don't support bitwise operations with non-integer operands
+	self->emplace<knumber_error>(knumber_error::ERROR_UNDEFINED);
+}
 
-	Q_UNUSED(rhs);
-	delete this;
+//------------------------------------------------------------------------------
+// Name:
+//------------------------------------------------------------------------------
+void knumber_fraction::bitwise_shift(knumber_base *self, knumber_float *) {
 	// NOTE: we don't support bitwise operations with non-integer operands
-	return new knumber_error(knumber_error::ERROR_UNDEFINED);
+	self->emplace<knumber_error>(knumber_error::ERROR_UNDEFINED);
 }
 
 //------------------------------------------------------------------------------
 // Name:
 //------------------------------------------------------------------------------
-knumber_base *knumber_fraction::neg() {
+void knumber_fraction::bitwise_shift(knumber_base *self, knumber_fraction *) {
+	// NOTE: we don't support bitwise operations with non-integer operands
+	self->emplace<knumber_error>(knumber_error::ERROR_UNDEFINED);
+}
+
+//------------------------------------------------------------------------------
+// Name:
+//------------------------------------------------------------------------------
+void knumber_fraction::neg(knumber_base *) {
 	mpq_neg(mpq_, mpq_);
-	return this;
 }
 
 //------------------------------------------------------------------------------
 // Name:
 //------------------------------------------------------------------------------
-knumber_base *knumber_fraction::abs() {
+void knumber_fraction::abs(knumber_base *) {
 	mpq_abs(mpq_, mpq_);
-	return this;
 }
 
 //------------------------------------------------------------------------------
 // Name:
 //------------------------------------------------------------------------------
-knumber_base *knumber_fraction::cmp() {
+void knumber_fraction::cmp(knumber_base *self) {
 
-	delete this;
-	return new knumber_error(knumber_error::ERROR_UNDEFINED);
+	self->emplace<knumber_error>(knumber_error::ERROR_UNDEFINED);
 }
 
 //------------------------------------------------------------------------------
 // Name:
 //------------------------------------------------------------------------------
-knumber_base *knumber_fraction::sqrt() {
+void knumber_fraction::sqrt(knumber_base *self) {
 
 	if(sign() < 0) {
-		delete this;
-		return new knumber_error(knumber_error::ERROR_UNDEFINED);
+		self->emplace<knumber_error>(knumber_error::ERROR_UNDEFINED);
+		return;
 	}
 
+	ensure_reduced();
+
 	if(mpz_perfect_square_p(mpq_numref(mpq_)) && mpz_perfect_square_p(mpq_denref(mpq_))) {
 		mpz_t num;
 		mpz_t den;
@@ -372,21 +702,20 @@ knumber_base *knumber_fraction::sqrt() {
 		mpz_sqrt(den, den);
 		mpq_set_num(mpq_, num);
 		mpq_set_den(mpq_, den);
-		mpq_canonicalize(mpq_);
+		reduce();
 		mpz_clear(num);
 		mpz_clear(den);
-		return this;
 	} else {
-		knumber_float *f = new knumber_float(this);
-		delete this;
-		return f->sqrt();
+		self->assign(knumber_float(this))->sqrt(self);
 	}
 }
 
 //------------------------------------------------------------------------------
 // Name:
 //------------------------------------------------------------------------------
-knumber_base *knumber_fraction::cbrt() {
+void knumber_fraction::cbrt(knumber_base *self) {
+
+	ensure_reduced();
 
 	// TODO: figure out how to properly use mpq_numref/mpq_denref here
 	mpz_t num;
@@ -401,379 +730,376 @@ knumber_base *knumber_fraction::cbrt() {
 	if(mpz_root(num, num, 3) && mpz_root(den, den, 3)) {
 		mpq_set_num(mpq_, num);
 		mpq_set_den(mpq_, den);
-		mpq_canonicalize(mpq_);
+		reduce();
 		mpz_clear(num);
 		mpz_clear(den);
-		return this;
 	} else {
 		mpz_clear(num);
 		mpz_clear(den);
-		knumber_float *f = new knumber_float(this);
-		delete this;
-		return f->cbrt();
+		self->assign(knumber_float(this))->cbrt(self);
 	}
 }
 
 //------------------------------------------------------------------------------
 // Name:
 //------------------------------------------------------------------------------
-knumber_base *knumber_fraction::factorial() {
+void knumber_fraction::factorial(knumber_base *self) {
 
 	if(sign() < 0) {
-		delete this;
-		return new knumber_error(knumber_error::ERROR_UNDEFINED);
+		self->emplace<knumber_error>(knumber_error::ERROR_UNDEFINED);
+		return;
 	}
 
-	knumber_integer *i = new knumber_integer(this);
-	delete this;
-	return i->factorial();
+	self->assign(knumber_integer(this))->factorial(self);
 }
 
 //------------------------------------------------------------------------------
 // Name:
 //------------------------------------------------------------------------------
-knumber_base *knumber_fraction::pow(knumber_base *rhs) {
+void knumber_fraction::pow(knumber_base *self, knumber_integer *rhs) {
 
-	// TODO: figure out how to properly use mpq_numref/mpq_denref here
-	if(knumber_integer *const p = dynamic_cast<knumber_integer *>(rhs)) {
+	ensure_reduced();
 
-		mpz_t num;
-		mpz_t den;
+	// a power too big to be exact is worked out as a float instead, GMP
+	// needs about six times the size of the result for it
+	const double scale = 6;
+	double bits = std::numeric_limits<double>::infinity();
+	if(mpz_sizeinbase(rhs->mpz_, 2) <= static_cast<size_t>(std::numeric_limits<unsigned long>::digits)) {
+		bits = (static_cast<double>(mpz_sizeinbase(mpq_numref(mpq_), 2)) + mpz_sizeinbase(mpq_denref(mpq_), 2)) * mpz_get_ui(rhs->mpz_);
+	}
 
-		mpz_init(num);
-		mpz_init(den);
+	if(!knumber_allocator::fits_budget(bits, scale)) {
+		self->assign(knumber_float(this))->pow(self, rhs);
+		return;
+	}
+
+	// TODO: figure out how to properly use mpq_numref/mpq_denref here
+	mpz_t num;
+	mpz_t den;
+
+	mpz_init(num);
+	mpz_init(den);
 
+	knumber_budget_scope scope(bits * scale);
+	try {
 		mpq_get_num(num, mpq_);
 		mpq_get_den(den, mpq_);
 
-		mpz_pow_ui(num, num, mpz_get_ui(p->mpz_));
-		mpz_pow_ui(den, den, mpz_get_ui(p->mpz_));
+		mpz_pow_ui(num, num, mpz_get_ui(rhs->mpz_));
+		mpz_pow_ui(den, den, mpz_get_ui(rhs->mpz_));
 		mpq_set_num(mpq_, num);
 		mpq_set_den(mpq_, den);
-		mpq_canonicalize(mpq_);
+		reduce();
+		knumber_budget_scope::check();
+	} catch(const knumber_budget_exceeded &) {
 		mpz_clear(num);
 		mpz_clear(den);
+		self->emplace<knumber_error>(knumber_error::ERROR_UNDEFINED);
+		scope.release();
+		return;
+	}
+	mpz_clear(num);
+	mpz_clear(den);
 
-		if(p->sign() < 0) {
-			return reciprocal();
-		} else {
-			return this;
-		}
-	} else if(knumber_float *const p = dynamic_cast<knumber_float *>(rhs)) {
-		Q_UNUSED(p);
-		knumber_float *f = new knumber_float(this);
-		delete this;
-		return f->pow(rhs);
-	} else if(knumber_fraction *const p = dynamic_cast<knumber_fraction *>(rhs)) {
-
-		// ok, so if any part of the number is > 1,000,000, then we risk
-		// the pow function overflowing... so we'll just convert to float to be safe
-		// TODO: at some point, we should figure out exactly what the threshold is
-		//       and if there is a better way to determine if the pow function will
-		//       overflow.
-		if(mpz_cmpabs_ui(mpq_numref(mpq_), 1000000) > 0 || mpz_cmpabs_ui(mpq_denref(mpq_), 1000000) > 0 || mpz_cmpabs_ui(mpq_numref(p->mpq_), 1000000) > 0 || mpz_cmpabs_ui(mpq_denref(p->mpq_), 1000000) > 0) {
-			knumber_float *f = new knumber_float(this);
-			delete this;
-			return f->pow(rhs);
-		}
+	if(rhs->sign() < 0) {
+		reciprocal(self);
+	}
+}
 
-		mpz_t lhs_num;
-		mpz_t lhs_den;
-		mpz_t rhs_num;
-		mpz_t rhs_den;
-
-		mpz_init(lhs_num);
-		mpz_init(lhs_den);
-		mpz_init(rhs_num);
-		mpz_init(rhs_den);
-
-		mpq_get_num(lhs_num, mpq_);
-		mpq_get_den(lhs_den, mpq_);
-		mpq_get_num(rhs_num, p->mpq_);
-		mpq_get_den(rhs_den, p->mpq_);
-
-		mpz_pow_ui(lhs_num, lhs_num, mpz_get_ui(rhs_num));
-		mpz_pow_ui(lhs_den, lhs_den, mpz_get_ui(rhs_num));
-
-		if(mpz_sgn(lhs_num) < 0 && mpz_even_p(rhs_den)) {
-			mpz_clear(lhs_num);
-			mpz_clear(lhs_den);
-			mpz_clear(rhs_num);
-			mpz_clear(rhs_den);
-			delete this;
-			return new knumber_error(knumber_error::ERROR_UNDEFINED);
-		}
+//------------------------------------------------------------------------------
+// Name:
+//------------------------------------------------------------------------------
+void knumber_fraction::pow(knumber_base *self, knumber_float *rhs) {
+	self->assign(knumber_float(this))->pow(self, rhs);
+}
 
-		if(mpz_sgn(lhs_den) < 0 && mpz_even_p(rhs_den)) {
-			mpz_clear(lhs_num);
-			mpz_clear(lhs_den);
-			mpz_clear(rhs_num);
-			mpz_clear(rhs_den);
-			delete this;
-			return new knumber_error(knumber_error::ERROR_UNDEFINED);
-		}
+//------------------------------------------------------------------------------
+// Name:
+//------------------------------------------------------------------------------
+void knumber_fraction::pow(knumber_base *self, knumber_fraction *rhs) {
 
-		const int n1 = mpz_root(lhs_num, lhs_num, mpz_get_ui(rhs_den));
-		const int n2 = mpz_root(lhs_den, lhs_den, mpz_get_ui(rhs_den));
+	ensure_reduced();
+	rhs->ensure_reduced();
 
-		if(n1 && n2) {
+	// ok, so if any part of the number is > 1,000,000, then we risk
+	// the pow function overflowing... so we'll just convert to float to be safe
+	// TODO: at some point, we should figure out exactly what the threshold is
+	//       and if there is a better way to determine if the pow function will
+	//       overflow.
+	if(mpz_cmpabs_ui(mpq_numref(mpq_), 1000000) > 0 || mpz_cmpabs_ui(mpq_denref(mpq_), 1000000) > 0 || mpz_cmpabs_ui(mpq_numref(rhs->mpq_), 1000000) > 0 || mpz_cmpabs_ui(mpq_denref(rhs->mpq_), 1000000) > 0) {
+		self->assign(knumber_float(this))->pow(self, rhs);
+		return;
+	}
 
-			mpq_set_num(mpq_, lhs_num);
-			mpq_set_den(mpq_, lhs_den);
-			mpq_canonicalize(mpq_);
-			mpz_clear(lhs_num);
-			mpz_clear(lhs_den);
-			mpz_clear(rhs_num);
-			mpz_clear(rhs_den);
+	mpz_t lhs_num;
+	mpz_t lhs_den;
+	mpz_t rhs_num;
+	mpz_t rhs_den;
+
+	mpz_init(lhs_num);
+	mpz_init(lhs_den);
+	mpz_init(rhs_num);
+	mpz_init(rhs_den);
+
+	mpq_get_num(lhs_num, mpq_);
+	mpq_get_den(lhs_den, mpq_);
+	mpq_get_num(rhs_num, rhs->mpq_);
+	mpq_get_den(rhs_den, rhs->mpq_);
+
+	mpz_pow_ui(lhs_num, lhs_num, mpz_get_ui(rhs_num));
+	mpz_pow_ui(lhs_den, lhs_den, mpz_get_ui(rhs_num));
+
+	if(mpz_sgn(lhs_num) < 0 && mpz_even_p(rhs_den)) {
+		mpz_clear(lhs_num);
+		mpz_clear(lhs_den);
+		mpz_clear(rhs_num);
+		mpz_clear(rhs_den);
+		self->emplace<knumber_error>(knumber_error::ERROR_UNDEFINED);
+		return;
+	}
 
-			if(p->sign() < 0) {
-				return reciprocal();
-			} else {
-				return this;
-			}
-		} else {
-			mpz_clear(lhs_num);
-			mpz_clear(lhs_den);
-			mpz_clear(rhs_num);
-			mpz_clear(rhs_den);
-			knumber_float *f = new knumber_float(this);
-			delete this;
-
-			return f->pow(rhs);
-		}
+	if(mpz_sgn(lhs_den) < 0 && mpz_even_p(rhs_den)) {
+		mpz_clear(lhs_num);
+		mpz_clear(lhs_den);
+		mpz_clear(rhs_num);
+		mpz_clear(rhs_den);
+		self->emplace<knumber_error>(knumber_error::ERROR_UNDEFINED);
+		return;
+	}
 
-	} else if(knumber_error *const p = dynamic_cast<knumber_error *>(rhs)) {
-		if(p->sign() > 0) {
-			knumber_error *e = new knumber_error(knumber_error::ERROR_POS_INFINITY);
-			delete this;
-			return e;
-		} else if(p->sign() < 0) {
-			knumber_integer *n = new knumber_integer(0);
-			delete this;
-			return n;
-		} else {
-			knumber_error *e = new knumber_error(knumber_error::ERROR_UNDEFINED);
-			delete this;
-			return e;
+	const int n1 = mpz_root(lhs_num, lhs_num, mpz_get_ui(rhs_den));
+	const int n2 = mpz_root(lhs_den, lhs_den, mpz_get_ui(rhs_den));
+
+	if(n1 && n2) {
+
+		mpq_set_num(mpq_, lhs_num);
+		mpq_set_den(mpq_, lhs_den);
+		reduce();
+		mpz_clear(lhs_num);
+		mpz_clear(lhs_den);
+		mpz_clear(rhs_num);
+		mpz_clear(rhs_den);
+
+		if(rhs->sign() < 0) {
+			reciprocal(self);
 		}
+	} else {
+		mpz_clear(lhs_num);
+		mpz_clear(lhs_den);
+		mpz_clear(rhs_num);
+		mpz_clear(rhs_den);
+		self->assign(knumber_float(this))->pow(self, rhs);
 	}
+}
+
+//------------------------------------------------------------------------------
+// Name:
+//------------------------------------------------------------------------------
+void knumber_fraction::pow(knumber_base *self, knumber_error *rhs) {
 
-	Q_ASSERT(0);
-	return 0;
+	if(rhs->sign() > 0) {
+		self->emplace<knumber_error>(knumber_error::ERROR_POS_INFINITY);
+	} else if(rhs->sign() < 0) {
+		self->emplace<knumber_integer>(0);
+	} else {
+		self->emplace<knumber_error>(knumber_error::ERROR_UNDEFINED);
+	}
 }
 
 //------------------------------------------------------------------------------
 // Name:
 //------------------------------------------------------------------------------
-knumber_base *knumber_fraction::sin() {
+void knumber_fraction::sin(knumber_base *self) {
 
-	knumber_float *f = new knumber_float(this);
-	delete this;
-	return f->sin();
+	self->assign(knumber_float(this))->sin(self);
 }
 
 //------------------------------------------------------------------------------
 // Name:
 //------------------------------------------------------------------------------
-knumber_base *knumber_fraction::floor() {
-	knumber_float *f = new knumber_float(this);
-	delete this;
-	return f->floor();
+void knumber_fraction::floor(knumber_base *self) {
+	self->assign(knumber_float(this))->floor(self);
 }
 
 //------------------------------------------------------------------------------
 // Name:
 //------------------------------------------------------------------------------
-knumber_base *knumber_fraction::ceil() {
-	knumber_float *f = new knumber_float(this);
-	delete this;
-	return f->ceil();
+void knumber_fraction::ceil(knumber_base *self) {
+	self->assign(knumber_float(this))->ceil(self);
 }
 
 //------------------------------------------------------------------------------
 // Name:
 //------------------------------------------------------------------------------
-knumber_base *knumber_fraction::cos() {
+void knumber_fraction::cos(knumber_base *self) {
 
-	knumber_float *f = new knumber_float(this);
-	delete this;
-	return f->cos();
+	self->assign(knumber_float(this))->cos(self);
 }
 
 //------------------------------------------------------------------------------
 // Name:
 //------------------------------------------------------------------------------
-knumber_base *knumber_fraction::tgamma() {
+void knumber_fraction::tgamma(knumber_base *self) {
 
-	knumber_float *f = new knumber_float(this);
-	delete this;
-	return f->tgamma();
+	self->assign(knumber_float(this))->tgamma(self);
 }
 
 //------------------------------------------------------------------------------
 // Name:
 //------------------------------------------------------------------------------
-knumber_base *knumber_fraction::tan() {
+void knumber_fraction::tan(knumber_base *self) {
 
-	knumber_float *f = new knumber_float(this);
-	delete this;
-	return f->tan();
+	self->assign(knumber_float(this))->tan(self);
 }
 
 //------------------------------------------------------------------------------
 // Name:
 //------------------------------------------------------------------------------
-knumber_base *knumber_fraction::asin() {
+void knumber_fraction::asin(knumber_base *self) {
 
-	knumber_float *f = new knumber_float(this);
-	delete this;
-	return f->asin();
+	self->assign(knumber_float(this))->asin(self);
 }
 
 //------------------------------------------------------------------------------
 // Name:
 //------------------------------------------------------------------------------
-knumber_base *knumber_fraction::acos() {
+void knumber_fraction::acos(knumber_base *self) {
 
-	knumber_float *f = new knumber_float(this);
-	delete this;
-	return f->acos();
+	self->assign(knumber_float(this))->acos(self);
 }
 
 //------------------------------------------------------------------------------
 // Name:
 //------------------------------------------------------------------------------
-knumber_base *knumber_fraction::atan() {
+void knumber_fraction::atan(knumber_base *self) {
 
-	knumber_float *f = new knumber_float(this);
-	delete this;
-	return f->atan();
+	self->assign(knumber_float(this))->atan(self);
 }
 
 //------------------------------------------------------------------------------
 // Name:
 //------------------------------------------------------------------------------
-knumber_base *knumber_fraction::sinh() {
-	knumber_float *f = new knumber_float(this);
-	delete this;
-	return f->sinh();
+void knumber_fraction::sinh(knumber_base *self) {
+	self->assign(knumber_float(this))->sinh(self);
 }
 
 //------------------------------------------------------------------------------
 // Name:
 //------------------------------------------------------------------------------
-knumber_base *knumber_fraction::cosh() {
-	knumber_float *f = new knumber_float(this);
-	delete this;
-	return f->cosh();
+void knumber_fraction::cosh(knumber_base *self) {
+	self->assign(knumber_float(this))->cosh(self);
 }
 
 //------------------------------------------------------------------------------
 // Name:
 //------------------------------------------------------------------------------
-knumber_base *knumber_fraction::tanh() {
-	knumber_float *f = new knumber_float(this);
-	delete this;
-	return f->tanh();
+void knumber_fraction::tanh(knumber_base *self) {
+	self->assign(knumber_float(this))->tanh(self);
 }
 
 //------------------------------------------------------------------------------
 // Name:
 //------------------------------------------------------------------------------
-knumber_base *knumber_fraction::asinh() {
-	knumber_float *f = new knumber_float(this);
-	delete this;
-	return f->asinh();
+void knumber_fraction::asinh(knumber_base *self) {
+	self->assign(knumber_float(this))->asinh(self);
 }
 
 //------------------------------------------------------------------------------
 // Name:
 //------------------------------------------------------------------------------
-knumber_base *knumber_fraction::acosh() {
-	knumber_float *f = new knumber_float(this);
-	delete this;
-	return f->acosh();
+void knumber_fraction::acosh(knumber_base *self) {
+	self->assign(knumber_float(this))->acosh(self);
 }
 
 //------------------------------------------------------------------------------
 // Name:
 //------------------------------------------------------------------------------
-knumber_base *knumber_fraction::atanh() {
-	knumber_float *f = new knumber_float(this);
-	delete this;
-	return f->atanh();
+void knumber_fraction::atanh(knumber_base *self) {
+	self->assign(knumber_float(this))->atanh(self);
 }
 
 //------------------------------------------------------------------------------
 // Name:
 //------------------------------------------------------------------------------
-int knumber_fraction::compare(knumber_base *rhs) {
+int knumber_fraction::compare(knumber_integer *rhs) {
 
-	if(knumber_integer *const p = dynamic_cast<knumber_integer *>(rhs)) {
-		knumber_fraction f(p);
-		return mpq_cmp(mpq_, f.mpq_);
-	} else if(knumber_float *const p = dynamic_cast<knumber_float *>(rhs)) {
-		knumber_float f(this);
-		return f.compare(p);
-	} else if(knumber_fraction *const p = dynamic_cast<knumber_fraction *>(rhs)) {
-		return mpq_cmp(mpq_, p->mpq_);
-	} else if(knumber_error *const p = dynamic_cast<knumber_error *>(rhs)) {
-		// NOTE: any number compared to NaN/Inf/-Inf always compares less
-		//       at the moment
-		return -1;
+	// n/d against x as n against x * d
+	if(mpz_cmp_ui(mpq_denref(mpq_), 1) == 0) {
+		return mpz_cmp(mpq_numref(mpq_), rhs->mpz_);
 	}
 
-	Q_ASSERT(0);
-	return 0;
+	const int sa = mpq_sgn(mpq_);
+	const int sb = mpz_sgn(rhs->mpz_);
+	if(sa != sb) {
+		return (sa < sb) ? -1 : 1;
+	}
+
+	mpz_t scaled;
+	mpz_init(scaled);
+	mpz_mul(scaled, rhs->mpz_, mpq_denref(mpq_));
+	const int r = mpz_cmp(mpq_numref(mpq_), scaled);
+	mpz_clear(scaled);
+	return r;
 }
 
 //------------------------------------------------------------------------------
 // Name:
 //------------------------------------------------------------------------------
-QString knumber_fraction::toString(int precision) const {
-
-
-	if(knumber_fraction::default_fractional_output) {
-
-		// TODO: figure out how to properly use mpq_numref/mpq_denref here
-
-		knumber_integer integer_part(this);
-		if(split_off_integer_for_fraction_output && !integer_part.is_zero()) {
-
-			mpz_t num;
-			mpz_init(num);
-			mpq_get_num(num, mpq_);
-
-			knumber_integer integer_part_1(this);
+int knumber_fraction::compare(knumber_float *rhs) {
+	return -rhs->compare(this);
+}
 
-			mpz_mul(integer_part.mpz_, integer_part.mpz_, mpq_denref(mpq_));
-			mpz_sub(num, num, integer_part.mpz_);
+//------------------------------------------------------------------------------
+// Name:
+//------------------------------------------------------------------------------
+int knumber_fraction::compare(knumber_fraction *rhs) {
 
-			if(mpz_sgn(num) < 0) {
-				mpz_neg(num, num);
-			}
+	// this may be shared, so it is compared as it is rather than reduced
+	if(reduced_ && rhs->reduced_) {
+		return mpq_cmp(mpq_, rhs->mpq_);
+	}
+	return compare_unreduced(mpq_, rhs->mpq_);
+}
 
-    		const size_t size = gmp_snprintf(NULL, 0, "%Zd %Zd/%Zd", integer_part_1.mpz_, num, mpq_denref(mpq_)) + 1;
-			QScopedArrayPointer<char> buf(new char[size]);
-    		gmp_snprintf(&buf[0], size, "%Zd %Zd/%Zd", integer_part_1.mpz_, num, mpq_denref(mpq_));
+//------------------------------------------------------------------------------
+// Name:
+//------------------------------------------------------------------------------
+int knumber_fraction::compare(knumber_error *) {
 
-			mpz_clear(num);
+	// NOTE: any number compared to NaN/Inf/-Inf always compares less
+	//       at the moment
+	return -1;
+}
 
-    		return QLatin1String(&buf[0]);
-		} else {
+//------------------------------------------------------------------------------
+// Name: exceeds_limb_budget
+//------------------------------------------------------------------------------
+bool knumber_fraction::exceeds_limb_budget() {
 
-			mpz_t num;
-			mpz_init(num);
-			mpq_get_num(num, mpq_);
+	// read once, so both checks are against the same budget
+	const std::size_t budget = limb_budget.load(std::memory_order_relaxed);
+	if(budget == 0 || mpz_size(mpq_numref(mpq_)) + mpz_size(mpq_denref(mpq_)) <= budget) {
+		return false;
+	}
 
-    		const size_t size = gmp_snprintf(NULL, 0, "%Zd/%Zd", num, mpq_denref(mpq_)) + 1;
-			QScopedArrayPointer<char> buf(new char[size]);
-    		gmp_snprintf(&buf[0], size, "%Zd/%Zd", num, mpq_denref(mpq_));
+	ensure_reduced();
+	return mpz_size(mpq_numref(mpq_)) + mpz_size(mpq_denref(mpq_)) > budget;
+}
 
-			mpz_clear(num);
+//------------------------------------------------------------------------------
+// Name:
+//------------------------------------------------------------------------------
+QString knumber_fraction::toString(int precision) const {
 
-    		return QLatin1String(&buf[0]);
+	const KNumberContext &context = KNumberContext::active();
+	if(!context.floatOutput()) {
+		if(reduced_) {
+			return knumber_formatter::format_fraction(mpq_, context.splitoffIntegerForFractionOutput());
 		}
+
+		knumber_fraction q(this);
+		q.reduce();
+		return knumber_formatter::format_fraction(q.mpq_, context.splitoffIntegerForFractionOutput());
 	} else {
 		return knumber_float(this).toString(precision);
 	}
@@ -796,114 +1122,94 @@ int knumber_fraction::sign() const {
 //------------------------------------------------------------------------------
 // Name:
 //------------------------------------------------------------------------------
-knumber_base *knumber_fraction::reciprocal() {
+void knumber_fraction::reciprocal(knumber_base *) {
 
 	mpq_inv(mpq_, mpq_);
-	return this;
+	reduced_limbs_ = mpz_size(mpq_denref(mpq_));
 }
 
 //------------------------------------------------------------------------------
 // Name:
 //------------------------------------------------------------------------------
-knumber_integer *knumber_fraction::numerator() const {
-
-	mpz_t num;
-	mpz_init(num);
-	mpq_get_num(num, mpq_);
-	knumber_integer *n = new knumber_integer(num);
-	mpz_clear(num);
-	return n;
+void knumber_fraction::log2(knumber_base *self) {
+	self->assign(knumber_float(this))->log2(self);
 }
 
 //------------------------------------------------------------------------------
 // Name:
 //------------------------------------------------------------------------------
-knumber_integer *knumber_fraction::denominator() const {
-
-	mpz_t den;
-	mpz_init(den);
-	mpq_get_den(den, mpq_);
-	knumber_integer *n = new knumber_integer(den);
-	mpz_clear(den);
-	return n;
+void knumber_fraction::log10(knumber_base *self) {
+	self->assign(knumber_float(this))->log10(self);
 }
 
 //------------------------------------------------------------------------------
 // Name:
 //------------------------------------------------------------------------------
-knumber_base *knumber_fraction::log2() {
-	knumber_float *f = new knumber_float(this);
-	delete this;
-	return f->log2();
+void knumber_fraction::ln(knumber_base *self) {
+	self->assign(knumber_float(this))->ln(self);
 }
 
 //------------------------------------------------------------------------------
 // Name:
 //------------------------------------------------------------------------------
-knumber_base *knumber_fraction::log10() {
-	knumber_float *f = new knumber_float(this);
-	delete this;
-	return f->log10();
+void knumber_fraction::exp2(knumber_base *self) {
+	self->assign(knumber_float(this))->exp2(self);
 }
 
 //------------------------------------------------------------------------------
 // Name:
 //------------------------------------------------------------------------------
-knumber_base *knumber_fraction::ln() {
-	knumber_float *f = new knumber_float(this);
-	delete this;
-	return f->ln();
+void knumber_fraction::exp10(knumber_base *self) {
+	self->assign(knumber_float(this))->exp10(self);
 }
 
 //------------------------------------------------------------------------------
 // Name:
 //------------------------------------------------------------------------------
-knumber_base *knumber_fraction::exp2() {
-	knumber_float *f = new knumber_float(this);
-	delete this;
-	return f->exp2();
+void knumber_fraction::exp(knumber_base *self) {
+	self->assign(knumber_float(this))->exp(self);
 }
 
 //------------------------------------------------------------------------------
 // Name:
 //------------------------------------------------------------------------------
-knumber_base *knumber_fraction::exp10() {
-	knumber_float *f = new knumber_float(this);
-	delete this;
-	return f->exp10();
+quint64 knumber_fraction::toUint64() const {
+	return knumber_integer(this).toUint64();
 }
 
 //------------------------------------------------------------------------------
 // Name:
 //------------------------------------------------------------------------------
-knumber_base *knumber_fraction::exp() {
-	knumber_float *f = new knumber_float(this);
-	delete this;
-	return f->exp();
+qint64 knumber_fraction::toInt64() const {
+	return knumber_integer(this).toInt64();
 }
 
 //------------------------------------------------------------------------------
 // Name:
 //------------------------------------------------------------------------------
-quint64 knumber_fraction::toUint64() const {
-	return knumber_integer(this).toUint64();
+void knumber_fraction::bin(knumber_base *self, knumber_error *) {
+	self->emplace<knumber_error>(knumber_error::ERROR_UNDEFINED);
 }
 
 //------------------------------------------------------------------------------
 // Name:
 //------------------------------------------------------------------------------
-qint64 knumber_fraction::toInt64() const {
-	return knumber_integer(this).toInt64();
+void knumber_fraction::bin(knumber_base *self, knumber_integer *) {
+	self->emplace<knumber_error>(knumber_error::ERROR_UNDEFINED);
 }
 
 //------------------------------------------------------------------------------
 // Name:
 //------------------------------------------------------------------------------
-knumber_base *knumber_fraction::bin(knumber_base *rhs) {
-	Q_UNUSED(rhs);
-	delete this;
-	return new knumber_error(knumber_error::ERROR_UNDEFINED);
+void knumber_fraction::bin(knumber_base *self, knumber_float *) {
+	self->emplace<knumber_error>(knumber_error::ERROR_UNDEFINED);
+}
 
+//------------------------------------------------------------------------------
+// Name:
+//------------------------------------------------------------------------------
+void knumber_fraction::bin(knumber_base *self, knumber_fraction *) {
+	self->emplace<knumber_error>(knumber_error::ERROR_UNDEFINED);
 }
 
 }
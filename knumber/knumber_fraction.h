@@ -19,103 +19,162 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #ifndef KNUMBER_FRACTION_H_
 #define KNUMBER_FRACTION_H_
 
-#include "knumber_base.h"
+// Workaround: include before gmp.h to fix build with gcc-4.9
+#include <cstddef>
+#include <gmp.h>
+
+#include <QString>
+#include <QtGlobal>
+#include <atomic>
 
 class KNumber;
 
 namespace detail {
 
-class knumber_fraction : public knumber_base {
+class knumber_base;
+class knumber_error;
+class knumber_integer;
+class knumber_float;
+
+class knumber_fraction {
 	friend class ::KNumber;
+	friend class knumber_base;
 	friend class knumber_error;
 	friend class knumber_integer;
 	friend class knumber_float;
 
 public:
-	static bool default_fractional_input;
-	static bool default_fractional_output;
-	static bool split_off_integer_for_fraction_output;
+	// shared by all threads, set from the GUI while others may be computing
+	static std::atomic<bool>        lazy_reduction;
+	static std::atomic<std::size_t> limb_budget;
+	static std::atomic<bool>        limb_budget_error;
 
 public:
-	static void set_default_fractional_input(bool value);
-	static void set_default_fractional_output(bool value);
-	static void set_split_off_integer_for_fraction_output(bool value);
+	static void set_lazy_reduction(bool value);
+	static void set_limb_budget(std::size_t limbs, bool error);
 
 public:
 	explicit knumber_fraction(const QString &s);
 	knumber_fraction(qint64 num, quint64 den);
 	knumber_fraction(quint64 num, quint64 den);
 	explicit knumber_fraction(mpq_t mpq);
-	virtual ~knumber_fraction();
+	knumber_fraction(knumber_fraction &&other);
+	~knumber_fraction();
 
 public:
-	knumber_base *clone() override;
+	QString toString(int precision) const;
+	quint64 toUint64() const;
+	qint64 toInt64() const;
 
 public:
-	QString toString(int precision) const override;
-	quint64 toUint64() const override;
-	qint64 toInt64() const override;
+	bool is_integer() const;
+	bool is_zero() const;
+	int sign() const;
 
 public:
-	bool is_integer() const override;
-	bool is_zero() const override;
-	int sign() const override;
+	void add(knumber_base *self, knumber_error *rhs);
+	void add(knumber_base *self, knumber_integer *rhs);
+	void add(knumber_base *self, knumber_float *rhs);
+	void add(knumber_base *self, knumber_fraction *rhs);
+	void sub(knumber_base *self, knumber_error *rhs);
+	void sub(knumber_base *self, knumber_integer *rhs);
+	void sub(knumber_base *self, knumber_float *rhs);
+	void sub(knumber_base *self, knumber_fraction *rhs);
+	void mul(knumber_base *self, knumber_error *rhs);
+	void mul(knumber_base *self, knumber_integer *rhs);
+	void mul(knumber_base *self, knumber_float *rhs);
+	void mul(knumber_base *self, knumber_fraction *rhs);
+	void div(knumber_base *self, knumber_error *rhs);
+	void div(knumber_base *self, knumber_integer *rhs);
+	void div(knumber_base *self, knumber_float *rhs);
+	void div(knumber_base *self, knumber_fraction *rhs);
+	void mod(knumber_base *self, knumber_error *rhs);
+	void mod(knumber_base *self, knumber_integer *rhs);
+	void mod(knumber_base *self, knumber_float *rhs);
+	void mod(knumber_base *self, knumber_fraction *rhs);
 
 public:
-    knumber_base *add(knumber_base *rhs) override;
-    knumber_base *sub(knumber_base *rhs) override;
-    knumber_base *mul(knumber_base *rhs) override;
-    knumber_base *div(knumber_base *rhs) override;
-	knumber_base *mod(knumber_base *rhs) override;
+	void bitwise_and(knumber_base *self, knumber_error *rhs);
+	void bitwise_and(knumber_base *self, knumber_integer *rhs);
+	void bitwise_and(knumber_base *self, knumber_float *rhs);
+	void bitwise_and(knumber_base *self, knumber_fraction *rhs);
+	void bitwise_xor(knumber_base *self, knumber_error *rhs);
+	void bitwise_xor(knumber_base *self, knumber_integer *rhs);
+	void bitwise_xor(knumber_base *self, knumber_float *rhs);
+	void bitwise_xor(knumber_base *self, knumber_fraction *rhs);
+	void bitwise_or(knumber_base *self, knumber_error *rhs);
+	void bitwise_or(knumber_base *self, knumber_integer *rhs);
+	void bitwise_or(knumber_base *self, knumber_float *rhs);
+	void bitwise_or(knumber_base *self, knumber_fraction *rhs);
+	void bitwise_shift(knumber_base *self, knumber_error *rhs);
+	void bitwise_shift(knumber_base *self, knumber_integer *rhs);
+	void bitwise_shift(knumber_base *self, knumber_float *rhs);
+	void bitwise_shift(knumber_base *self, knumber_fraction *rhs);
 
 public:
-	knumber_base *bitwise_and(knumber_base *rhs) override;
-	knumber_base *bitwise_xor(knumber_base *rhs) override;
-	knumber_base *bitwise_or(knumber_base *rhs) override;
-	knumber_base *bitwise_shift(knumber_base *rhs) override;
+	void pow(knumber_base *self, knumber_error *rhs);
+	void pow(knumber_base *self, knumber_integer *rhs);
+	void pow(knumber_base *self, knumber_float *rhs);
+	void pow(knumber_base *self, knumber_fraction *rhs);
+	void neg(knumber_base *self);
+	void cmp(knumber_base *self);
+	void abs(knumber_base *self);
+	void sqrt(knumber_base *self);
+	void cbrt(knumber_base *self);
+	void factorial(knumber_base *self);
+	void reciprocal(knumber_base *self);
+	void tgamma(knumber_base *self);
 
 public:
-	knumber_base *pow(knumber_base *rhs) override;
-	knumber_base *neg() override;
-	knumber_base *cmp() override;
-	knumber_base *abs() override;
-	knumber_base *sqrt() override;
-	knumber_base *cbrt() override;
-	knumber_base *factorial() override;
-	knumber_base *reciprocal() override;
-	knumber_base *tgamma() override;
+	void log2(knumber_base *self);
+	void log10(knumber_base *self);
+	void ln(knumber_base *self);
+	void exp2(knumber_base *self);
+	void floor(knumber_base *self);
+	void ceil(knumber_base *self);
+	void exp10(knumber_base *self);
+	void exp(knumber_base *self);
+	void bin(knumber_base *self, knumber_error *rhs);
+	void bin(knumber_base *self, knumber_integer *rhs);
+	void bin(knumber_base *self, knumber_float *rhs);
+	void bin(knumber_base *self, knumber_fraction *rhs);
 
 public:
-	knumber_base *log2() override;
-	knumber_base *log10() override;
-	knumber_base *ln() override;
-	knumber_base *exp2() override;
-	knumber_base *floor() override;
-	knumber_base *ceil() override;
-	knumber_base *exp10() override;
-	knumber_base *exp() override;
-	knumber_base *bin(knumber_base *rhs) override;
+	void sin(knumber_base *self);
+	void cos(knumber_base *self);
+	void tan(knumber_base *self);
+	void asin(knumber_base *self);
+	void acos(knumber_base *self);
+	void atan(knumber_base *self);
+	void sinh(knumber_base *self);
+	void cosh(knumber_base *self);
+	void tanh(knumber_base *self);
+	void asinh(knumber_base *self);
+	void acosh(knumber_base *self);
+	void atanh(knumber_base *self);
 
 public:
-	knumber_base *sin() override;
-	knumber_base *cos() override;
-	knumber_base *tan() override;
-	knumber_base *asin() override;
-	knumber_base *acos() override;
-	knumber_base *atan() override;
-	knumber_base *sinh() override;
-	knumber_base *cosh() override;
-	knumber_base *tanh() override;
-	knumber_base *asinh() override;
-	knumber_base *acosh() override;
-	knumber_base *atanh() override;
+	int compare(knumber_error *rhs);
+	int compare(knumber_integer *rhs);
+	int compare(knumber_float *rhs);
+	int compare(knumber_fraction *rhs);
 
 public:
-	int compare(knumber_base *rhs) override;
+	// true if numerator and denominator in lowest terms have more limbs
+	// together than limb_budget, which is no limit if it is 0
+	bool exceeds_limb_budget();
 
 private:
-	knumber_integer *numerator() const;
-	knumber_integer *denominator() const;
+	// with lazy reduction, arithmetic leaves out the GCD which brings a
+	// fraction to lowest terms. it is done once the denominator has grown by
+	// more than lazy_reduction_limbs since the last time, or when something
+	// needs the lowest terms. the denominator is always positive
+	static const std::size_t lazy_reduction_limbs = 8;
+
+	void reduce();
+	void reduce_lazily();
+	void ensure_reduced();
+	void scale_reduced(mpz_srcptr x, bool divide);
 
 private:
 	// conversion constructors
@@ -129,7 +188,12 @@ private:
 	explicit knumber_fraction(const knumber_error *value);
 
 private:
-	mpq_t mpq_;
+	Q_DISABLE_COPY(knumber_fraction)
+
+private:
+	mpq_t       mpq_;
+	bool        reduced_;
+	std::size_t reduced_limbs_;  // size of the denominator after the last reduce()
 };
 
 }
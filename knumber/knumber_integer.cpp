@@ -17,15 +17,512 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
 #include <config-kcalc.h>
-#include "knumber_integer.h"
-#include "knumber_float.h"
-#include "knumber_fraction.h"
-#include "knumber_error.h"
-#include <QScopedArrayPointer>
+#include "knumber_base.h"
+#include "knumber_formatter.h"
+#include "knumber_allocator.h"
+#include "knumber_bits.h"
 #include <QDebug>
+#include <QThread>
+#include <QtConcurrentRun>
+#include <atomic>
+#include <deque>
+#include <limits>
+#include <vector>
+#include <math.h>
 
 namespace detail {
 
+namespace {
+
+// the flag KNumber::setCancelFlag() gave the calling thread
+thread_local const QAtomicInt *cancel_flag = 0;
+
+// factorials and binomials up to this and powers with fewer bits than
+// chunked_pow_bits are left to GMP in one call, they are quick enough
+// not to need canceling
+const unsigned long chunked_limit    = 20000;
+const unsigned long chunked_pow_bits = 1 << 20;
+
+// factorials above this are split over the thread pool when there are at
+// least parallel_min_threads threads to use, but over no more than
+// parallel_max_threads. the product trees do two to five times the work of
+// mpz_fac_ui, with 4 threads that leaves too little to be worth it and past
+// 32 the extra pieces cost more than the threads give. binomials stay with
+// mpz_bin_ui, which is faster than splitting them with any number of threads
+const unsigned long parallel_limit       = 100000;
+const int           parallel_min_threads = 8;
+const int           parallel_max_threads = 32;
+
+// the number of threads KNumber::setThreadCount() asked for, 0 is one for
+// each core
+std::atomic<int> thread_count(0);
+
+// how many factors the leaves of a product tree multiply one by one
+const unsigned long product_leaf = 64;
+
+// about how much memory GMP needs for a power, a factorial and a binomial
+// compared to the size of the result
+const double pow_scale       = 6;
+const double factorial_scale = 6;
+const double bin_scale       = 64;
+
+//------------------------------------------------------------------------------
+// Name: fits_ulong_abs
+//------------------------------------------------------------------------------
+bool fits_ulong_abs(const mpz_t x) {
+	return mpz_sizeinbase(x, 2) <= static_cast<size_t>(std::numeric_limits<unsigned long>::digits);
+}
+
+//------------------------------------------------------------------------------
+// Name: low_bits
+// Desc: the lowest 64 bits of |x|, straight from the limbs
+//------------------------------------------------------------------------------
+quint64 low_bits(const mpz_t x) {
+
+	const size_t limbs = mpz_size(x);
+	if(limbs <= 1) {
+		return limbs ? static_cast<quint64>(mpz_getlimbn(x, 0)) : 0;
+	}
+
+	quint64 value = 0;
+	for(size_t i = 0; i < limbs && i * GMP_NUMB_BITS < 64; ++i) {
+		value |= static_cast<quint64>(mpz_getlimbn(x, i)) << (i * GMP_NUMB_BITS);
+	}
+
+	return value;
+}
+
+//------------------------------------------------------------------------------
+// Name: power_bits
+// Desc: about how many bits x^e has
+//------------------------------------------------------------------------------
+double power_bits(const mpz_t x, unsigned long e) {
+
+	if(mpz_cmpabs_ui(x, 1) <= 0) {
+		return 1;
+	}
+
+	signed long int exp;
+	const double d = mpz_get_d_2exp(&exp, x);
+	return static_cast<double>(e) * (exp + ::log2(::fabs(d)));
+}
+
+//------------------------------------------------------------------------------
+// Name: factorial_bits
+// Desc: about how many bits n! has, from Stirling's formula
+//------------------------------------------------------------------------------
+double factorial_bits(double n) {
+
+	if(n < 2) {
+		return 1;
+	}
+
+	return n * ::log2(n) - n / M_LN2 + 0.5 * ::log2(2 * M_PI * n) + 1;
+}
+
+//------------------------------------------------------------------------------
+// Name: odd_part
+// Desc: x without the powers of two in it, x must not be 0
+//------------------------------------------------------------------------------
+unsigned long odd_part(unsigned long x) {
+	return x >> trailing_zeros(x);
+}
+
+//------------------------------------------------------------------------------
+// Name: range_product
+// Desc: r = a * (a + step) * (a + 2 * step) ... up to and including b, as a
+//       product tree so that the multiplications are of numbers of the same
+//       size. with odd_parts, the factors are divided by the powers of two
+//       they have in them. returns false if the computation has been canceled
+//------------------------------------------------------------------------------
+bool range_product(mpz_t r, unsigned long a, unsigned long b, unsigned long step, bool odd_parts = false) {
+
+	if(a > b) {
+		mpz_set_ui(r, 1);
+		return true;
+	}
+
+	const unsigned long count = (b - a) / step + 1;
+	if(count <= product_leaf) {
+		mpz_set_ui(r, odd_parts ? odd_part(a) : a);
+		for(unsigned long i = 1; i < count; ++i) {
+			mpz_mul_ui(r, r, odd_parts ? odd_part(a + i * step) : a + i * step);
+		}
+		knumber_budget_scope::check();
+		return !knumber_integer::canceled();
+	}
+
+	const unsigned long middle = a + (count / 2 - 1) * step;
+
+	mpz_t upper;
+	mpz_init(upper);
+	const bool done = range_product(r, a, middle, step, odd_parts) && range_product(upper, middle + step, b, step, odd_parts);
+	if(done) {
+		mpz_mul(r, r, upper);
+	}
+	mpz_clear(upper);
+	knumber_budget_scope::check();
+	return done && !knumber_integer::canceled();
+}
+
+//------------------------------------------------------------------------------
+// Name: chunked_factorial
+// Desc: n! as 2^(n - popcount(n)) times the odd numbers of (n / 2^(i + 1),
+//       n / 2^i] to the power of i + 1, for every i
+//------------------------------------------------------------------------------
+bool chunked_factorial(mpz_t r, unsigned long n) {
+
+	int levels = 0;
+	while((n >> levels) > 2) {
+		++levels;
+	}
+
+	mpz_t odd;
+	mpz_t level;
+	mpz_init_set_ui(odd, 1);
+	mpz_init(level);
+	mpz_set_ui(r, 1);
+
+	bool done = true;
+	for(int i = levels; i >= 0 && done; --i) {
+		const unsigned long first = (n >> (i + 1)) + 1;
+		const unsigned long last  = n >> i;
+		if(first > last) {
+			continue;
+		}
+		done = range_product(level, first | 1, (last & 1) ? last : last - 1, 2);
+		if(done) {
+			mpz_mul(odd, odd, level);
+			mpz_mul(r, r, odd);
+			knumber_budget_scope::check();
+		}
+	}
+
+	mpz_clear(level);
+	mpz_clear(odd);
+
+	if(!done) {
+		return false;
+	}
+
+	mpz_mul_2exp(r, r, n - bit_count(n));
+	return true;
+}
+
+//------------------------------------------------------------------------------
+// Name: chunked_bin
+// Desc: C(n, k) as (n - k + 1) * ... * n / k!, for 0 <= k <= n
+//------------------------------------------------------------------------------
+bool chunked_bin(mpz_t r, unsigned long n, unsigned long k) {
+
+	k = qMin(k, n - k);
+
+	mpz_t denominator;
+	mpz_init(denominator);
+	const bool done = range_product(r, n - k + 1, n, 1) && chunked_factorial(denominator, k);
+	if(done) {
+		mpz_divexact(r, r, denominator);
+	}
+	mpz_clear(denominator);
+	return done;
+}
+
+//------------------------------------------------------------------------------
+// Name: chunked_pow
+// Desc: r = base^e by squaring, one step for each bit of e. r may be base,
+//       e must not be 0
+//------------------------------------------------------------------------------
+bool chunked_pow(mpz_t r, const mpz_t base, unsigned long e) {
+
+	mpz_t b;
+	mpz_init_set(b, base);
+	mpz_set_ui(r, 1);
+
+	bool done = true;
+	for(int bit = highest_bit(e); bit >= 0 && done; --bit) {
+		mpz_mul(r, r, r);
+		if((e >> bit) & 1) {
+			mpz_mul(r, r, b);
+		}
+		knumber_budget_scope::check();
+		done = !knumber_integer::canceled();
+	}
+
+	mpz_clear(b);
+	return done;
+}
+
+//------------------------------------------------------------------------------
+// Name: parallel_threads
+//------------------------------------------------------------------------------
+int parallel_threads() {
+	const int count = thread_count.load(std::memory_order_relaxed);
+	return qMin((count > 0) ? count : QThread::idealThreadCount(), parallel_max_threads);
+}
+
+// a piece of a parallel product for the thread pool: either the product of
+// the odd parts of first to last, or that of a piece of the results of each
+// of two earlier tasks, shifted to where it goes in their product
+struct product_task {
+	const QAtomicInt    *flag;
+	std::atomic<qint64> *growth;
+	double               bits;
+	unsigned long        first;
+	unsigned long        last;
+	product_task        *lhs;
+	product_task        *rhs;
+	mp_size_t            lhs_offset;    // in limbs
+	mp_size_t            lhs_size;
+	mp_size_t            rhs_offset;
+	mp_size_t            rhs_size;
+	product_task        *sum;           // the task the pieces are added up in
+	mpz_t                result;
+	bool                 live;          // result is initialized
+	bool                 exceeded;
+};
+
+//------------------------------------------------------------------------------
+// Name: add_task
+//------------------------------------------------------------------------------
+product_task *add_task(std::deque<product_task> *tasks, double bits) {
+	tasks->push_back(product_task());
+	product_task *const task = &tasks->back();
+	task->flag   = cancel_flag;
+	task->growth = knumber_budget_scope::growth();
+	task->bits   = bits;
+	return task;
+}
+
+//------------------------------------------------------------------------------
+// Name: run_product_task
+// Desc: runs with the cancel flag of the thread which added the task and a
+//       budget scope which charges the operation of that thread. the result
+//       is initialized here, so that its memory is in that scope. returns
+//       false if the task was canceled
+//------------------------------------------------------------------------------
+bool run_product_task(product_task *task) {
+
+	const QAtomicInt *const flag = cancel_flag;
+	cancel_flag = task->flag;
+
+	bool done = false;
+	knumber_budget_scope scope(task->bits, task->growth);
+	try {
+		mpz_init(task->result);
+		if(task->lhs) {
+			mpz_t lhs;
+			mpz_t rhs;
+			mpz_roinit_n(lhs, mpz_limbs_read(task->lhs->result) + task->lhs_offset, task->lhs_size);
+			mpz_roinit_n(rhs, mpz_limbs_read(task->rhs->result) + task->rhs_offset, task->rhs_size);
+			mpz_mul(task->result, lhs, rhs);
+			mpz_mul_2exp(task->result, task->result, (task->lhs_offset + task->rhs_offset) * GMP_NUMB_BITS);
+			knumber_budget_scope::check();
+			done = !knumber_integer::canceled();
+		} else {
+			done = range_product(task->result, task->first, task->last, 1, true);
+		}
+	} catch(const knumber_budget_exceeded &) {
+		scope.release();
+		mpz_init(task->result);
+		task->exceeded = true;
+	}
+
+	task->live = true;
+	cancel_flag = flag;
+	return done;
+}
+
+//------------------------------------------------------------------------------
+// Name: run_tasks
+// Desc: runs the tasks on the thread pool and waits for all of them. the
+//       calling thread takes over the results, it frees them or adds them up.
+//       returns false if one was canceled or went over a budget
+//------------------------------------------------------------------------------
+bool run_tasks(const std::vector<product_task *> &round) {
+
+	std::vector<QFuture<bool> > futures;
+	for(std::size_t i = 0; i < round.size(); ++i) {
+		futures.push_back(QtConcurrent::run(run_product_task, round[i]));
+	}
+
+	bool done = true;
+	for(std::size_t i = 0; i < round.size(); ++i) {
+		done = futures[i].result() && !round[i]->exceeded && done;
+		knumber_budget_scope::track(round[i]->result->_mp_d, round[i]->result->_mp_alloc * sizeof(mp_limb_t));
+	}
+
+	return done;
+}
+
+//------------------------------------------------------------------------------
+// Name: split_product
+// Desc: adds the tasks for lhs * rhs, with each cut into this many pieces
+//------------------------------------------------------------------------------
+void split_product(std::deque<product_task> *tasks, std::vector<product_task *> *round, product_task *lhs, product_task *rhs, int pieces, double bits) {
+
+	const mp_size_t lhs_limbs = mpz_size(lhs->result);
+	const mp_size_t rhs_limbs = mpz_size(rhs->result);
+	pieces = static_cast<int>(qMin<mp_size_t>(pieces, qMin(lhs_limbs, rhs_limbs)));
+
+	product_task *sum = 0;
+	for(int i = 0; i < pieces; ++i) {
+		for(int j = 0; j < pieces; ++j) {
+			product_task *const task = add_task(tasks, bits);
+			task->lhs        = lhs;
+			task->rhs        = rhs;
+			task->lhs_offset = i * (lhs_limbs / pieces) + qMin<mp_size_t>(i, lhs_limbs % pieces);
+			task->lhs_size   = lhs_limbs / pieces + ((i < lhs_limbs % pieces) ? 1 : 0);
+			task->rhs_offset = j * (rhs_limbs / pieces) + qMin<mp_size_t>(j, rhs_limbs % pieces);
+			task->rhs_size   = rhs_limbs / pieces + ((j < rhs_limbs % pieces) ? 1 : 0);
+			task->sum        = sum ? sum : task;
+			sum = task->sum;
+			round->push_back(task);
+		}
+	}
+}
+
+//------------------------------------------------------------------------------
+// Name: parallel_product
+// Desc: r = the product of the odd parts of a, a + 1, ... b. the range is cut
+//       into one slice for each thread, then the products are multiplied two
+//       at a time. while there are fewer multiplications than threads, each
+//       of them is cut into pieces as well. returns false if the computation
+//       has been canceled, throws knumber_budget_exceeded if it went over a
+//       budget
+//------------------------------------------------------------------------------
+bool parallel_product(mpz_t r, unsigned long a, unsigned long b, int threads, double bits) {
+
+	const unsigned long count = b - a + 1;
+	const int slices          = static_cast<int>(qMin<unsigned long>(threads, qMax<unsigned long>(count / product_leaf, 1)));
+	const unsigned long size  = count / slices;
+	const unsigned long extra = count % slices;
+
+	// a deque, so that the tasks stay where they are while more are added
+	std::deque<product_task> tasks;
+
+	// the results which the next round multiplies, in the order of the range
+	std::vector<product_task *> level;
+
+	unsigned long first = a;
+	for(int i = 0; i < slices; ++i) {
+		product_task *const task = add_task(&tasks, bits);
+		task->first = first;
+		task->last  = first + size - ((static_cast<unsigned long>(i) < extra) ? 0 : 1);
+		first = task->last + 1;
+		level.push_back(task);
+	}
+
+	bool done     = run_tasks(level);
+	bool exceeded = false;
+
+	while(done && level.size() > 1) {
+
+		// the multiplications of a round share the threads
+		const int pairs = static_cast<int>(level.size() / 2);
+		int pieces = 1;
+		while((pieces + 1) * (pieces + 1) * pairs <= threads) {
+			++pieces;
+		}
+
+		std::vector<product_task *> round;
+		std::vector<product_task *> upper;
+		for(std::size_t i = 0; i + 1 < level.size(); i += 2) {
+			split_product(&tasks, &round, level[i], level[i + 1], pieces, bits);
+			upper.push_back(round.back()->sum);
+		}
+
+		if(level.size() % 2 != 0) {
+			upper.push_back(level.back());
+		}
+
+		done = run_tasks(round);
+		if(!done) {
+			break;
+		}
+
+		for(std::size_t i = 0; i < 2 * static_cast<std::size_t>(pairs); ++i) {
+			mpz_clear(level[i]->result);
+			level[i]->live = false;
+		}
+
+		// GMP grows the sum before it changes it, so the sum is still
+		// intact if that goes over a budget
+		try {
+			for(std::size_t i = 0; i < round.size(); ++i) {
+				if(round[i]->sum != round[i]) {
+					mpz_add(round[i]->sum->result, round[i]->sum->result, round[i]->result);
+					mpz_clear(round[i]->result);
+					round[i]->live = false;
+				}
+			}
+			knumber_budget_scope::check();
+		} catch(const knumber_budget_exceeded &) {
+			done     = false;
+			exceeded = true;
+			break;
+		}
+
+		level.swap(upper);
+	}
+
+	if(!done) {
+		for(std::deque<product_task>::iterator it = tasks.begin(); it != tasks.end(); ++it) {
+			if(it->live) {
+				mpz_clear(it->result);
+			}
+			exceeded = exceeded || it->exceeded;
+		}
+
+		if(exceeded) {
+			throw knumber_budget_exceeded();
+		}
+
+		return false;
+	}
+
+	mpz_swap(r, level[0]->result);
+	mpz_clear(level[0]->result);
+	return true;
+}
+
+//------------------------------------------------------------------------------
+// Name: parallel_factorial
+// Desc: n! as 2^(n - popcount(n)) times the odd parts of 1 ... n
+//------------------------------------------------------------------------------
+bool parallel_factorial(mpz_t r, unsigned long n, int threads, double bits) {
+
+	if(!parallel_product(r, 1, n, threads, bits)) {
+		return false;
+	}
+
+	mpz_mul_2exp(r, r, n - bit_count(n));
+	return true;
+}
+
+
+}
+
+//------------------------------------------------------------------------------
+// Name: set_thread_count
+//------------------------------------------------------------------------------
+void knumber_integer::set_thread_count(int count) {
+	thread_count = qMax(count, 0);
+}
+
+//------------------------------------------------------------------------------
+// Name: set_cancel_flag
+//------------------------------------------------------------------------------
+void knumber_integer::set_cancel_flag(const QAtomicInt *flag) {
+	cancel_flag = flag;
+}
+
+//------------------------------------------------------------------------------
+// Name: canceled
+//------------------------------------------------------------------------------
+bool knumber_integer::canceled() {
+	return cancel_flag && *cancel_flag != 0;
+}
+
 //------------------------------------------------------------------------------
 // Name: knumber_integer
 //------------------------------------------------------------------------------
@@ -111,10 +608,11 @@ knumber_integer::knumber_integer(const knumber_fraction *value) {
 }
 
 //------------------------------------------------------------------------------
-// Name: clone
+// Name: knumber_integer
 //------------------------------------------------------------------------------
-knumber_base *knumber_integer::clone() {
-	return new knumber_integer(this);
+knumber_integer::knumber_integer(knumber_integer &&other) {
+	mpz_init(mpz_);
+	mpz_swap(mpz_, other.mpz_);
 }
 
 //------------------------------------------------------------------------------
@@ -127,304 +625,357 @@ knumber_integer::~knumber_integer() {
 //------------------------------------------------------------------------------
 // Name: add
 //------------------------------------------------------------------------------
-knumber_base *knumber_integer::add(knumber_base *rhs) {
+void knumber_integer::add(knumber_base *, knumber_integer *rhs) {
+	mpz_add(mpz_, mpz_, rhs->mpz_);
+}
 
-	if(knumber_integer *const p = dynamic_cast<knumber_integer *>(rhs)) {
-		mpz_add(mpz_, mpz_, p->mpz_);
-		return this;
-	} else if(knumber_float *const p = dynamic_cast<knumber_float *>(rhs)) {
-		knumber_float *const f = new knumber_float(this);
-		delete this;
-		return f->add(p);
-	} else if(knumber_fraction *const p = dynamic_cast<knumber_fraction *>(rhs)) {
-		knumber_fraction *const q = new knumber_fraction(this);
-		delete this;
-		return q->add(p);
-	} else if(knumber_error *const p = dynamic_cast<knumber_error *>(rhs)) {
-		delete this;
-		return p->clone();
-	}
+//------------------------------------------------------------------------------
+// Name: add
+//------------------------------------------------------------------------------
+void knumber_integer::add(knumber_base *self, knumber_float *rhs) {
+	self->assign(knumber_float(this))->add(self, rhs);
+}
 
-	Q_ASSERT(0);
-	return 0;
+//------------------------------------------------------------------------------
+// Name: add
+// Desc: x + q as q + x
+//------------------------------------------------------------------------------
+void knumber_integer::add(knumber_base *self, knumber_fraction *rhs) {
+	knumber_integer x(std::move(*this));
+	self->assign(knumber_fraction(rhs))->add(self, &x);
+}
+
+//------------------------------------------------------------------------------
+// Name: add
+//------------------------------------------------------------------------------
+void knumber_integer::add(knumber_base *self, knumber_error *rhs) {
+	self->assign(knumber_error(rhs));
+}
+
+//------------------------------------------------------------------------------
+// Name: sub
+//------------------------------------------------------------------------------
+void knumber_integer::sub(knumber_base *, knumber_integer *rhs) {
+	mpz_sub(mpz_, mpz_, rhs->mpz_);
 }
 
 //------------------------------------------------------------------------------
 // Name: sub
 //------------------------------------------------------------------------------
-knumber_base *knumber_integer::sub(knumber_base *rhs) {
+void knumber_integer::sub(knumber_base *self, knumber_float *rhs) {
+	self->assign(knumber_float(this))->sub(self, rhs);
+}
+
+//------------------------------------------------------------------------------
+// Name: sub
+// Desc: x - q as -(q - x)
+//------------------------------------------------------------------------------
+void knumber_integer::sub(knumber_base *self, knumber_fraction *rhs) {
+	knumber_integer x(std::move(*this));
+	self->assign(knumber_fraction(rhs))->sub(self, &x);
+	self->neg();
+}
+
+//------------------------------------------------------------------------------
+// Name: sub
+//------------------------------------------------------------------------------
+void knumber_integer::sub(knumber_base *self, knumber_error *rhs) {
+	self->assign(knumber_error(rhs))->neg(self);
+}
+
+//------------------------------------------------------------------------------
+// Name: mul
+//------------------------------------------------------------------------------
+void knumber_integer::mul(knumber_base *self, knumber_integer *rhs) {
 
-	if(knumber_integer *const p = dynamic_cast<knumber_integer *>(rhs)) {
-		mpz_sub(mpz_, mpz_, p->mpz_);
-		return this;
-	} else if(knumber_float *const p = dynamic_cast<knumber_float *>(rhs)) {
-		knumber_float *f = new knumber_float(this);
-		delete this;
-		return f->sub(p);
-	} else if(knumber_fraction *const p = dynamic_cast<knumber_fraction *>(rhs)) {
-		knumber_fraction *q = new knumber_fraction(this);
-		delete this;
-		return q->sub(p);
-	} else if(knumber_error *const p = dynamic_cast<knumber_error *>(rhs)) {
-		knumber_base *e = p->clone();
-		delete this;
-		return e->neg();
+	// a product too big to be exact is worked out as a float instead
+	if(!knumber_allocator::fits_budget(static_cast<double>(mpz_sizeinbase(mpz_, 2)) + mpz_sizeinbase(rhs->mpz_, 2))) {
+		self->assign(knumber_float(this))->mul(self, rhs);
+		return;
 	}
 
-	Q_ASSERT(0);
-	return 0;
+	mpz_mul(mpz_, mpz_, rhs->mpz_);
 }
 
 //------------------------------------------------------------------------------
 // Name: mul
 //------------------------------------------------------------------------------
-knumber_base *knumber_integer::mul(knumber_base *rhs) {
-
-	if(knumber_integer *const p = dynamic_cast<knumber_integer *>(rhs)) {
-		mpz_mul(mpz_, mpz_, p->mpz_);
-		return this;
-	} else if(knumber_float *const p = dynamic_cast<knumber_float *>(rhs)) {
-		knumber_float *f = new knumber_float(this);
-		delete this;
-		return f->mul(p);
-	} else if(knumber_fraction *const p = dynamic_cast<knumber_fraction *>(rhs)) {
-		knumber_fraction *q = new knumber_fraction(this);
-		delete this;
-		return q->mul(p);
-	} else if(knumber_error *const p = dynamic_cast<knumber_error *>(rhs)) {
-
-		if(is_zero()) {
-			delete this;
-			knumber_error *e = new knumber_error(knumber_error::ERROR_UNDEFINED);
-			return e->neg();
-		}
+void knumber_integer::mul(knumber_base *self, knumber_float *rhs) {
+	self->assign(knumber_float(this))->mul(self, rhs);
+}
 
-		if(sign() < 0) {
-			delete this;
-			knumber_base *e = p->clone();
-			return e->neg();
-		} else {
-			delete this;
-			return p->clone();
-		}
+//------------------------------------------------------------------------------
+// Name: mul
+// Desc: x * q as q * x
+//------------------------------------------------------------------------------
+void knumber_integer::mul(knumber_base *self, knumber_fraction *rhs) {
+	knumber_integer x(std::move(*this));
+	self->assign(knumber_fraction(rhs))->mul(self, &x);
+}
+
+//------------------------------------------------------------------------------
+// Name: mul
+//------------------------------------------------------------------------------
+void knumber_integer::mul(knumber_base *self, knumber_error *rhs) {
+
+	if(is_zero()) {
+		self->emplace<knumber_error>(knumber_error::ERROR_UNDEFINED);
+	} else if(sign() < 0) {
+		self->assign(knumber_error(rhs))->neg(self);
+	} else {
+		self->assign(knumber_error(rhs));
+	}
+}
+
+//------------------------------------------------------------------------------
+// Name: div
+//------------------------------------------------------------------------------
+void knumber_integer::div(knumber_base *self, knumber_integer *rhs) {
+
+	if(rhs->is_zero()) {
+		self->emplace<knumber_error>((sign() < 0) ? knumber_error::ERROR_NEG_INFINITY : knumber_error::ERROR_POS_INFINITY);
+		return;
 	}
 
-	Q_ASSERT(0);
-	return 0;
+	self->assign(knumber_fraction(this))->div(self, rhs);
 }
 
 //------------------------------------------------------------------------------
 // Name: div
 //------------------------------------------------------------------------------
-knumber_base *knumber_integer::div(knumber_base *rhs) {
+void knumber_integer::div(knumber_base *self, knumber_float *rhs) {
 
 	if(rhs->is_zero()) {
-		if(sign() < 0) {
-			delete this;
-			return new knumber_error(knumber_error::ERROR_NEG_INFINITY);
-		} else {
-			delete this;
-			return new knumber_error(knumber_error::ERROR_POS_INFINITY);
-		}
+		self->emplace<knumber_error>((sign() < 0) ? knumber_error::ERROR_NEG_INFINITY : knumber_error::ERROR_POS_INFINITY);
+		return;
 	}
 
-	if(knumber_integer *const p = dynamic_cast<knumber_integer *>(rhs)) {
-		knumber_fraction *q = new knumber_fraction(this);
-		delete this;
-		return q->div(p);
-	} else if(knumber_float *const p = dynamic_cast<knumber_float *>(rhs)) {
-		knumber_float *f = new knumber_float(this);
-		delete this;
-		return f->div(p);
-	} else if(knumber_fraction *const p = dynamic_cast<knumber_fraction *>(rhs)) {
-		knumber_fraction *q = new knumber_fraction(this);
-		delete this;
-		return q->div(p);
-	} else if(knumber_error *const p = dynamic_cast<knumber_error *>(rhs)) {
-
-		if(p->sign() > 0) {
-			delete this;
-			return new knumber_integer(0);
-		} else if(p->sign() < 0) {
-			delete this;
-			return new knumber_integer(0);
-		}
+	self->assign(knumber_float(this))->div(self, rhs);
+}
 
-		delete this;
-		return p->clone();
+//------------------------------------------------------------------------------
+// Name: div
+//------------------------------------------------------------------------------
+void knumber_integer::div(knumber_base *self, knumber_fraction *rhs) {
+
+	if(rhs->is_zero()) {
+		self->emplace<knumber_error>((sign() < 0) ? knumber_error::ERROR_NEG_INFINITY : knumber_error::ERROR_POS_INFINITY);
+		return;
 	}
 
-	Q_ASSERT(0);
-	return 0;
+	self->assign(knumber_fraction(this))->div(self, rhs);
+}
+
+//------------------------------------------------------------------------------
+// Name: div
+//------------------------------------------------------------------------------
+void knumber_integer::div(knumber_base *self, knumber_error *rhs) {
+
+	if(rhs->sign() != 0) {
+		self->emplace<knumber_integer>(0);
+	} else {
+		self->assign(knumber_error(rhs));
+	}
 }
 
 //------------------------------------------------------------------------------
 // Name: mod
 //------------------------------------------------------------------------------
-knumber_base *knumber_integer::mod(knumber_base *rhs) {
+void knumber_integer::mod(knumber_base *self, knumber_integer *rhs) {
 
 	if(rhs->is_zero()) {
-		delete this;
-		return new knumber_error(knumber_error::ERROR_UNDEFINED);
+		self->emplace<knumber_error>(knumber_error::ERROR_UNDEFINED);
+		return;
 	}
 
-	if(knumber_integer *const p = dynamic_cast<knumber_integer *>(rhs)) {
-		mpz_mod(mpz_, mpz_, p->mpz_);
-		return this;
-	} else if(knumber_float *const p = dynamic_cast<knumber_float *>(rhs)) {
-		knumber_float *f = new knumber_float(this);
-		delete this;
-		return f->mod(p);
-	} else if(knumber_fraction *const p = dynamic_cast<knumber_fraction *>(rhs)) {
-		knumber_fraction *q = new knumber_fraction(this);
-		delete this;
-		return q->mod(p);
-	} else if(knumber_error *const p = dynamic_cast<knumber_error *>(rhs)) {
-		delete this;
-		return p->clone();
+	mpz_mod(mpz_, mpz_, rhs->mpz_);
+}
+
+//------------------------------------------------------------------------------
+// Name: mod
+//------------------------------------------------------------------------------
+void knumber_integer::mod(knumber_base *self, knumber_float *rhs) {
+
+	if(rhs->is_zero()) {
+		self->emplace<knumber_error>(knumber_error::ERROR_UNDEFINED);
+		return;
 	}
 
-	Q_ASSERT(0);
-	return 0;
+	self->assign(knumber_float(this))->mod(self, rhs);
 }
 
 //------------------------------------------------------------------------------
-// Name: bitwise_and
+// Name: mod
 //------------------------------------------------------------------------------
-knumber_base *knumber_integer::bitwise_and(knumber_base *rhs) {
+void knumber_integer::mod(knumber_base *self, knumber_fraction *rhs) {
 
-	if(knumber_integer *const p = dynamic_cast<knumber_integer *>(rhs)) {
-		mpz_and(mpz_, mpz_, p->mpz_);
-		return this;
-	} else if(knumber_float *const p = dynamic_cast<knumber_float *>(rhs)) {
-		knumber_float *f = new knumber_float(this);
-		delete this;
-		return f->bitwise_and(p);
-	} else if(knumber_fraction *const p = dynamic_cast<knumber_fraction *>(rhs)) {
-		knumber_fraction *f = new knumber_fraction(this);
-		delete this;
-		return f->bitwise_and(p);
-	} else if(knumber_error *const p = dynamic_cast<knumber_error *>(rhs)) {
-		delete this;
-		return p->clone();
+	if(rhs->is_zero()) {
+		self->emplace<knumber_error>(knumber_error::ERROR_UNDEFINED);
+		return;
 	}
 
-	Q_ASSERT(0);
-	return 0;
+	self->assign(knumber_fraction(this))->mod(self, rhs);
+}
+
+//------------------------------------------------------------------------------
+// Name: mod
+//------------------------------------------------------------------------------
+void knumber_integer::mod(knumber_base *self, knumber_error *rhs) {
+	self->assign(knumber_error(rhs));
+}
+
+//------------------------------------------------------------------------------
+// Name: bitwise_and
+//------------------------------------------------------------------------------
+void knumber_integer::bitwise_and(knumber_base *, knumber_integer *rhs) {
+	mpz_and(mpz_, mpz_, rhs->mpz_);
+}
+
+//------------------------------------------------------------------------------
+// Name: bitwise_and
+//------------------------------------------------------------------------------
+void knumber_integer::bitwise_and(knumber_base *self, knumber_float *rhs) {
+	self->assign(knumber_float(this))->bitwise_and(self, rhs);
+}
+
+//------------------------------------------------------------------------------
+// Name: bitwise_and
+//------------------------------------------------------------------------------
+void knumber_integer::bitwise_and(knumber_base *self, knumber_fraction *rhs) {
+	self->assign(knumber_fraction(this))->bitwise_and(self, rhs);
+}
+
+//------------------------------------------------------------------------------
+// Name: bitwise_and
+//------------------------------------------------------------------------------
+void knumber_integer::bitwise_and(knumber_base *self, knumber_error *rhs) {
+	self->assign(knumber_error(rhs));
 }
 
 //------------------------------------------------------------------------------
 // Name: bitwise_xor
 //------------------------------------------------------------------------------
-knumber_base *knumber_integer::bitwise_xor(knumber_base *rhs) {
+void knumber_integer::bitwise_xor(knumber_base *, knumber_integer *rhs) {
+	mpz_xor(mpz_, mpz_, rhs->mpz_);
+}
 
-	if(knumber_integer *const p = dynamic_cast<knumber_integer *>(rhs)) {
-		mpz_xor(mpz_, mpz_, p->mpz_);
-		return this;
-	} else if(knumber_float *const p = dynamic_cast<knumber_float *>(rhs)) {
-		knumber_float *f = new knumber_float(this);
-		delete this;
-		return f->bitwise_xor(p);
-	} else if(knumber_fraction *const p = dynamic_cast<knumber_fraction *>(rhs)) {
-		knumber_fraction *f = new knumber_fraction(this);
-		delete this;
-		return f->bitwise_xor(p);
-	} else if(knumber_error *const p = dynamic_cast<knumber_error *>(rhs)) {
-		delete this;
-		return p->clone();
-	}
+//------------------------------------------------------------------------------
+// Name: bitwise_xor
+//------------------------------------------------------------------------------
+void knumber_integer::bitwise_xor(knumber_base *self, knumber_float *rhs) {
+	self->assign(knumber_float(this))->bitwise_xor(self, rhs);
+}
+
+//------------------------------------------------------------------------------
+// Name: bitwise_xor
+//------------------------------------------------------------------------------
+void knumber_integer::bitwise_xor(knumber_base *self, knumber_fraction *rhs) {
+	self->assign(knumber_fraction(this))->bitwise_xor(self, rhs);
+}
 
-	Q_ASSERT(0);
-	return 0;
+//------------------------------------------------------------------------------
+// Name: bitwise_xor
+//------------------------------------------------------------------------------
+void knumber_integer::bitwise_xor(knumber_base *self, knumber_error *rhs) {
+	self->assign(knumber_error(rhs));
 }
 
 //------------------------------------------------------------------------------
 // Name: bitwise_or
 //------------------------------------------------------------------------------
-knumber_base *knumber_integer::bitwise_or(knumber_base *rhs) {
+void knumber_integer::bitwise_or(knumber_base *, knumber_integer *rhs) {
+	mpz_ior(mpz_, mpz_, rhs->mpz_);
+}
 
-	if(knumber_integer *const p = dynamic_cast<knumber_integer *>(rhs)) {
-		mpz_ior(mpz_, mpz_, p->mpz_);
-		return this;
-	} else if(knumber_float *const p = dynamic_cast<knumber_float *>(rhs)) {
-		knumber_float *f = new knumber_float(this);
-		delete this;
-		return f->bitwise_or(p);
-	} else if(knumber_fraction *const p = dynamic_cast<knumber_fraction *>(rhs)) {
-		knumber_fraction *f = new knumber_fraction(this);
-		delete this;
-		return f->bitwise_or(p);
-	} else if(knumber_error *const p = dynamic_cast<knumber_error *>(rhs)) {
-		delete this;
-		return p->clone();
-	}
+//------------------------------------------------------------------------------
+// Name: bitwise_or
+//------------------------------------------------------------------------------
+void knumber_integer::bitwise_or(knumber_base *self, knumber_float *rhs) {
+	self->assign(knumber_float(this))->bitwise_or(self, rhs);
+}
+
+//------------------------------------------------------------------------------
+// Name: bitwise_or
+//------------------------------------------------------------------------------
+void knumber_integer::bitwise_or(knumber_base *self, knumber_fraction *rhs) {
+	self->assign(knumber_fraction(this))->bitwise_or(self, rhs);
+}
 
-	Q_ASSERT(0);
-	return 0;
+//------------------------------------------------------------------------------
+// Name: bitwise_or
+//------------------------------------------------------------------------------
+void knumber_integer::bitwise_or(knumber_base *self, knumber_error *rhs) {
+	self->assign(knumber_error(rhs));
 }
 
 //------------------------------------------------------------------------------
 // Name: bitwise_shift
 //------------------------------------------------------------------------------
-knumber_base *knumber_integer::bitwise_shift(knumber_base *rhs) {
-
-	if(knumber_integer *const p = dynamic_cast<knumber_integer *>(rhs)) {
-
-		const signed long int bit_count = mpz_get_si(p->mpz_);
-
-		// TODO: left shift with high bit set is broken in
-		//       non decimal modes :-/, always displays 0
-		//       interestingly, the bit is not "lost"
-		//       we simply don't have a mechanism to display
-		//       values in HEX/DEC/OCT mode which are greater than
-		//       64-bits
-
-		if(bit_count > 0) {
-			// left shift
-			mpz_mul_2exp(mpz_, mpz_, bit_count);
-		} else if(bit_count < 0) {
-        	// right shift
-        	if(mpz_sgn(mpz_) < 0) {
-            	mpz_fdiv_q_2exp(mpz_, mpz_, -bit_count);
-        	} else {
-            	mpz_tdiv_q_2exp(mpz_, mpz_, -bit_count);
-        	}
+void knumber_integer::bitwise_shift(knumber_base *self, knumber_integer *rhs) {
+
+	const signed long int bit_count = mpz_get_si(rhs->mpz_);
+
+	// TODO: left shift with high bit set is broken in
+	//       non decimal modes :-/, always displays 0
+	//       interestingly, the bit is not "lost"
+	//       we simply don't have a mechanism to display
+	//       values in HEX/DEC/OCT mode which are greater than
+	//       64-bits
+
+	if(bit_count > 0) {
+		// left shift, a result too big to be exact is infinite
+		if(!is_zero() && !knumber_allocator::fits_budget(static_cast<double>(mpz_sizeinbase(mpz_, 2)) + bit_count)) {
+			const bool negative = sign() < 0;
+			knumber_error *const e = self->emplace<knumber_error>(knumber_error::ERROR_POS_INFINITY);
+			if(negative) {
+				e->neg(self);
+			}
+			return;
+		}
+		mpz_mul_2exp(mpz_, mpz_, bit_count);
+	} else if(bit_count < 0) {
+		// right shift
+		if(mpz_sgn(mpz_) < 0) {
+			mpz_fdiv_q_2exp(mpz_, mpz_, -bit_count);
+		} else {
+			mpz_tdiv_q_2exp(mpz_, mpz_, -bit_count);
 		}
-		return this;
-	} else if(knumber_float *const p = dynamic_cast<knumber_float *>(rhs)) {
-		Q_UNUSED(p);
-		knumber_error *e = new knumber_error(knumber_error::ERROR_UNDEFINED);
-		delete this;
-		return e;
-	} else if(knumber_fraction *const p = dynamic_cast<knumber_fraction *>(rhs)) {
-		Q_UNUSED(p);
-		knumber_error *e = new knumber_error(knumber_error::ERROR_UNDEFINED);
-		delete this;
-		return e;
-	} else if(knumber_error *const p = dynamic_cast<knumber_error *>(rhs)) {
-		Q_UNUSED(p);
-		knumber_error *e = new knumber_error(knumber_error::ERROR_UNDEFINED);
-		delete this;
-		return e;
 	}
+}
 
-	Q_ASSERT(0);
-	return 0;
+//------------------------------------------------------------------------------
+// Name: bitwise_shift
+//------------------------------------------------------------------------------
+void knumber_integer::bitwise_shift(knumber_base *self, knumber_float *) {
+	self->emplace<knumber_error>(knumber_error::ERROR_UNDEFINED);
+}
+
+//------------------------------------------------------------------------------
+// Name: bitwise_shift
+//------------------------------------------------------------------------------
+void knumber_integer::bitwise_shift(knumber_base *self, knumber_fraction *) {
+	self->emplace<knumber_error>(knumber_error::ERROR_UNDEFINED);
+}
+
+//------------------------------------------------------------------------------
+// Name: bitwise_shift
+//------------------------------------------------------------------------------
+void knumber_integer::bitwise_shift(knumber_base *self, knumber_error *) {
+	self->emplace<knumber_error>(knumber_error::ERROR_UNDEFINED);
 }
 
 //------------------------------------------------------------------------------
 // Name: neg
 //------------------------------------------------------------------------------
-knumber_base *knumber_integer::neg() {
+void knumber_integer::neg(knumber_base *) {
 
 	mpz_neg(mpz_, mpz_);
-	return this;
 }
 
 //------------------------------------------------------------------------------
 // Name: cmp
 //------------------------------------------------------------------------------
-knumber_base *knumber_integer::cmp() {
+void knumber_integer::cmp(knumber_base *) {
 
 #if 0
 	// unfortunately this breaks things pretty badly
@@ -433,260 +984,284 @@ knumber_base *knumber_integer::cmp() {
 #else
 	mpz_swap(mpz_, knumber_integer(~toUint64()).mpz_);
 #endif
-	return this;
 }
 
 //------------------------------------------------------------------------------
 // Name: abs
 //------------------------------------------------------------------------------
-knumber_base *knumber_integer::abs() {
+void knumber_integer::abs(knumber_base *) {
 
 	mpz_abs(mpz_, mpz_);
-	return this;
 }
 
 //------------------------------------------------------------------------------
 // Name: sqrt
 //------------------------------------------------------------------------------
-knumber_base *knumber_integer::sqrt() {
+void knumber_integer::sqrt(knumber_base *self) {
 
 	if(sign() < 0) {
-		delete this;
-		return new knumber_error(knumber_error::ERROR_UNDEFINED);
+		self->emplace<knumber_error>(knumber_error::ERROR_UNDEFINED);
+		return;
 	}
 
 	if(mpz_perfect_square_p(mpz_)) {
 		mpz_sqrt(mpz_, mpz_);
-		return this;
 	} else {
-		knumber_float *f = new knumber_float(this);
-		delete this;
-		return f->sqrt();
+		self->assign(knumber_float(this))->sqrt(self);
 	}
 }
 
 //------------------------------------------------------------------------------
 // Name: cbrt
 //------------------------------------------------------------------------------
-knumber_base *knumber_integer::cbrt() {
+void knumber_integer::cbrt(knumber_base *self) {
 
 	mpz_t x;
 	mpz_init_set(x, mpz_);
 	if(mpz_root(x, x, 3)) {
 		mpz_swap(mpz_, x);
 		mpz_clear(x);
-		return this;
+		return;
 	}
 
 	mpz_clear(x);
-	knumber_float *f = new knumber_float(this);
-	delete this;
-	return f->cbrt();
+	self->assign(knumber_float(this))->cbrt(self);
 }
 
 //------------------------------------------------------------------------------
 // Name: pow
 //------------------------------------------------------------------------------
-knumber_base *knumber_integer::pow(knumber_base *rhs) {
+void knumber_integer::pow(knumber_base *self, knumber_integer *rhs) {
 
-	if(knumber_integer *const p = dynamic_cast<knumber_integer *>(rhs)) {
-
-		if(is_zero() && p->is_even() && p->sign() < 0) {
-			delete this;
-			return new knumber_error(knumber_error::ERROR_POS_INFINITY);
-		}
+	if(is_zero() && rhs->is_even() && rhs->sign() < 0) {
+		self->emplace<knumber_error>(knumber_error::ERROR_POS_INFINITY);
+		return;
+	}
 
-		mpz_pow_ui(mpz_, mpz_, mpz_get_ui(p->mpz_));
+	// a power too big to be exact is worked out as a float instead
+	const double bits = fits_ulong_abs(rhs->mpz_) ? power_bits(mpz_, mpz_get_ui(rhs->mpz_)) : std::numeric_limits<double>::infinity();
+	if(!knumber_allocator::fits_budget(bits, pow_scale)) {
+		self->assign(knumber_float(this))->pow(self, rhs);
+		return;
+	}
 
-		if(p->sign() < 0) {
-			return reciprocal();
-		} else {
-			return this;
-		}
-	} else if(knumber_float *const p = dynamic_cast<knumber_float *>(rhs)) {
-		knumber_float *f = new knumber_float(this);
-		delete this;
-		return f->pow(p);
-	} else if(knumber_fraction *const p = dynamic_cast<knumber_fraction *>(rhs)) {
-		knumber_fraction *f = new knumber_fraction(this);
-		delete this;
-		return f->pow(p);
-	} else if(knumber_error *const p = dynamic_cast<knumber_error *>(rhs)) {
-		if(p->sign() > 0) {
-			knumber_error *e = new knumber_error(knumber_error::ERROR_POS_INFINITY);
-			delete this;
-			return e;
-		} else if(p->sign() < 0) {
-			mpz_init_set_si(mpz_, 0);
-			return this;
+	const unsigned long e = mpz_get_ui(rhs->mpz_);
+	knumber_budget_scope scope(bits * pow_scale);
+	try {
+		if(cancel_flag && mpz_sizeinbase(mpz_, 2) * e > chunked_pow_bits) {
+			if(!chunked_pow(mpz_, mpz_, e)) {
+				self->emplace<knumber_error>(knumber_error::ERROR_UNDEFINED);
+				return;
+			}
 		} else {
-			knumber_error *e = new knumber_error(knumber_error::ERROR_UNDEFINED);
-			delete this;
-			return e;
+			mpz_pow_ui(mpz_, mpz_, e);
 		}
+		knumber_budget_scope::check();
+	} catch(const knumber_budget_exceeded &) {
+		self->emplace<knumber_error>(knumber_error::ERROR_UNDEFINED);
+		scope.release();
+		return;
 	}
 
-	Q_ASSERT(0);
-	return 0;
+	if(rhs->sign() < 0) {
+		reciprocal(self);
+	}
+}
+
+//------------------------------------------------------------------------------
+// Name: pow
+//------------------------------------------------------------------------------
+void knumber_integer::pow(knumber_base *self, knumber_float *rhs) {
+	self->assign(knumber_float(this))->pow(self, rhs);
+}
+
+//------------------------------------------------------------------------------
+// Name: pow
+//------------------------------------------------------------------------------
+void knumber_integer::pow(knumber_base *self, knumber_fraction *rhs) {
+	self->assign(knumber_fraction(this))->pow(self, rhs);
+}
+
+//------------------------------------------------------------------------------
+// Name: pow
+//------------------------------------------------------------------------------
+void knumber_integer::pow(knumber_base *self, knumber_error *rhs) {
+
+	if(rhs->sign() > 0) {
+		self->emplace<knumber_error>(knumber_error::ERROR_POS_INFINITY);
+	} else if(rhs->sign() < 0) {
+		mpz_set_si(mpz_, 0);
+	} else {
+		self->emplace<knumber_error>(knumber_error::ERROR_UNDEFINED);
+	}
 }
 
 //------------------------------------------------------------------------------
 // Name: sin
 //------------------------------------------------------------------------------
-knumber_base *knumber_integer::sin() {
+void knumber_integer::sin(knumber_base *self) {
 
-	knumber_float *f = new knumber_float(this);
-	delete this;
-	return f->sin();
+	self->assign(knumber_float(this))->sin(self);
 }
 
 //------------------------------------------------------------------------------
 // Name: cos
 //------------------------------------------------------------------------------
-knumber_base *knumber_integer::cos() {
+void knumber_integer::cos(knumber_base *self) {
 
-	knumber_float *f = new knumber_float(this);
-	delete this;
-	return f->cos();
+	self->assign(knumber_float(this))->cos(self);
 }
 
 //------------------------------------------------------------------------------
 // Name: tan
 //------------------------------------------------------------------------------
-knumber_base *knumber_integer::tan() {
+void knumber_integer::tan(knumber_base *self) {
 
-	knumber_float *f = new knumber_float(this);
-	delete this;
-	return f->tan();
+	self->assign(knumber_float(this))->tan(self);
 }
 
 //------------------------------------------------------------------------------
 // Name: asin
 //------------------------------------------------------------------------------
-knumber_base *knumber_integer::asin() {
+void knumber_integer::asin(knumber_base *self) {
 
-	knumber_float *f = new knumber_float(this);
-	delete this;
-	return f->asin();
+	self->assign(knumber_float(this))->asin(self);
 }
 
 //------------------------------------------------------------------------------
 // Name: acos
 //------------------------------------------------------------------------------
-knumber_base *knumber_integer::acos() {
+void knumber_integer::acos(knumber_base *self) {
 
-	knumber_float *f = new knumber_float(this);
-	delete this;
-	return f->acos();
+	self->assign(knumber_float(this))->acos(self);
 }
 
 //------------------------------------------------------------------------------
 // Name: atan
 //------------------------------------------------------------------------------
-knumber_base *knumber_integer::atan() {
+void knumber_integer::atan(knumber_base *self) {
 
-	knumber_float *f = new knumber_float(this);
-	delete this;
-	return f->atan();
+	self->assign(knumber_float(this))->atan(self);
 }
 
 //------------------------------------------------------------------------------
 // Name: tgamma
 //------------------------------------------------------------------------------
-knumber_base *knumber_integer::tgamma() {
+void knumber_integer::tgamma(knumber_base *self) {
 
-	knumber_float *f = new knumber_float(this);
-	delete this;
-	return f->tgamma();
+	self->assign(knumber_float(this))->tgamma(self);
 }
 
 //------------------------------------------------------------------------------
 // Name:
 //------------------------------------------------------------------------------
-knumber_base *knumber_integer::sinh() {
-	knumber_float *f = new knumber_float(this);
-	delete this;
-	return f->sinh();
+void knumber_integer::sinh(knumber_base *self) {
+	self->assign(knumber_float(this))->sinh(self);
 }
 
 //------------------------------------------------------------------------------
 // Name:
 //------------------------------------------------------------------------------
-knumber_base *knumber_integer::cosh() {
-	knumber_float *f = new knumber_float(this);
-	delete this;
-	return f->cosh();
+void knumber_integer::cosh(knumber_base *self) {
+	self->assign(knumber_float(this))->cosh(self);
 }
 
 //------------------------------------------------------------------------------
 // Name:
 //------------------------------------------------------------------------------
-knumber_base *knumber_integer::tanh() {
-	knumber_float *f = new knumber_float(this);
-	delete this;
-	return f->tanh();
+void knumber_integer::tanh(knumber_base *self) {
+	self->assign(knumber_float(this))->tanh(self);
 }
 
 //------------------------------------------------------------------------------
 // Name:
 //------------------------------------------------------------------------------
-knumber_base *knumber_integer::asinh() {
-	knumber_float *f = new knumber_float(this);
-	delete this;
-	return f->asinh();
+void knumber_integer::asinh(knumber_base *self) {
+	self->assign(knumber_float(this))->asinh(self);
 }
 
 //------------------------------------------------------------------------------
 // Name:
 //------------------------------------------------------------------------------
-knumber_base *knumber_integer::acosh() {
-	knumber_float *f = new knumber_float(this);
-	delete this;
-	return f->acosh();
+void knumber_integer::acosh(knumber_base *self) {
+	self->assign(knumber_float(this))->acosh(self);
 }
 
 //------------------------------------------------------------------------------
 // Name:
 //------------------------------------------------------------------------------
-knumber_base *knumber_integer::atanh() {
-	knumber_float *f = new knumber_float(this);
-	delete this;
-	return f->atanh();
+void knumber_integer::atanh(knumber_base *self) {
+	self->assign(knumber_float(this))->atanh(self);
 }
 
 //------------------------------------------------------------------------------
 // Name: factorial
 //------------------------------------------------------------------------------
-knumber_base *knumber_integer::factorial() {
+void knumber_integer::factorial(knumber_base *self) {
 
 	if(sign() < 0) {
-		delete this;
-		return new knumber_error(knumber_error::ERROR_UNDEFINED);
+		self->emplace<knumber_error>(knumber_error::ERROR_UNDEFINED);
+		return;
 	}
 
-	mpz_fac_ui(mpz_, mpz_get_ui(mpz_));
-	return this;
+	// a factorial too big to be exact is infinite
+	const double bits = mpz_fits_ulong_p(mpz_) ? factorial_bits(mpz_get_d(mpz_)) : std::numeric_limits<double>::infinity();
+	if(!knumber_allocator::fits_budget(bits, factorial_scale)) {
+		self->emplace<knumber_error>(knumber_error::ERROR_POS_INFINITY);
+		return;
+	}
+
+	const unsigned long n = mpz_get_ui(mpz_);
+	const int threads     = parallel_threads();
+	knumber_budget_scope scope(bits * factorial_scale);
+	try {
+		bool done = true;
+		if(n > parallel_limit && threads >= parallel_min_threads) {
+			done = parallel_factorial(mpz_, n, threads, bits * factorial_scale);
+		} else if(cancel_flag && n > chunked_limit) {
+			done = chunked_factorial(mpz_, n);
+		} else {
+			mpz_fac_ui(mpz_, n);
+		}
+		knumber_budget_scope::check();
+
+		if(!done) {
+			self->emplace<knumber_error>(knumber_error::ERROR_UNDEFINED);
+		}
+	} catch(const knumber_budget_exceeded &) {
+		self->emplace<knumber_error>(knumber_error::ERROR_UNDEFINED);
+		scope.release();
+	}
 }
 
 //------------------------------------------------------------------------------
 // Name: compare
 //------------------------------------------------------------------------------
-int knumber_integer::compare(knumber_base *rhs) {
+int knumber_integer::compare(knumber_integer *rhs) {
+	return mpz_cmp(mpz_, rhs->mpz_);
+}
 
-	if(knumber_integer *const p = dynamic_cast<knumber_integer *>(rhs)) {
-		return mpz_cmp(mpz_, p->mpz_);
-	} else if(knumber_float *const p = dynamic_cast<knumber_float *>(rhs)) {
-		return knumber_float(this).compare(p);
-	} else if(knumber_fraction *const p = dynamic_cast<knumber_fraction *>(rhs)) {
-		return knumber_fraction(this).compare(p);
-	} else if(knumber_error *const p = dynamic_cast<knumber_error *>(rhs)) {
-		// NOTE: any number compared to NaN/Inf/-Inf always compares less
-		//       at the moment
-		return -1;
-	}
+//------------------------------------------------------------------------------
+// Name: compare
+//------------------------------------------------------------------------------
+int knumber_integer::compare(knumber_float *rhs) {
+	return -rhs->compare(this);
+}
 
-	Q_ASSERT(0);
-	return 0;
+//------------------------------------------------------------------------------
+// Name: compare
+//------------------------------------------------------------------------------
+int knumber_integer::compare(knumber_fraction *rhs) {
+	return -rhs->compare(this);
+}
+
+//------------------------------------------------------------------------------
+// Name: compare
+//------------------------------------------------------------------------------
+int knumber_integer::compare(knumber_error *) {
+	// NOTE: any number compared to NaN/Inf/-Inf always compares less
+	//       at the moment
+	return -1;
 }
 
 //------------------------------------------------------------------------------
@@ -695,55 +1270,34 @@ int knumber_integer::compare(knumber_base *rhs) {
 QString knumber_integer::toString(int precision) const {
 
 	Q_UNUSED(precision);
-
-    const size_t size = gmp_snprintf(NULL, 0, "%Zd", mpz_) + 1;
-	QScopedArrayPointer<char> buf(new char[size]);
-    gmp_snprintf(&buf[0], size, "%Zd", mpz_);
-    return QLatin1String(&buf[0]);
+	return knumber_formatter::format_integer(mpz_, -1);
 }
 
 //------------------------------------------------------------------------------
-// Name:
+// Name: toUint64
+// Desc: the lowest 64 bits of the two's complement, so this wraps around
 //------------------------------------------------------------------------------
 quint64 knumber_integer::toUint64() const {
-    // libgmp doesn't have unsigned long long conversion
-    // so convert to string and then to unsigned long long
-    const QString tmpstring = toString(-1);
-
-    bool ok;
-    quint64 value;
-
-    if (sign() < 0) {
-        const qint64 signedvalue = tmpstring.toLongLong(&ok, 10);
-        value = static_cast<quint64>(signedvalue);
-    } else {
-        value = tmpstring.toULongLong(&ok, 10);
-    }
-
-    if (!ok) {
-        // TODO: what to do if error?
-        value = 0;
-    }
-    return value;
+	const quint64 magnitude = low_bits(mpz_);
+	return (mpz_sgn(mpz_) < 0) ? 0 - magnitude : magnitude;
 }
 
 //------------------------------------------------------------------------------
-// Name:
+// Name: toInt64
+// Desc: values out of range give the closest of INT64_MIN and INT64_MAX
 //------------------------------------------------------------------------------
 qint64 knumber_integer::toInt64() const {
-	// libgmp doesn't have long long conversion
-	// so convert to string and then to long long
-	const QString tmpstring = toString(-1);
 
-	bool ok;
-	qint64 value = tmpstring.toLongLong(&ok, 10);
+	if(mpz_sizeinbase(mpz_, 2) > 64) {
+		return (mpz_sgn(mpz_) < 0) ? std::numeric_limits<qint64>::min() : std::numeric_limits<qint64>::max();
+	}
 
-	if (!ok) {
-		// TODO: what to do if error?
-		value = 0;
+	const quint64 magnitude = low_bits(mpz_);
+	if(mpz_sgn(mpz_) < 0) {
+		return (magnitude > Q_UINT64_C(0x8000000000000000)) ? std::numeric_limits<qint64>::min() : static_cast<qint64>(0 - magnitude);
 	}
 
-	return value;
+	return (magnitude > static_cast<quint64>(std::numeric_limits<qint64>::max())) ? std::numeric_limits<qint64>::max() : static_cast<qint64>(magnitude);
 }
 
 //------------------------------------------------------------------------------
@@ -784,105 +1338,134 @@ bool knumber_integer::is_odd() const {
 //------------------------------------------------------------------------------
 // Name: reciprocal
 //------------------------------------------------------------------------------
-knumber_base *knumber_integer::reciprocal() {
-	knumber_fraction *q = new knumber_fraction(this);
-	delete this;
-	return q->reciprocal();
+void knumber_integer::reciprocal(knumber_base *self) {
+	self->assign(knumber_fraction(this))->reciprocal(self);
 }
 
 //------------------------------------------------------------------------------
 // Name: log2
 //------------------------------------------------------------------------------
-knumber_base *knumber_integer::log2() {
-	knumber_float *f = new knumber_float(this);
-	delete this;
-	return f->log2();
+void knumber_integer::log2(knumber_base *self) {
+	self->assign(knumber_float(this))->log2(self);
 }
 
 //------------------------------------------------------------------------------
 // Name: floor
 //------------------------------------------------------------------------------
-knumber_base *knumber_integer::floor() {
+void knumber_integer::floor(knumber_base *) {
 	// should have no effect on the value
-	return this;
 }
 
 //------------------------------------------------------------------------------
 // Name: ceil
 //------------------------------------------------------------------------------
-knumber_base *knumber_integer::ceil() {
+void knumber_integer::ceil(knumber_base *) {
 	// should have no effect on the value
-	return this;
 }
 
 //------------------------------------------------------------------------------
 // Name: log10
 //------------------------------------------------------------------------------
-knumber_base *knumber_integer::log10() {
-	knumber_float *f = new knumber_float(this);
-	delete this;
-	return f->log10();
+void knumber_integer::log10(knumber_base *self) {
+	self->assign(knumber_float(this))->log10(self);
 }
 
 //------------------------------------------------------------------------------
 // Name: ln
 //------------------------------------------------------------------------------
-knumber_base *knumber_integer::ln() {
-	knumber_float *f = new knumber_float(this);
-	delete this;
-	return f->ln();
+void knumber_integer::ln(knumber_base *self) {
+	self->assign(knumber_float(this))->ln(self);
 }
 
 //------------------------------------------------------------------------------
 // Name: exp2
 //------------------------------------------------------------------------------
-knumber_base *knumber_integer::exp2() {
-	knumber_float *f = new knumber_float(this);
-	delete this;
-	return f->exp2();
+void knumber_integer::exp2(knumber_base *self) {
+	self->assign(knumber_float(this))->exp2(self);
 }
 
 //------------------------------------------------------------------------------
 // Name: exp10
 //------------------------------------------------------------------------------
-knumber_base *knumber_integer::exp10() {
-	knumber_float *f = new knumber_float(this);
-	delete this;
-	return f->exp10();
+void knumber_integer::exp10(knumber_base *self) {
+	self->assign(knumber_float(this))->exp10(self);
 }
 
 //------------------------------------------------------------------------------
 // Name: exp
 //------------------------------------------------------------------------------
-knumber_base *knumber_integer::exp() {
-	knumber_float *f = new knumber_float(this);
-	delete this;
-	return f->exp();
+void knumber_integer::exp(knumber_base *self) {
+	self->assign(knumber_float(this))->exp(self);
 }
 
 //------------------------------------------------------------------------------
 // Name: bin
 //------------------------------------------------------------------------------
-knumber_base *knumber_integer::bin(knumber_base *rhs) {
+void knumber_integer::bin(knumber_base *self, knumber_integer *rhs) {
+
+	const unsigned long k = mpz_get_ui(rhs->mpz_);
+
+	// bin(n, k) for a negative n is (-1)^k * bin(k - n - 1, k), a result
+	// too big to be exact is infinite
+	const double n = (mpz_sgn(mpz_) < 0) ? static_cast<double>(k) - mpz_get_d(mpz_) - 1 : mpz_get_d(mpz_);
+	double bits = 1;
+	if(n >= static_cast<double>(k)) {
+		if(n < std::numeric_limits<unsigned long>::max()) {
+			bits = factorial_bits(n) - factorial_bits(k) - factorial_bits(n - k);
+		} else {
+			bits = static_cast<double>(k) * ::log2(n);
+		}
 
+		if(!knumber_allocator::fits_budget(bits, bin_scale)) {
+			const bool negative = mpz_sgn(mpz_) < 0 && (k & 1);
+			knumber_error *const e = self->emplace<knumber_error>(knumber_error::ERROR_POS_INFINITY);
+			if(negative) {
+				e->neg(self);
+			}
+			return;
+		}
+	}
 
-	if(knumber_integer *const p = dynamic_cast<knumber_integer *>(rhs)) {
-		mpz_bin_ui(mpz_, mpz_, mpz_get_ui(p->mpz_));
-		return this;
+	// the chunked way only works for 0 <= k <= n
+	const bool in_range = mpz_sgn(mpz_) >= 0 && mpz_fits_ulong_p(mpz_) && k <= mpz_get_ui(mpz_);
+	knumber_budget_scope scope(bits * bin_scale);
+	try {
+		bool done = true;
+		if(in_range && cancel_flag && k > chunked_limit) {
+			done = chunked_bin(mpz_, mpz_get_ui(mpz_), k);
+		} else {
+			mpz_bin_ui(mpz_, mpz_, k);
+		}
+		knumber_budget_scope::check();
 
-	} else if(knumber_float *const p = dynamic_cast<knumber_float *>(rhs)) {
-		delete this;
-		return new knumber_error(knumber_error::ERROR_UNDEFINED);
-	} else if(knumber_fraction *const p = dynamic_cast<knumber_fraction *>(rhs)) {
-		delete this;
-		return new knumber_error(knumber_error::ERROR_UNDEFINED);
-	} else if(knumber_error *const p = dynamic_cast<knumber_error *>(rhs)) {
-		delete this;
-		return new knumber_error(knumber_error::ERROR_UNDEFINED);
+		if(!done) {
+			self->emplace<knumber_error>(knumber_error::ERROR_UNDEFINED);
+		}
+	} catch(const knumber_budget_exceeded &) {
+		self->emplace<knumber_error>(knumber_error::ERROR_UNDEFINED);
+		scope.release();
 	}
+}
+
+//------------------------------------------------------------------------------
+// Name: bin
+//------------------------------------------------------------------------------
+void knumber_integer::bin(knumber_base *self, knumber_float *) {
+	self->emplace<knumber_error>(knumber_error::ERROR_UNDEFINED);
+}
+
+//------------------------------------------------------------------------------
+// Name: bin
+//------------------------------------------------------------------------------
+void knumber_integer::bin(knumber_base *self, knumber_fraction *) {
+	self->emplace<knumber_error>(knumber_error::ERROR_UNDEFINED);
+}
 
-	Q_ASSERT(0);
-	return 0;
+//------------------------------------------------------------------------------
+// Name: bin
+//------------------------------------------------------------------------------
+void knumber_integer::bin(knumber_base *self, knumber_error *) {
+	self->emplace<knumber_error>(knumber_error::ERROR_UNDEFINED);
 }
 
 }
@@ -20,7 +20,10 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "knumber_operators.h"
 #include "knumber.h"
 #include "knumber_base.h"
+#include <QByteArray>
+#include <QDataStream>
 #include <QDebug>
+#include <utility>
 
 //------------------------------------------------------------------------------
 // Name:
@@ -112,6 +115,136 @@ KNumber operator<<(const KNumber &lhs, const KNumber &rhs) {
 	return x;
 }
 
+//------------------------------------------------------------------------------
+// Name:
+//------------------------------------------------------------------------------
+KNumber operator+(KNumber &&lhs, const KNumber &rhs) {
+	lhs += rhs;
+	return std::move(lhs);
+}
+
+//------------------------------------------------------------------------------
+// Name:
+//------------------------------------------------------------------------------
+KNumber operator-(KNumber &&lhs, const KNumber &rhs) {
+	lhs -= rhs;
+	return std::move(lhs);
+}
+
+//------------------------------------------------------------------------------
+// Name:
+//------------------------------------------------------------------------------
+KNumber operator*(KNumber &&lhs, const KNumber &rhs) {
+	lhs *= rhs;
+	return std::move(lhs);
+}
+
+//------------------------------------------------------------------------------
+// Name:
+//------------------------------------------------------------------------------
+KNumber operator/(KNumber &&lhs, const KNumber &rhs) {
+	lhs /= rhs;
+	return std::move(lhs);
+}
+
+//------------------------------------------------------------------------------
+// Name:
+//------------------------------------------------------------------------------
+KNumber operator%(KNumber &&lhs, const KNumber &rhs) {
+	lhs %= rhs;
+	return std::move(lhs);
+}
+
+//------------------------------------------------------------------------------
+// Name:
+//------------------------------------------------------------------------------
+KNumber operator&(KNumber &&lhs, const KNumber &rhs) {
+	lhs &= rhs;
+	return std::move(lhs);
+}
+
+//------------------------------------------------------------------------------
+// Name:
+//------------------------------------------------------------------------------
+KNumber operator|(KNumber &&lhs, const KNumber &rhs) {
+	lhs |= rhs;
+	return std::move(lhs);
+}
+
+//------------------------------------------------------------------------------
+// Name:
+//------------------------------------------------------------------------------
+KNumber operator^(KNumber &&lhs, const KNumber &rhs) {
+	lhs ^= rhs;
+	return std::move(lhs);
+}
+
+//------------------------------------------------------------------------------
+// Name:
+//------------------------------------------------------------------------------
+KNumber operator>>(KNumber &&lhs, const KNumber &rhs) {
+	lhs >>= rhs;
+	return std::move(lhs);
+}
+
+//------------------------------------------------------------------------------
+// Name:
+//------------------------------------------------------------------------------
+KNumber operator<<(KNumber &&lhs, const KNumber &rhs) {
+	lhs <<= rhs;
+	return std::move(lhs);
+}
+
+//------------------------------------------------------------------------------
+// Name:
+//------------------------------------------------------------------------------
+KNumber operator+(const KNumber &lhs, KNumber &&rhs) {
+
+	// the operands can only be swapped when neither is a special, the
+	// detail classes don't treat those symmetrically
+	if(lhs.type() != KNumber::TYPE_ERROR && rhs.type() != KNumber::TYPE_ERROR) {
+		rhs += lhs;
+		return std::move(rhs);
+	}
+
+	KNumber x(lhs);
+	x += rhs;
+	return x;
+}
+
+//------------------------------------------------------------------------------
+// Name:
+//------------------------------------------------------------------------------
+KNumber operator+(KNumber &&lhs, KNumber &&rhs) {
+	lhs += rhs;
+	return std::move(lhs);
+}
+
+//------------------------------------------------------------------------------
+// Name:
+//------------------------------------------------------------------------------
+KNumber operator*(const KNumber &lhs, KNumber &&rhs) {
+
+	// the operands can only be swapped when neither is a special, the
+	// detail classes don't treat those symmetrically
+	if(lhs.type() != KNumber::TYPE_ERROR && rhs.type() != KNumber::TYPE_ERROR) {
+		rhs *= lhs;
+		return std::move(rhs);
+	}
+
+	KNumber x(lhs);
+	x *= rhs;
+	return x;
+}
+
+//------------------------------------------------------------------------------
+// Name:
+//------------------------------------------------------------------------------
+KNumber operator*(KNumber &&lhs, KNumber &&rhs) {
+	lhs *= rhs;
+	return std::move(lhs);
+}
+
 //------------------------------------------------------------------------------
 // Name:
 //------------------------------------------------------------------------------
@@ -257,40 +390,65 @@ KNumber exp(const KNumber &x) {
 // Name:
 //------------------------------------------------------------------------------
 bool operator==(const KNumber &lhs, const KNumber &rhs) {
-	return lhs.value_->compare(rhs.value_) == 0;
+	return lhs.compare(rhs) == 0;
 }
 
 //------------------------------------------------------------------------------
 // Name:
 //------------------------------------------------------------------------------
 bool operator!=(const KNumber &lhs, const KNumber &rhs) {
-	return lhs.value_->compare(rhs.value_) != 0;
+	return lhs.compare(rhs) != 0;
 }
 
 //------------------------------------------------------------------------------
 // Name:
 //------------------------------------------------------------------------------
 bool operator>=(const KNumber &lhs, const KNumber &rhs) {
-	return lhs.value_->compare(rhs.value_) >= 0;
+	return lhs.compare(rhs) >= 0;
 }
 
 //------------------------------------------------------------------------------
 // Name:
 //------------------------------------------------------------------------------
 bool operator<=(const KNumber &lhs, const KNumber &rhs) {
-	return lhs.value_->compare(rhs.value_) <= 0;
+	return lhs.compare(rhs) <= 0;
 }
 
 //------------------------------------------------------------------------------
 // Name:
 //------------------------------------------------------------------------------
 bool operator>(const KNumber &lhs, const KNumber &rhs) {
-	return lhs.value_->compare(rhs.value_) > 0;
+	return lhs.compare(rhs) > 0;
 }
 
 //------------------------------------------------------------------------------
 // Name:
 //------------------------------------------------------------------------------
 bool operator<(const KNumber &lhs, const KNumber &rhs) {
-	return lhs.value_->compare(rhs.value_) < 0;
+	return lhs.compare(rhs) < 0;
+}
+
+//------------------------------------------------------------------------------
+// Name:
+//------------------------------------------------------------------------------
+QDataStream &operator<<(QDataStream &stream, const KNumber &x) {
+	return stream << x.serialize();
+}
+
+//------------------------------------------------------------------------------
+// Name:
+//------------------------------------------------------------------------------
+QDataStream &operator>>(QDataStream &stream, KNumber &x) {
+
+	QByteArray data;
+	stream >> data;
+
+	qint64 used;
+	x = KNumber::deserialize(data.constData(), data.size(), &used);
+	if(used == 0 || used != data.size()) {
+		x = KNumber::NaN;
+		stream.setStatus(QDataStream::ReadCorruptData);
+	}
+
+	return stream;
 }
@@ -20,6 +20,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #define KNUMBER_OPERATORS_H_
 
 class KNumber;
+class QDataStream;
 
 bool operator==(const KNumber &lhs, const KNumber &rhs);
 bool operator!=(const KNumber &lhs, const KNumber &rhs);
@@ -40,6 +41,23 @@ KNumber operator^(const KNumber &lhs, const KNumber &rhs);
 KNumber operator>>(const KNumber &lhs, const KNumber &rhs);
 KNumber operator<<(const KNumber &lhs, const KNumber &rhs);
 
+// these reuse the storage of a temporary operand instead of copying it
+KNumber operator+(KNumber &&lhs, const KNumber &rhs);
+KNumber operator-(KNumber &&lhs, const KNumber &rhs);
+KNumber operator*(KNumber &&lhs, const KNumber &rhs);
+KNumber operator/(KNumber &&lhs, const KNumber &rhs);
+KNumber operator%(KNumber &&lhs, const KNumber &rhs);
+KNumber operator&(KNumber &&lhs, const KNumber &rhs);
+KNumber operator|(KNumber &&lhs, const KNumber &rhs);
+KNumber operator^(KNumber &&lhs, const KNumber &rhs);
+KNumber operator>>(KNumber &&lhs, const KNumber &rhs);
+KNumber operator<<(KNumber &&lhs, const KNumber &rhs);
+
+KNumber operator+(const KNumber &lhs, KNumber &&rhs);
+KNumber operator*(const KNumber &lhs, KNumber &&rhs);
+KNumber operator+(KNumber &&lhs, KNumber &&rhs);
+KNumber operator*(KNumber &&lhs, KNumber &&rhs);
+
 KNumber abs(const KNumber &x);
 KNumber cbrt(const KNumber &x);
 KNumber sqrt(const KNumber &x);
@@ -64,4 +82,9 @@ KNumber exp2(const KNumber &x);
 KNumber exp10(const KNumber &x);
 KNumber exp(const KNumber &x);
 
+// the value as a QByteArray of KNumber::serialize(). a value which can't be
+// read back is nan and sets the stream to QDataStream::ReadCorruptData
+QDataStream &operator<<(QDataStream &stream, const KNumber &x);
+QDataStream &operator>>(QDataStream &stream, KNumber &x);
+
 #endif
@@ -0,0 +1,85 @@
+/*
+Copyright (C) 2001 - 2013 Evan Teran
+                          evan.teran@gmail.com
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef KNUMBER_OVERFLOW_H_
+#define KNUMBER_OVERFLOW_H_
+
+#include <QtGlobal>
+#include <limits>
+
+// 64 bit arithmetic which reports whether the result fits, used for the
+// values KNumber keeps inline. *r is only valid if false is returned
+
+namespace detail {
+
+//------------------------------------------------------------------------------
+// Name: add_overflow
+//------------------------------------------------------------------------------
+inline bool add_overflow(qint64 a, qint64 b, qint64 *r) {
+#if defined(__GNUC__)
+	return __builtin_add_overflow(a, b, r);
+#else
+	if((b > 0 && a > std::numeric_limits<qint64>::max() - b) || (b < 0 && a < std::numeric_limits<qint64>::min() - b)) {
+		return true;
+	}
+	*r = a + b;
+	return false;
+#endif
+}
+
+//------------------------------------------------------------------------------
+// Name: sub_overflow
+//------------------------------------------------------------------------------
+inline bool sub_overflow(qint64 a, qint64 b, qint64 *r) {
+#if defined(__GNUC__)
+	return __builtin_sub_overflow(a, b, r);
+#else
+	if((b < 0 && a > std::numeric_limits<qint64>::max() + b) || (b > 0 && a < std::numeric_limits<qint64>::min() + b)) {
+		return true;
+	}
+	*r = a - b;
+	return false;
+#endif
+}
+
+//------------------------------------------------------------------------------
+// Name: mul_overflow
+//------------------------------------------------------------------------------
+inline bool mul_overflow(qint64 a, qint64 b, qint64 *r) {
+#if defined(__GNUC__)
+	return __builtin_mul_overflow(a, b, r);
+#else
+	const qint64 max = std::numeric_limits<qint64>::max();
+	const qint64 min = std::numeric_limits<qint64>::min();
+	if(a > 0) {
+		if(b > 0 ? a > max / b : b < min / a) {
+			return true;
+		}
+	} else if(a < 0) {
+		if(b > 0 ? a < min / b : b < 0 && a < max / b) {
+			return true;
+		}
+	}
+	*r = a * b;
+	return false;
+#endif
+}
+
+}
+
+#endif
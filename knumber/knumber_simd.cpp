@@ -0,0 +1,426 @@
+/*
+Copyright (C) 2001 - 2013 Evan Teran
+                          evan.teran@gmail.com
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <config-kcalc.h>
+#include "knumber_simd.h"
+
+// every implementation has to round the same way, so a multiplication and an
+// addition must not be fused into one FMA by the compiler
+#if defined(__clang__)
+#pragma STDC FP_CONTRACT OFF
+#elif defined(__GNUC__)
+#pragma GCC optimize("fp-contract=off")
+#endif
+
+// the vector versions are compiled for their instruction set function by
+// function, so the rest of the library still runs on any x86
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define KNUMBER_SIMD_X86
+#include <immintrin.h>
+#endif
+
+namespace detail {
+
+namespace {
+
+// the number of running sums, one per element of an AVX2 register
+const int lanes = 4;
+
+// what is added up for each element
+enum term {
+	TERM_VALUE,
+	TERM_SQUARE,
+	TERM_DEVIATION
+};
+
+struct kernels {
+	double (*sum)(const double *x, int n, double mean);
+	double (*sum_of_squares)(const double *x, int n, double mean);
+	double (*sum_of_squared_deviations)(const double *x, int n, double mean);
+	void (*add)(double *r, const double *x, const double *y, int n);
+	void (*mul)(double *r, const double *x, const double *y, int n);
+	void (*scale)(double *r, const double *x, double factor, int n);
+	const char *name;
+};
+
+//------------------------------------------------------------------------------
+// Name: make_term
+//------------------------------------------------------------------------------
+template <term T>
+inline double make_term(double x, double mean) {
+	switch(T) {
+	case TERM_SQUARE:
+		return x * x;
+	case TERM_DEVIATION:
+		return (x - mean) * (x - mean);
+	case TERM_VALUE:
+	default:
+		return x;
+	}
+}
+
+//------------------------------------------------------------------------------
+// Name: two_sum
+// Desc: *s += v, the rounding error of that goes into *c
+//------------------------------------------------------------------------------
+inline void two_sum(double *s, double *c, double v) {
+	const double t  = *s + v;
+	const double bb = t - *s;
+	*c += (*s - (t - bb)) + (v - bb);
+	*s = t;
+}
+
+//------------------------------------------------------------------------------
+// Name: finish
+// Desc: adds the elements after the last full group of four to the running
+//       sums, then the running sums and their errors together
+//------------------------------------------------------------------------------
+template <term T>
+double finish(double *s, double *c, const double *x, int n, double mean) {
+
+	for(int i = 0; i < n; ++i) {
+		two_sum(&s[i], &c[i], make_term<T>(x[i], mean));
+	}
+
+	double sum   = 0.0;
+	double error = 0.0;
+	for(int i = 0; i < lanes; ++i) {
+		two_sum(&sum, &error, s[i]);
+		error += c[i];
+	}
+
+	return sum + error;
+}
+
+//------------------------------------------------------------------------------
+// Name: scalar_sum
+//------------------------------------------------------------------------------
+template <term T>
+double scalar_sum(const double *x, int n, double mean) {
+
+	double s[lanes] = { 0.0, 0.0, 0.0, 0.0 };
+	double c[lanes] = { 0.0, 0.0, 0.0, 0.0 };
+
+	int i = 0;
+	for(; i + lanes <= n; i += lanes) {
+		for(int j = 0; j < lanes; ++j) {
+			two_sum(&s[j], &c[j], make_term<T>(x[i + j], mean));
+		}
+	}
+
+	return finish<T>(s, c, x + i, n - i, mean);
+}
+
+//------------------------------------------------------------------------------
+// Name: scalar_add
+//------------------------------------------------------------------------------
+void scalar_add(double *r, const double *x, const double *y, int n) {
+	for(int i = 0; i < n; ++i) {
+		r[i] = x[i] + y[i];
+	}
+}
+
+//------------------------------------------------------------------------------
+// Name: scalar_mul
+//------------------------------------------------------------------------------
+void scalar_mul(double *r, const double *x, const double *y, int n) {
+	for(int i = 0; i < n; ++i) {
+		r[i] = x[i] * y[i];
+	}
+}
+
+//------------------------------------------------------------------------------
+// Name: scalar_scale
+//------------------------------------------------------------------------------
+void scalar_scale(double *r, const double *x, double factor, int n) {
+	for(int i = 0; i < n; ++i) {
+		r[i] = x[i] * factor;
+	}
+}
+
+const kernels scalar_kernels = {
+	scalar_sum<TERM_VALUE>,
+	scalar_sum<TERM_SQUARE>,
+	scalar_sum<TERM_DEVIATION>,
+	scalar_add,
+	scalar_mul,
+	scalar_scale,
+	"scalar"
+};
+
+#ifdef KNUMBER_SIMD_X86
+
+//------------------------------------------------------------------------------
+// Name: sse2_sum
+// Desc: running sums 0 and 1 in lo, 2 and 3 in hi
+//------------------------------------------------------------------------------
+template <term T>
+__attribute__((target("sse2")))
+double sse2_sum(const double *x, int n, double mean) {
+
+	__m128d s_lo = _mm_setzero_pd();
+	__m128d s_hi = _mm_setzero_pd();
+	__m128d c_lo = _mm_setzero_pd();
+	__m128d c_hi = _mm_setzero_pd();
+	const __m128d m = _mm_set1_pd(mean);
+
+	int i = 0;
+	for(; i + lanes <= n; i += lanes) {
+		__m128d v_lo = _mm_loadu_pd(x + i);
+		__m128d v_hi = _mm_loadu_pd(x + i + 2);
+
+		if(T == TERM_DEVIATION) {
+			v_lo = _mm_sub_pd(v_lo, m);
+			v_hi = _mm_sub_pd(v_hi, m);
+		}
+
+		if(T != TERM_VALUE) {
+			v_lo = _mm_mul_pd(v_lo, v_lo);
+			v_hi = _mm_mul_pd(v_hi, v_hi);
+		}
+
+		const __m128d t_lo  = _mm_add_pd(s_lo, v_lo);
+		const __m128d t_hi  = _mm_add_pd(s_hi, v_hi);
+		const __m128d bb_lo = _mm_sub_pd(t_lo, s_lo);
+		const __m128d bb_hi = _mm_sub_pd(t_hi, s_hi);
+		c_lo = _mm_add_pd(c_lo, _mm_add_pd(_mm_sub_pd(s_lo, _mm_sub_pd(t_lo, bb_lo)), _mm_sub_pd(v_lo, bb_lo)));
+		c_hi = _mm_add_pd(c_hi, _mm_add_pd(_mm_sub_pd(s_hi, _mm_sub_pd(t_hi, bb_hi)), _mm_sub_pd(v_hi, bb_hi)));
+		s_lo = t_lo;
+		s_hi = t_hi;
+	}
+
+	double s[lanes];
+	double c[lanes];
+	_mm_storeu_pd(s, s_lo);
+	_mm_storeu_pd(s + 2, s_hi);
+	_mm_storeu_pd(c, c_lo);
+	_mm_storeu_pd(c + 2, c_hi);
+
+	return finish<T>(s, c, x + i, n - i, mean);
+}
+
+//------------------------------------------------------------------------------
+// Name: sse2_add
+//------------------------------------------------------------------------------
+__attribute__((target("sse2")))
+void sse2_add(double *r, const double *x, const double *y, int n) {
+	int i = 0;
+	for(; i + 2 <= n; i += 2) {
+		_mm_storeu_pd(r + i, _mm_add_pd(_mm_loadu_pd(x + i), _mm_loadu_pd(y + i)));
+	}
+	scalar_add(r + i, x + i, y + i, n - i);
+}
+
+//------------------------------------------------------------------------------
+// Name: sse2_mul
+//------------------------------------------------------------------------------
+__attribute__((target("sse2")))
+void sse2_mul(double *r, const double *x, const double *y, int n) {
+	int i = 0;
+	for(; i + 2 <= n; i += 2) {
+		_mm_storeu_pd(r + i, _mm_mul_pd(_mm_loadu_pd(x + i), _mm_loadu_pd(y + i)));
+	}
+	scalar_mul(r + i, x + i, y + i, n - i);
+}
+
+//------------------------------------------------------------------------------
+// Name: sse2_scale
+//------------------------------------------------------------------------------
+__attribute__((target("sse2")))
+void sse2_scale(double *r, const double *x, double factor, int n) {
+	const __m128d f = _mm_set1_pd(factor);
+	int i = 0;
+	for(; i + 2 <= n; i += 2) {
+		_mm_storeu_pd(r + i, _mm_mul_pd(_mm_loadu_pd(x + i), f));
+	}
+	scalar_scale(r + i, x + i, factor, n - i);
+}
+
+const kernels sse2_kernels = {
+	sse2_sum<TERM_VALUE>,
+	sse2_sum<TERM_SQUARE>,
+	sse2_sum<TERM_DEVIATION>,
+	sse2_add,
+	sse2_mul,
+	sse2_scale,
+	"sse2"
+};
+
+//------------------------------------------------------------------------------
+// Name: avx2_sum
+//------------------------------------------------------------------------------
+template <term T>
+__attribute__((target("avx2")))
+double avx2_sum(const double *x, int n, double mean) {
+
+	__m256d s = _mm256_setzero_pd();
+	__m256d c = _mm256_setzero_pd();
+	const __m256d m = _mm256_set1_pd(mean);
+
+	int i = 0;
+	for(; i + lanes <= n; i += lanes) {
+		__m256d v = _mm256_loadu_pd(x + i);
+
+		if(T == TERM_DEVIATION) {
+			v = _mm256_sub_pd(v, m);
+		}
+
+		if(T != TERM_VALUE) {
+			v = _mm256_mul_pd(v, v);
+		}
+
+		const __m256d t  = _mm256_add_pd(s, v);
+		const __m256d bb = _mm256_sub_pd(t, s);
+		c = _mm256_add_pd(c, _mm256_add_pd(_mm256_sub_pd(s, _mm256_sub_pd(t, bb)), _mm256_sub_pd(v, bb)));
+		s = t;
+	}
+
+	double sums[lanes];
+	double errors[lanes];
+	_mm256_storeu_pd(sums, s);
+	_mm256_storeu_pd(errors, c);
+
+	return finish<T>(sums, errors, x + i, n - i, mean);
+}
+
+//------------------------------------------------------------------------------
+// Name: avx2_add
+//------------------------------------------------------------------------------
+__attribute__((target("avx2")))
+void avx2_add(double *r, const double *x, const double *y, int n) {
+	int i = 0;
+	for(; i + 4 <= n; i += 4) {
+		_mm256_storeu_pd(r + i, _mm256_add_pd(_mm256_loadu_pd(x + i), _mm256_loadu_pd(y + i)));
+	}
+	scalar_add(r + i, x + i, y + i, n - i);
+}
+
+//------------------------------------------------------------------------------
+// Name: avx2_mul
+//------------------------------------------------------------------------------
+__attribute__((target("avx2")))
+void avx2_mul(double *r, const double *x, const double *y, int n) {
+	int i = 0;
+	for(; i + 4 <= n; i += 4) {
+		_mm256_storeu_pd(r + i, _mm256_mul_pd(_mm256_loadu_pd(x + i), _mm256_loadu_pd(y + i)));
+	}
+	scalar_mul(r + i, x + i, y + i, n - i);
+}
+
+//------------------------------------------------------------------------------
+// Name: avx2_scale
+//------------------------------------------------------------------------------
+__attribute__((target("avx2")))
+void avx2_scale(double *r, const double *x, double factor, int n) {
+	const __m256d f = _mm256_set1_pd(factor);
+	int i = 0;
+	for(; i + 4 <= n; i += 4) {
+		_mm256_storeu_pd(r + i, _mm256_mul_pd(_mm256_loadu_pd(x + i), f));
+	}
+	scalar_scale(r + i, x + i, factor, n - i);
+}
+
+const kernels avx2_kernels = {
+	avx2_sum<TERM_VALUE>,
+	avx2_sum<TERM_SQUARE>,
+	avx2_sum<TERM_DEVIATION>,
+	avx2_add,
+	avx2_mul,
+	avx2_scale,
+	"avx2"
+};
+
+#endif
+
+//------------------------------------------------------------------------------
+// Name: choose_kernels
+//------------------------------------------------------------------------------
+const kernels *choose_kernels() {
+#ifdef KNUMBER_SIMD_X86
+	__builtin_cpu_init();
+	if(__builtin_cpu_supports("avx2")) {
+		return &avx2_kernels;
+	}
+
+	if(__builtin_cpu_supports("sse2")) {
+		return &sse2_kernels;
+	}
+#endif
+	return &scalar_kernels;
+}
+
+//------------------------------------------------------------------------------
+// Name: selected
+//------------------------------------------------------------------------------
+const kernels &selected() {
+	static const kernels *const k = choose_kernels();
+	return *k;
+}
+
+}
+
+//------------------------------------------------------------------------------
+// Name: sum
+//------------------------------------------------------------------------------
+double knumber_simd::sum(const double *x, int n) {
+	return selected().sum(x, n, 0.0);
+}
+
+//------------------------------------------------------------------------------
+// Name: sum_of_squares
+//------------------------------------------------------------------------------
+double knumber_simd::sum_of_squares(const double *x, int n) {
+	return selected().sum_of_squares(x, n, 0.0);
+}
+
+//------------------------------------------------------------------------------
+// Name: sum_of_squared_deviations
+//------------------------------------------------------------------------------
+double knumber_simd::sum_of_squared_deviations(const double *x, int n, double mean) {
+	return selected().sum_of_squared_deviations(x, n, mean);
+}
+
+//------------------------------------------------------------------------------
+// Name: add
+//------------------------------------------------------------------------------
+void knumber_simd::add(double *r, const double *x, const double *y, int n) {
+	selected().add(r, x, y, n);
+}
+
+//------------------------------------------------------------------------------
+// Name: mul
+//------------------------------------------------------------------------------
+void knumber_simd::mul(double *r, const double *x, const double *y, int n) {
+	selected().mul(r, x, y, n);
+}
+
+//------------------------------------------------------------------------------
+// Name: scale
+//------------------------------------------------------------------------------
+void knumber_simd::scale(double *r, const double *x, double factor, int n) {
+	selected().scale(r, x, factor, n);
+}
+
+//------------------------------------------------------------------------------
+// Name: name
+//------------------------------------------------------------------------------
+const char *knumber_simd::name() {
+	return selected().name;
+}
+
+}
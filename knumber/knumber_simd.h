@@ -0,0 +1,52 @@
+/*
+Copyright (C) 2001 - 2013 Evan Teran
+                          evan.teran@gmail.com
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef KNUMBER_SIMD_H_
+#define KNUMBER_SIMD_H_
+
+namespace detail {
+
+// Loops over arrays of doubles for KNumberArray. The implementation is picked
+// once, at the first call, from what the CPU supports: AVX2, SSE2 or plain C.
+//
+// The sums are compensated: each of four running sums keeps the rounding
+// error of its additions (Knuth's two-sum) and adds it back at the end. All
+// implementations do the very same operations in the same order, so they
+// give the same result to the last bit.
+class knumber_simd {
+public:
+	static double sum(const double *x, int n);
+	static double sum_of_squares(const double *x, int n);
+
+	// the sum of (x - mean)^2
+	static double sum_of_squared_deviations(const double *x, int n, double mean);
+
+public:
+	// r may be the same array as x or y
+	static void add(double *r, const double *x, const double *y, int n);
+	static void mul(double *r, const double *x, const double *y, int n);
+	static void scale(double *r, const double *x, double factor, int n);
+
+public:
+	// "avx2", "sse2" or "scalar"
+	static const char *name();
+};
+
+}
+
+#endif
@@ -0,0 +1,42 @@
+/*
+Copyright (C) 2001 - 2013 Evan Teran
+                          evan.teran@gmail.com
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <config-kcalc.h>
+#include "knumber_statistics.h"
+
+namespace detail {
+
+std::atomic<quint64> knumber_statistics::counters_[knumber_statistics::COUNTER_COUNT];
+
+//------------------------------------------------------------------------------
+// Name: value
+//------------------------------------------------------------------------------
+quint64 knumber_statistics::value(counter c) {
+	return counters_[c].load(std::memory_order_relaxed);
+}
+
+//------------------------------------------------------------------------------
+// Name: reset
+//------------------------------------------------------------------------------
+void knumber_statistics::reset() {
+	for(int i = 0; i < COUNTER_COUNT; ++i) {
+		counters_[i].store(0, std::memory_order_relaxed);
+	}
+}
+
+}
@@ -0,0 +1,75 @@
+/*
+Copyright (C) 2001 - 2013 Evan Teran
+                          evan.teran@gmail.com
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef KNUMBER_STATISTICS_H_
+#define KNUMBER_STATISTICS_H_
+
+#include <QtGlobal>
+#include <atomic>
+
+namespace detail {
+
+// Counters for the hot paths of the library. They are only updated when
+// built with KNUMBER_STATISTICS, otherwise KNUMBER_COUNT compiles to nothing
+// and the counters stay at zero. KNumber::statistics() reads them.
+class knumber_statistics {
+public:
+	enum counter {
+		OBJECTS_ALLOCATED,    // knumber_* objects created on the heap
+		INLINE_SPILLS,        // inline integers moved out to a knumber_integer
+		INTEGER_TO_FLOAT,
+		INTEGER_TO_FRACTION,
+		FRACTION_TO_FLOAT,
+		FRACTION_TO_INTEGER,  // by simplify()
+		FLOAT_TO_INTEGER,     // by simplify()
+		INLINED,              // values simplify() moved back inline
+		CANONICALIZATIONS,    // mpq_canonicalize calls
+		LIMB_BYTES,           // bytes GMP asked for, growing a block counts the new size
+		FRACTION_OVER_BUDGET, // fractions replaced for going over the limb budget
+		CACHE_HITS,           // results found in the result cache
+		CACHE_MISSES,         // results looked for in the result cache and not found
+		FAST_PATH_HITS,       // functions answered from a double
+		FAST_PATH_MISSES,     // functions which had to be evaluated at the full precision
+		POOL_HITS,            // pooled sizes served from the cache of the thread
+		POOL_MISSES,          // pooled sizes which had to go to malloc
+		COUNTER_COUNT
+	};
+
+public:
+	static void add(counter c, quint64 n) {
+		counters_[c].fetch_add(n, std::memory_order_relaxed);
+	}
+
+	static quint64 value(counter c);
+	static void reset();
+
+private:
+	static std::atomic<quint64> counters_[COUNTER_COUNT];
+};
+
+}
+
+#ifdef KNUMBER_STATISTICS
+#define KNUMBER_COUNT(c)      ::detail::knumber_statistics::add(::detail::knumber_statistics::c, 1)
+#define KNUMBER_COUNT_N(c, n) ::detail::knumber_statistics::add(::detail::knumber_statistics::c, (n))
+#else
+#define KNUMBER_COUNT(c)      do { } while(0)
+#define KNUMBER_COUNT_N(c, n) do { } while(0)
+#endif
+
+#endif
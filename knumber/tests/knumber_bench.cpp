@@ -0,0 +1,762 @@
+/*
+Copyright (C) 2001 - 2013 Evan Teran
+                          evan.teran@gmail.com
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Micro benchmark for the KNumber operations, prints the average cost
+// of each operation in nanoseconds.
+//
+// Every operation is timed for every pair of operand types (integer,
+// fraction, float and error) at a few operand sizes and float precisions,
+// next to parsing, formatting and the promotions done by simplify().
+//
+// usage: knumber_bench [--csv | --json] [iterations]
+//
+// iterations is the most an operation is run, slow operations are run
+// less often so that each one takes about the same time. --csv and --json
+// write one record per operation for tracking the numbers between releases.
+
+#include "knumber.h"
+#include "knumber_array.h"
+#include "knumber_context.h"
+#include "knumber_simd.h"
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QString>
+#include <QStringList>
+#include <cstdlib>
+#include <cstring>
+#include <gmp.h>
+#include <iomanip>
+#include <iostream>
+#include <string>
+
+namespace {
+
+typedef void (*bench_func)(const KNumber &lhs, const KNumber &rhs);
+
+// results are folded in here so the compiler can't drop the work
+volatile int sink = 0;
+
+// how long a single operation is timed for at most
+const qint64 time_budget_ns = 20000000;
+
+void op_add(const KNumber &lhs, const KNumber &rhs) { sink += (lhs + rhs).type(); }
+void op_sub(const KNumber &lhs, const KNumber &rhs) { sink += (lhs - rhs).type(); }
+void op_mul(const KNumber &lhs, const KNumber &rhs) { sink += (lhs * rhs).type(); }
+void op_div(const KNumber &lhs, const KNumber &rhs) { sink += (lhs / rhs).type(); }
+void op_mod(const KNumber &lhs, const KNumber &rhs) { sink += (lhs % rhs).type(); }
+void op_pow(const KNumber &lhs, const KNumber &rhs) { sink += lhs.pow(rhs).type(); }
+void op_and(const KNumber &lhs, const KNumber &rhs) { sink += (lhs & rhs).type(); }
+void op_or(const KNumber &lhs, const KNumber &rhs) { sink += (lhs | rhs).type(); }
+void op_xor(const KNumber &lhs, const KNumber &rhs) { sink += (lhs ^ rhs).type(); }
+void op_shift(const KNumber &lhs, const KNumber &rhs) { sink += (lhs << rhs).type(); }
+void op_less(const KNumber &lhs, const KNumber &rhs) { sink += (lhs < rhs); }
+void op_equal(const KNumber &lhs, const KNumber &rhs) { sink += (lhs == rhs); }
+void op_bin(const KNumber &lhs, const KNumber &rhs) { sink += lhs.bin(rhs).type(); }
+
+void op_copy(const KNumber &lhs, const KNumber &) { sink += KNumber(lhs).type(); }
+void op_type(const KNumber &lhs, const KNumber &) { sink += lhs.type(); }
+void op_neg(const KNumber &lhs, const KNumber &) { sink += (-lhs).type(); }
+void op_cmp(const KNumber &lhs, const KNumber &) { sink += (~lhs).type(); }
+void op_abs(const KNumber &lhs, const KNumber &) { sink += lhs.abs().type(); }
+void op_sqrt(const KNumber &lhs, const KNumber &) { sink += lhs.sqrt().type(); }
+void op_cbrt(const KNumber &lhs, const KNumber &) { sink += lhs.cbrt().type(); }
+void op_floor(const KNumber &lhs, const KNumber &) { sink += lhs.floor().type(); }
+void op_ceil(const KNumber &lhs, const KNumber &) { sink += lhs.ceil().type(); }
+void op_integer_part(const KNumber &lhs, const KNumber &) { sink += lhs.integerPart().type(); }
+void op_factorial(const KNumber &lhs, const KNumber &) { sink += lhs.factorial().type(); }
+void op_to_int64(const KNumber &lhs, const KNumber &) { sink += static_cast<int>(lhs.toInt64()); }
+void op_to_uint64(const KNumber &lhs, const KNumber &) { sink += static_cast<int>(lhs.toUint64()); }
+
+void op_sin(const KNumber &lhs, const KNumber &) { sink += lhs.sin().type(); }
+void op_cos(const KNumber &lhs, const KNumber &) { sink += lhs.cos().type(); }
+void op_tan(const KNumber &lhs, const KNumber &) { sink += lhs.tan().type(); }
+void op_asin(const KNumber &lhs, const KNumber &) { sink += lhs.asin().type(); }
+void op_acos(const KNumber &lhs, const KNumber &) { sink += lhs.acos().type(); }
+void op_atan(const KNumber &lhs, const KNumber &) { sink += lhs.atan().type(); }
+void op_sinh(const KNumber &lhs, const KNumber &) { sink += lhs.sinh().type(); }
+void op_cosh(const KNumber &lhs, const KNumber &) { sink += lhs.cosh().type(); }
+void op_tanh(const KNumber &lhs, const KNumber &) { sink += lhs.tanh().type(); }
+void op_asinh(const KNumber &lhs, const KNumber &) { sink += lhs.asinh().type(); }
+void op_acosh(const KNumber &lhs, const KNumber &) { sink += lhs.acosh().type(); }
+void op_atanh(const KNumber &lhs, const KNumber &) { sink += lhs.atanh().type(); }
+void op_tgamma(const KNumber &lhs, const KNumber &) { sink += lhs.tgamma().type(); }
+void op_log2(const KNumber &lhs, const KNumber &) { sink += lhs.log2().type(); }
+void op_log10(const KNumber &lhs, const KNumber &) { sink += lhs.log10().type(); }
+void op_ln(const KNumber &lhs, const KNumber &) { sink += lhs.ln().type(); }
+void op_exp2(const KNumber &lhs, const KNumber &) { sink += lhs.exp2().type(); }
+void op_exp10(const KNumber &lhs, const KNumber &) { sink += lhs.exp10().type(); }
+void op_exp(const KNumber &lhs, const KNumber &) { sink += lhs.exp().type(); }
+
+void op_string(const KNumber &lhs, const KNumber &) { sink += lhs.toQString().length(); }
+void op_display(const KNumber &lhs, const KNumber &) { sink += lhs.toQString(12, 8).length(); }
+
+void op_serialize(const KNumber &lhs, const KNumber &) { sink += lhs.serialize().size(); }
+void op_binary_round_trip(const KNumber &lhs, const KNumber &) { const QByteArray data = lhs.serialize(); sink += KNumber::deserialize(data.constData(), data.size()).type(); }
+void op_string_round_trip(const KNumber &lhs, const KNumber &) { sink += KNumber(lhs.toQString()).type(); }
+
+struct operation {
+	const char *name;
+	bench_func  func;
+};
+
+const operation binary_operations[] = {
+	{ "+",   op_add   },
+	{ "-",   op_sub   },
+	{ "*",   op_mul   },
+	{ "/",   op_div   },
+	{ "%",   op_mod   },
+	{ "&",   op_and   },
+	{ "|",   op_or    },
+	{ "^",   op_xor   },
+	{ "<",   op_less  },
+	{ "==",  op_equal }
+};
+
+// these take the exponent/shift count from the small operands only, a
+// 1000 digit exponent would not finish
+const operation small_rhs_operations[] = {
+	{ "pow", op_pow   },
+	{ "<<",  op_shift }
+};
+
+const operation unary_operations[] = {
+	{ "copy",        op_copy         },
+	{ "type",        op_type         },
+	{ "neg",         op_neg          },
+	{ "~",           op_cmp          },
+	{ "abs",         op_abs          },
+	{ "sqrt",        op_sqrt         },
+	{ "cbrt",        op_cbrt         },
+	{ "floor",       op_floor        },
+	{ "ceil",        op_ceil         },
+	{ "integerPart", op_integer_part },
+	{ "toInt64",     op_to_int64     },
+	{ "toUint64",    op_to_uint64    }
+};
+
+const operation functions[] = {
+	{ "sin",    op_sin    },
+	{ "cos",    op_cos    },
+	{ "tan",    op_tan    },
+	{ "asin",   op_asin   },
+	{ "acos",   op_acos   },
+	{ "atan",   op_atan   },
+	{ "sinh",   op_sinh   },
+	{ "cosh",   op_cosh   },
+	{ "tanh",   op_tanh   },
+	{ "asinh",  op_asinh  },
+	{ "acosh",  op_acosh  },
+	{ "atanh",  op_atanh  },
+	{ "tgamma", op_tgamma },
+	{ "log2",   op_log2   },
+	{ "log10",  op_log10  },
+	{ "ln",     op_ln     },
+	{ "exp2",   op_exp2   },
+	{ "exp10",  op_exp10  },
+	{ "exp",    op_exp    }
+};
+
+const char *const type_names[] = { "error", "integer", "float", "fraction" };
+
+//------------------------------------------------------------------------------
+// Name: reporter
+// Desc: writes the results as a table, as CSV or as a JSON document
+//------------------------------------------------------------------------------
+class reporter {
+public:
+	enum Format {
+		FORMAT_TEXT,
+		FORMAT_CSV,
+		FORMAT_JSON
+	};
+
+public:
+	explicit reporter(Format format) : format_(format), count_(0) {
+	}
+
+public:
+	void begin(int iterations) {
+		switch(format_) {
+		case FORMAT_TEXT:
+			std::cout << "KNumber micro benchmark, at most " << iterations << " iterations per operation\n";
+			break;
+		case FORMAT_CSV:
+			std::cout << "group,operation,lhs,rhs,digits,precision,ns_per_op,iterations\n";
+			break;
+		case FORMAT_JSON:
+			std::cout
+				<< "{\n"
+				<< "  \"benchmark\": \"knumber\",\n"
+#ifdef KNUMBER_USE_MPFR
+				<< "  \"mpfr\": true,\n"
+#else
+				<< "  \"mpfr\": false,\n"
+#endif
+				<< "  \"iterations\": " << iterations << ",\n"
+				<< "  \"results\": [";
+			break;
+		}
+	}
+
+	void end() {
+		switch(format_) {
+		case FORMAT_TEXT:
+			if(KNumber::statisticsEnabled()) {
+				const KNumber::Statistics s = KNumber::statistics();
+				std::cout
+					<< "\nfast path hits: " << s.fastPathHits << ", misses: " << s.fastPathMisses << "\n"
+					<< "pool hits: " << s.poolHits << ", misses: " << s.poolMisses << "\n"
+					<< "objects allocated: " << s.objectsAllocated << ", inline spills: " << s.inlineSpills << ", inlined: " << s.inlined << "\n"
+					<< "integer to float: " << s.integerToFloat << ", integer to fraction: " << s.integerToFraction << ", fraction to float: " << s.fractionToFloat << "\n"
+					<< "fraction to integer: " << s.fractionToInteger << ", float to integer: " << s.floatToInteger << "\n"
+					<< "mpq_canonicalize calls: " << s.canonicalizations << ", limb bytes: " << s.limbBytes << "\n"
+					<< "fractions over the limb budget: " << s.fractionOverflows << "\n"
+					<< "result cache hits: " << s.cacheHits << ", misses: " << s.cacheMisses << "\n";
+			}
+			break;
+		case FORMAT_CSV:
+			break;
+		case FORMAT_JSON:
+			std::cout
+				<< "\n  ]";
+
+			if(KNumber::statisticsEnabled()) {
+				const KNumber::Statistics s = KNumber::statistics();
+				std::cout
+					<< ",\n  \"statistics\": {"
+					<< " \"objects_allocated\": " << s.objectsAllocated
+					<< ", \"inline_spills\": " << s.inlineSpills
+					<< ", \"integer_to_float\": " << s.integerToFloat
+					<< ", \"integer_to_fraction\": " << s.integerToFraction
+					<< ", \"fraction_to_float\": " << s.fractionToFloat
+					<< ", \"fraction_to_integer\": " << s.fractionToInteger
+					<< ", \"float_to_integer\": " << s.floatToInteger
+					<< ", \"inlined\": " << s.inlined
+					<< ", \"canonicalizations\": " << s.canonicalizations
+					<< ", \"limb_bytes\": " << s.limbBytes
+					<< ", \"fraction_overflows\": " << s.fractionOverflows
+					<< ", \"cache_hits\": " << s.cacheHits
+					<< ", \"cache_misses\": " << s.cacheMisses
+					<< ", \"fast_path_hits\": " << s.fastPathHits
+					<< ", \"fast_path_misses\": " << s.fastPathMisses
+					<< ", \"pool_hits\": " << s.poolHits
+					<< ", \"pool_misses\": " << s.poolMisses << " }";
+			}
+
+			std::cout << "\n}\n";
+			break;
+		}
+	}
+
+	void group(const std::string &name) {
+		group_ = name;
+		if(format_ == FORMAT_TEXT) {
+			std::cout << "\n" << name << "\n";
+		}
+	}
+
+	// lhs/rhs name the operand types, digits their size and precision the
+	// float precision in bits the operation ran at
+	void result(const std::string &operation, const char *lhs, const char *rhs, int digits, double ns, int iterations) {
+
+		const unsigned long precision = KNumberContext::current().floatPrecisionBits();
+
+		switch(format_) {
+		case FORMAT_TEXT:
+			{
+				std::string name = operation;
+				if(*lhs && *rhs) {
+					name = std::string(lhs) + " " + operation + " " + rhs;
+				} else if(*lhs) {
+					name = operation + " " + lhs;
+				}
+				if(digits > 0) {
+					name += " (" + std::to_string(digits) + " digits)";
+				}
+
+				std::cout
+					<< std::left << std::setw(52) << name
+					<< std::right << std::setw(12) << std::fixed << std::setprecision(1) << ns
+					<< " ns/op\n";
+			}
+			break;
+		case FORMAT_CSV:
+			std::cout
+				<< quoted(group_) << ',' << quoted(operation) << ',' << lhs << ',' << rhs << ','
+				<< digits << ',' << precision << ','
+				<< std::fixed << std::setprecision(1) << ns << ',' << iterations << '\n';
+			break;
+		case FORMAT_JSON:
+			std::cout
+				<< (count_ != 0 ? ",\n" : "\n")
+				<< "    { \"group\": " << quoted(group_)
+				<< ", \"operation\": " << quoted(operation)
+				<< ", \"lhs\": " << quoted(lhs)
+				<< ", \"rhs\": " << quoted(rhs)
+				<< ", \"digits\": " << digits
+				<< ", \"precision\": " << precision
+				<< ", \"ns_per_op\": " << std::fixed << std::setprecision(1) << ns
+				<< ", \"iterations\": " << iterations << " }";
+			break;
+		}
+
+		++count_;
+	}
+
+private:
+	// the names here have no backslashes, only quotes need escaping
+	std::string quoted(const std::string &s) const {
+		std::string r = "\"";
+		for(std::string::size_type i = 0; i < s.size(); ++i) {
+			if(s[i] == '"') {
+				r += (format_ == FORMAT_JSON) ? "\\\"" : "\"\"";
+			} else {
+				r += s[i];
+			}
+		}
+		return r + "\"";
+	}
+
+private:
+	Format      format_;
+	std::string group_;
+	int         count_;
+};
+
+//------------------------------------------------------------------------------
+// Name: time_loop
+// Desc: runs func until either iterations or the time budget run out, returns
+//       the nanoseconds per call and stores the number of calls in count
+//------------------------------------------------------------------------------
+template <class F>
+double time_loop(F func, int iterations, int *count) {
+
+	// a short run to warm up and to see how expensive the operation is
+	const int probe = (iterations >= 100) ? iterations / 100 : 1;
+
+	QElapsedTimer timer;
+	timer.start();
+
+	for(int i = 0; i < probe; ++i) {
+		func(i);
+	}
+
+	const qint64 probe_ns = qMax<qint64>(timer.nsecsElapsed(), 1);
+	const qint64 affordable = time_budget_ns * probe / probe_ns;
+	const int n = static_cast<int>(qBound<qint64>(probe, affordable, iterations));
+
+	timer.restart();
+
+	for(int i = 0; i < n; ++i) {
+		func(i);
+	}
+
+	*count = n;
+	return static_cast<double>(timer.nsecsElapsed()) / n;
+}
+
+//------------------------------------------------------------------------------
+// Name: run
+//------------------------------------------------------------------------------
+void run(reporter &out, const std::string &operation, const char *lhs_type, const char *rhs_type, int digits, bench_func func, const KNumber &lhs, const KNumber &rhs, int iterations) {
+
+	int count;
+	const double ns = time_loop([&](int) { func(lhs, rhs); }, iterations, &count);
+	out.result(operation, lhs_type, rhs_type, digits, ns, count);
+}
+
+//------------------------------------------------------------------------------
+// Name: run_parse
+// Desc: parses every string of the input mix in turn, the time is per string
+//------------------------------------------------------------------------------
+void run_parse(reporter &out, const char *name, const char *const *inputs, int count, int iterations) {
+
+	QStringList strings;
+	for(int i = 0; i < count; ++i) {
+		strings.append(QLatin1String(inputs[i]));
+	}
+
+	int n;
+	const double ns = time_loop([&](int i) { sink += KNumber(strings[i % count]).type(); }, iterations, &n);
+	out.result(name, "", "", 0, ns, n);
+}
+
+//------------------------------------------------------------------------------
+// Name: run_data_set
+// Desc: the statistics of a whole data set, exact and in doubles, next to
+//       adding it up one KNumber at a time. the time is per data set
+//------------------------------------------------------------------------------
+void run_data_set(reporter &out, const char *kind, KNumberArray data, int iterations) {
+
+	const QVector<KNumber> values = data.toVector();
+	int n;
+
+	double ns = time_loop([&](int) {
+		KNumber sum = KNumber::Zero;
+		for(int i = 0; i < values.size(); ++i) {
+			sum += values[i];
+		}
+		sink += sum.type();
+	}, iterations, &n);
+	out.result("KNumber loop sum", kind, "", 0, ns, n);
+
+	for(int fast = 0; fast < 2; ++fast) {
+		data.setFastFloat(fast != 0);
+		const std::string suffix = fast ? ", fast float" : "";
+
+		ns = time_loop([&](int) { sink += data.sum().type(); }, iterations, &n);
+		out.result("sum" + suffix, kind, "", 0, ns, n);
+
+		ns = time_loop([&](int) { sink += data.sumOfSquares().type(); }, iterations, &n);
+		out.result("sum of squares" + suffix, kind, "", 0, ns, n);
+
+		ns = time_loop([&](int) { sink += data.variance().type(); }, iterations, &n);
+		out.result("variance" + suffix, kind, "", 0, ns, n);
+	}
+}
+
+//------------------------------------------------------------------------------
+// Name: run_decimal_sum
+// Desc: adds up decimal inputs read as fractions, the way a long column of
+//       prices or measurements is typed in. the time is per addition
+//------------------------------------------------------------------------------
+void run_decimal_sum(reporter &out, const char *name, bool lazy, int count) {
+
+	KNumber::setLazyFractionReduction(lazy);
+
+	QVector<KNumber> values;
+	values.reserve(count);
+	for(int i = 0; i < count; ++i) {
+		// one to three decimals, so that the denominators differ
+		values.append(KNumber(QString::fromLatin1("%1.%2").arg(i % 9973).arg(i % 997 + 1)));
+	}
+
+	QElapsedTimer timer;
+	timer.start();
+
+	KNumber sum = KNumber::Zero;
+	for(int i = 0; i < count; ++i) {
+		sum += values[i];
+	}
+	sink += sum.toQString().size();
+
+	out.result(name, "fraction", "", 0, static_cast<double>(timer.nsecsElapsed()) / count, count);
+
+	KNumber::setLazyFractionReduction(false);
+}
+
+//------------------------------------------------------------------------------
+// Name: digit_string
+// Desc: a number with the given number of digits, first is the leading digit
+//------------------------------------------------------------------------------
+QString digit_string(int digits, int first) {
+
+	QString s;
+	for(int i = 0; i < digits; ++i) {
+		s += QLatin1Char(static_cast<char>('0' + (first + 7 * i) % 10));
+	}
+
+	if(s[0] == QLatin1Char('0')) {
+		s[0] = QLatin1Char('1');
+	}
+	return s;
+}
+
+//------------------------------------------------------------------------------
+// Name: operand_set
+// Desc: a left and a right hand side of each type, of about the same size
+//------------------------------------------------------------------------------
+struct operand_set {
+	KNumber lhs[4];
+	KNumber rhs[4];
+};
+
+operand_set make_operands(int digits) {
+
+	operand_set ops;
+
+	ops.lhs[KNumber::TYPE_ERROR] = KNumber::NaN;
+	ops.rhs[KNumber::TYPE_ERROR] = KNumber::PosInfinity;
+
+	const QString pi = QLatin1String("3.1415926535897932384626433832795028841971693993751058209749445923078164062862089986280348253421170679");
+	const QString e  = QLatin1String("-2.7182818284590452353602874713526624977572470936999595749669676277240766303535475945713821785251664274");
+
+	// the floats get as many digits as the precision holds, the caller sets that
+	ops.lhs[KNumber::TYPE_FLOAT] = KNumber(pi);
+	ops.rhs[KNumber::TYPE_FLOAT] = KNumber(e);
+
+	if(digits <= 4) {
+		ops.lhs[KNumber::TYPE_INTEGER]  = KNumber(1234);
+		ops.rhs[KNumber::TYPE_INTEGER]  = KNumber(-56);
+		ops.lhs[KNumber::TYPE_FRACTION] = KNumber(QLatin1String("22/7"));
+		ops.rhs[KNumber::TYPE_FRACTION] = KNumber(QLatin1String("-355/113"));
+	} else {
+		ops.lhs[KNumber::TYPE_INTEGER]  = KNumber(digit_string(digits, 1));
+		ops.rhs[KNumber::TYPE_INTEGER]  = -KNumber(digit_string(digits, 4));
+		ops.lhs[KNumber::TYPE_FRACTION] = KNumber(digit_string(digits, 2) + QLatin1Char('/') + digit_string(digits, 9));
+		ops.rhs[KNumber::TYPE_FRACTION] = -KNumber(digit_string(digits, 5) + QLatin1Char('/') + digit_string(digits, 3));
+	}
+
+	return ops;
+}
+
+// small exponents and shift counts for pow and <<
+operand_set make_small_operands() {
+
+	operand_set ops;
+	ops.rhs[KNumber::TYPE_ERROR]    = KNumber::PosInfinity;
+	ops.rhs[KNumber::TYPE_INTEGER]  = KNumber(3);
+	ops.rhs[KNumber::TYPE_FLOAT]    = KNumber(QLatin1String("0.5"));
+	ops.rhs[KNumber::TYPE_FRACTION] = KNumber(QLatin1String("1/3"));
+	return ops;
+}
+
+// arguments inside the domain of most of the float functions
+operand_set make_function_operands() {
+
+	operand_set ops;
+	ops.lhs[KNumber::TYPE_ERROR]    = KNumber::NaN;
+	ops.lhs[KNumber::TYPE_INTEGER]  = KNumber(3);
+	ops.lhs[KNumber::TYPE_FLOAT]    = KNumber(QLatin1String("0.7853981633974483096156608458198757210492923498437764552437361480769541015715522496570087063355292670"));
+	ops.lhs[KNumber::TYPE_FRACTION] = KNumber(QLatin1String("1/3"));
+	return ops;
+}
+
+}
+
+int main(int argc, char *argv[]) {
+
+	reporter::Format format = reporter::FORMAT_TEXT;
+	int iterations = 200000;
+
+	for(int i = 1; i < argc; ++i) {
+		if(std::strcmp(argv[i], "--csv") == 0) {
+			format = reporter::FORMAT_CSV;
+		} else if(std::strcmp(argv[i], "--json") == 0) {
+			format = reporter::FORMAT_JSON;
+		} else {
+			iterations = std::atoi(argv[i]);
+			if(iterations <= 0) {
+				std::cerr << "usage: " << argv[0] << " [--csv | --json] [iterations]\n";
+				return 1;
+			}
+		}
+	}
+
+	reporter out(format);
+	out.begin(iterations);
+
+	// what the display produces while a number is typed in
+	const char *const typed[] = {
+		"3", "31", "314", "3.", "3.1", "3.14", "3.141", "3.1415", "3.14159", "-3.14159",
+		"1", "12", "123", "1234", "12345", "123456", "1.5e", "1.5e1", "1.5e-12", "0"
+	};
+
+	// the kind of values found in scienceconstants.xml
+	const char *const constants[] = {
+		"299792458", "6.67384e-11", "6.62606957e-34", "1.054571726e-34", "1.602176565e-19",
+		"9.10938291e-31", "1.672621777e-27", "6.02214129e23", "1.3806488e-23", "8.3144621",
+		"96485.3365", "5.670373e-8", "8.854187817e-12", "1.2566370614e-6", "0.0072973525698"
+	};
+
+	// everything else: the constants in knumber.cpp, fractions, big integers
+	const char *const mixed[] = {
+		"0", "1", "-1", "inf", "-inf", "nan", "22/7", "-355/113",
+		"1267650600228229401496703205376", "18446744073709551616", "-0.5", "1e100", "12abc"
+	};
+
+	out.group("parse");
+	run_parse(out, "typed input",       typed,     sizeof(typed) / sizeof(typed[0]),         iterations);
+	run_parse(out, "science constants", constants, sizeof(constants) / sizeof(constants[0]), iterations);
+	run_parse(out, "mixed",             mixed,     sizeof(mixed) / sizeof(mixed[0]),         iterations);
+
+	KNumber::setDefaultFractionalInput(true);
+	run_parse(out, "typed input (fractional)", typed, sizeof(typed) / sizeof(typed[0]), iterations);
+	KNumber::setDefaultFractionalInput(false);
+
+	// results which change the representation, simplify() turns integral
+	// fractions into integers and integers which fit back into 64 bits
+	{
+		const KNumber max(Q_INT64_C(9223372036854775807));
+		const KNumber big(QLatin1String("9223372036854775808"));
+		const KNumber half(QLatin1String("1/2"));
+		const KNumber third(QLatin1String("1/3"));
+
+		out.group("promotion");
+		run(out, "INT64_MAX + 1, spills to a big integer",   "", "", 0, op_add, max,   KNumber(1), iterations);
+		run(out, "2^63 - 1, fits in 64 bits again",           "", "", 0, op_sub, big,   KNumber(1), iterations);
+		run(out, "1 / 3, gives a fraction",                   "", "", 0, op_div, KNumber(1), KNumber(3), iterations);
+		run(out, "1/2 + 1/2, fraction becomes an integer",    "", "", 0, op_add, half,  half,  iterations);
+		run(out, "1/3 * 3, fraction becomes an integer",      "", "", 0, op_mul, third, KNumber(3), iterations);
+		run(out, "0.5 * 2, float stays a float",              "", "", 0, op_mul, KNumber(QLatin1String("0.5")), KNumber(2), iterations);
+	}
+
+	const operand_set small = make_small_operands();
+
+	// the operand sizes go together with the float precisions, numbers with
+	// more digits usually come with a higher precision. the precisions are
+	// in decimal digits, which is 64, 383 and 3359 bits
+	const int sizes[]      = { 4, 100, 1000 };
+	const int precisions[] = { 0, 115, 1011 };
+
+	for(unsigned int level = 0; level < sizeof(sizes) / sizeof(sizes[0]); ++level) {
+
+		// the operands have to be created in the context to get its precision
+		KNumberContext context = KNumberContext::current();
+		context.setFloatPrecision(precisions[level]);
+		const KNumberContext::Scope scope(context);
+
+		const operand_set ops = make_operands(sizes[level]);
+		const int digits = sizes[level];
+		const std::string bits = std::to_string(context.floatPrecisionBits());
+
+		out.group("binary operations, " + std::to_string(digits) + " digits, " + bits + " bits");
+
+		for(unsigned int op = 0; op < sizeof(binary_operations) / sizeof(binary_operations[0]); ++op) {
+			for(int l = KNumber::TYPE_ERROR; l <= KNumber::TYPE_FRACTION; ++l) {
+				for(int r = KNumber::TYPE_ERROR; r <= KNumber::TYPE_FRACTION; ++r) {
+					run(out, binary_operations[op].name, type_names[l], type_names[r], digits, binary_operations[op].func, ops.lhs[l], ops.rhs[r], iterations);
+				}
+			}
+		}
+
+		for(unsigned int op = 0; op < sizeof(small_rhs_operations) / sizeof(small_rhs_operations[0]); ++op) {
+			for(int l = KNumber::TYPE_ERROR; l <= KNumber::TYPE_FRACTION; ++l) {
+				for(int r = KNumber::TYPE_ERROR; r <= KNumber::TYPE_FRACTION; ++r) {
+					run(out, small_rhs_operations[op].name, type_names[l], type_names[r], digits, small_rhs_operations[op].func, ops.lhs[l], small.rhs[r], iterations);
+				}
+			}
+		}
+
+		out.group("unary operations, " + std::to_string(digits) + " digits, " + bits + " bits");
+
+		for(unsigned int op = 0; op < sizeof(unary_operations) / sizeof(unary_operations[0]); ++op) {
+			for(int l = KNumber::TYPE_ERROR; l <= KNumber::TYPE_FRACTION; ++l) {
+				run(out, unary_operations[op].name, type_names[l], "", digits, unary_operations[op].func, ops.lhs[l], ops.lhs[l], iterations);
+			}
+		}
+
+		out.group("toQString, " + std::to_string(digits) + " digits, " + bits + " bits");
+
+		for(int l = KNumber::TYPE_ERROR; l <= KNumber::TYPE_FRACTION; ++l) {
+			run(out, "toQString()", type_names[l], "", digits, op_string, ops.lhs[l], ops.lhs[l], iterations);
+			run(out, "toQString(12, 8)", type_names[l], "", digits, op_display, ops.lhs[l], ops.lhs[l], iterations);
+		}
+
+		{
+			KNumberContext float_output = context;
+			float_output.setFloatOutput(true);
+			const KNumberContext::Scope float_scope(float_output);
+			run(out, "toQString() as float", type_names[KNumber::TYPE_FRACTION], "", digits, op_string, ops.lhs[KNumber::TYPE_FRACTION], ops.lhs[KNumber::TYPE_FRACTION], iterations);
+		}
+
+		// keeping a value as binary rather than as its decimal string
+		out.group("serialize, " + std::to_string(digits) + " digits, " + bits + " bits");
+
+		for(int l = KNumber::TYPE_ERROR; l <= KNumber::TYPE_FRACTION; ++l) {
+			run(out, "serialize()", type_names[l], "", digits, op_serialize, ops.lhs[l], ops.lhs[l], iterations);
+			run(out, "deserialize(serialize())", type_names[l], "", digits, op_binary_round_trip, ops.lhs[l], ops.lhs[l], iterations);
+			run(out, "KNumber(toQString())", type_names[l], "", digits, op_string_round_trip, ops.lhs[l], ops.lhs[l], iterations);
+		}
+
+		// the transcendental functions only make sense for moderate arguments,
+		// they are timed at each precision
+		const operand_set args = make_function_operands();
+
+		out.group("functions, " + bits + " bits");
+
+		for(unsigned int op = 0; op < sizeof(functions) / sizeof(functions[0]); ++op) {
+			for(int l = KNumber::TYPE_ERROR; l <= KNumber::TYPE_FRACTION; ++l) {
+				run(out, functions[op].name, type_names[l], "", 0, functions[op].func, args.lhs[l], args.lhs[l], iterations);
+			}
+		}
+	}
+
+	// at the precision KCalc shows by default most functions can be answered
+	// from a double
+	KNumber::setDefaultFloatPrecision(12);
+	{
+		const operand_set args = make_function_operands();
+
+		out.group("functions, 12 digits");
+
+		for(unsigned int op = 0; op < sizeof(functions) / sizeof(functions[0]); ++op) {
+			run(out, functions[op].name, type_names[KNumber::TYPE_FLOAT], "", 0, functions[op].func, args.lhs[KNumber::TYPE_FLOAT], args.lhs[KNumber::TYPE_FLOAT], iterations);
+		}
+	}
+
+	// these grow with the value of the operand rather than its size
+	{
+		out.group("factorial and binomial");
+
+		const int values[] = { 20, 200, 2000 };
+		for(unsigned int i = 0; i < sizeof(values) / sizeof(values[0]); ++i) {
+			const KNumber n(values[i]);
+			run(out, std::to_string(values[i]) + "!", "", "", 0, op_factorial, n, n, iterations);
+			run(out, "bin(" + std::to_string(values[i]) + ", " + std::to_string(values[i] / 2) + ")", "", "", 0, op_bin, n, KNumber(values[i] / 2), iterations);
+		}
+
+		const KNumber x(QLatin1String("20.5"));
+		run(out, "20.5!", "", "", 0, op_factorial, x, x, iterations);
+	}
+
+	// the thread pool against mpz_fac_ui, which is what one thread gives
+	{
+		out.group("big factorials, 1 thread and the thread pool");
+
+		const int values[] = { 120000, 400000, 1000000 };
+		for(unsigned int i = 0; i < sizeof(values) / sizeof(values[0]); ++i) {
+			const KNumber n(values[i]);
+			KNumber::setThreadCount(1);
+			run(out, std::to_string(values[i]) + "!, 1 thread", "", "", 0, op_factorial, n, n, qMax(iterations / 40000, 1));
+			KNumber::setThreadCount(0);
+			run(out, std::to_string(values[i]) + "!, thread pool", "", "", 0, op_factorial, n, n, qMax(iterations / 40000, 1));
+		}
+	}
+
+	// the GCD after every addition against one every now and then
+	{
+		out.group("decimal fraction sums, 100000 values");
+
+		KNumber::setDefaultFractionalInput(true);
+		run_decimal_sum(out, "sum", false, 100000);
+		run_decimal_sum(out, "sum, lazy reduction", true, 100000);
+		KNumber::setDefaultFractionalInput(false);
+	}
+
+	// what KStats works on, with and without the double lane
+	{
+		out.group("data sets, 1000 values, " + std::string(detail::knumber_simd::name()));
+
+		KNumberArray integers;
+		KNumberArray halves;
+		KNumberArray decimals;
+		for(int i = 0; i < 1000; ++i) {
+			integers.append(KNumber(i * 37 - 5000));
+			halves.append(KNumber(i) + KNumber(QLatin1String("0.5")));
+			decimals.append(KNumber(QString::fromLatin1("%1.%2").arg(i).arg(i % 10)));
+		}
+
+		run_data_set(out, "integer", integers, iterations);
+		run_data_set(out, "double", halves, iterations);
+		run_data_set(out, "decimal", decimals, iterations);
+	}
+
+	out.end();
+	return 0;
+}
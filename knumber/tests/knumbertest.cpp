@@ -20,10 +20,21 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
 #include "knumber.h"
+#include "knumber_allocator.h"
+#include "knumber_array.h"
+#include "knumber_context.h"
+#include "knumber_float.h"
+#include <QAtomicInt>
+#include <QByteArray>
+#include <QDataStream>
+#include <QFuture>
 #include <QString>
+#include <QtConcurrentRun>
+#include <atomic>
 #include <cstdlib>
 #include <iostream>
 #include <limits>
+#include <utility>
 
 namespace {
 const int precision = 12;
@@ -158,6 +169,15 @@ void testingCompare() {
 	checkTruth("KNumber(3.2) < KNumber(3)", KNumber(3.2) < KNumber(3), false);
 
 	checkTruth("KNumber(3.2) < KNumber(\"3/5\")", KNumber(3.2) < KNumber(QLatin1String("3/5")), false);
+
+	// mixed types are compared exactly
+	const KNumber big = (KNumber(1) << KNumber(200)) + KNumber(1);
+	checkTruth("KNumber(2.5) == KNumber(\"5/2\")", KNumber(2.5) == KNumber(QLatin1String("5/2")), true);
+	checkTruth("KNumber(-2.5) < KNumber(-2)", KNumber(-2.5) < KNumber(-2), true);
+	checkTruth("KNumber(\"7/2\") > KNumber(3)", KNumber(QLatin1String("7/2")) > KNumber(3), true);
+	checkTruth("KNumber(3) < KNumber(\"7/2\")", KNumber(3) < KNumber(QLatin1String("7/2")), true);
+	checkTruth("2^200 + 1 > 2^200 as a float", big > (KNumber(1) << KNumber(200)) * KNumber(1.0), true);
+	checkTruth("2^200 as a float < 2^200 + 1", (KNumber(1) << KNumber(200)) * KNumber(1.0) < big, true);
 }
 
 
@@ -329,6 +349,10 @@ void testingDivisions() {
 	checkResult("KNumber(\"-5/3\") / KNumber(0)", KNumber(QLatin1String("-5/3")) / KNumber(0), QLatin1String("nan"), KNumber::TYPE_ERROR);
 	checkResult("KNumber(\"5/3\") / KNumber(\"2/3\")", KNumber(QLatin1String("5/3")) / KNumber(QLatin1String("2/3")), QLatin1String("5/2"), KNumber::TYPE_FRACTION);
 	checkResult("KNumber(\"49/3\") / KNumber(\"7/9\")", KNumber(QLatin1String("49/3")) / KNumber(QLatin1String("7/9")), QLatin1String("21"), KNumber::TYPE_INTEGER);
+	checkResult("KNumber(\"3/4\") / KNumber(-6)", KNumber(QLatin1String("3/4")) / KNumber(-6), QLatin1String("-1/8"), KNumber::TYPE_FRACTION);
+	checkResult("KNumber(\"3/4\") * KNumber(-6)", KNumber(QLatin1String("3/4")) * KNumber(-6), QLatin1String("-9/2"), KNumber::TYPE_FRACTION);
+	checkResult("KNumber(\"3/4\") / (2^70 * 3)", KNumber(QLatin1String("3/4")) / ((KNumber(1) << KNumber(70)) * KNumber(3)), QLatin1String("1/4722366482869645213696"), KNumber::TYPE_FRACTION);
+	checkResult("KNumber(7) - KNumber(\"1/3\")", KNumber(7) - KNumber(QLatin1String("1/3")), QLatin1String("20/3"), KNumber::TYPE_FRACTION);
 	checkResult("KNumber(\"5/2\") / KNumber(2.5)", KNumber(QLatin1String("5/2")) / KNumber(2.5), QLatin1String("1"), KNumber::TYPE_INTEGER);
 	checkResult("KNumber(\"5/2\") / KNumber(0.0)", KNumber(QLatin1String("5/2")) / KNumber(0.0), QLatin1String("nan"), KNumber::TYPE_ERROR);
 	checkResult("KNumber(\"-5/2\") / KNumber(0.0)", KNumber(QLatin1String("-5/2")) / KNumber(0.0), QLatin1String("nan"), KNumber::TYPE_ERROR);
@@ -469,6 +493,39 @@ void testingFactorial() {
 	checkResult("KNumber(3.5).factorial()", KNumber(3.5).factorial(), QLatin1String("6"), KNumber::TYPE_INTEGER);
 }
 
+void testingThreads() {
+
+	std::cout << "\n\n";
+	std::cout << "Testing operations split over threads:\n";
+	std::cout << "--------------------------------------\n";
+
+	KNumber::setThreadCount(1);
+	const KNumber factorial = KNumber(100001).factorial();
+
+	// the same results whichever way the range is cut
+	KNumber::setThreadCount(8);
+	checkTruth("8 threads: KNumber(100001).factorial()", KNumber(100001).factorial() == factorial, true);
+	KNumber::setThreadCount(13);
+	checkTruth("13 threads: KNumber(100001).factorial()", KNumber(100001).factorial() == factorial, true);
+	KNumber::setThreadCount(64);
+	checkTruth("64 threads: KNumber(100001).factorial()", KNumber(100001).factorial() == factorial, true);
+	checkTruth("64 threads: KNumber(250000).bin(100001)", KNumber(250000).bin(KNumber(100001)) == KNumber(250000).bin(KNumber(149999)), true);
+
+	KNumber::setThreadCount(8);
+	QAtomicInt flag(1);
+	KNumber::setCancelFlag(&flag);
+	checkResult("8 threads, canceled: KNumber(100001).factorial()", KNumber(100001).factorial(), QLatin1String("nan"), KNumber::TYPE_ERROR);
+	checkResult("8 threads, canceled: KNumber(250000).bin(100001)", KNumber(250000).bin(KNumber(100001)), QLatin1String("nan"), KNumber::TYPE_ERROR);
+	KNumber::setCancelFlag(0);
+
+	KNumber::setMemoryBudget(0, detail::knumber_allocator::in_use() + 100000);
+	checkResult("8 threads, process budget: KNumber(100001).factorial()", KNumber(100001).factorial(), QLatin1String("nan"), KNumber::TYPE_ERROR);
+	KNumber::setMemoryBudget(256 << 20, 0);
+	checkTruth("8 threads: KNumber(100001).factorial() after the budget", KNumber(100001).factorial() == factorial, true);
+
+	KNumber::setThreadCount(0);
+}
+
 void testingComplement() {
 	std::cout << "\n\n";
 	std::cout << "Testing complement:\n";
@@ -507,6 +564,491 @@ void testingShifts() {
 	checkResult("KNumber(16) >> KNumber(2)", KNumber(16) >> KNumber(2), QLatin1String("4"), KNumber::TYPE_INTEGER);
 }
 
+void testingCopyAndMove() {
+
+	std::cout << "\n\n";
+	std::cout << "Testing copy and move:\n";
+	std::cout << "----------------------\n";
+
+	KNumber a(QLatin1String("2.5"));
+	const KNumber b(std::move(a));
+	checkResult("KNumber(std::move(KNumber(2.5)))", b, QLatin1String("2.5"), KNumber::TYPE_FLOAT);
+	checkResult("moved from KNumber", a, QLatin1String("0"), KNumber::TYPE_INTEGER);
+
+	const KNumber d(QLatin1String("1.5"));
+	KNumber e(d);
+	e += KNumber(1);
+	checkResult("copy of KNumber(1.5) += KNumber(1)", e, QLatin1String("2.5"), KNumber::TYPE_FLOAT);
+	checkResult("original KNumber(1.5)", d, QLatin1String("1.5"), KNumber::TYPE_FLOAT);
+
+	KNumber f(KNumber::NegInfinity);
+	f += KNumber::PosInfinity;
+	checkResult("copy of KNumber::NegInfinity += KNumber::PosInfinity", f, QLatin1String("nan"), KNumber::TYPE_ERROR);
+	checkResult("KNumber::NegInfinity", KNumber::NegInfinity, QLatin1String("-inf"), KNumber::TYPE_ERROR);
+
+	KNumber c;
+	c = KNumber(QLatin1String("1/3"));
+	checkResult("c = KNumber(\"1/3\")", c, QLatin1String("1/3"), KNumber::TYPE_FRACTION);
+
+	checkResult("KNumber(\"2/3\") * (KNumber::One + KNumber(\"1/2\"))", KNumber(QLatin1String("2/3")) * (KNumber::One + KNumber(QLatin1String("1/2"))), QLatin1String("1"), KNumber::TYPE_INTEGER);
+	checkResult("KNumber(\"3.5\") - (KNumber(1) + KNumber(\"0.25\"))", KNumber(QLatin1String("3.5")) - (KNumber(1) + KNumber(QLatin1String("0.25"))), QLatin1String("2.25"), KNumber::TYPE_FLOAT);
+	checkResult("(KNumber(7) + KNumber(\"1/2\")) / KNumber(3)", (KNumber(7) + KNumber(QLatin1String("1/2"))) / KNumber(3), QLatin1String("5/2"), KNumber::TYPE_FRACTION);
+	checkResult("KNumber(-2) * (KNumber::PosInfinity + KNumber(1))", KNumber(-2) * (KNumber::PosInfinity + KNumber(1)), QLatin1String("-inf"), KNumber::TYPE_ERROR);
+	checkResult("KNumber(-2) + (KNumber::NegInfinity * KNumber(1))", KNumber(-2) + (KNumber::NegInfinity * KNumber(1)), QLatin1String("-inf"), KNumber::TYPE_ERROR);
+}
+
+void testingSmallIntegers() {
+
+	std::cout << "\n\n";
+	std::cout << "Testing 64-bit integer overflow:\n";
+	std::cout << "--------------------------------\n";
+
+	const KNumber max(std::numeric_limits<qint64>::max());
+	const KNumber min(std::numeric_limits<qint64>::min());
+	const KNumber max_plus_one(QLatin1String("9223372036854775808"));
+
+	checkTruth("KNumber(INT64_MAX) + KNumber(1) == 9223372036854775808", max + KNumber(1) == max_plus_one, true);
+	checkTruth("KNumber(INT64_MIN) - KNumber(1) == -9223372036854775809", min - KNumber(1) == KNumber(QLatin1String("-9223372036854775809")), true);
+	checkTruth("KNumber(INT64_MAX) * KNumber(2) == 18446744073709551614", max * KNumber(2) == KNumber(QLatin1String("18446744073709551614")), true);
+	checkTruth("KNumber(INT64_MIN) / KNumber(-1) == 9223372036854775808", min / KNumber(-1) == max_plus_one, true);
+	checkTruth("-KNumber(INT64_MIN) == 9223372036854775808", -min == max_plus_one, true);
+	checkTruth("KNumber(INT64_MIN).abs() == 9223372036854775808", min.abs() == max_plus_one, true);
+
+	// -(2^63) fits in 64 bits and is moved back inline
+	const quint64 inlined = KNumber::statistics().inlined;
+	checkTruth("-KNumber(9223372036854775808) == KNumber(INT64_MIN)", -max_plus_one == min, true);
+	checkTruth("-KNumber(9223372036854775808) is inline", KNumber::statistics().inlined == inlined + (KNumber::statisticsEnabled() ? 1 : 0), true);
+
+	checkTruth("KNumber(1) << KNumber(64) == 18446744073709551616", (KNumber(1) << KNumber(64)) == KNumber(QLatin1String("18446744073709551616")), true);
+	checkTruth("KNumber(INT64_MAX) + KNumber(1) > KNumber(INT64_MAX)", max + KNumber(1) > max, true);
+	checkTruth("KNumber(INT64_MIN) < KNumber(INT64_MAX)", min < max, true);
+	checkTruth("KNumber(INT64_MAX) + KNumber(1) - KNumber(1) == KNumber(INT64_MAX)", max + KNumber(1) - KNumber(1) == max, true);
+	checkTruth("KNumber(INT64_MAX) * KNumber(2) / KNumber(2) == KNumber(INT64_MAX)", max * KNumber(2) / KNumber(2) == max, true);
+	checkTruth("(KNumber(INT64_MAX) + KNumber(1)).toQString() == \"9223372036854775808\"", (max + KNumber(1)).toQString() == QLatin1String("9223372036854775808"), true);
+	checkTruth("KNumber(Q_UINT64_C(18446744073709551615)).toUint64() == 18446744073709551615", KNumber(Q_UINT64_C(18446744073709551615)).toUint64() == Q_UINT64_C(18446744073709551615), true);
+
+	// out of range, toUint64() wraps around and toInt64() saturates
+	const KNumber big = (KNumber(1) << KNumber(70)) + KNumber(5);
+	checkTruth("(KNumber(INT64_MAX) + KNumber(1)).toUint64() == 9223372036854775808", (max + KNumber(1)).toUint64() == Q_UINT64_C(9223372036854775808), true);
+	checkTruth("(KNumber(INT64_MAX) + KNumber(1)).toInt64() == INT64_MAX", (max + KNumber(1)).toInt64() == std::numeric_limits<qint64>::max(), true);
+	checkTruth("(KNumber(INT64_MIN) - KNumber(1)).toUint64() == 9223372036854775807", (min - KNumber(1)).toUint64() == Q_UINT64_C(9223372036854775807), true);
+	checkTruth("(KNumber(INT64_MIN) - KNumber(1)).toInt64() == INT64_MIN", (min - KNumber(1)).toInt64() == std::numeric_limits<qint64>::min(), true);
+	checkTruth("(2^70 + 5).toUint64() == 5", big.toUint64() == 5, true);
+	checkTruth("(2^70 + 5).toInt64() == INT64_MAX", big.toInt64() == std::numeric_limits<qint64>::max(), true);
+	checkTruth("(-(2^70 + 5)).toUint64() == 18446744073709551611", (-big).toUint64() == Q_UINT64_C(18446744073709551611), true);
+	checkTruth("(-(2^70 + 5)).toInt64() == INT64_MIN", (-big).toInt64() == std::numeric_limits<qint64>::min(), true);
+	checkTruth("(-(2^70 + 5) / 2).toInt64() == INT64_MIN", (-big / KNumber(2)).toInt64() == std::numeric_limits<qint64>::min(), true);
+	checkTruth("KNumber::NaN.toUint64() == 0", KNumber::NaN.toUint64() == 0, true);
+
+	checkType("KNumber(INT64_MAX) + KNumber(1)", (max + KNumber(1)).type(), KNumber::TYPE_INTEGER);
+	checkType("KNumber(INT64_MAX) * KNumber(INT64_MAX)", (max * max).type(), KNumber::TYPE_INTEGER);
+
+	checkResult("KNumber(INT64_MIN) % KNumber(-1)", min % KNumber(-1), QLatin1String("0"), KNumber::TYPE_INTEGER);
+	checkResult("KNumber(-7) % KNumber(3)", KNumber(-7) % KNumber(3), QLatin1String("2"), KNumber::TYPE_INTEGER);
+	checkResult("KNumber(7) / KNumber(-2)", KNumber(7) / KNumber(-2), QLatin1String("-7/2"), KNumber::TYPE_FRACTION);
+}
+
+void testingSameOperand() {
+
+	std::cout << "\n\n";
+	std::cout << "Testing a number on both sides:\n";
+	std::cout << "-------------------------------\n";
+
+	// the value is replaced by one of another kind before the operation is
+	// done with the right hand side
+	KNumber g(QLatin1String("123456789012345678901234567890"));
+	g /= g;
+	checkResult("x = KNumber(\"123456789012345678901234567890\"), x /= x", g, QLatin1String("1"), KNumber::TYPE_INTEGER);
+
+	KNumber h(QLatin1String("2/3"));
+	h *= h;
+	checkResult("x = KNumber(\"2/3\"), x *= x", h, QLatin1String("4/9"), KNumber::TYPE_FRACTION);
+
+	KNumber i(QLatin1String("1.25"));
+	i += i;
+	checkResult("x = KNumber(\"1.25\"), x += x", i, QLatin1String("2.5"), KNumber::TYPE_FLOAT);
+
+	KNumber j(KNumber::PosInfinity);
+	j -= j;
+	checkResult("x = KNumber::PosInfinity, x -= x", j, QLatin1String("nan"), KNumber::TYPE_ERROR);
+}
+
+void testingArray() {
+
+	std::cout << "\n\n";
+	std::cout << "Testing KNumberArray:\n";
+	std::cout << "---------------------\n";
+
+	const KNumber max(std::numeric_limits<qint64>::max());
+
+	KNumberArray a;
+	a.append(KNumber(3));
+	a.append(max);
+	a.append(max);
+	a.append(KNumber(QLatin1String("1/3")));
+	a.append(KNumber(QLatin1String("-5")));
+
+	checkResult("KNumberArray {3, INT64_MAX, INT64_MAX, 1/3, -5}.sum()", a.sum(), QLatin1String("55340232221128654837/3"), KNumber::TYPE_FRACTION);
+	checkResult("KNumberArray {3, INT64_MAX, INT64_MAX, 1/3, -5}.sumOfSquares()", a.sumOfSquares(), QLatin1String("1531270651144223085253144340116185022789/9"), KNumber::TYPE_FRACTION);
+	checkTruth("KNumberArray.at(1) == INT64_MAX", a.at(1) == max, true);
+	checkTruth("KNumberArray.isExact()", a.isExact(), true);
+
+	a.removeLast();
+	a.removeLast();
+	checkTruth("KNumberArray {3, INT64_MAX, INT64_MAX}.sum() == 18446744073709551617", a.sum() == KNumber(QLatin1String("18446744073709551617")), true);
+	checkTruth("KNumberArray.size() == 3", a.size() == 3, true);
+
+	KNumberArray b;
+	b.append(KNumber(QLatin1String("0.5")));
+	b.append(KNumber(QLatin1String("1.25")));
+	b.append(KNumber(4));
+	checkResult("KNumberArray {0.5, 1.25, 4}.sum()", b.sum(), QLatin1String("5.75"), KNumber::TYPE_FLOAT);
+	checkResult("KNumberArray {0.5, 1.25, 4}.sumOfSquares()", b.sumOfSquares(), QLatin1String("17.8125"), KNumber::TYPE_FLOAT);
+	checkTruth("KNumberArray {0.5, 1.25, 4}.isExact() == false", b.isExact(), false);
+
+	KNumberArray c;
+	c.append(KNumber(2));
+	c.append(KNumber(3));
+	c.append(KNumber(QLatin1String("2/3")));
+	checkResult("{3, INT64_MAX, INT64_MAX} . {2, 3, 2/3}", a.dot(c), QLatin1String("101457092405402533895/3"), KNumber::TYPE_FRACTION);
+	checkResult("{0.5, 1.25, 4} . {2, 3, 2/3}", b.dot(c), QLatin1String("7.41666666667"), KNumber::TYPE_FLOAT);
+
+	KNumberArray d = b;
+	d.add(c);
+	checkResult("({0.5, 1.25, 4} + {2, 3, 2/3})[0]", d.at(0), QLatin1String("2.5"), KNumber::TYPE_FLOAT);
+	checkResult("({0.5, 1.25, 4} + {2, 3, 2/3})[1]", d.at(1), QLatin1String("4.25"), KNumber::TYPE_FLOAT);
+	checkResult("({0.5, 1.25, 4} + {2, 3, 2/3})[2]", d.at(2), QLatin1String("14/3"), KNumber::TYPE_FRACTION);
+
+	d = b;
+	d.mul(c);
+	checkResult("({0.5, 1.25, 4} * {2, 3, 2/3})[0]", d.at(0), QLatin1String("1"), KNumber::TYPE_INTEGER);
+	checkResult("({0.5, 1.25, 4} * {2, 3, 2/3})[1]", d.at(1), QLatin1String("3.75"), KNumber::TYPE_FLOAT);
+
+	d = a;
+	d.scale(KNumber(2));
+	checkTruth("({3, INT64_MAX, INT64_MAX} * 2)[1] == 18446744073709551614", d.at(1) == KNumber(QLatin1String("18446744073709551614")), true);
+	d.scale(KNumber(QLatin1String("0.5")));
+	checkTruth("{3, INT64_MAX, INT64_MAX} * 2 * 0.5 == {3, INT64_MAX, INT64_MAX}", d.at(0) == KNumber(3) && d.at(1) == max && d.at(2) == max, true);
+
+	KNumberArray e;
+	e.append(KNumber(1));
+	e.append(KNumber::PosInfinity);
+	e.append(KNumber::NegInfinity);
+	checkResult("KNumberArray {1, inf, -inf}.sum()", e.sum(), QLatin1String("nan"), KNumber::TYPE_ERROR);
+	checkTruth("KNumberArray {1, inf, -inf}.isExact() == false", e.isExact(), false);
+	e.clear();
+	checkResult("KNumberArray {}.sum()", e.sum(), QLatin1String("0"), KNumber::TYPE_INTEGER);
+
+	KNumberArray f;
+	for(int i = 0; i < 5; ++i) {
+		f.append(KNumber(i) + KNumber(QLatin1String("1.5")));
+	}
+	checkResult("KNumberArray {1.5 .. 5.5}.mean()", f.mean(), QLatin1String("3.5"), KNumber::TYPE_FLOAT);
+	checkResult("KNumberArray {1.5 .. 5.5}.variance()", f.variance(), QLatin1String("2"), KNumber::TYPE_INTEGER);
+	f.setFastFloat(true);
+	checkResult("fast KNumberArray {1.5 .. 5.5}.mean()", f.mean(), QLatin1String("3.5"), KNumber::TYPE_FLOAT);
+	checkResult("fast KNumberArray {1.5 .. 5.5}.variance()", f.variance(), QLatin1String("2"), KNumber::TYPE_INTEGER);
+	checkResult("fast KNumberArray {1.5 .. 5.5}.sumOfSquares()", f.sumOfSquares(), QLatin1String("71.25"), KNumber::TYPE_FLOAT);
+
+	// the sums are compensated, and the floats rounded to the nearest double
+	f.clear();
+	for(int i = 0; i < 10; ++i) {
+		f.append(KNumber(QLatin1String("0.1")));
+	}
+	checkResult("fast KNumberArray {0.1 x 10}.sum()", f.sum(), QLatin1String("1"), KNumber::TYPE_INTEGER);
+	f.clear();
+	f.append(KNumber(QLatin1String("1000000000000000.25")));
+	f.append(KNumber(QLatin1String("0.125")));
+	f.append(-KNumber(QLatin1String("1000000000000000.25")));
+	checkResult("fast KNumberArray {1e15 + 0.25, 0.125, -1e15 - 0.25}.sum()", f.sum(), QLatin1String("0.125"), KNumber::TYPE_FLOAT);
+
+	// an integer a double doesn't hold exactly makes it all exact again
+	f.clear();
+	f.append(KNumber(QLatin1String("0.5")));
+	f.append(KNumber(QLatin1String("9007199254740993")));
+	KNumberArray g = f;
+	g.setFastFloat(false);
+	checkTruth("fast KNumberArray {0.5, 2^53 + 1}.sum() == exact sum", f.sum() == g.sum(), true);
+
+	f.clear();
+	f.append(KNumber(Q_INT64_C(3037000500)));
+	f.append(KNumber(QLatin1String("0.1")));
+	g.clear();
+	g.append(KNumber(Q_INT64_C(3037000500)));
+	g.append(KNumber(QLatin1String("0.2")));
+	KNumberArray h = f;
+	h.add(g);
+	checkResult("fast {3037000500, 0.1} + {3037000500, 0.2} [1]", h.at(1), QLatin1String("0.3"), KNumber::TYPE_FLOAT);
+	h = f;
+	h.mul(g);
+	checkTruth("fast ({3037000500, 0.1} * {3037000500, 0.2})[0] == 9223372037000250000", h.at(0) == KNumber(QLatin1String("9223372037000250000")), true);
+	checkResult("fast {3037000500, 0.1} * {3037000500, 0.2} [1]", h.at(1), QLatin1String("0.02"), KNumber::TYPE_FLOAT);
+	h.scale(KNumber(QLatin1String("0.5")));
+	checkResult("fast {9223372037000250000, 0.02} * 0.5 [1]", h.at(1), QLatin1String("0.01"), KNumber::TYPE_FLOAT);
+}
+
+void testingLazyReduction() {
+
+	std::cout << "\n\n";
+	std::cout << "Testing lazy fraction reduction:\n";
+	std::cout << "--------------------------------\n";
+
+	KNumber eager_sum = KNumber::Zero;
+	for(int i = 1; i <= 200; ++i) {
+		eager_sum += KNumber(Q_INT64_C(1), static_cast<quint64>(i));
+	}
+
+	KNumber::setLazyFractionReduction(true);
+	KNumber::setDefaultFractionalInput(true);
+
+	checkResult("lazy KNumber(2, 4)", KNumber(Q_INT64_C(2), Q_UINT64_C(4)), QLatin1String("1/2"), KNumber::TYPE_FRACTION);
+	checkResult("lazy KNumber(\"0.25\") + KNumber(\"0.75\")", KNumber(QLatin1String("0.25")) + KNumber(QLatin1String("0.75")), QLatin1String("1"), KNumber::TYPE_INTEGER);
+	checkResult("lazy KNumber(\"1.5\") + KNumber(\"0.25\")", KNumber(QLatin1String("1.5")) + KNumber(QLatin1String("0.25")), QLatin1String("7/4"), KNumber::TYPE_FRACTION);
+	checkResult("lazy KNumber(\"1.5\") * KNumber(\"0.4\")", KNumber(QLatin1String("1.5")) * KNumber(QLatin1String("0.4")), QLatin1String("3/5"), KNumber::TYPE_FRACTION);
+	checkResult("lazy KNumber(\"1.5\") / KNumber(\"0.25\")", KNumber(QLatin1String("1.5")) / KNumber(QLatin1String("0.25")), QLatin1String("6"), KNumber::TYPE_INTEGER);
+	checkResult("lazy KNumber(4, 16).sqrt()", KNumber(Q_INT64_C(4), Q_UINT64_C(16)).sqrt(), QLatin1String("1/2"), KNumber::TYPE_FRACTION);
+	checkResult("lazy KNumber(16, 54).cbrt()", KNumber(Q_INT64_C(16), Q_UINT64_C(54)).cbrt(), QLatin1String("2/3"), KNumber::TYPE_FRACTION);
+	checkResult("lazy KNumber(2, 4) ^ KNumber(-2)", KNumber(Q_INT64_C(2), Q_UINT64_C(4)).pow(KNumber(-2)), QLatin1String("4"), KNumber::TYPE_INTEGER);
+	checkTruth("lazy KNumber(2, 4) == KNumber(1, 2)", KNumber(Q_INT64_C(2), Q_UINT64_C(4)) == KNumber(Q_INT64_C(1), Q_UINT64_C(2)), true);
+	checkTruth("lazy KNumber(6, 4) < KNumber(7, 4)", KNumber(Q_INT64_C(6), Q_UINT64_C(4)) < KNumber(Q_INT64_C(7), Q_UINT64_C(4)), true);
+	checkTruth("lazy KNumber(-6, 4) < KNumber(1, 3)", KNumber(Q_INT64_C(-6), Q_UINT64_C(4)) < KNumber(Q_INT64_C(1), Q_UINT64_C(3)), true);
+	checkTruth("lazy KNumber(9, 6).toInt64() == 1", KNumber(Q_INT64_C(9), Q_UINT64_C(6)).toInt64() == 1, true);
+
+	KNumber sum = KNumber::Zero;
+	for(int i = 0; i < 1000; ++i) {
+		sum += KNumber(QLatin1String("0.001"));
+	}
+	checkResult("lazy 1000 * 0.001 added up", sum, QLatin1String("1"), KNumber::TYPE_INTEGER);
+
+	// the denominator grows past the limit here and is reduced on the way
+	KNumber lazy_sum = KNumber::Zero;
+	for(int i = 1; i <= 200; ++i) {
+		lazy_sum += KNumber(Q_INT64_C(1), static_cast<quint64>(i));
+	}
+	checkTruth("lazy sum of 1/1 .. 1/200 == eager sum", lazy_sum == eager_sum, true);
+	checkTruth("lazy sum of 1/1 .. 1/200 prints as the eager sum", lazy_sum.toQString() == eager_sum.toQString(), true);
+
+	KNumber::setDefaultFractionalInput(false);
+	KNumber::setLazyFractionReduction(false);
+}
+
+void testingLimbBudget() {
+
+	std::cout << "\n\n";
+	std::cout << "Testing the fraction limb budget:\n";
+	std::cout << "---------------------------------\n";
+
+	const KNumber three(3);
+
+	KNumber::setFractionLimbBudget(4);
+
+	KNumber x = KNumber::One;
+	for(int i = 0; i < 10; ++i) {
+		x /= three;
+	}
+	checkResult("budget 4: 1 / 3^10", x, QLatin1String("1/59049"), KNumber::TYPE_FRACTION);
+
+	// 3^200 needs more than 4 limbs
+	KNumber::resetStatistics();
+	for(int i = 10; i < 200; ++i) {
+		x /= three;
+	}
+	checkTruth("budget 4: 1 / 3^200 is a float", x.type() == KNumber::TYPE_FLOAT, true);
+	checkTruth("budget 4: fractionOverflows counted", KNumber::statistics().fractionOverflows == (KNumber::statisticsEnabled() ? 1 : 0), true);
+	checkTruth("budget 4: 1 / 3^200 * 3^200 is about 1", (x * three.pow(KNumber(200)) - KNumber::One).abs() < KNumber(QLatin1String("1e-15")), true);
+
+	KNumber::setFractionLimbBudget(4, KNumber::FRACTION_OVERFLOW_TO_ERROR);
+
+	KNumber y = KNumber::One;
+	for(int i = 0; i < 200; ++i) {
+		y /= three;
+	}
+	checkResult("budget 4, error: 1 / 3^200", y, QLatin1String("nan"), KNumber::TYPE_ERROR);
+
+	// in lowest terms the sum fits, unreduced it would not
+	KNumber::setFractionLimbBudget(16);
+	KNumber::setLazyFractionReduction(true);
+
+	KNumber sum = KNumber::Zero;
+	for(int i = 1; i <= 200; ++i) {
+		sum += KNumber(Q_INT64_C(1), static_cast<quint64>(i));
+	}
+	checkTruth("budget 16, lazy: sum of 1/1 .. 1/200 is a fraction", sum.type() == KNumber::TYPE_FRACTION, true);
+
+	KNumber::setLazyFractionReduction(false);
+	KNumber::setFractionLimbBudget(0);
+
+	KNumber z = KNumber::One;
+	for(int i = 0; i < 200; ++i) {
+		z /= three;
+	}
+	checkTruth("no budget: 1 / 3^200 is a fraction", z.type() == KNumber::TYPE_FRACTION, true);
+}
+
+void testingCancel() {
+
+	std::cout << "\n\n";
+	std::cout << "Testing cancelable operations:\n";
+	std::cout << "------------------------------\n";
+
+	const KNumber factorial = KNumber(30001).factorial();
+	const KNumber binomial  = KNumber(100000).bin(KNumber(50001));
+	const KNumber power     = KNumber(3).pow(KNumber(1000001));
+
+	QAtomicInt flag(0);
+	KNumber::setCancelFlag(&flag);
+
+	// worked out in steps, with the same results
+	checkTruth("cancel flag: KNumber(30001).factorial()", KNumber(30001).factorial() == factorial, true);
+	checkTruth("cancel flag: KNumber(100000).bin(50001)", KNumber(100000).bin(KNumber(50001)) == binomial, true);
+	checkTruth("cancel flag: KNumber(100000).bin(99999)", KNumber(100000).bin(KNumber(99999)) == KNumber(100000), true);
+	checkTruth("cancel flag: KNumber(100000).bin(100000)", KNumber(100000).bin(KNumber(100000)) == KNumber::One, true);
+	checkTruth("cancel flag: KNumber(3) ^ KNumber(1000001)", KNumber(3).pow(KNumber(1000001)) == power, true);
+	checkTruth("cancel flag: KNumber(3) ^ KNumber(-1000001)", KNumber(3).pow(KNumber(-1000001)) == KNumber::One / power, true);
+
+	KNumber::setCancelFlag(0);
+	flag = 1;
+	KNumber::setCancelFlag(&flag);
+
+	checkResult("canceled: KNumber(30001).factorial()", KNumber(30001).factorial(), QLatin1String("nan"), KNumber::TYPE_ERROR);
+	checkResult("canceled: KNumber(100000).bin(50001)", KNumber(100000).bin(KNumber(50001)), QLatin1String("nan"), KNumber::TYPE_ERROR);
+	checkResult("canceled: KNumber(3) ^ KNumber(1000001)", KNumber(3).pow(KNumber(1000001)), QLatin1String("nan"), KNumber::TYPE_ERROR);
+
+	// too small to be worth canceling
+	checkResult("canceled: KNumber(13).factorial()", KNumber(13).factorial(), QLatin1String("6227020800"), KNumber::TYPE_INTEGER);
+	checkResult("canceled: KNumber(3) ^ KNumber(20)", KNumber(3).pow(KNumber(20)), QLatin1String("3486784401"), KNumber::TYPE_INTEGER);
+
+	KNumber::setCancelFlag(0);
+
+	checkTruth("no cancel flag: KNumber(30001).factorial()", KNumber(30001).factorial() == factorial, true);
+}
+
+// allocates 768 KiB in a budget scope which shares the growth of an
+// operation on another thread, returns true if that goes over the budget
+bool overBudgetInScope(std::atomic<qint64> *growth) {
+
+	bool exceeded = false;
+	mpz_t x;
+	mpz_init(x);
+	detail::knumber_budget_scope scope(1 << 23, growth);
+	try {
+		mpz_realloc2(x, 768 * 1024 * 8);
+		detail::knumber_budget_scope::check();
+	} catch(const detail::knumber_budget_exceeded &) {
+		exceeded = true;
+	}
+	mpz_clear(x);
+	return exceeded;
+}
+
+void testingMemoryBudget() {
+
+	std::cout << "\n\n";
+	std::cout << "Testing the memory budget:\n";
+	std::cout << "--------------------------\n";
+
+	// with the default budget
+	checkTruth("KNumber(2) ^ KNumber(3000000000) is a float", KNumber(2).pow(KNumber(Q_INT64_C(3000000000))).type() == KNumber::TYPE_FLOAT, true);
+	checkTruth("KNumber(1/2) ^ KNumber(3000000000) is a float", KNumber(QLatin1String("1/2")).pow(KNumber(Q_INT64_C(3000000000))).type() == KNumber::TYPE_FLOAT, true);
+	checkResult("KNumber(1) ^ KNumber(10^30)", KNumber(1).pow(KNumber(QLatin1String("1000000000000000000000000000000"))), QLatin1String("1"), KNumber::TYPE_INTEGER);
+	checkResult("KNumber(10^20).factorial()", KNumber(QLatin1String("100000000000000000000")).factorial(), QLatin1String("inf"), KNumber::TYPE_ERROR);
+
+	const KNumber big = KNumber(3).pow(KNumber(3000000));
+
+	KNumber::setMemoryBudget(1 << 20, 0);
+
+	checkTruth("budget 1 MiB: KNumber(3) ^ KNumber(10000000) is a float", KNumber(3).pow(KNumber(10000000)).type() == KNumber::TYPE_FLOAT, true);
+	checkTruth("budget 1 MiB: KNumber(3) ^ KNumber(100000) is an integer", KNumber(3).pow(KNumber(100000)).type() == KNumber::TYPE_INTEGER, true);
+	checkResult("budget 1 MiB: KNumber(1000000).factorial()", KNumber(1000000).factorial(), QLatin1String("inf"), KNumber::TYPE_ERROR);
+	checkTruth("budget 1 MiB: KNumber(50000).factorial() is an integer", KNumber(50000).factorial().type() == KNumber::TYPE_INTEGER, true);
+	checkResult("budget 1 MiB: KNumber(10000000).bin(5000000)", KNumber(10000000).bin(KNumber(5000000)), QLatin1String("inf"), KNumber::TYPE_ERROR);
+	checkResult("budget 1 MiB: KNumber(1) << KNumber(10000000)", KNumber(1) << KNumber(10000000), QLatin1String("inf"), KNumber::TYPE_ERROR);
+	checkResult("budget 1 MiB: KNumber(-1) << KNumber(10000000)", KNumber(-1) << KNumber(10000000), QLatin1String("-inf"), KNumber::TYPE_ERROR);
+	checkTruth("budget 1 MiB: 3^3000000 * 3^3000000 is a float", (big * big).type() == KNumber::TYPE_FLOAT, true);
+
+	// the threads of an operation share its budget
+	{
+		detail::knumber_budget_scope scope(1 << 23);
+		mpz_t x;
+		mpz_init2(x, 768 * 1024 * 8);
+		checkTruth("budget 1 MiB: 768 KiB on each of two threads", QtConcurrent::run(overBudgetInScope, detail::knumber_budget_scope::growth()).result(), true);
+		mpz_clear(x);
+		checkTruth("budget 1 MiB: 768 KiB on a second thread after the first freed its 768 KiB", QtConcurrent::run(overBudgetInScope, detail::knumber_budget_scope::growth()).result(), false);
+	}
+
+	// the estimate passes, but the memory in use is already close to the
+	// process budget
+	KNumber::setMemoryBudget(0, detail::knumber_allocator::in_use() + 100000);
+
+	checkResult("process budget: KNumber(100000).factorial()", KNumber(100000).factorial(), QLatin1String("nan"), KNumber::TYPE_ERROR);
+
+	QAtomicInt flag(0);
+	KNumber::setCancelFlag(&flag);
+	checkResult("process budget, cancel flag: KNumber(100000).factorial()", KNumber(100000).factorial(), QLatin1String("nan"), KNumber::TYPE_ERROR);
+	KNumber::setCancelFlag(0);
+
+	checkResult("process budget: KNumber(13).factorial()", KNumber(13).factorial(), QLatin1String("6227020800"), KNumber::TYPE_INTEGER);
+
+	KNumber::setMemoryBudget(256 << 20, 0);
+
+	checkTruth("default budget: KNumber(100000).factorial() is an integer", KNumber(100000).factorial().type() == KNumber::TYPE_INTEGER, true);
+}
+
+void testingResultCache() {
+
+	std::cout << "\n\n";
+	std::cout << "Testing the result cache:\n";
+	std::cout << "-------------------------\n";
+
+	const bool counted = KNumber::statisticsEnabled();
+
+	const KNumber factorial = KNumber(1000).factorial();
+	const KNumber binomial  = KNumber(1000).bin(KNumber(500));
+	const KNumber power     = KNumber(3).pow(KNumber(1000));
+	const KNumber gamma     = KNumber(QLatin1String("10.5")).tgamma();
+
+	KNumber::setResultCacheSize(1 << 20);
+	KNumber::resetStatistics();
+
+	checkTruth("cache: KNumber(1000).factorial()", KNumber(1000).factorial() == factorial, true);
+	checkTruth("cache: KNumber(1000).factorial() again", KNumber(1000).factorial() == factorial, true);
+	checkTruth("cache: KNumber(1000).bin(500) again", KNumber(1000).bin(KNumber(500)) == binomial && KNumber(1000).bin(KNumber(500)) == binomial, true);
+	checkTruth("cache: KNumber(3) ^ KNumber(1000) again", KNumber(3).pow(KNumber(1000)) == power && KNumber(3).pow(KNumber(1000)) == power, true);
+	checkTruth("cache: KNumber(10.5).tgamma() again", KNumber(QLatin1String("10.5")).tgamma() == gamma && KNumber(QLatin1String("10.5")).tgamma() == gamma, true);
+	checkTruth("cache: 4 hits", KNumber::statistics().cacheHits == (counted ? 4 : 0), true);
+	checkTruth("cache: 4 misses", KNumber::statistics().cacheMisses == (counted ? 4 : 0), true);
+
+	// a different precision is a miss
+	KNumber::resetStatistics();
+	KNumber::setDefaultFloatPrecision(20);
+	const KNumber gamma20 = KNumber(QLatin1String("10.5")).tgamma();
+	checkTruth("cache: precision 20, KNumber(10.5).tgamma() is a miss", KNumber::statistics().cacheHits == 0, true);
+	KNumber::setDefaultFloatPrecision(12);
+	checkTruth("cache: precision 12, KNumber(10.5).tgamma()", KNumber(QLatin1String("10.5")).tgamma() == gamma, true);
+	Q_UNUSED(gamma20);
+
+	// canceled results are not kept
+	QAtomicInt flag(1);
+	KNumber::setCancelFlag(&flag);
+	checkResult("cache, canceled: KNumber(30001).factorial()", KNumber(30001).factorial(), QLatin1String("nan"), KNumber::TYPE_ERROR);
+	KNumber::setCancelFlag(0);
+	checkTruth("cache: KNumber(30001).factorial() after a cancel", KNumber(30001).factorial().type() == KNumber::TYPE_INTEGER, true);
+
+	// 1000! (about 1 KiB) is the least recently used and has to go to make
+	// room for 3000! (about 4 KiB)
+	KNumber::setResultCacheSize(4608);
+	KNumber::clearResultCache();
+	KNumber(1000).factorial();
+	KNumber(3000).factorial();
+	KNumber::resetStatistics();
+	checkTruth("cache, 4608 bytes: KNumber(1000).factorial()", KNumber(1000).factorial() == factorial, true);
+	checkTruth("cache, 4608 bytes: KNumber(1000).factorial() was dropped", KNumber::statistics().cacheMisses == (counted ? 1 : 0), true);
+	KNumber(3000).factorial();
+	checkTruth("cache, 4608 bytes: KNumber(3000).factorial() was dropped", KNumber::statistics().cacheMisses == (counted ? 2 : 0), true);
+
+	KNumber::setResultCacheSize(0);
+}
+
 void testingPower() {
 
 	std::cout << "\n\n";
@@ -752,8 +1294,40 @@ void testingFloatPrecision() {
 	KNumber::setDefaultFloatPrecision(1000);
 	checkResult("Precision >= 1000: (KNumber(1) + KNumber(\"1e-980\")) - KNumber(1)", (KNumber(1) + KNumber(QLatin1String("1e-980"))) - KNumber(1), QLatin1String("1e-980"), KNumber::TYPE_FLOAT);
 
+	const QString pi_digits(QLatin1String("3.14159265358979323846264338327950288419716939937510582097494459230781640628620899862803482534211706"));
+	const QString e_digits(QLatin1String("2.7182818284590452353602874713526624977572470936999595749669676277240766303535475945713821785251664274"));
+	checkTruth("Precision >= 1000: KNumber::Pi() to 100 digits", KNumber::Pi().toQString(120).left(100) == pi_digits.left(100), true);
+	checkTruth("Precision >= 1000: KNumber::Euler() to 100 digits", KNumber::Euler().toQString(120).left(100) == e_digits.left(100), true);
+	checkTruth("Precision >= 1000: KNumber(\"123456789012345678901234567890.5\").floor()", KNumber(QLatin1String("123456789012345678901234567890.5")).floor() == KNumber(QLatin1String("123456789012345678901234567890")), true);
+	checkTruth("Precision >= 1000: KNumber(\"-123456789012345678901234567890.5\").ceil()", KNumber(QLatin1String("-123456789012345678901234567890.5")).ceil() == KNumber(QLatin1String("-123456789012345678901234567890")), true);
+#ifdef KNUMBER_USE_MPFR
+	checkTruth("Precision >= 1000: exp(KNumber(1)) to 100 digits", exp(KNumber(1)).toQString(120).left(100) == e_digits.left(100), true);
+	checkTruth("Precision >= 1000: KNumber(4) * atan(KNumber(1)) to 100 digits", (KNumber(4) * atan(KNumber(1))).toQString(120).left(100) == pi_digits.left(100), true);
+	checkTruth("Precision >= 1000: KNumber(2).pow(KNumber(\"0.5\")) == sqrt(KNumber(2))", KNumber(2).pow(KNumber(QLatin1String("0.5"))) == sqrt(KNumber(2)), true);
+#endif
+
 	KNumber::setDefaultFloatPrecision(20);
 	checkResult("Precision >= 20: sin(KNumber(30))", sin(KNumber(30) * (KNumber::Pi() / KNumber(180))), QLatin1String("0.5"), KNumber::TYPE_FLOAT);
+	checkResult("Precision >= 20: sin(KNumber(30) * KNumber::PiOver180())", sin(KNumber(30) * KNumber::PiOver180()), QLatin1String("0.5"), KNumber::TYPE_FLOAT);
+	checkResult("Precision >= 20: sin(KNumber(100) * KNumber::PiOver200())", sin(KNumber(100) * KNumber::PiOver200()), QLatin1String("1"), KNumber::TYPE_INTEGER);
+
+#ifdef KNUMBER_USE_MPFR
+	// at the precision KCalc shows by default a double is usually enough, the
+	// shown digits have to be the same either way
+	KNumber::setDefaultFloatPrecision(12);
+	const bool    counted = KNumber::statisticsEnabled();
+	const quint64 hits    = KNumber::statistics().fastPathHits;
+	const quint64 misses  = KNumber::statistics().fastPathMisses;
+	checkResult("Precision >= 12: sin(KNumber(\"0.5\"))", sin(KNumber(QLatin1String("0.5"))), QLatin1String("0.479425538604"), KNumber::TYPE_FLOAT);
+	checkResult("Precision >= 12: exp(KNumber(1))", exp(KNumber(1)), QLatin1String("2.71828182846"), KNumber::TYPE_FLOAT);
+	checkResult("Precision >= 12: ln(KNumber(10))", ln(KNumber(10)), QLatin1String("2.30258509299"), KNumber::TYPE_FLOAT);
+	checkTruth("Precision >= 12: fast path used", KNumber::statistics().fastPathHits == hits + (counted ? 3 : 0), true);
+	checkResult("Precision >= 12: KNumber(0).sinh()", KNumber(0).sinh(), QLatin1String("0"), KNumber::TYPE_INTEGER);
+	checkTruth("Precision >= 12: fast path declined a zero result", KNumber::statistics().fastPathMisses == misses + (counted ? 1 : 0), true);
+	checkResult("Precision >= 12: sin(KNumber(\"1e20\"))", sin(KNumber(QLatin1String("1e20"))), QLatin1String("-0.645251285266"), KNumber::TYPE_FLOAT);
+	checkTruth("Precision >= 12: fast path declined a large periodic argument", KNumber::statistics().fastPathMisses == misses + (counted ? 2 : 0), true);
+	KNumber::setDefaultFloatPrecision(20);
+#endif
 
 }
 
@@ -777,6 +1351,17 @@ void testingOutput() {
 	checkResult("Fractional output: KNumber(\"-1/4\")", KNumber(QLatin1String("-1/4")), QLatin1String("-1/4"), KNumber::TYPE_FRACTION);
 	checkResult("Fractional output: KNumber(\"21/4\")", KNumber(QLatin1String("21/4")), QLatin1String("21/4"), KNumber::TYPE_FRACTION);
 	checkResult("Fractional output: KNumber(\"-21/4\")", KNumber(QLatin1String("-21/4")), QLatin1String("-21/4"), KNumber::TYPE_FRACTION);
+
+	// rounding to a number of decimals
+	checkTruth("KNumber(5).toQString(-1, 2) == \"5.00\"", KNumber(5).toQString(-1, 2) == QLatin1String("5.00"), true);
+	checkTruth("KNumber(\"1.25\").toQString(-1, 1) == \"1.3\"", KNumber(QLatin1String("1.25")).toQString(-1, 1) == QLatin1String("1.3"), true);
+	checkTruth("KNumber(\"1.5\").toQString(-1, 3) == \"1.500\"", KNumber(QLatin1String("1.5")).toQString(-1, 3) == QLatin1String("1.500"), true);
+	checkTruth("KNumber(\"99.5\").toQString(-1, 0) == \"100\"", KNumber(QLatin1String("99.5")).toQString(-1, 0) == QLatin1String("100"), true);
+	checkTruth("KNumber(\"-0.96\").toQString(-1, 1) == \"-1.0\"", KNumber(QLatin1String("-0.96")).toQString(-1, 1) == QLatin1String("-1.0"), true);
+	checkTruth("KNumber(\"1.25e30\").toQString(4, 1) == \"1.3e+30\"", KNumber(QLatin1String("1.25e30")).toQString(4, 1) == QLatin1String("1.3e+30"), true);
+	checkTruth("KNumber(\"1.2349999999999999999999\").toQString(-1, 2) == \"1.23\"", KNumber(QLatin1String("1.2349999999999999999999")).toQString(-1, 2) == QLatin1String("1.23"), true);
+	checkTruth("KNumber(\"-0.04\").toQString(-1, 1) == \"0.0\"", KNumber(QLatin1String("-0.04")).toQString(-1, 1) == QLatin1String("0.0"), true);
+	checkTruth("KNumber(\"-21/4\").toQString(-1, 2) == \"-21/4\"", KNumber(QLatin1String("-21/4")).toQString(-1, 2) == QLatin1String("-21/4"), true);
 }
 
 void testingConstructors() {
@@ -799,10 +1384,26 @@ void testingConstructors() {
 	checkResult("KNumber(\"5e-2\")", KNumber(QLatin1String("5e-2")), QLatin1String("1/20"), KNumber::TYPE_FRACTION);
 	checkResult("KNumber(\"1.2e3\")", KNumber(QLatin1String("1.2e3")), QLatin1String("1200"), KNumber::TYPE_INTEGER);
 	checkResult("KNumber(\"0.02e+1\")", KNumber(QLatin1String("0.02e+1")), QLatin1String("1/5"), KNumber::TYPE_FRACTION);
+	checkResult("KNumber(\"+1.25e1\")", KNumber(QLatin1String("+1.25e1")), QLatin1String("25/2"), KNumber::TYPE_FRACTION);
+	checkResult("KNumber(\"12.5e-20\")", KNumber(QLatin1String("12.5e-20")), QLatin1String("1/8000000000000000000"), KNumber::TYPE_FRACTION);
 
 	KNumber::setDefaultFractionalInput(false);
 	std::cout << "Read decimals as floats:\n";
 	checkResult("KNumber(\"5.3\")", KNumber(QLatin1String("5.3")), QLatin1String("5.3"), KNumber::TYPE_FLOAT);
+	checkResult("KNumber(\"+5.3\")", KNumber(QLatin1String("+5.3")), QLatin1String("5.3"), KNumber::TYPE_FLOAT);
+	checkResult("KNumber(\".5\")", KNumber(QLatin1String(".5")), QLatin1String("0.5"), KNumber::TYPE_FLOAT);
+	checkResult("KNumber(\"5.\")", KNumber(QLatin1String("5.")), QLatin1String("5"), KNumber::TYPE_INTEGER);
+	checkResult("KNumber(\"-2.5e-3\")", KNumber(QLatin1String("-2.5e-3")), QLatin1String("-0.0025"), KNumber::TYPE_FLOAT);
+	checkResult("KNumber(\"+12\")", KNumber(QLatin1String("+12")), QLatin1String("12"), KNumber::TYPE_INTEGER);
+	checkResult("KNumber(\"+3/6\")", KNumber(QLatin1String("+3/6")), QLatin1String("1/2"), KNumber::TYPE_FRACTION);
+	checkResult("KNumber(\"-4/2\")", KNumber(QLatin1String("-4/2")), QLatin1String("-2"), KNumber::TYPE_INTEGER);
+	checkTruth("KNumber(\"-9223372036854775808\")", KNumber(QLatin1String("-9223372036854775808")) == KNumber(std::numeric_limits<qint64>::min()), true);
+	checkTruth("KNumber(\"9223372036854775808\")", KNumber(QLatin1String("9223372036854775808")) == KNumber(Q_UINT64_C(9223372036854775808)), true);
+	checkTruth("KNumber(\"123456789012345678901234567890/10\")", KNumber(QLatin1String("123456789012345678901234567890/10")) == KNumber(QLatin1String("12345678901234567890123456789")), true);
+	checkResult("KNumber(\"5/0\")", KNumber(QLatin1String("5/0")), QLatin1String("nan"), KNumber::TYPE_ERROR);
+	checkResult("KNumber(\"1e\")", KNumber(QLatin1String("1e")), QLatin1String("nan"), KNumber::TYPE_ERROR);
+	checkResult("KNumber(\"12abc\")", KNumber(QLatin1String("12abc")), QLatin1String("nan"), KNumber::TYPE_ERROR);
+	checkResult("KNumber(\"1/2/3\")", KNumber(QLatin1String("1/2/3")), QLatin1String("nan"), KNumber::TYPE_ERROR);
 
 	checkResult("KNumber(\"nan\")", KNumber(QLatin1String("nan")), QLatin1String("nan"), KNumber::TYPE_ERROR);
 	checkResult("KNumber(\"inf\")", KNumber(QLatin1String("inf")), QLatin1String("inf"), KNumber::TYPE_ERROR);
@@ -826,8 +1427,195 @@ void testingConstants() {
 	checkType(QLatin1String("KNumber::Euler"),  KNumber::Euler().type(), KNumber::TYPE_FLOAT);
 }
 
+void testingStatistics() {
+	std::cout << "\n\n";
+	std::cout << "Statistics:\n";
+	std::cout << "-----------\n";
+
+	KNumber::resetStatistics();
+
+	const KNumber half(QLatin1String("1/2"));
+	const KNumber big = KNumber(Q_INT64_C(9223372036854775807)) + KNumber(1);
+	const KNumber sum = half + half;
+	const KNumber product = big * big;
+	Q_UNUSED(sum);
+	Q_UNUSED(product);
+
+	KNumber::Statistics s = KNumber::statistics();
+	if(KNumber::statisticsEnabled()) {
+		checkTruth("statistics: objectsAllocated > 0", s.objectsAllocated > 0, true);
+		checkTruth("statistics: inlineSpills > 0", s.inlineSpills > 0, true);
+		checkTruth("statistics: fractionToInteger > 0", s.fractionToInteger > 0, true);
+		checkTruth("statistics: inlined > 0", s.inlined > 0, true);
+		checkTruth("statistics: canonicalizations > 0", s.canonicalizations > 0, true);
+		checkTruth("statistics: limbBytes > 0", s.limbBytes > 0, true);
+		checkTruth("statistics: poolHits > 0", s.poolHits > 0, true);
+	} else {
+		checkTruth("statistics: nothing counted", s.objectsAllocated == 0 && s.limbBytes == 0 && s.poolHits == 0, true);
+	}
+
+	KNumber::resetStatistics();
+	s = KNumber::statistics();
+	checkTruth("statistics: reset", s.objectsAllocated == 0 && s.inlineSpills == 0 && s.canonicalizations == 0 && s.limbBytes == 0 && s.poolHits == 0, true);
+}
+
+}
+
+
+// 1/6 as a float in a context with this many digits
+QString sixthWithPrecision(int digits) {
+	KNumberContext context = KNumberContext::current();
+	context.setFloatPrecision(digits);
+	const KNumberContext::Scope scope(context);
+	return (KNumber(QLatin1String("0.5")) / KNumber(3)).toQString();
+}
+
+QString piWithPrecision(int digits) {
+	KNumberContext context = KNumberContext::current();
+	context.setFloatPrecision(digits);
+	const KNumberContext::Scope scope(context);
+	return KNumber::Pi().toQString();
 }
 
+void testingContext() {
+
+	std::cout << "\n\n";
+	std::cout << "Testing contexts:\n";
+	std::cout << "-----------------\n";
+
+	const QString sixth30 = sixthWithPrecision(30);
+	const QString sixth60 = sixthWithPrecision(60);
+	checkTruth("30 digits: 0.5 / 3", sixth30.startsWith(QLatin1String("0.16666666666666666666666666666")), true);
+	checkTruth("60 digits: 0.5 / 3", sixth60.startsWith(QLatin1String("0.16666666666666666666666666666666666666666666666666666666666")), true);
+	checkTruth("30 digits: 0.5 / 3 is shorter than at 60", sixth30.size() < sixth60.size(), true);
+
+	// threads with a context each don't see each other's precision, nor
+	// the default one changing
+	QFuture<QString> results[8];
+	for(int i = 0; i < 8; ++i) {
+		results[i] = QtConcurrent::run(sixthWithPrecision, (i % 2) ? 60 : 30);
+	}
+	KNumber::setDefaultFloatPrecision(12);
+	KNumber::setDefaultFloatPrecision(20);
+
+	bool same = true;
+	for(int i = 0; i < 8; ++i) {
+		same = same && results[i].result() == ((i % 2) ? sixth60 : sixth30);
+	}
+	checkTruth("8 threads at 30 and 60 digits: 0.5 / 3", same, true);
+
+	// the constants are kept for each precision
+	const QString pi30 = piWithPrecision(30);
+	const QString pi60 = piWithPrecision(60);
+	QFuture<QString> pis[8];
+	for(int i = 0; i < 8; ++i) {
+		pis[i] = QtConcurrent::run(piWithPrecision, (i % 2) ? 60 : 30);
+	}
+
+	same = pi30.startsWith(QLatin1String("3.14159265358979323846264338327")) && pi60.startsWith(QLatin1String("3.14159265358979323846264338327950288419716939937510582097494"));
+	for(int i = 0; i < 8; ++i) {
+		same = same && pis[i].result() == ((i % 2) ? pi60 : pi30);
+	}
+	checkTruth("8 threads at 30 and 60 digits: KNumber::Pi()", same, true);
+	checkTruth("default context: 20 digits", KNumberContext::current().floatPrecision() == 20, true);
+
+	KNumberContext context = KNumberContext::current();
+	context.setFloatPrecision(200);
+	KNumber sixth;
+	{
+		const KNumberContext::Scope scope(context);
+		sixth = KNumber(QLatin1String("0.5")) / KNumber(3);
+	}
+
+	// a float is worked out at the precision of the context it is used in,
+	// the value it came from keeps its own
+	KNumber rounded;
+	{
+		KNumberContext lower = context;
+		lower.setFloatPrecision(20);
+		const KNumberContext::Scope scope(lower);
+		rounded = sixth + KNumber(QLatin1String("0.25"));
+		checkTruth("scope at 20 digits: KNumberContext::current().floatPrecision()", KNumberContext::current().floatPrecision() == 20, true);
+	}
+	{
+		const KNumberContext::Scope scope(context);
+		checkTruth("200 digits: 0.5 / 3 + 0.25 at 20 digits is less precise", (sixth + KNumber(QLatin1String("0.25")) - rounded).abs() > KNumber(QLatin1String("1e-100")), true);
+		checkTruth("200 digits: 0.5 / 3 keeps its precision", sixth.toQString() == sixthWithPrecision(200), true);
+	}
+
+	context.setDecimalSeparator(QLatin1String(","));
+	context.setFractionalInput(true);
+	{
+		const KNumberContext::Scope scope(context);
+		checkResult("scope with ',' and fractional input: KNumber(\"1,25\")", KNumber(QLatin1String("1,25")), QLatin1String("5/4"), KNumber::TYPE_FRACTION);
+		checkTruth("scope with ',': KNumber::decimalSeparator()", KNumber::decimalSeparator() == QLatin1String(","), true);
+	}
+	checkTruth("default context: KNumber::decimalSeparator()", KNumber::decimalSeparator() == QLatin1String("."), true);
+	checkType("default context: KNumber(\"1.25\")", KNumber(QLatin1String("1.25")).type(), KNumber::TYPE_FLOAT);
+}
+
+// the value and its type come back, and serialize the same way again
+bool roundTrips(const KNumber &x) {
+	const QByteArray data = x.serialize();
+	qint64 used = 0;
+	const KNumber y = KNumber::deserialize(data.constData(), data.size(), &used);
+	return used == data.size() && y.type() == x.type() && y.toQString() == x.toQString() && y.serialize() == data;
+}
+
+void testingSerialization() {
+
+	std::cout << "\n\n";
+	std::cout << "Testing serialization:\n";
+	std::cout << "----------------------\n";
+
+	checkTruth("KNumber(0) round trips", roundTrips(KNumber(0)), true);
+	checkTruth("KNumber(42) round trips", roundTrips(KNumber(42)), true);
+	checkTruth("KNumber(INT64_MIN) round trips", roundTrips(KNumber(std::numeric_limits<qint64>::min())), true);
+	checkTruth("KNumber(\"-340282366920938463463374607431768211456\") round trips", roundTrips(KNumber(QLatin1String("-340282366920938463463374607431768211456"))), true);
+	checkTruth("KNumber(\"-22/7\") round trips", roundTrips(KNumber(QLatin1String("-22/7"))), true);
+	checkTruth("KNumber(\"0.1\") round trips", roundTrips(KNumber(QLatin1String("0.1"))), true);
+	checkTruth("KNumber(\"-2.5e300\") round trips", roundTrips(KNumber(QLatin1String("-2.5e300"))), true);
+	checkTruth("KNumber::NaN round trips", roundTrips(KNumber::NaN), true);
+	checkTruth("KNumber::NegInfinity round trips", roundTrips(KNumber::NegInfinity), true);
+	checkTruth("KNumber(42).serialize().size() == 24", KNumber(42).serialize().size() == 24, true);
+
+	// a float is read back with its own precision, whatever the context's
+	QByteArray sixth;
+	{
+		KNumberContext context = KNumberContext::current();
+		context.setFloatPrecision(200);
+		const KNumberContext::Scope scope(context);
+		sixth = (KNumber(QLatin1String("0.5")) / KNumber(3)).serialize();
+	}
+	checkTruth("200 digits: 0.5 / 3 read back keeps its precision", KNumber::deserialize(sixth.constData(), sixth.size()).toQString() == sixthWithPrecision(200), true);
+
+	qint64 used = -1;
+	checkType("KNumber::deserialize() of a truncated value", KNumber::deserialize(sixth.constData(), sixth.size() - 1, &used).type(), KNumber::TYPE_ERROR);
+	checkTruth("KNumber::deserialize() of a truncated value: used == 0", used == 0, true);
+
+	QByteArray corrupt = KNumber(42).serialize();
+	corrupt[0] = 2;
+	checkType("KNumber::deserialize() of another version", KNumber::deserialize(corrupt.constData(), corrupt.size(), &used).type(), KNumber::TYPE_ERROR);
+
+	// a float header asking for 2^32 - 1 bits and giving no words
+	const char huge_precision[24] = { 1, KNumber::TYPE_FLOAT, 0, 0, '\xff', '\xff', '\xff', '\xff' };
+	checkType("KNumber::deserialize() of a float with a 2^32 - 1 bit precision", KNumber::deserialize(huge_precision, sizeof(huge_precision), &used).type(), KNumber::TYPE_ERROR);
+	checkTruth("KNumber::deserialize() of a float with a 2^32 - 1 bit precision: used == 0", used == 0, true);
+
+	QByteArray stream_data;
+	{
+		QDataStream out(&stream_data, QIODevice::WriteOnly);
+		out << KNumber(QLatin1String("-22/7")) << KNumber(QLatin1String("1.5"));
+	}
+
+	QDataStream in(stream_data);
+	KNumber fraction;
+	KNumber number;
+	in >> fraction >> number;
+	checkResult("QDataStream >> -22/7", fraction, QLatin1String("-22/7"), KNumber::TYPE_FRACTION);
+	checkResult("QDataStream >> 1.5", number, QLatin1String("1.5"), KNumber::TYPE_FLOAT);
+	checkTruth("QDataStream::status() == QDataStream::Ok", in.status() == QDataStream::Ok, true);
+}
 
 int main() {
 
@@ -843,15 +1631,28 @@ int main() {
 	testingAbs();
 	testingSqrt();
 	testingFactorial();
+	testingCancel();
+	testingMemoryBudget();
+	testingResultCache();
+	testingThreads();
 	testingComplement();
 	testingPower();
 	testingTruncateToInteger();
 	testingShifts();
+	testingSmallIntegers();
+	testingSameOperand();
+	testingArray();
+	testingLazyReduction();
+	testingLimbBudget();
+	testingCopyAndMove();
 	testingInfArithmetic();
 	testingFloatPrecision();
+	testingContext();
+	testingSerialization();
 	testingTrig();
 	testingSpecial();
 	testingOutput();
+	testingStatistics();
 	std::cout << "SUCCESS" << std::endl;
 }
 
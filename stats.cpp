@@ -45,12 +45,20 @@ void KStats::clearAll() {
 	data_.clear();
 }
 
+//------------------------------------------------------------------------------
+// Name: setFastFloat
+// Desc: lets data sets with floats in them be worked on in double precision
+//------------------------------------------------------------------------------
+void KStats::setFastFloat(bool x) {
+	data_.setFastFloat(x);
+}
+
 //------------------------------------------------------------------------------
 // Name: enterData
 // Desc: adds an item to the data set
 //------------------------------------------------------------------------------
 void KStats::enterData(const KNumber &data) {
-	data_.push_back(data);
+	data_.append(data);
 }
 
 //------------------------------------------------------------------------------
@@ -59,9 +67,7 @@ void KStats::enterData(const KNumber &data) {
 //------------------------------------------------------------------------------
 void KStats::clearLast() {
 
-	if(!data_.isEmpty()) {
-		data_.pop_back();
-	}
+	data_.removeLast();
 }
 
 //------------------------------------------------------------------------------
@@ -70,13 +76,7 @@ void KStats::clearLast() {
 //------------------------------------------------------------------------------
 KNumber KStats::sum() const {
 
-	KNumber result = KNumber::Zero;
-	
-	Q_FOREACH(const KNumber &x, data_) {
-		result += x;
-	}
-
-	return result;
+	return data_.sum();
 }
 
 //------------------------------------------------------------------------------
@@ -99,7 +99,7 @@ KNumber KStats::median() {
 		return data_.at(0);
 
 	// need to copy data_-list, because sorting afterwards
-	QVector<KNumber> tmp_data(data_);
+	QVector<KNumber> tmp_data = data_.toVector();
 	std::sort(tmp_data.begin(), tmp_data.end());
 
 	if (bound & 1) {    // odd
@@ -122,9 +122,7 @@ KNumber KStats::std_kernel() {
 	const KNumber mean_value = mean();
 
 	if(mean_value.type() != KNumber::TYPE_ERROR) {
-		Q_FOREACH(const KNumber &x, data_) {
-			result += (x - mean_value) * (x - mean_value);
-		}
+		result = data_.sumOfSquaredDeviations();
 	}
 
 	return result;
@@ -136,13 +134,7 @@ KNumber KStats::std_kernel() {
 //------------------------------------------------------------------------------
 KNumber KStats::sum_of_squares() const {
 
-	KNumber result = KNumber::Zero;
-
-	Q_FOREACH(const KNumber &x, data_) {
-		result += (x * x);
-	}
-
-	return result;
+	return data_.sumOfSquares();
 }
 
 //------------------------------------------------------------------------------
@@ -156,7 +148,7 @@ KNumber KStats::mean() {
 		return KNumber::Zero;
 	}
 
-	return (sum() / KNumber(count()));
+	return data_.mean();
 }
 
 //------------------------------------------------------------------------------
@@ -22,8 +22,8 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #ifndef KSTATS_H_
 #define KSTATS_H_
 
-#include <QVector>
 #include "knumber.h"
+#include "knumber_array.h"
 
 class KStats {
 public:
@@ -32,6 +32,7 @@ public:
 
 public:
     void clearAll();
+    void setFastFloat(bool x);
     void enterData(const KNumber &data);
     void clearLast();
     KNumber sum() const;
@@ -45,8 +46,8 @@ public:
     bool error();
 
 private:
-    QVector<KNumber> data_;
-    bool             error_flag_;
+    KNumberArray data_;
+    bool         error_flag_;
 };
 
 #endif